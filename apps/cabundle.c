@@ -0,0 +1,189 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "apps.h"
+#include "progs.h"
+#include "internal/o_dir.h"
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509_vfy.h>
+
+static int verbose = 0;
+static const char *extensions[] = { "pem", "crt", "cer" };
+
+typedef enum OPTION_choice {
+    OPT_ERR = -1, OPT_EOF = 0, OPT_HELP,
+    OPT_OUT, OPT_VERBOSE
+} OPTION_CHOICE;
+
+const OPTIONS cabundle_options[] = {
+    {OPT_HELP_STR, 1, '-', "Usage: %s [options] file-or-dir...\n"},
+    {OPT_HELP_STR, 1, '-', "Valid options are:\n"},
+    {"help", OPT_HELP, '-', "Display this summary"},
+    {"out", OPT_OUT, '>', "Output file - default stdout"},
+    {"v", OPT_VERBOSE, '-', "Verbose output"},
+    {NULL}
+};
+
+/* Add the certificates in PEM file |path| to |certs|, skipping duplicates */
+static int do_file(const char *path, STACK_OF(X509) *certs)
+{
+    BIO *in;
+    X509 *x;
+    int count = 0, dups = 0;
+
+    if ((in = BIO_new_file(path, "r")) == NULL) {
+        BIO_printf(bio_err, "%s: error: cannot open %s\n",
+                   opt_getprog(), path);
+        return 1;
+    }
+    while ((x = PEM_read_bio_X509(in, NULL, NULL, NULL)) != NULL) {
+        int i;
+
+        for (i = 0; i < sk_X509_num(certs); i++)
+            if (X509_cmp(sk_X509_value(certs, i), x) == 0)
+                break;
+        if (i < sk_X509_num(certs)) {
+            X509_free(x);
+            dups++;
+            continue;
+        }
+        if (!sk_X509_push(certs, x)) {
+            X509_free(x);
+            BIO_free(in);
+            BIO_puts(bio_err, "out of memory\n");
+            return 1;
+        }
+        count++;
+    }
+    BIO_free(in);
+    /* The loop above always ends with a "no start line" error */
+    ERR_clear_error();
+    if (verbose)
+        BIO_printf(bio_err, "%s: %d certificate(s), %d duplicate(s)\n",
+                   path, count, dups);
+    return 0;
+}
+
+static void str_free(char *s)
+{
+    OPENSSL_free(s);
+}
+
+static int do_dir(const char *dirname, STACK_OF(X509) *certs)
+{
+    OPENSSL_DIR_CTX *d = NULL;
+    STACK_OF(OPENSSL_STRING) *files;
+    const char *filename, *ext;
+    char *copy, *buf;
+    size_t i;
+    int n, errs = 0, buflen;
+
+    if ((files = sk_OPENSSL_STRING_new_null()) == NULL) {
+        BIO_puts(bio_err, "out of memory\n");
+        return 1;
+    }
+    while ((filename = OPENSSL_DIR_read(&d, dirname)) != NULL) {
+        if ((ext = strrchr(filename, '.')) == NULL)
+            continue;
+        for (i = 0; i < OSSL_NELEM(extensions); i++)
+            if (strcasecmp(extensions[i], ext + 1) == 0)
+                break;
+        if (i >= OSSL_NELEM(extensions))
+            continue;
+        if ((copy = OPENSSL_strdup(filename)) == NULL
+                || sk_OPENSSL_STRING_push(files, copy) == 0) {
+            OPENSSL_free(copy);
+            BIO_puts(bio_err, "out of memory\n");
+            errs = 1;
+            goto end;
+        }
+    }
+    /* Process files in a stable order so that the output is reproducible */
+    sk_OPENSSL_STRING_sort(files);
+
+    for (n = 0; n < sk_OPENSSL_STRING_num(files); n++) {
+        filename = sk_OPENSSL_STRING_value(files, n);
+        buflen = strlen(dirname) + 1 + strlen(filename) + 1;
+        buf = app_malloc(buflen, "filename buffer");
+        BIO_snprintf(buf, buflen, "%s/%s", dirname, filename);
+        errs += do_file(buf, certs);
+        OPENSSL_free(buf);
+    }
+
+ end:
+    OPENSSL_DIR_end(&d);
+    sk_OPENSSL_STRING_pop_free(files, str_free);
+    return errs;
+}
+
+int cabundle_main(int argc, char **argv)
+{
+    BIO *out = NULL;
+    STACK_OF(X509) *certs = NULL;
+    OPTION_CHOICE o;
+    char *outfile = NULL, *prog;
+    int ret = 1, errs = 0;
+
+    prog = opt_init(argc, argv, cabundle_options);
+    while ((o = opt_next()) != OPT_EOF) {
+        switch (o) {
+        case OPT_EOF:
+        case OPT_ERR:
+ opthelp:
+            BIO_printf(bio_err, "%s: Use -help for summary.\n", prog);
+            goto end;
+        case OPT_HELP:
+            opt_help(cabundle_options);
+            ret = 0;
+            goto end;
+        case OPT_OUT:
+            outfile = opt_arg();
+            break;
+        case OPT_VERBOSE:
+            verbose = 1;
+            break;
+        }
+    }
+    argc = opt_num_rest();
+    argv = opt_rest();
+    if (argc == 0)
+        goto opthelp;
+
+    if ((certs = sk_X509_new_null()) == NULL)
+        goto end;
+    for (; *argv != NULL; argv++) {
+        if (app_isdir(*argv) > 0)
+            errs += do_dir(*argv, certs);
+        else
+            errs += do_file(*argv, certs);
+    }
+    if (errs != 0)
+        goto end;
+
+    out = bio_open_default(outfile, 'w', FORMAT_ASN1);
+    if (out == NULL)
+        goto end;
+    if (!X509_bundle_write_bio(out, certs)) {
+        BIO_printf(bio_err, "%s: Error writing bundle\n", prog);
+        ERR_print_errors(bio_err);
+        goto end;
+    }
+    if (verbose)
+        BIO_printf(bio_err, "Wrote %d certificate(s)\n", sk_X509_num(certs));
+    ret = 0;
+
+ end:
+    BIO_free_all(out);
+    sk_X509_pop_free(certs, X509_free);
+    return ret;
+}
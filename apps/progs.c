@@ -15,6 +15,7 @@
 FUNCTION functions[] = {
     {FT_general, "asn1parse", asn1parse_main, asn1parse_options},
     {FT_general, "ca", ca_main, ca_options},
+    {FT_general, "cabundle", cabundle_main, cabundle_options},
 #ifndef OPENSSL_NO_SOCK
     {FT_general, "ciphers", ciphers_main, ciphers_options},
 #endif
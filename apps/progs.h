@@ -14,6 +14,7 @@
 
 extern int asn1parse_main(int argc, char *argv[]);
 extern int ca_main(int argc, char *argv[]);
+extern int cabundle_main(int argc, char *argv[]);
 extern int ciphers_main(int argc, char *argv[]);
 extern int cms_main(int argc, char *argv[]);
 extern int crl_main(int argc, char *argv[]);
@@ -66,6 +67,7 @@ extern int x509_main(int argc, char *argv[]);
 
 extern const OPTIONS asn1parse_options[];
 extern const OPTIONS ca_options[];
+extern const OPTIONS cabundle_options[];
 extern const OPTIONS ciphers_options[];
 extern const OPTIONS cms_options[];
 extern const OPTIONS crl_options[];
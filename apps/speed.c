@@ -132,6 +132,10 @@ typedef struct openssl_speed_sec_st {
 static volatile int run = 0;
 
 static int mr = 0;
+#ifndef OPENSSL_NO_CRYPTO_MDEBUG
+static int allocs = 0;
+static int alloc_start;
+#endif
 static int usertime = 1;
 
 #ifndef OPENSSL_NO_MD2
@@ -283,6 +287,35 @@ static double Time_F(int s)
 }
 #endif
 
+/*
+ * With -allocs, report how many times the heap allocator was entered per
+ * operation of a public key benchmark.  The counts come from the
+ * crypto-mdebug build, so this is a no-op otherwise.
+ */
+#ifndef OPENSSL_NO_CRYPTO_MDEBUG
+static void alloc_count_start(void)
+{
+    int mcount, rcount;
+
+    CRYPTO_get_alloc_counts(&mcount, &rcount, NULL);
+    alloc_start = mcount + rcount;
+}
+
+static void alloc_count_print(long count)
+{
+    int mcount, rcount;
+
+    if (!allocs || count <= 0)
+        return;
+    CRYPTO_get_alloc_counts(&mcount, &rcount, NULL);
+    BIO_printf(bio_err, "%.2f allocations per operation\n",
+               (double)(mcount + rcount - alloc_start) / count);
+}
+#else
+# define alloc_count_start()
+# define alloc_count_print(count)
+#endif
+
 static void multiblock_speed(const EVP_CIPHER *evp_cipher, int lengths_single,
                              const openssl_speed_sec_t *seconds);
 
@@ -305,7 +338,8 @@ typedef enum OPTION_choice {
     OPT_ERR = -1, OPT_EOF = 0, OPT_HELP,
     OPT_ELAPSED, OPT_EVP, OPT_HMAC, OPT_DECRYPT, OPT_ENGINE, OPT_MULTI,
     OPT_MR, OPT_MB, OPT_MISALIGN, OPT_ASYNCJOBS, OPT_R_ENUM,
-    OPT_PRIMES, OPT_SECONDS, OPT_BYTES, OPT_AEAD, OPT_CMAC
+    OPT_PRIMES, OPT_SECONDS, OPT_BYTES, OPT_AEAD, OPT_CMAC, OPT_ALLOCS,
+    OPT_BATCH
 } OPTION_CHOICE;
 
 const OPTIONS speed_options[] = {
@@ -344,6 +378,14 @@ const OPTIONS speed_options[] = {
      "Run [non-PKI] benchmarks on custom-sized buffer"},
     {"misalign", OPT_MISALIGN, 'p',
      "Use specified offset to mis-align buffers"},
+#ifndef OPENSSL_NO_CRYPTO_MDEBUG
+    {"allocs", OPT_ALLOCS, '-',
+     "Report heap allocations per public key operation"},
+#endif
+#ifndef OPENSSL_NO_EC
+    {"batch", OPT_BATCH, 'p',
+     "Verify ECDSA signatures in batches of the specified size"},
+#endif
     {NULL}
 };
 
@@ -1197,6 +1239,7 @@ static int DSA_verify_loop(void *args)
 
 #ifndef OPENSSL_NO_EC
 static long ecdsa_c[ECDSA_NUM][2];
+static int ecdsa_batch = 0;
 static int ECDSA_sign_loop(void *args)
 {
     loopargs_t *tempargs = *(loopargs_t **) args;
@@ -1237,6 +1280,60 @@ static int ECDSA_verify_loop(void *args)
     return count;
 }
 
+/*
+ * Verifies |ecdsa_batch| copies of the signature at a time.  Each signature
+ * is decoded in every round so that the work done per signature matches
+ * ECDSA_verify_loop().
+ */
+static int ECDSA_verify_batch_loop(void *args)
+{
+    loopargs_t *tempargs = *(loopargs_t **) args;
+    EC_KEY **ecdsa = tempargs->ecdsa;
+    const unsigned char *p;
+    const unsigned char **dgst;
+    int *dgst_len, *res;
+    ECDSA_SIG **sigs;
+    EC_KEY **keys;
+    int i, count;
+
+    dgst = app_malloc(ecdsa_batch * sizeof(*dgst), "batch digests");
+    dgst_len = app_malloc(ecdsa_batch * sizeof(*dgst_len), "batch lengths");
+    res = app_malloc(ecdsa_batch * sizeof(*res), "batch results");
+    sigs = app_malloc(ecdsa_batch * sizeof(*sigs), "batch signatures");
+    keys = app_malloc(ecdsa_batch * sizeof(*keys), "batch keys");
+    for (i = 0; i < ecdsa_batch; i++) {
+        dgst[i] = tempargs->buf;
+        dgst_len[i] = 20;
+        sigs[i] = NULL;
+        keys[i] = ecdsa[testnum];
+    }
+
+    for (count = 0; COND(ecdsa_c[testnum][1]); count += ecdsa_batch) {
+        for (i = 0; i < ecdsa_batch; i++) {
+            p = tempargs->buf2;
+            if (d2i_ECDSA_SIG(&sigs[i], &p, tempargs->siglen) == NULL)
+                break;
+        }
+        if (i < ecdsa_batch
+            || ECDSA_do_verify_batch(dgst, dgst_len, (const ECDSA_SIG **)sigs,
+                                     keys, ecdsa_batch, res) != 1) {
+            BIO_printf(bio_err, "ECDSA batch verify failure\n");
+            ERR_print_errors(bio_err);
+            count = -1;
+            break;
+        }
+    }
+
+    for (i = 0; i < ecdsa_batch; i++)
+        ECDSA_SIG_free(sigs[i]);
+    OPENSSL_free(keys);
+    OPENSSL_free(sigs);
+    OPENSSL_free(res);
+    OPENSSL_free(dgst_len);
+    OPENSSL_free(dgst);
+    return count;
+}
+
 /* ******************************************************************** */
 static long ecdh_c[EC_NUM][1];
 
@@ -1298,6 +1395,67 @@ static int EdDSA_verify_loop(void *args)
 }
 #endif                          /* OPENSSL_NO_EC */
 
+/* Pauses and resumes to measure across all jobs */
+#define ASYNC_SWITCHES  1000000
+
+static int async_switch_loop(void *args)
+{
+    int i, rounds = *(int *)args;
+
+    for (i = 0; i < rounds; i++)
+        if (!ASYNC_pause_job())
+            return 0;
+    return 1;
+}
+
+/*
+ * Reports what one round trip from a job to the caller of ASYNC_start_job()
+ * and back costs, i.e. the overhead the async mode adds to every operation
+ * that has to wait.  Elapsed time is used, as the system time taken by
+ * context switch implementations that change the signal mask counts.
+ */
+static void print_async_switch_cost(int async_jobs, loopargs_t *loopargs)
+{
+    int i, ret, num_inprogress = async_jobs, error = 0, first = 1;
+    int rounds = ASYNC_SWITCHES / async_jobs + 1;
+    double d;
+
+    app_tminterval(TM_START, 0);
+    while (num_inprogress > 0) {
+        num_inprogress = 0;
+        for (i = 0; i < async_jobs; i++) {
+            /* Every job is started once, and resumed until it finishes */
+            if (!first && loopargs[i].inprogress_job == NULL)
+                continue;
+            switch (ASYNC_start_job(&loopargs[i].inprogress_job,
+                                    loopargs[i].wait_ctx, &ret,
+                                    async_switch_loop, &rounds,
+                                    sizeof(rounds))) {
+            case ASYNC_PAUSE:
+                num_inprogress++;
+                break;
+            case ASYNC_FINISH:
+                if (ret == 0)
+                    error = 1;
+                break;
+            default:
+                error = 1;
+                break;
+            }
+        }
+        first = 0;
+    }
+    d = app_tminterval(TM_STOP, 0);
+
+    if (error) {
+        BIO_printf(bio_err, "Failed to measure async job switches\n");
+        ERR_print_errors(bio_err);
+        return;
+    }
+    BIO_printf(bio_err, "%d async jobs: %.0f ns per pause and resume\n",
+               async_jobs, d * 1e9 / ((double)rounds * async_jobs));
+}
+
 static int run_benchmark(int async_jobs,
                          int (*loop_function) (void *), loopargs_t * loopargs)
 {
@@ -1704,6 +1862,22 @@ int speed_main(int argc, char **argv)
                 goto opterr;
             }
             break;
+        case OPT_ALLOCS:
+#ifndef OPENSSL_NO_CRYPTO_MDEBUG
+            allocs = 1;
+#endif
+            break;
+        case OPT_BATCH:
+#ifndef OPENSSL_NO_EC
+            if (!opt_int(opt_arg(), &ecdsa_batch))
+                goto end;
+            if (ecdsa_batch < 1) {
+                BIO_printf(bio_err, "%s: Batch size must be positive\n",
+                           prog);
+                goto opterr;
+            }
+#endif
+            break;
         case OPT_MR:
             mr = 1;
             break;
@@ -1932,6 +2106,9 @@ int speed_main(int argc, char **argv)
                    "You have chosen to measure elapsed time "
                    "instead of user CPU time.\n");
 
+    if (async_jobs > 0 && !mr)
+        print_async_switch_cost(async_jobs, loopargs);
+
 #ifndef OPENSSL_NO_RSA
     for (i = 0; i < loopargs_len; i++) {
         if (primes > RSA_DEFAULT_PRIME_NUM) {
@@ -2874,12 +3051,14 @@ int speed_main(int argc, char **argv)
                                seconds.rsa);
             /* RSA_blinding_on(rsa_key[testnum],NULL); */
             Time_F(START);
+            alloc_count_start();
             count = run_benchmark(async_jobs, RSA_sign_loop, loopargs);
             d = Time_F(STOP);
             BIO_printf(bio_err,
                        mr ? "+R1:%ld:%d:%.2f\n"
                        : "%ld %u bits private RSA's in %.2fs\n",
                        count, rsa_bits[testnum], d);
+            alloc_count_print(count);
             rsa_results[testnum][0] = (double)count / d;
             rsa_count = count;
         }
@@ -2900,12 +3079,14 @@ int speed_main(int argc, char **argv)
                                rsa_c[testnum][1], rsa_bits[testnum],
                                seconds.rsa);
             Time_F(START);
+            alloc_count_start();
             count = run_benchmark(async_jobs, RSA_verify_loop, loopargs);
             d = Time_F(STOP);
             BIO_printf(bio_err,
                        mr ? "+R2:%ld:%d:%.2f\n"
                        : "%ld %u bits public RSA's in %.2fs\n",
                        count, rsa_bits[testnum], d);
+            alloc_count_print(count);
             rsa_results[testnum][1] = (double)count / d;
         }
 
@@ -3027,6 +3208,7 @@ int speed_main(int argc, char **argv)
                                    ecdsa_c[testnum][0],
                                    test_curves[testnum].bits, seconds.ecdsa);
                 Time_F(START);
+                alloc_count_start();
                 count = run_benchmark(async_jobs, ECDSA_sign_loop, loopargs);
                 d = Time_F(STOP);
 
@@ -3034,6 +3216,7 @@ int speed_main(int argc, char **argv)
                            mr ? "+R5:%ld:%u:%.2f\n" :
                            "%ld %u bits ECDSA signs in %.2fs \n",
                            count, test_curves[testnum].bits, d);
+                alloc_count_print(count);
                 ecdsa_results[testnum][0] = (double)count / d;
                 rsa_count = count;
             }
@@ -3056,12 +3239,16 @@ int speed_main(int argc, char **argv)
                                    ecdsa_c[testnum][1],
                                    test_curves[testnum].bits, seconds.ecdsa);
                 Time_F(START);
-                count = run_benchmark(async_jobs, ECDSA_verify_loop, loopargs);
+                alloc_count_start();
+                count = run_benchmark(async_jobs, ecdsa_batch > 1
+                                      ? ECDSA_verify_batch_loop
+                                      : ECDSA_verify_loop, loopargs);
                 d = Time_F(STOP);
                 BIO_printf(bio_err,
                            mr ? "+R6:%ld:%u:%.2f\n"
                            : "%ld %u bits ECDSA verify in %.2fs\n",
                            count, test_curves[testnum].bits, d);
+                alloc_count_print(count);
                 ecdsa_results[testnum][1] = (double)count / d;
             }
 
@@ -3215,6 +3402,7 @@ int speed_main(int argc, char **argv)
                                ecdh_c[testnum][0],
                                test_curves[testnum].bits, seconds.ecdh);
             Time_F(START);
+            alloc_count_start();
             count =
                 run_benchmark(async_jobs, ECDH_EVP_derive_key_loop, loopargs);
             d = Time_F(STOP);
@@ -3222,6 +3410,7 @@ int speed_main(int argc, char **argv)
                        mr ? "+R7:%ld:%d:%.2f\n" :
                        "%ld %u-bits ECDH ops in %.2fs\n", count,
                        test_curves[testnum].bits, d);
+            alloc_count_print(count);
             ecdh_results[testnum][0] = (double)count / d;
             rsa_count = count;
         }
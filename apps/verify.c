@@ -27,7 +27,8 @@ static int v_verbose = 0, vflags = 0;
 
 typedef enum OPTION_choice {
     OPT_ERR = -1, OPT_EOF = 0, OPT_HELP,
-    OPT_ENGINE, OPT_CAPATH, OPT_CAFILE, OPT_NOCAPATH, OPT_NOCAFILE,
+    OPT_ENGINE, OPT_CAPATH, OPT_CAFILE, OPT_CABUNDLE, OPT_NOCAPATH,
+    OPT_NOCAFILE,
     OPT_UNTRUSTED, OPT_TRUSTED, OPT_CRLFILE, OPT_CRL_DOWNLOAD, OPT_SHOW_CHAIN,
     OPT_V_ENUM, OPT_NAMEOPT,
     OPT_VERBOSE, OPT_SM2ID, OPT_SM2HEXID
@@ -41,6 +42,8 @@ const OPTIONS verify_options[] = {
         "Print extra information about the operations being performed."},
     {"CApath", OPT_CAPATH, '/', "A directory of trusted certificates"},
     {"CAfile", OPT_CAFILE, '<', "A file of trusted certificates"},
+    {"CAbundle", OPT_CABUNDLE, '<',
+     "A DER bundle of trusted certificates, loaded on demand"},
     {"no-CAfile", OPT_NOCAFILE, '-',
      "Do not load the default certificates file"},
     {"no-CApath", OPT_NOCAPATH, '-',
@@ -74,7 +77,7 @@ int verify_main(int argc, char **argv)
     STACK_OF(X509_CRL) *crls = NULL;
     X509_STORE *store = NULL;
     X509_VERIFY_PARAM *vpm = NULL;
-    const char *prog, *CApath = NULL, *CAfile = NULL;
+    const char *prog, *CApath = NULL, *CAfile = NULL, *CAbundle = NULL;
     int noCApath = 0, noCAfile = 0;
     int vpmtouched = 0, crl_download = 0, show_chain = 0, i = 0, ret = 1;
     OPTION_CHOICE o;
@@ -123,6 +126,9 @@ int verify_main(int argc, char **argv)
         case OPT_CAFILE:
             CAfile = opt_arg();
             break;
+        case OPT_CABUNDLE:
+            CAbundle = opt_arg();
+            break;
         case OPT_NOCAPATH:
             noCApath = 1;
             break;
@@ -195,15 +201,27 @@ int verify_main(int argc, char **argv)
     }
     argc = opt_num_rest();
     argv = opt_rest();
-    if (trusted != NULL && (CAfile || CApath)) {
+    if (trusted != NULL && (CAfile || CApath || CAbundle)) {
         BIO_printf(bio_err,
-                   "%s: Cannot use -trusted with -CAfile or -CApath\n",
-                   prog);
+                   "%s: Cannot use -trusted with -CAfile, -CApath or "
+                   "-CAbundle\n", prog);
         goto end;
     }
 
     if ((store = setup_verify(CAfile, CApath, noCAfile, noCApath)) == NULL)
         goto end;
+    if (CAbundle != NULL) {
+        X509_LOOKUP *lookup = X509_STORE_add_lookup(store,
+                                                    X509_LOOKUP_bundle());
+
+        if (lookup == NULL
+                || !X509_LOOKUP_load_file(lookup, CAbundle,
+                                          X509_FILETYPE_ASN1)) {
+            BIO_printf(bio_err, "Error loading bundle %s\n", CAbundle);
+            ERR_print_errors(bio_err);
+            goto end;
+        }
+    }
     X509_STORE_set_verify_cb(store, cb);
 
     if (vpmtouched)
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include "internal/numbers.h"
+
+/*
+ * A simple region allocator: memory is handed out from the current block by
+ * bumping an offset and is only given back all at once by OSSL_ARENA_reset().
+ * Blocks are kept across resets, so a reused arena stops calling malloc once
+ * it has grown to the size its workload needs.
+ */
+
+#define ARENA_ALIGN             16
+#define ARENA_DEFAULT_BLOCK     16384
+#define ARENA_ROUNDUP(n)        (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+typedef struct arena_block_st {
+    struct arena_block_st *next;
+    size_t size;                /* Usable bytes after the header */
+    size_t used;
+} ARENA_BLOCK;
+
+#define ARENA_HDR       ARENA_ROUNDUP(sizeof(ARENA_BLOCK))
+
+struct ossl_arena_st {
+    size_t block_size;
+    ARENA_BLOCK *head, *cur;
+    size_t used;                /* Bytes handed out since the last reset */
+    size_t peak;                /* High water mark of |used| */
+    size_t num_allocs;          /* Allocations served */
+    size_t num_blocks;          /* Blocks allocated */
+};
+
+OSSL_ARENA *OSSL_ARENA_new(size_t block_size)
+{
+    OSSL_ARENA *arena = OPENSSL_zalloc(sizeof(*arena));
+
+    if (arena == NULL) {
+        CRYPTOerr(0, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    if (block_size == 0)
+        block_size = ARENA_DEFAULT_BLOCK;
+    arena->block_size = ARENA_ROUNDUP(block_size);
+    return arena;
+}
+
+void OSSL_ARENA_free(OSSL_ARENA *arena)
+{
+    ARENA_BLOCK *b, *next;
+
+    if (arena == NULL)
+        return;
+    for (b = arena->head; b != NULL; b = next) {
+        next = b->next;
+        OPENSSL_free(b);
+    }
+    OPENSSL_free(arena);
+}
+
+void *OSSL_ARENA_alloc(OSSL_ARENA *arena, size_t num)
+{
+    ARENA_BLOCK *b = arena->cur, *nb;
+    size_t size;
+
+    if (num > SIZE_MAX - ARENA_HDR - ARENA_ALIGN) {
+        CRYPTOerr(0, ERR_R_PASSED_INVALID_ARGUMENT);
+        return NULL;
+    }
+    num = ARENA_ROUNDUP(num == 0 ? 1 : num);
+
+    /* Move on through blocks left over from before the last reset */
+    while (b != NULL && b->size - b->used < num && b->next != NULL) {
+        b = b->next;
+        b->used = 0;
+    }
+    if (b == NULL || b->size - b->used < num) {
+        size = num > arena->block_size ? num : arena->block_size;
+        if ((nb = OPENSSL_malloc(ARENA_HDR + size)) == NULL) {
+            CRYPTOerr(0, ERR_R_MALLOC_FAILURE);
+            return NULL;
+        }
+        nb->size = size;
+        nb->used = 0;
+        nb->next = NULL;
+        if (b == NULL)
+            arena->head = nb;
+        else
+            b->next = nb;
+        b = nb;
+        arena->num_blocks++;
+    }
+    arena->cur = b;
+
+    b->used += num;
+    arena->used += num;
+    if (arena->used > arena->peak)
+        arena->peak = arena->used;
+    arena->num_allocs++;
+    return (unsigned char *)b + ARENA_HDR + b->used - num;
+}
+
+void OSSL_ARENA_reset(OSSL_ARENA *arena)
+{
+    if (arena == NULL || arena->head == NULL)
+        return;
+    arena->cur = arena->head;
+    arena->cur->used = 0;
+    arena->used = 0;
+}
+
+void OSSL_ARENA_get_stats(const OSSL_ARENA *arena, size_t *num_allocs,
+                          size_t *num_blocks, size_t *peak)
+{
+    if (num_allocs != NULL)
+        *num_allocs = arena->num_allocs;
+    if (num_blocks != NULL)
+        *num_blocks = arena->num_blocks;
+    if (peak != NULL)
+        *peak = arena->peak;
+}
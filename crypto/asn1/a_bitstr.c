@@ -125,9 +125,7 @@ ASN1_BIT_STRING *c2i_ASN1_BIT_STRING(ASN1_BIT_STRING **a,
     } else
         s = NULL;
 
-    ret->length = (int)len;
-    OPENSSL_free(ret->data);
-    ret->data = s;
+    ASN1_STRING_set0(ret, s, (int)len);
     ret->type = V_ASN1_BIT_STRING;
     if (a != NULL)
         (*a) = ret;
@@ -140,6 +138,37 @@ ASN1_BIT_STRING *c2i_ASN1_BIT_STRING(ASN1_BIT_STRING **a,
     return NULL;
 }
 
+/*
+ * As c2i_ASN1_BIT_STRING() but leave the result pointing into |p|. This is
+ * only possible when the unused bits are already zero, as they are in DER,
+ * otherwise fall back to a copy.
+ */
+ASN1_BIT_STRING *c2i_ASN1_BIT_STRING_borrow(ASN1_BIT_STRING **a,
+                                            const unsigned char *p, long len)
+{
+    ASN1_BIT_STRING *ret;
+    int i;
+
+    if (len < 2 || len > INT_MAX || p[0] > 7
+            || (p[len - 1] & ~(0xff << p[0])) != 0)
+        return c2i_ASN1_BIT_STRING(a, &p, len);
+
+    if ((a == NULL) || ((*a) == NULL)) {
+        if ((ret = ASN1_BIT_STRING_new()) == NULL)
+            return NULL;
+    } else
+        ret = (*a);
+
+    i = p[0];
+    ret->flags &= ~(ASN1_STRING_FLAG_BITS_LEFT | 0x07); /* clear */
+    ret->flags |= (ASN1_STRING_FLAG_BITS_LEFT | i); /* set */
+    ret->type = V_ASN1_BIT_STRING;
+    asn1_string_borrow(ret, p + 1, (int)len - 1);
+    if (a != NULL)
+        (*a) = ret;
+    return ret;
+}
+
 /*
  * These next 2 functions from Goetz Babin-Ebell.
  */
@@ -159,6 +188,11 @@ int ASN1_BIT_STRING_set_bit(ASN1_BIT_STRING *a, int n, int value)
 
     a->flags &= ~(ASN1_STRING_FLAG_BITS_LEFT | 0x07); /* clear, set on write */
 
+    /* Take a private copy before modifying a borrowed string */
+    if ((a->flags & ASN1_STRING_FLAG_BORROWED) != 0
+            && !ASN1_STRING_set(a, a->data, a->length))
+        return 0;
+
     if ((a->length < (w + 1)) || (a->data == NULL)) {
         if (!value)
             return 1;         /* Don't need to set */
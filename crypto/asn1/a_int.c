@@ -316,6 +316,38 @@ ASN1_INTEGER *c2i_ASN1_INTEGER(ASN1_INTEGER **a, const unsigned char **pp,
     return NULL;
 }
 
+/*
+ * As c2i_ASN1_INTEGER() but a non-negative value is left pointing into |p|
+ * rather than copied: the content octets are the magnitude once any leading
+ * zero octet is skipped. Negative values still need converting, so copy them.
+ */
+ASN1_INTEGER *c2i_ASN1_INTEGER_borrow(ASN1_INTEGER **a,
+                                      const unsigned char *p, long len)
+{
+    ASN1_INTEGER *ret;
+    size_t r;
+    int neg;
+
+    r = c2i_ibuf(NULL, &neg, p, len);
+    if (r == 0)
+        return NULL;
+    if (neg)
+        return c2i_ASN1_INTEGER(a, &p, len);
+
+    if ((a == NULL) || ((*a) == NULL)) {
+        ret = ASN1_INTEGER_new();
+        if (ret == NULL)
+            return NULL;
+    } else
+        ret = *a;
+
+    ret->type = V_ASN1_INTEGER;
+    asn1_string_borrow(ret, p + len - r, (int)r);
+    if (a != NULL)
+        (*a) = ret;
+    return ret;
+}
+
 static int asn1_string_get_int64(int64_t *pr, const ASN1_STRING *a, int itype)
 {
     if (a == NULL) {
@@ -432,9 +464,7 @@ ASN1_INTEGER *d2i_ASN1_UINTEGER(ASN1_INTEGER **a, const unsigned char **pp,
         p += len;
     }
 
-    OPENSSL_free(ret->data);
-    ret->data = s;
-    ret->length = (int)len;
+    ASN1_STRING_set0(ret, s, (int)len);
     if (a != NULL)
         (*a) = ret;
     *pp = p;
@@ -249,7 +249,8 @@ int ASN1_STRING_copy(ASN1_STRING *dst, const ASN1_STRING *str)
         return 0;
     /* Copy flags but preserve embed value */
     dst->flags &= ASN1_STRING_FLAG_EMBED;
-    dst->flags |= str->flags & ~ASN1_STRING_FLAG_EMBED;
+    dst->flags |= str->flags
+                  & ~(ASN1_STRING_FLAG_EMBED | ASN1_STRING_FLAG_BORROWED);
     return 1;
 }
 
@@ -279,7 +280,15 @@ int ASN1_STRING_set(ASN1_STRING *str, const void *_data, int len)
         else
             len = strlen(data);
     }
-    if ((str->length <= len) || (str->data == NULL)) {
+    if ((str->flags & ASN1_STRING_FLAG_BORROWED) != 0) {
+        /* Never write to or reallocate the buffer we were decoded from */
+        if ((c = OPENSSL_malloc(len + 1)) == NULL) {
+            ASN1err(ASN1_F_ASN1_STRING_SET, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        str->data = c;
+        str->flags &= ~ASN1_STRING_FLAG_BORROWED;
+    } else if ((str->length <= len) || (str->data == NULL)) {
         c = str->data;
         str->data = OPENSSL_realloc(c, len + 1);
         if (str->data == NULL) {
@@ -299,11 +308,23 @@ int ASN1_STRING_set(ASN1_STRING *str, const void *_data, int len)
 
 void ASN1_STRING_set0(ASN1_STRING *str, void *data, int len)
 {
-    OPENSSL_free(str->data);
+    if ((str->flags & ASN1_STRING_FLAG_BORROWED) == 0)
+        OPENSSL_free(str->data);
+    str->flags &= ~ASN1_STRING_FLAG_BORROWED;
     str->data = data;
     str->length = len;
 }
 
+/* Point |str| at |len| bytes of |data|, which must outlive it */
+void asn1_string_borrow(ASN1_STRING *str, const unsigned char *data, int len)
+{
+    if ((str->flags & ASN1_STRING_FLAG_BORROWED) == 0)
+        OPENSSL_free(str->data);
+    str->flags |= ASN1_STRING_FLAG_BORROWED;
+    str->data = (unsigned char *)data;
+    str->length = len;
+}
+
 ASN1_STRING *ASN1_STRING_new(void)
 {
     return ASN1_STRING_type_new(V_ASN1_OCTET_STRING);
@@ -326,7 +347,7 @@ void asn1_string_embed_free(ASN1_STRING *a, int embed)
 {
     if (a == NULL)
         return;
-    if (!(a->flags & ASN1_STRING_FLAG_NDEF))
+    if (!(a->flags & (ASN1_STRING_FLAG_NDEF | ASN1_STRING_FLAG_BORROWED)))
         OPENSSL_free(a->data);
     if (embed == 0)
         OPENSSL_free(a);
@@ -343,7 +364,8 @@ void ASN1_STRING_clear_free(ASN1_STRING *a)
 {
     if (a == NULL)
         return;
-    if (a->data && !(a->flags & ASN1_STRING_FLAG_NDEF))
+    if (a->data
+            && !(a->flags & (ASN1_STRING_FLAG_NDEF | ASN1_STRING_FLAG_BORROWED)))
         OPENSSL_cleanse(a->data, a->length);
     ASN1_STRING_free(a);
 }
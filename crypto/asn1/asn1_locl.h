@@ -47,6 +47,7 @@ typedef struct mime_header_st MIME_HEADER;
 DEFINE_STACK_OF(MIME_HEADER)
 
 void asn1_string_embed_free(ASN1_STRING *a, int embed);
+void asn1_string_borrow(ASN1_STRING *str, const unsigned char *data, int len);
 
 int asn1_get_choice_selector(ASN1_VALUE **pval, const ASN1_ITEM *it);
 int asn1_get_choice_selector_const(const ASN1_VALUE **pval, const ASN1_ITEM *it);
@@ -78,9 +79,13 @@ ASN1_OBJECT *c2i_ASN1_OBJECT(ASN1_OBJECT **a, const unsigned char **pp,
 int i2c_ASN1_BIT_STRING(ASN1_BIT_STRING *a, unsigned char **pp);
 ASN1_BIT_STRING *c2i_ASN1_BIT_STRING(ASN1_BIT_STRING **a,
                                      const unsigned char **pp, long length);
+ASN1_BIT_STRING *c2i_ASN1_BIT_STRING_borrow(ASN1_BIT_STRING **a,
+                                            const unsigned char *p, long len);
 int i2c_ASN1_INTEGER(ASN1_INTEGER *a, unsigned char **pp);
 ASN1_INTEGER *c2i_ASN1_INTEGER(ASN1_INTEGER **a, const unsigned char **pp,
                                long length);
+ASN1_INTEGER *c2i_ASN1_INTEGER_borrow(ASN1_INTEGER **a,
+                                      const unsigned char *p, long len);
 
 /* Internal functions used by x_int64.c */
 int c2i_uint64_int(uint64_t *ret, int *neg, const unsigned char **pp, long len);
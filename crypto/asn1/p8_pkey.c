@@ -20,7 +20,9 @@ static int pkey_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
     /* Since the structure must still be valid use ASN1_OP_FREE_PRE */
     if (operation == ASN1_OP_FREE_PRE) {
         PKCS8_PRIV_KEY_INFO *key = (PKCS8_PRIV_KEY_INFO *)*pval;
-        if (key->pkey)
+        /* A borrowed key is the caller's to clean up */
+        if (key->pkey
+                && (key->pkey->flags & ASN1_STRING_FLAG_BORROWED) == 0)
             OPENSSL_cleanse(key->pkey->data, key->pkey->length);
     }
     return 1;
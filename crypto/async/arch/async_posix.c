@@ -13,12 +13,21 @@
 #ifdef ASYNC_POSIX
 
 # include <stddef.h>
+# include <string.h>
 # include <unistd.h>
+# include <sys/mman.h>
+
+# if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#  define MAP_ANON MAP_ANONYMOUS
+# endif
 
 #define STACKSIZE       32768
 
 int ASYNC_is_capable(void)
 {
+# ifdef ASYNC_FIBRE_ASM
+    return 1;
+# else
     ucontext_t ctx;
 
     /*
@@ -26,33 +35,137 @@ int ASYNC_is_capable(void)
      * MacOSX PPC64). Check for a working getcontext();
      */
     return getcontext(&ctx) == 0;
+# endif
 }
 
 void async_local_cleanup(void)
 {
 }
 
+/*
+ * Allocates a stack for |fibre| with an inaccessible guard page below it,
+ * so that a job running off the end of its stack faults instead of
+ * silently overwriting whatever happens to be next in memory.  Pages are
+ * only committed once touched, so many jobs with mostly shallow stacks
+ * cost little more than the pages they actually use.  If the mapping
+ * cannot be made, falls back to a plain heap allocation without a guard.
+ */
+static unsigned char *async_fibre_stack_new(async_fibre *fibre, size_t *len)
+{
+    size_t size = ASYNC_get_stack_size();
+    long pgsize = -1;
+
+# if defined(_SC_PAGE_SIZE)
+    pgsize = sysconf(_SC_PAGE_SIZE);
+# elif defined(_SC_PAGESIZE)
+    pgsize = sysconf(_SC_PAGESIZE);
+# endif
+    if (size == 0)
+        size = STACKSIZE;
+
+# ifdef MAP_ANON
+    if (pgsize > 0) {
+        unsigned char *p;
+
+        size = (size + pgsize - 1) & ~((size_t)pgsize - 1);
+        p = mmap(NULL, size + pgsize, PROT_READ | PROT_WRITE,
+                 MAP_ANON | MAP_PRIVATE, -1, 0);
+        if (p != MAP_FAILED) {
+            if (mprotect(p, pgsize, PROT_NONE) == 0) {
+                fibre->stack = p;
+                fibre->stack_len = size + pgsize;
+                *len = size;
+                return p + pgsize;
+            }
+            munmap(p, size + pgsize);
+        }
+        /*
+         * Every guarded stack is a mapping of its own, so a process with
+         * very many jobs can hit the limit on those (vm.max_map_count on
+         * Linux) long before it runs out of memory.  Carry on without the
+         * guard page rather than failing the job.
+         */
+    }
+# endif
+
+    /* No guard page then */
+    if ((fibre->stack = OPENSSL_malloc(size)) == NULL)
+        return NULL;
+    fibre->stack_len = 0;
+    *len = size;
+    return fibre->stack;
+}
+
+static void async_fibre_stack_free(async_fibre *fibre)
+{
+    if (fibre->stack == NULL)
+        return;
+# ifdef MAP_ANON
+    if (fibre->stack_len != 0)
+        munmap(fibre->stack, fibre->stack_len);
+    else
+# endif
+        OPENSSL_free(fibre->stack);
+    fibre->stack = NULL;
+}
+
+# ifdef ASYNC_FIBRE_ASM
+
+int async_fibre_makecontext(async_fibre *fibre)
+{
+    unsigned char *stack;
+    size_t len;
+    uint64_t *sp;
+    uint32_t csr = 0x1f80;      /* Default MXCSR and x87 control word */
+    uint16_t cw = 0x037f;
+
+    if ((stack = async_fibre_stack_new(fibre, &len)) == NULL)
+        return 0;
+
+    /*
+     * Lay out the top of the stack the way async_fibre_swap() leaves it,
+     * see crypto/async/asm/async-x86_64.pl: the saved control words,
+     * %r15, %r14, %r13, %r12, %rbx and %rbp, all zero, the return address
+     * and an unused slot.  The first switch to the fibre "returns" into
+     * async_start_func() with the stack aligned as after a call, that
+     * function never returns itself.
+     */
+    sp = (uint64_t *)(((size_t)stack + len) & ~(size_t)15);
+    sp -= 9;
+    memset(sp, 0, 9 * sizeof(*sp));
+    memcpy(sp, &csr, sizeof(csr));
+    memcpy((unsigned char *)sp + 4, &cw, sizeof(cw));
+    sp[7] = (uint64_t)(size_t)async_start_func;
+    fibre->sp = sp;
+    return 1;
+}
+
+# else
+
 int async_fibre_makecontext(async_fibre *fibre)
 {
+    unsigned char *stack;
+    size_t len;
+
     fibre->env_init = 0;
     if (getcontext(&fibre->fibre) == 0) {
-        fibre->fibre.uc_stack.ss_sp = OPENSSL_malloc(STACKSIZE);
-        if (fibre->fibre.uc_stack.ss_sp != NULL) {
-            fibre->fibre.uc_stack.ss_size = STACKSIZE;
+        if ((stack = async_fibre_stack_new(fibre, &len)) != NULL) {
+            fibre->fibre.uc_stack.ss_sp = stack;
+            fibre->fibre.uc_stack.ss_size = len;
             fibre->fibre.uc_link = NULL;
             makecontext(&fibre->fibre, async_start_func, 0);
             return 1;
         }
-    } else {
-        fibre->fibre.uc_stack.ss_sp = NULL;
     }
+    fibre->fibre.uc_stack.ss_sp = NULL;
     return 0;
 }
 
+# endif
+
 void async_fibre_free(async_fibre *fibre)
 {
-    OPENSSL_free(fibre->fibre.uc_stack.ss_sp);
-    fibre->fibre.uc_stack.ss_sp = NULL;
+    async_fibre_stack_free(fibre);
 }
 
 #endif
@@ -25,13 +25,37 @@
 #  define ASYNC_POSIX
 #  define ASYNC_ARCH
 
-#  include <ucontext.h>
-#  include <setjmp.h>
+#  ifdef ASYNC_FIBRE_ASM
+
+typedef struct async_fibre_st {
+    void *sp;
+    unsigned char *stack;
+    size_t stack_len;
+} async_fibre;
+
+void async_fibre_swap(void **save_sp, void *next_sp);
+
+/*
+ * Only the registers the ABI says a callee preserves are switched, there
+ * is no signal mask to restore and nothing to set up on the first switch.
+ */
+static ossl_inline int async_fibre_swapcontext(async_fibre *o, async_fibre *n, int r)
+{
+    async_fibre_swap(&o->sp, n->sp);
+    return 1;
+}
+
+#  else
+
+#   include <ucontext.h>
+#   include <setjmp.h>
 
 typedef struct async_fibre_st {
     ucontext_t fibre;
     jmp_buf env;
     int env_init;
+    unsigned char *stack;
+    size_t stack_len;
 } async_fibre;
 
 static ossl_inline int async_fibre_swapcontext(async_fibre *o, async_fibre *n, int r)
@@ -48,6 +72,8 @@ static ossl_inline int async_fibre_swapcontext(async_fibre *o, async_fibre *n, i
     return 1;
 }
 
+#  endif
+
 #  define async_fibre_init_dispatcher(d)
 
 int async_fibre_makecontext(async_fibre *fibre);
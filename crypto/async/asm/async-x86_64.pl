@@ -0,0 +1,96 @@
+#! /usr/bin/env perl
+# Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+#
+# Context switch between ASYNC fibres.  The ucontext based fibres have to
+# be entered with setcontext(3) the first time, which restores the signal
+# mask with a system call, and carry a ucontext_t and a jmp_buf around.
+# Switching between two fibres of the same thread only needs the
+# callee-saved registers, the stack pointer and the floating point control
+# words.
+#
+# void async_fibre_swap(void **save_sp, void *next_sp);
+#
+# pushes the state of the caller on its stack, stores the resulting stack
+# pointer at |save_sp| and resumes the fibre whose stack pointer is
+# |next_sp|.  A fresh fibre is started by handing in a stack laid out the
+# way async_fibre_swap leaves it, see crypto/async/arch/async_posix.c.
+#
+# Only the SysV ABI is supported, Win64 uses Windows fibres.
+#
+# Cost of an ASYNC_start_job()/ASYNC_pause_job() round trip, nanoseconds:
+#
+#			ucontext	this
+# Xeon (virtualized)	100		85
+#
+# The fibre switch itself is only part of it, a round trip of two bare
+# async_fibre_swap() calls takes ~40ns on the same machine.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
+*STDOUT=*OUT;
+
+$code.=<<___;
+.text
+
+.globl	async_fibre_swap
+.type	async_fibre_swap,\@abi-omnipotent
+.align	16
+async_fibre_swap:
+.cfi_startproc
+	push	%rbp
+.cfi_push	%rbp
+	push	%rbx
+.cfi_push	%rbx
+	push	%r12
+.cfi_push	%r12
+	push	%r13
+.cfi_push	%r13
+	push	%r14
+.cfi_push	%r14
+	push	%r15
+.cfi_push	%r15
+	lea	-8(%rsp),%rsp
+.cfi_adjust_cfa_offset	8
+	stmxcsr	(%rsp)
+	fnstcw	4(%rsp)
+
+	mov	%rsp,(%rdi)		# save the current fibre
+	mov	%rsi,%rsp		# and switch to the next one
+.cfi_def_cfa	%rsp,64
+
+	ldmxcsr	(%rsp)
+	fldcw	4(%rsp)
+	lea	8(%rsp),%rsp
+.cfi_adjust_cfa_offset	-8
+	pop	%r15
+.cfi_pop	%r15
+	pop	%r14
+.cfi_pop	%r14
+	pop	%r13
+.cfi_pop	%r13
+	pop	%r12
+.cfi_pop	%r12
+	pop	%rbx
+.cfi_pop	%rbx
+	pop	%rbp
+.cfi_pop	%rbp
+	ret
+.cfi_endproc
+.size	async_fibre_swap,.-async_fibre_swap
+___
+
+print $code;
+close STDOUT;
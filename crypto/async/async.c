@@ -27,9 +27,15 @@
 #define ASYNC_JOB_PAUSED    2
 #define ASYNC_JOB_STOPPING  3
 
+/* Smallest stack ASYNC_set_stack_size() accepts */
+#define ASYNC_MIN_STACK     8192
+
 static CRYPTO_THREAD_LOCAL ctxkey;
 static CRYPTO_THREAD_LOCAL poolkey;
 
+/* Stack size for new jobs, 0 for the platform default */
+static size_t stack_size = 0;
+
 static void async_delete_thread_state(void *arg);
 
 static async_ctx *async_ctx_new(void)
@@ -101,6 +107,41 @@ static void async_job_free(ASYNC_JOB *job)
     }
 }
 
+/*
+ * Jobs counted by |pool|.  Only the owning thread adds to the count, others
+ * can only lower it, so the owner can rely on the result staying in bounds.
+ */
+static size_t async_pool_size(async_pool *pool)
+{
+    int refs;
+
+    CRYPTO_UP_REF(&pool->references, &refs, pool->lock);
+    CRYPTO_DOWN_REF(&pool->references, &refs, pool->lock);
+    return (size_t)refs - 1;
+}
+
+static void async_pool_free(async_pool *pool)
+{
+    int refs;
+
+    CRYPTO_DOWN_REF(&pool->references, &refs, pool->lock);
+    if (refs > 0)
+        return;
+    sk_ASYNC_JOB_free(pool->jobs);
+    CRYPTO_THREAD_lock_free(pool->lock);
+    OPENSSL_free(pool);
+}
+
+/* Free |job| and drop it from the count of the pool that made it */
+static void async_job_discard(ASYNC_JOB *job)
+{
+    async_pool *pool = job->pool;
+
+    async_job_free(job);
+    if (pool != NULL)
+        async_pool_free(pool);
+}
+
 static ASYNC_JOB *async_get_pool_job(void) {
     ASYNC_JOB *job;
     async_pool *pool;
@@ -118,8 +159,10 @@ static ASYNC_JOB *async_get_pool_job(void) {
 
     job = sk_ASYNC_JOB_pop(pool->jobs);
     if (job == NULL) {
+        int refs;
+
         /* Pool is empty */
-        if ((pool->max_size != 0) && (pool->curr_size >= pool->max_size))
+        if ((pool->max_size != 0) && (async_pool_size(pool) >= pool->max_size))
             return NULL;
 
         job = async_job_new();
@@ -128,7 +171,8 @@ static ASYNC_JOB *async_get_pool_job(void) {
                 async_job_free(job);
                 return NULL;
             }
-            pool->curr_size++;
+            CRYPTO_UP_REF(&pool->references, &refs, pool->lock);
+            job->pool = pool;
         }
     }
     return job;
@@ -138,22 +182,56 @@ static void async_release_job(ASYNC_JOB *job) {
     async_pool *pool;
 
     pool = (async_pool *)CRYPTO_THREAD_get_local(&poolkey);
+    if (pool == NULL) {
+        /*
+         * The job was started by another thread and resumed by this one,
+         * which has not needed a pool of its own so far
+         */
+        if (ASYNC_init_thread(0, 0) == 0) {
+            async_job_discard(job);
+            return;
+        }
+        pool = (async_pool *)CRYPTO_THREAD_get_local(&poolkey);
+    }
+
+    /*
+     * A job made by another thread's pool moves over to this one if it has
+     * room, and is freed otherwise.  Either way the other pool stops
+     * counting it, so that it can make a new job instead.
+     */
+    if (job->pool != pool) {
+        int refs;
+
+        if (pool->max_size != 0 && async_pool_size(pool) >= pool->max_size) {
+            async_job_discard(job);
+            return;
+        }
+        CRYPTO_UP_REF(&pool->references, &refs, pool->lock);
+        async_pool_free(job->pool);
+        job->pool = pool;
+    }
     OPENSSL_free(job->funcargs);
     job->funcargs = NULL;
-    sk_ASYNC_JOB_push(pool->jobs, job);
+    if (!sk_ASYNC_JOB_push(pool->jobs, job))
+        async_job_discard(job);
 }
 
 void async_start_func(void)
 {
     ASYNC_JOB *job;
-    async_ctx *ctx = async_get_ctx();
+    async_ctx *ctx;
 
     while (1) {
         /* Run the job */
-        job = ctx->currjob;
+        job = async_get_ctx()->currjob;
         job->ret = job->func(job->funcargs);
 
-        /* Stop the job */
+        /*
+         * Stop the job.  A paused job may be resumed by another thread, see
+         * ASYNC_SCHED_run(), so return to the dispatcher of the thread that
+         * is running it now.
+         */
+        ctx = async_get_ctx();
         job->status = ASYNC_JOB_STOPPING;
         if (!async_fibre_swapcontext(&job->fibrectx,
                                      &ctx->dispatcher, 1)) {
@@ -171,7 +249,11 @@ int ASYNC_start_job(ASYNC_JOB **job, ASYNC_WAIT_CTX *wctx, int *ret,
 {
     async_ctx *ctx;
 
-    if (!OPENSSL_init_crypto(OPENSSL_INIT_ASYNC, NULL))
+    /*
+     * A paused job can only exist once initialisation has succeeded, so
+     * resuming one, the common case, need not go through it again
+     */
+    if (*job == NULL && !OPENSSL_init_crypto(OPENSSL_INIT_ASYNC, NULL))
         return ASYNC_ERR;
 
     ctx = async_get_ctx();
@@ -290,10 +372,8 @@ static void async_empty_pool(async_pool *pool)
     if (!pool || !pool->jobs)
         return;
 
-    do {
-        job = sk_ASYNC_JOB_pop(pool->jobs);
-        async_job_free(job);
-    } while (job);
+    while ((job = sk_ASYNC_JOB_pop(pool->jobs)) != NULL)
+        async_job_discard(job);
 }
 
 int async_init(void)
@@ -318,7 +398,6 @@ void async_deinit(void)
 int ASYNC_init_thread(size_t max_size, size_t init_size)
 {
     async_pool *pool;
-    size_t curr_size = 0;
 
     if (init_size > max_size) {
         ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD, ASYNC_R_INVALID_POOL_SIZE);
@@ -338,12 +417,16 @@ int ASYNC_init_thread(size_t max_size, size_t init_size)
     }
 
     pool->jobs = sk_ASYNC_JOB_new_reserve(NULL, init_size);
-    if (pool->jobs == NULL) {
+    pool->lock = CRYPTO_THREAD_lock_new();
+    if (pool->jobs == NULL || pool->lock == NULL) {
         ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD, ERR_R_MALLOC_FAILURE);
+        sk_ASYNC_JOB_free(pool->jobs);
+        CRYPTO_THREAD_lock_free(pool->lock);
         OPENSSL_free(pool);
         return 0;
     }
 
+    pool->references = 1;
     pool->max_size = max_size;
 
     /* Pre-create jobs as required */
@@ -359,10 +442,10 @@ int ASYNC_init_thread(size_t max_size, size_t init_size)
             break;
         }
         job->funcargs = NULL;
+        job->pool = pool;
+        pool->references++;
         sk_ASYNC_JOB_push(pool->jobs, job); /* Cannot fail due to reserve */
-        curr_size++;
     }
-    pool->curr_size = curr_size;
     if (!CRYPTO_THREAD_set_local(&poolkey, pool)) {
         ASYNCerr(ASYNC_F_ASYNC_INIT_THREAD, ASYNC_R_FAILED_TO_SET_POOL);
         goto err;
@@ -371,8 +454,7 @@ int ASYNC_init_thread(size_t max_size, size_t init_size)
     return 1;
 err:
     async_empty_pool(pool);
-    sk_ASYNC_JOB_free(pool->jobs);
-    OPENSSL_free(pool);
+    async_pool_free(pool);
     return 0;
 }
 
@@ -382,9 +464,9 @@ static void async_delete_thread_state(void *arg)
     async_pool *pool = (async_pool *)CRYPTO_THREAD_get_local(&poolkey);
 
     if (pool != NULL) {
+        /* Jobs still running elsewhere keep the pool until they finish */
         async_empty_pool(pool);
-        sk_ASYNC_JOB_free(pool->jobs);
-        OPENSSL_free(pool);
+        async_pool_free(pool);
         CRYPTO_THREAD_set_local(&poolkey, NULL);
     }
     async_local_cleanup();
@@ -452,3 +534,18 @@ void ASYNC_unblock_pause(void)
     if (ctx->blocked > 0)
         ctx->blocked--;
 }
+
+int ASYNC_set_stack_size(size_t size)
+{
+    if (size != 0 && size < ASYNC_MIN_STACK) {
+        ASYNCerr(0, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+    stack_size = size;
+    return 1;
+}
+
+size_t ASYNC_get_stack_size(void)
+{
+    return stack_size;
+}
@@ -21,6 +21,7 @@
 #endif
 
 #include "internal/async.h"
+#include "internal/refcount.h"
 #include <openssl/crypto.h>
 
 typedef struct async_ctx_st async_ctx;
@@ -43,6 +44,8 @@ struct async_job_st {
     int ret;
     int status;
     ASYNC_WAIT_CTX *waitctx;
+    /* The pool that counts this job, possibly another thread's */
+    async_pool *pool;
 };
 
 struct fd_lookup_st {
@@ -62,13 +65,21 @@ struct async_wait_ctx_st {
     ASYNC_callback_fn callback;
     void *callback_arg;
     int status;
+    ASYNC_RING *ring;
+    void *ring_data;
 };
 
 DEFINE_STACK_OF(ASYNC_JOB)
 
 struct async_pool_st {
     STACK_OF(ASYNC_JOB) *jobs;
-    size_t curr_size;
+    /*
+     * One reference for the owning thread, until it cleans up, and one for
+     * each job counted by the pool, wherever it is.  Jobs finished by
+     * another thread drop theirs from that thread.
+     */
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
     size_t max_size;
 };
 
@@ -77,4 +88,5 @@ void async_start_func(void);
 async_ctx *async_get_ctx(void);
 
 void async_wait_ctx_reset_counts(ASYNC_WAIT_CTX *ctx);
+int async_ring_post(void *arg);
 
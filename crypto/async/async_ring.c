@@ -0,0 +1,176 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* This must be the first #include file */
+#include "async_locl.h"
+
+#include <string.h>
+#include <openssl/err.h>
+#include "e_os.h"
+
+#ifdef ASYNC_POSIX
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+/*
+ * A completion ring collects the completions of many ASYNC_WAIT_CTXs, so
+ * that an application with thousands of operations in flight waits on a
+ * single fd and picks up all completions at once, instead of watching an
+ * fd per job.  The fd is only made readable when the ring goes from empty
+ * to non-empty, and cleared again when it has been drained, which keeps
+ * the notification cost per batch rather than per completion.
+ */
+
+#define RING_DEFAULT_SIZE       64
+
+struct async_ring_st {
+    CRYPTO_RWLOCK *lock;
+    void **entries;
+    size_t size;
+    size_t first;
+    size_t num;
+#ifdef ASYNC_POSIX
+    /* Readable while the ring is not empty */
+    int fd[2];
+    int signalled;
+#endif
+};
+
+ASYNC_RING *ASYNC_RING_new(size_t size)
+{
+    ASYNC_RING *ring;
+#ifdef ASYNC_POSIX
+    int i;
+#endif
+
+    if ((ring = OPENSSL_zalloc(sizeof(*ring))) == NULL) {
+        ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+#ifdef ASYNC_POSIX
+    ring->fd[0] = ring->fd[1] = -1;
+#endif
+    ring->size = size == 0 ? RING_DEFAULT_SIZE : size;
+    if ((ring->lock = CRYPTO_THREAD_lock_new()) == NULL
+            || (ring->entries = OPENSSL_malloc(ring->size
+                                               * sizeof(*ring->entries)))
+               == NULL) {
+        ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+#ifdef ASYNC_POSIX
+    if (pipe(ring->fd) != 0) {
+        SYSerr(0, get_last_sys_error());
+        goto err;
+    }
+    for (i = 0; i < 2; i++)
+        if (fcntl(ring->fd[i], F_SETFL,
+                  fcntl(ring->fd[i], F_GETFL) | O_NONBLOCK) == -1) {
+            SYSerr(0, get_last_sys_error());
+            goto err;
+        }
+#endif
+    return ring;
+ err:
+    ASYNC_RING_free(ring);
+    return NULL;
+}
+
+void ASYNC_RING_free(ASYNC_RING *ring)
+{
+    if (ring == NULL)
+        return;
+#ifdef ASYNC_POSIX
+    if (ring->fd[0] != -1)
+        close(ring->fd[0]);
+    if (ring->fd[1] != -1)
+        close(ring->fd[1]);
+#endif
+    OPENSSL_free(ring->entries);
+    CRYPTO_THREAD_lock_free(ring->lock);
+    OPENSSL_free(ring);
+}
+
+int ASYNC_RING_get_fd(ASYNC_RING *ring, OSSL_ASYNC_FD *fd)
+{
+#ifdef ASYNC_POSIX
+    *fd = ring->fd[0];
+    return 1;
+#else
+    ASYNCerr(0, ERR_R_DISABLED);
+    return 0;
+#endif
+}
+
+size_t ASYNC_RING_drain(ASYNC_RING *ring, void **user_data, size_t max)
+{
+    size_t n, i;
+#ifdef ASYNC_POSIX
+    char buf;
+#endif
+
+    CRYPTO_THREAD_write_lock(ring->lock);
+    n = ring->num < max ? ring->num : max;
+    for (i = 0; i < n; i++)
+        user_data[i] = ring->entries[(ring->first + i) % ring->size];
+    ring->first = (ring->first + n) % ring->size;
+    ring->num -= n;
+#ifdef ASYNC_POSIX
+    if (ring->num == 0 && ring->signalled)
+        ring->signalled = read(ring->fd[0], &buf, 1) != 1;
+#endif
+    CRYPTO_THREAD_unlock(ring->lock);
+    return n;
+}
+
+static int ring_push(ASYNC_RING *ring, void *user_data)
+{
+    void **entries;
+    size_t i;
+#ifdef ASYNC_POSIX
+    char buf = 0;
+#endif
+
+    if (ring->num == ring->size) {
+        entries = OPENSSL_malloc(2 * ring->size * sizeof(*entries));
+        if (entries == NULL)
+            return 0;
+        for (i = 0; i < ring->num; i++)
+            entries[i] = ring->entries[(ring->first + i) % ring->size];
+        OPENSSL_free(ring->entries);
+        ring->entries = entries;
+        ring->first = 0;
+        ring->size *= 2;
+    }
+    ring->entries[(ring->first + ring->num++) % ring->size] = user_data;
+#ifdef ASYNC_POSIX
+    if (!ring->signalled)
+        ring->signalled = write(ring->fd[1], &buf, 1) == 1;
+#endif
+    return 1;
+}
+
+/*
+ * The ASYNC_WAIT_CTX callback installed by ASYNC_WAIT_CTX_set_ring(), may
+ * be called from any thread
+ */
+int async_ring_post(void *arg)
+{
+    ASYNC_WAIT_CTX *ctx = arg;
+    ASYNC_RING *ring = ctx->ring;
+    int ret;
+
+    CRYPTO_THREAD_write_lock(ring->lock);
+    ret = ring_push(ring, ctx->ring_data);
+    CRYPTO_THREAD_unlock(ring->lock);
+    if (!ret)
+        ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+    return ret;
+}
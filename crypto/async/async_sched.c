@@ -0,0 +1,618 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* This must be the first #include file */
+#include "async_locl.h"
+
+#include <openssl/err.h>
+#include "e_os.h"
+
+#ifdef ASYNC_POSIX
+
+# include <stdlib.h>
+# include <string.h>
+# include <fcntl.h>
+# include <poll.h>
+# include <unistd.h>
+
+/*
+ * A scheduler lets several application threads share the work of running
+ * ASYNC jobs.  Every thread inside ASYNC_SCHED_run() is a worker with its own
+ * queue of runnable tasks.  Workers take submitted tasks from a shared
+ * injection queue and steal from each other when their own queue runs dry.
+ * A task whose job pauses is parked until one of its wait fds becomes
+ * readable or its ASYNC_WAIT_CTX callback is called, and is then resumed by
+ * whichever worker notices, not necessarily the one it paused on.
+ */
+
+/* How long an idle worker waits before looking at paused tasks again */
+# define SCHED_POLL_MS          10
+/* Tasks a busy worker runs between checks of the paused tasks */
+# define SCHED_POLL_INTERVAL    16
+
+# define TASK_QUEUED            0
+# define TASK_RUNNING           1
+# define TASK_PAUSED            2
+
+typedef struct async_task_st ASYNC_TASK;
+
+struct async_task_st {
+    ASYNC_SCHED *sched;
+    ASYNC_JOB *job;
+    ASYNC_WAIT_CTX *waitctx;
+    int (*func)(void *);
+    void *args;                 /* Copied into the job when it starts */
+    size_t size;
+    ASYNC_SCHED_done_fn done;
+    void *done_arg;
+    int state;
+    int woken;                  /* Callback called while not paused */
+    /* Links in the paused list, |next| also in the injection queue */
+    ASYNC_TASK *prev, *next;
+};
+
+typedef struct async_worker_st {
+    CRYPTO_RWLOCK *lock;
+    /* Ring buffer of runnable tasks */
+    ASYNC_TASK **tasks;
+    size_t first, num, size;
+    /* Buffers for polling, only used by the owning thread */
+    struct pollfd *pfds;
+    size_t pfds_size;
+    OSSL_ASYNC_FD *fds;
+    size_t fds_size;
+} ASYNC_WORKER;
+
+struct async_sched_st {
+    /* Protects everything below and the state of the tasks */
+    CRYPTO_RWLOCK *lock;
+    ASYNC_WORKER **workers;
+    size_t num_workers, workers_size;
+    size_t next_victim;
+    ASYNC_TASK *inject_first, *inject_last;
+    ASYNC_TASK *paused;
+    size_t outstanding;         /* Submitted and not finished */
+    int stopping;
+    /* Readable while the injection queue is not empty or we are stopping */
+    int wakefd[2];
+    int signalled;
+};
+
+static void sched_update_wake(ASYNC_SCHED *sched)
+{
+    int want = sched->inject_first != NULL || sched->stopping;
+    char c = 0;
+
+    if (want && !sched->signalled)
+        sched->signalled = write(sched->wakefd[1], &c, 1) == 1;
+    else if (!want && sched->signalled)
+        sched->signalled = read(sched->wakefd[0], &c, 1) != 1;
+}
+
+/* Called with the scheduler lock held */
+static void sched_inject(ASYNC_SCHED *sched, ASYNC_TASK *task)
+{
+    task->state = TASK_QUEUED;
+    task->next = NULL;
+    if (sched->inject_last == NULL)
+        sched->inject_first = task;
+    else
+        sched->inject_last->next = task;
+    sched->inject_last = task;
+    sched_update_wake(sched);
+}
+
+/* Called with the scheduler lock held */
+static ASYNC_TASK *sched_inject_pop(ASYNC_SCHED *sched)
+{
+    ASYNC_TASK *task = sched->inject_first;
+
+    if (task != NULL) {
+        sched->inject_first = task->next;
+        if (sched->inject_first == NULL) {
+            sched->inject_last = NULL;
+            sched_update_wake(sched);
+        }
+        task->next = NULL;
+    }
+    return task;
+}
+
+/* Called with the scheduler lock held */
+static void sched_unlink_paused(ASYNC_SCHED *sched, ASYNC_TASK *task)
+{
+    if (task->prev != NULL)
+        task->prev->next = task->next;
+    else
+        sched->paused = task->next;
+    if (task->next != NULL)
+        task->next->prev = task->prev;
+    task->prev = task->next = NULL;
+}
+
+static void task_free(ASYNC_TASK *task)
+{
+    ASYNC_WAIT_CTX_free(task->waitctx);
+    OPENSSL_free(task->args);
+    OPENSSL_free(task);
+}
+
+static int worker_push(ASYNC_WORKER *w, ASYNC_TASK *task)
+{
+    ASYNC_TASK **tasks;
+    size_t i, size;
+    int ret = 0;
+
+    CRYPTO_THREAD_write_lock(w->lock);
+    if (w->num == w->size) {
+        size = w->size == 0 ? 16 : 2 * w->size;
+        if ((tasks = OPENSSL_malloc(size * sizeof(*tasks))) == NULL)
+            goto end;
+        for (i = 0; i < w->num; i++)
+            tasks[i] = w->tasks[(w->first + i) % w->size];
+        OPENSSL_free(w->tasks);
+        w->tasks = tasks;
+        w->first = 0;
+        w->size = size;
+    }
+    w->tasks[(w->first + w->num++) % w->size] = task;
+    ret = 1;
+ end:
+    CRYPTO_THREAD_unlock(w->lock);
+    return ret;
+}
+
+/* The owner runs its tasks oldest first */
+static ASYNC_TASK *worker_pop(ASYNC_WORKER *w)
+{
+    ASYNC_TASK *task = NULL;
+
+    CRYPTO_THREAD_write_lock(w->lock);
+    if (w->num > 0) {
+        task = w->tasks[w->first];
+        w->first = (w->first + 1) % w->size;
+        w->num--;
+    }
+    CRYPTO_THREAD_unlock(w->lock);
+    return task;
+}
+
+/* Thieves take the newest task, which the owner would have reached last */
+static ASYNC_TASK *worker_steal(ASYNC_WORKER *w)
+{
+    ASYNC_TASK *task = NULL;
+
+    CRYPTO_THREAD_write_lock(w->lock);
+    if (w->num > 0)
+        task = w->tasks[(w->first + --w->num) % w->size];
+    CRYPTO_THREAD_unlock(w->lock);
+    return task;
+}
+
+/*
+ * Queue |task| on |w|, or on the injection queue if that fails.  Called with
+ * the scheduler lock held.
+ */
+static void sched_queue(ASYNC_SCHED *sched, ASYNC_WORKER *w, ASYNC_TASK *task)
+{
+    task->state = TASK_QUEUED;
+    if (!worker_push(w, task))
+        sched_inject(sched, task);
+}
+
+static ASYNC_TASK *sched_next_task(ASYNC_SCHED *sched, ASYNC_WORKER *w)
+{
+    ASYNC_TASK *task;
+    size_t i, n;
+
+    if ((task = worker_pop(w)) != NULL)
+        return task;
+
+    CRYPTO_THREAD_write_lock(sched->lock);
+    task = sched_inject_pop(sched);
+    for (i = 0, n = sched->num_workers; task == NULL && i < n; i++) {
+        ASYNC_WORKER *victim = sched->workers[sched->next_victim++ % n];
+
+        if (victim != w)
+            task = worker_steal(victim);
+    }
+    CRYPTO_THREAD_unlock(sched->lock);
+    return task;
+}
+
+/* Runs |task| until its job pauses or finishes */
+static void sched_run_task(ASYNC_SCHED *sched, ASYNC_WORKER *w,
+                           ASYNC_TASK *task)
+{
+    int status, ret = 0;
+    size_t numfds = 0;
+
+    CRYPTO_THREAD_write_lock(sched->lock);
+    task->state = TASK_RUNNING;
+    CRYPTO_THREAD_unlock(sched->lock);
+
+    status = ASYNC_start_job(&task->job, task->waitctx, &ret, task->func,
+                             task->args, task->size);
+    if (status != ASYNC_NO_JOBS) {
+        OPENSSL_free(task->args);
+        task->args = NULL;
+    }
+
+    switch (status) {
+    case ASYNC_PAUSE:
+        CRYPTO_THREAD_write_lock(sched->lock);
+        if (!task->woken
+                && ASYNC_WAIT_CTX_get_all_fds(task->waitctx, NULL, &numfds)
+                && numfds > 0) {
+            task->state = TASK_PAUSED;
+            task->prev = NULL;
+            task->next = sched->paused;
+            if (sched->paused != NULL)
+                sched->paused->prev = task;
+            sched->paused = task;
+            CRYPTO_THREAD_unlock(sched->lock);
+            return;
+        }
+        /* Already woken, or nothing to wait for: just a yield */
+        task->woken = 0;
+        sched_queue(sched, w, task);
+        CRYPTO_THREAD_unlock(sched->lock);
+        return;
+
+    case ASYNC_NO_JOBS:
+        /* The job pool of this thread is full, let another worker try */
+        CRYPTO_THREAD_write_lock(sched->lock);
+        sched_inject(sched, task);
+        CRYPTO_THREAD_unlock(sched->lock);
+        return;
+
+    default:
+        if (task->done != NULL)
+            task->done(status, status == ASYNC_FINISH ? ret : 0,
+                       task->done_arg);
+        task_free(task);
+        CRYPTO_THREAD_write_lock(sched->lock);
+        sched->outstanding--;
+        CRYPTO_THREAD_unlock(sched->lock);
+        return;
+    }
+}
+
+static int fd_cmp(const void *a, const void *b)
+{
+    OSSL_ASYNC_FD fa = *(const OSSL_ASYNC_FD *)a;
+    OSSL_ASYNC_FD fb = *(const OSSL_ASYNC_FD *)b;
+
+    return fa < fb ? -1 : fa > fb;
+}
+
+static int worker_reserve_fds(ASYNC_WORKER *w, size_t num)
+{
+    struct pollfd *pfds;
+    OSSL_ASYNC_FD *fds;
+
+    if (num <= w->fds_size)
+        return 1;
+    num += num / 2;
+    pfds = OPENSSL_realloc(w->pfds, num * sizeof(*pfds));
+    if (pfds == NULL)
+        return 0;
+    w->pfds = pfds;
+    fds = OPENSSL_realloc(w->fds, num * sizeof(*fds));
+    if (fds == NULL)
+        return 0;
+    w->fds = fds;
+    w->pfds_size = w->fds_size = num;
+    return 1;
+}
+
+/*
+ * Waits for up to |timeout| milliseconds for new tasks or for the wait fds of
+ * paused tasks, and queues the tasks whose fds are ready on |w|.
+ */
+static int sched_poll(ASYNC_SCHED *sched, ASYNC_WORKER *w, int timeout)
+{
+    ASYNC_TASK *task, *next;
+    size_t n = 0, numfds, i, nready;
+    int include_wake;
+
+    CRYPTO_THREAD_write_lock(sched->lock);
+    if (timeout != 0 && sched->paused == NULL && sched->outstanding == 0
+            && !sched->stopping)
+        timeout = -1;
+    if (timeout == 0 && sched->paused == NULL) {
+        CRYPTO_THREAD_unlock(sched->lock);
+        return 1;
+    }
+    /* When stopping the wake fd stays readable, so leave it out */
+    include_wake = timeout != 0 && !sched->stopping;
+    for (task = sched->paused; task != NULL; task = task->next) {
+        if (!ASYNC_WAIT_CTX_get_all_fds(task->waitctx, NULL, &numfds)
+                || !worker_reserve_fds(w, n + numfds + 1)
+                || !ASYNC_WAIT_CTX_get_all_fds(task->waitctx, w->fds + n,
+                                               &numfds)) {
+            CRYPTO_THREAD_unlock(sched->lock);
+            ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        n += numfds;
+    }
+    CRYPTO_THREAD_unlock(sched->lock);
+
+    if (!worker_reserve_fds(w, n + 1)) {
+        ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        w->pfds[i].fd = w->fds[i];
+        w->pfds[i].events = POLLIN;
+        w->pfds[i].revents = 0;
+    }
+    if (include_wake) {
+        w->pfds[n].fd = sched->wakefd[0];
+        w->pfds[n].events = POLLIN;
+        w->pfds[n].revents = 0;
+    }
+    if (poll(w->pfds, n + include_wake, timeout) <= 0)
+        return 1;
+
+    for (i = nready = 0; i < n; i++)
+        if (w->pfds[i].revents != 0)
+            w->fds[nready++] = w->pfds[i].fd;
+    if (nready == 0)
+        return 1;
+    qsort(w->fds, nready, sizeof(*w->fds), fd_cmp);
+
+    /*
+     * Tasks may have been resumed, or even freed, since the list was read,
+     * so look the ready fds up in the paused tasks as they are now.
+     */
+    CRYPTO_THREAD_write_lock(sched->lock);
+    for (task = sched->paused; task != NULL; task = next) {
+        OSSL_ASYNC_FD *fds;
+        int ready = 0;
+
+        next = task->next;
+        if (!ASYNC_WAIT_CTX_get_all_fds(task->waitctx, NULL, &numfds)
+                || !worker_reserve_fds(w, nready + numfds)) {
+            CRYPTO_THREAD_unlock(sched->lock);
+            ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        /* The task's fds go after the ready ones */
+        fds = w->fds + nready;
+        ASYNC_WAIT_CTX_get_all_fds(task->waitctx, fds, &numfds);
+        for (i = 0; i < numfds && !ready; i++)
+            ready = bsearch(&fds[i], w->fds, nready, sizeof(*w->fds),
+                            fd_cmp) != NULL;
+        if (ready) {
+            sched_unlink_paused(sched, task);
+            sched_queue(sched, w, task);
+        }
+    }
+    CRYPTO_THREAD_unlock(sched->lock);
+    return 1;
+}
+
+/* The ASYNC_WAIT_CTX callback, may be called from any thread */
+static int sched_wake(void *arg)
+{
+    ASYNC_TASK *task = arg;
+    ASYNC_SCHED *sched = task->sched;
+
+    CRYPTO_THREAD_write_lock(sched->lock);
+    if (task->state == TASK_PAUSED) {
+        sched_unlink_paused(sched, task);
+        sched_inject(sched, task);
+    } else {
+        task->woken = 1;
+    }
+    CRYPTO_THREAD_unlock(sched->lock);
+    return 1;
+}
+
+ASYNC_SCHED *ASYNC_SCHED_new(void)
+{
+    ASYNC_SCHED *sched;
+    int i;
+
+    if (!OPENSSL_init_crypto(OPENSSL_INIT_ASYNC, NULL))
+        return NULL;
+
+    if ((sched = OPENSSL_zalloc(sizeof(*sched))) == NULL) {
+        ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    sched->wakefd[0] = sched->wakefd[1] = -1;
+    if ((sched->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    if (pipe(sched->wakefd) != 0) {
+        SYSerr(0, get_last_sys_error());
+        goto err;
+    }
+    for (i = 0; i < 2; i++)
+        if (fcntl(sched->wakefd[i], F_SETFL,
+                  fcntl(sched->wakefd[i], F_GETFL) | O_NONBLOCK) == -1) {
+            SYSerr(0, get_last_sys_error());
+            goto err;
+        }
+    return sched;
+ err:
+    ASYNC_SCHED_free(sched);
+    return NULL;
+}
+
+void ASYNC_SCHED_free(ASYNC_SCHED *sched)
+{
+    ASYNC_TASK *task;
+
+    if (sched == NULL)
+        return;
+    /* Only tasks that never ran can be left when no worker is running */
+    while ((task = sched_inject_pop(sched)) != NULL)
+        task_free(task);
+    if (sched->wakefd[0] != -1)
+        close(sched->wakefd[0]);
+    if (sched->wakefd[1] != -1)
+        close(sched->wakefd[1]);
+    OPENSSL_free(sched->workers);
+    CRYPTO_THREAD_lock_free(sched->lock);
+    OPENSSL_free(sched);
+}
+
+int ASYNC_SCHED_submit(ASYNC_SCHED *sched, int (*func)(void *), void *args,
+                       size_t size, ASYNC_SCHED_done_fn done, void *done_arg)
+{
+    ASYNC_TASK *task;
+
+    if ((task = OPENSSL_zalloc(sizeof(*task))) == NULL
+            || (task->waitctx = ASYNC_WAIT_CTX_new()) == NULL
+            || (args != NULL
+                && (task->args = OPENSSL_memdup(args, size)) == NULL)) {
+        ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    task->sched = sched;
+    task->func = func;
+    task->size = size;
+    task->done = done;
+    task->done_arg = done_arg;
+    if (!ASYNC_WAIT_CTX_set_callback(task->waitctx, sched_wake, task))
+        goto err;
+
+    CRYPTO_THREAD_write_lock(sched->lock);
+    if (sched->stopping) {
+        CRYPTO_THREAD_unlock(sched->lock);
+        ASYNCerr(0, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+        goto err;
+    }
+    sched->outstanding++;
+    sched_inject(sched, task);
+    CRYPTO_THREAD_unlock(sched->lock);
+    return 1;
+ err:
+    if (task != NULL)
+        task_free(task);
+    return 0;
+}
+
+void ASYNC_SCHED_stop(ASYNC_SCHED *sched)
+{
+    CRYPTO_THREAD_write_lock(sched->lock);
+    sched->stopping = 1;
+    sched_update_wake(sched);
+    CRYPTO_THREAD_unlock(sched->lock);
+}
+
+static void worker_free(ASYNC_WORKER *w)
+{
+    CRYPTO_THREAD_lock_free(w->lock);
+    OPENSSL_free(w->tasks);
+    OPENSSL_free(w->pfds);
+    OPENSSL_free(w->fds);
+    OPENSSL_free(w);
+}
+
+int ASYNC_SCHED_run(ASYNC_SCHED *sched)
+{
+    ASYNC_WORKER *w, **workers;
+    ASYNC_TASK *task;
+    unsigned int steps = 0;
+    size_t i;
+    int done, ret = 0;
+
+    if ((w = OPENSSL_zalloc(sizeof(*w))) == NULL
+            || (w->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+        OPENSSL_free(w);
+        return 0;
+    }
+
+    CRYPTO_THREAD_write_lock(sched->lock);
+    if (sched->num_workers == sched->workers_size) {
+        size_t size = sched->workers_size == 0 ? 4 : 2 * sched->workers_size;
+
+        workers = OPENSSL_realloc(sched->workers, size * sizeof(*workers));
+        if (workers == NULL) {
+            CRYPTO_THREAD_unlock(sched->lock);
+            ASYNCerr(0, ERR_R_MALLOC_FAILURE);
+            worker_free(w);
+            return 0;
+        }
+        sched->workers = workers;
+        sched->workers_size = size;
+    }
+    sched->workers[sched->num_workers++] = w;
+    CRYPTO_THREAD_unlock(sched->lock);
+
+    for (;;) {
+        if ((task = sched_next_task(sched, w)) != NULL) {
+            sched_run_task(sched, w, task);
+            if (++steps % SCHED_POLL_INTERVAL == 0 && !sched_poll(sched, w, 0))
+                goto end;
+            continue;
+        }
+
+        CRYPTO_THREAD_write_lock(sched->lock);
+        done = sched->stopping && sched->outstanding == 0;
+        CRYPTO_THREAD_unlock(sched->lock);
+        if (done)
+            break;
+        if (!sched_poll(sched, w, SCHED_POLL_MS))
+            goto end;
+    }
+    ret = 1;
+
+ end:
+    CRYPTO_THREAD_write_lock(sched->lock);
+    for (i = 0; i < sched->num_workers; i++)
+        if (sched->workers[i] == w) {
+            sched->workers[i] = sched->workers[--sched->num_workers];
+            break;
+        }
+    /* Hand whatever is left over to the remaining workers */
+    while ((task = worker_pop(w)) != NULL)
+        sched_inject(sched, task);
+    CRYPTO_THREAD_unlock(sched->lock);
+    worker_free(w);
+    return ret;
+}
+
+#else
+
+ASYNC_SCHED *ASYNC_SCHED_new(void)
+{
+    ASYNCerr(0, ERR_R_DISABLED);
+    return NULL;
+}
+
+void ASYNC_SCHED_free(ASYNC_SCHED *sched)
+{
+}
+
+int ASYNC_SCHED_submit(ASYNC_SCHED *sched, int (*func)(void *), void *args,
+                       size_t size, ASYNC_SCHED_done_fn done, void *done_arg)
+{
+    ASYNCerr(0, ERR_R_DISABLED);
+    return 0;
+}
+
+int ASYNC_SCHED_run(ASYNC_SCHED *sched)
+{
+    ASYNCerr(0, ERR_R_DISABLED);
+    return 0;
+}
+
+void ASYNC_SCHED_stop(ASYNC_SCHED *sched)
+{
+}
+
+#endif
@@ -206,6 +206,24 @@ int ASYNC_WAIT_CTX_get_callback(ASYNC_WAIT_CTX *ctx,
       return 1;
 }
 
+int ASYNC_WAIT_CTX_set_ring(ASYNC_WAIT_CTX *ctx, ASYNC_RING *ring,
+                            void *user_data)
+{
+    if (ctx == NULL)
+        return 0;
+
+    ctx->ring = ring;
+    ctx->ring_data = user_data;
+    if (ring != NULL) {
+        ctx->callback = async_ring_post;
+        ctx->callback_arg = ctx;
+    } else if (ctx->callback == async_ring_post) {
+        ctx->callback = NULL;
+        ctx->callback_arg = NULL;
+    }
+    return 1;
+}
+
 int ASYNC_WAIT_CTX_set_status(ASYNC_WAIT_CTX *ctx, int status)
 {
       ctx->status = status;
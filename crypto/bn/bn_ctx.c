@@ -8,7 +8,10 @@
  */
 
 #include <openssl/trace.h>
+#include <openssl/async.h>
 #include "internal/cryptlib.h"
+#include "internal/cryptlib_int.h"
+#include "internal/bn_int.h"
 #include "bn_lcl.h"
 
 /*-
@@ -46,6 +49,8 @@ typedef struct bignum_pool {
     BN_POOL_ITEM *head, *current, *tail;
     /* Stack depth and allocation size */
     unsigned used, size;
+    /* If set, items and the data of non-secure bignums come from here */
+    OSSL_ARENA *arena;
 } BN_POOL;
 static void BN_POOL_init(BN_POOL *);
 static void BN_POOL_finish(BN_POOL *);
@@ -62,6 +67,8 @@ typedef struct bignum_ctx_stack {
     unsigned int *indexes;
     /* Number of stack frames, and the size of the allocated array */
     unsigned int depth, size;
+    /* If set, |indexes| is allocated from here */
+    OSSL_ARENA *arena;
 } BN_STACK;
 static void BN_STACK_init(BN_STACK *);
 static void BN_STACK_finish(BN_STACK *);
@@ -88,8 +95,100 @@ struct bignum_ctx {
     int flags;
     /* The library context */
     OPENSSL_CTX *libctx;
+    /* Set for contexts made by bn_ctx_new_scoped() */
+    struct bn_scope_st *scope;
 };
 
+#ifndef FIPS_MODE
+/*
+ * Each thread keeps an arena for the short lived contexts that the library
+ * creates for a single operation. The arena is reset once the last such
+ * context in the thread is freed, so repeated operations reuse its memory.
+ */
+# define BN_SCOPE_ARENA_SIZE     16384
+
+typedef struct bn_scope_st {
+    OSSL_ARENA *arena;
+    unsigned int live;          /* Number of contexts using |arena| */
+} BN_SCOPE;
+
+typedef struct bn_scope_global_st {
+    CRYPTO_THREAD_LOCAL scope;
+} BN_SCOPE_GLOBAL;
+
+static void *bn_scope_ossl_ctx_new(OPENSSL_CTX *libctx)
+{
+    BN_SCOPE_GLOBAL *sgbl = OPENSSL_zalloc(sizeof(*sgbl));
+
+    if (sgbl == NULL)
+        return NULL;
+    /* Make sure the thread stop handlers are available */
+    OPENSSL_init_crypto(0, NULL);
+    if (!CRYPTO_THREAD_init_local(&sgbl->scope, NULL)) {
+        OPENSSL_free(sgbl);
+        return NULL;
+    }
+    return sgbl;
+}
+
+static void bn_scope_ossl_ctx_free(void *vsgbl)
+{
+    BN_SCOPE_GLOBAL *sgbl = vsgbl;
+
+    CRYPTO_THREAD_cleanup_local(&sgbl->scope);
+    OPENSSL_free(sgbl);
+}
+
+static const OPENSSL_CTX_METHOD bn_scope_ossl_ctx_method = {
+    bn_scope_ossl_ctx_new,
+    bn_scope_ossl_ctx_free,
+};
+
+static void bn_scope_delete_thread_state(void *arg)
+{
+    BN_SCOPE_GLOBAL *sgbl =
+        openssl_ctx_get_data(arg, OPENSSL_CTX_BN_SCOPE_INDEX,
+                             &bn_scope_ossl_ctx_method);
+    BN_SCOPE *scope;
+
+    if (sgbl == NULL)
+        return;
+    scope = CRYPTO_THREAD_get_local(&sgbl->scope);
+    CRYPTO_THREAD_set_local(&sgbl->scope, NULL);
+    if (scope != NULL) {
+        OSSL_ARENA_free(scope->arena);
+        OPENSSL_free(scope);
+    }
+}
+
+static BN_SCOPE *bn_scope_get(OPENSSL_CTX *libctx)
+{
+    BN_SCOPE_GLOBAL *sgbl =
+        openssl_ctx_get_data(libctx, OPENSSL_CTX_BN_SCOPE_INDEX,
+                             &bn_scope_ossl_ctx_method);
+    BN_SCOPE *scope;
+
+    if (sgbl == NULL)
+        return NULL;
+    scope = CRYPTO_THREAD_get_local(&sgbl->scope);
+    if (scope == NULL) {
+        libctx = openssl_ctx_get_concrete(libctx);
+        if (!ossl_init_thread_start(NULL, libctx,
+                                    bn_scope_delete_thread_state))
+            return NULL;
+        if ((scope = OPENSSL_zalloc(sizeof(*scope))) == NULL)
+            return NULL;
+        if ((scope->arena = OSSL_ARENA_new(BN_SCOPE_ARENA_SIZE)) == NULL
+                || !CRYPTO_THREAD_set_local(&sgbl->scope, scope)) {
+            OSSL_ARENA_free(scope->arena);
+            OPENSSL_free(scope);
+            return NULL;
+        }
+    }
+    return scope;
+}
+#endif /* FIPS_MODE */
+
 #ifndef FIPS_MODE
 /* Debugging functionality */
 static void ctxdbg(BIO *channel, const char *text, BN_CTX *ctx)
@@ -188,9 +287,64 @@ void BN_CTX_free(BN_CTX *ctx)
 #endif
     BN_STACK_finish(&ctx->stack);
     BN_POOL_finish(&ctx->pool);
+#ifndef FIPS_MODE
+    if (ctx->scope != NULL) {
+        /* |ctx| itself lives in the arena */
+        if (--ctx->scope->live == 0)
+            OSSL_ARENA_reset(ctx->scope->arena);
+        return;
+    }
+#endif
     OPENSSL_free(ctx);
 }
 
+int BN_CTX_set0_arena(BN_CTX *ctx, OSSL_ARENA *arena)
+{
+    /* Anything already allocated would be freed to the wrong place */
+    if (ctx->pool.size != 0 || ctx->stack.size != 0 || ctx->scope != NULL) {
+        BNerr(0, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+        return 0;
+    }
+    ctx->pool.arena = ctx->stack.arena = arena;
+    return 1;
+}
+
+/*
+ * Create a context for use within a single operation, which must free it
+ * before returning. Outside of async jobs, which may move between threads,
+ * the context and all its temporaries are carved out of an arena owned by
+ * the calling thread.
+ */
+BN_CTX *bn_ctx_new_scoped(OPENSSL_CTX *libctx)
+{
+#ifndef FIPS_MODE
+    BN_SCOPE *scope;
+    BN_CTX *ret;
+
+    if (ASYNC_get_current_job() != NULL)
+        return BN_CTX_new_ex(libctx);
+
+    /* The heap is a fine fallback, so don't leave errors behind for it */
+    ERR_set_mark();
+    if ((scope = bn_scope_get(libctx)) == NULL
+            || (ret = OSSL_ARENA_alloc(scope->arena, sizeof(*ret))) == NULL) {
+        ERR_pop_to_mark();
+        return BN_CTX_new_ex(libctx);
+    }
+    ERR_clear_last_mark();
+    memset(ret, 0, sizeof(*ret));
+    BN_POOL_init(&ret->pool);
+    BN_STACK_init(&ret->stack);
+    ret->pool.arena = ret->stack.arena = scope->arena;
+    ret->libctx = libctx;
+    ret->scope = scope;
+    scope->live++;
+    return ret;
+#else
+    return BN_CTX_new_ex(libctx);
+#endif
+}
+
 void BN_CTX_start(BN_CTX *ctx)
 {
     CTXDBG("ENTER BN_CTX_start()", ctx);
@@ -264,11 +418,13 @@ static void BN_STACK_init(BN_STACK *st)
 {
     st->indexes = NULL;
     st->depth = st->size = 0;
+    st->arena = NULL;
 }
 
 static void BN_STACK_finish(BN_STACK *st)
 {
-    OPENSSL_free(st->indexes);
+    if (st->arena == NULL)
+        OPENSSL_free(st->indexes);
     st->indexes = NULL;
 }
 
@@ -281,13 +437,18 @@ static int BN_STACK_push(BN_STACK *st, unsigned int idx)
             st->size ? (st->size * 3 / 2) : BN_CTX_START_FRAMES;
         unsigned int *newitems;
 
-        if ((newitems = OPENSSL_malloc(sizeof(*newitems) * newsize)) == NULL) {
+        if (st->arena != NULL)
+            newitems = OSSL_ARENA_alloc(st->arena, sizeof(*newitems) * newsize);
+        else
+            newitems = OPENSSL_malloc(sizeof(*newitems) * newsize);
+        if (newitems == NULL) {
             BNerr(BN_F_BN_STACK_PUSH, ERR_R_MALLOC_FAILURE);
             return 0;
         }
         if (st->depth)
             memcpy(newitems, st->indexes, sizeof(*newitems) * st->depth);
-        OPENSSL_free(st->indexes);
+        if (st->arena == NULL)
+            OPENSSL_free(st->indexes);
         st->indexes = newitems;
         st->size = newsize;
     }
@@ -308,6 +469,7 @@ static void BN_POOL_init(BN_POOL *p)
 {
     p->head = p->current = p->tail = NULL;
     p->used = p->size = 0;
+    p->arena = NULL;
 }
 
 static void BN_POOL_finish(BN_POOL *p)
@@ -320,7 +482,8 @@ static void BN_POOL_finish(BN_POOL *p)
             if (bn->d)
                 BN_clear_free(bn);
         p->current = p->head->next;
-        OPENSSL_free(p->head);
+        if (p->arena == NULL)
+            OPENSSL_free(p->head);
         p->head = p->current;
     }
 }
@@ -335,7 +498,11 @@ static BIGNUM *BN_POOL_get(BN_POOL *p, int flag)
     if (p->used == p->size) {
         BN_POOL_ITEM *item;
 
-        if ((item = OPENSSL_malloc(sizeof(*item))) == NULL) {
+        if (p->arena != NULL)
+            item = OSSL_ARENA_alloc(p->arena, sizeof(*item));
+        else
+            item = OPENSSL_malloc(sizeof(*item));
+        if (item == NULL) {
             BNerr(BN_F_BN_POOL_GET, ERR_R_MALLOC_FAILURE);
             return NULL;
         }
@@ -343,6 +510,8 @@ static BIGNUM *BN_POOL_get(BN_POOL *p, int flag)
             bn_init(bn);
             if ((flag & BN_FLG_SECURE) != 0)
                 BN_set_flags(bn, BN_FLG_SECURE);
+            else
+                bn->arena = p->arena;
         }
         item->prev = p->tail;
         item->next = NULL;
@@ -739,6 +739,7 @@ int BN_mod_exp_mont_consttime(BIGNUM *rr, const BIGNUM *a, const BIGNUM *p,
     tmp.dmax = am.dmax = top;
     tmp.neg = am.neg = 0;
     tmp.flags = am.flags = BN_FLG_STATIC_DATA;
+    tmp.arena = am.arena = NULL;
 
     /* prepare a^0 in Montgomery domain */
 #if 1                           /* by Shay Gueron's suggestion */
@@ -1126,6 +1127,71 @@ int BN_mod_exp_mont_consttime(BIGNUM *rr, const BIGNUM *a, const BIGNUM *p,
     return ret;
 }
 
+/*
+ * Computes rr1 = a1^p1 mod m1 and rr2 = a2^p2 mod m2, e.g. the two halves
+ * of an RSA CRT computation.  If the moduli are both 1024 or both 1536 bits
+ * and AVX512IFMA is available the two exponentiations run side by side,
+ * otherwise this is two calls to BN_mod_exp_mont_consttime().
+ */
+int BN_mod_exp_mont_consttime_x2(BIGNUM *rr1, const BIGNUM *a1,
+                                 const BIGNUM *p1, const BIGNUM *m1,
+                                 BN_MONT_CTX *in_mont1,
+                                 BIGNUM *rr2, const BIGNUM *a2,
+                                 const BIGNUM *p2, const BIGNUM *m2,
+                                 BN_MONT_CTX *in_mont2, BN_CTX *ctx)
+{
+#ifdef RSAZ_ENABLED
+    int bits = BN_num_bits(m1), words = bits / BN_BITS2, ret = 0;
+    BN_MONT_CTX *mont1 = in_mont1, *mont2 = in_mont2;
+    BN_ULONG in[6][1536 / BN_BITS2];
+
+    if ((bits == 1024 || bits == 1536) && BN_num_bits(m2) == bits
+            && BN_is_odd(m1) && BN_is_odd(m2)
+            && !a1->neg && !a2->neg && !p1->neg && !p2->neg
+            && BN_ucmp(a1, m1) < 0 && BN_ucmp(a2, m2) < 0
+            && p1->top <= words && p2->top <= words
+            && rsaz_avx512ifma_eligible()) {
+        if (mont1 == NULL
+                && ((mont1 = BN_MONT_CTX_new()) == NULL
+                    || !BN_MONT_CTX_set(mont1, m1, ctx)))
+            goto err;
+        if (mont2 == NULL
+                && ((mont2 = BN_MONT_CTX_new()) == NULL
+                    || !BN_MONT_CTX_set(mont2, m2, ctx)))
+            goto err;
+        if (!bn_copy_words(in[0], a1, words)
+                || !bn_copy_words(in[1], p1, words)
+                || !bn_copy_words(in[2], &mont1->RR, words)
+                || !bn_copy_words(in[3], a2, words)
+                || !bn_copy_words(in[4], p2, words)
+                || !bn_copy_words(in[5], &mont2->RR, words)
+                || bn_wexpand(rr1, words) == NULL
+                || bn_wexpand(rr2, words) == NULL)
+            goto err;
+        if (!RSAZ_mod_exp_avx512_x2(rr1->d, in[0], in[1], m1->d, in[2],
+                                    mont1->n0[0],
+                                    rr2->d, in[3], in[4], m2->d, in[5],
+                                    mont2->n0[0], bits))
+            goto err;
+        rr1->top = rr2->top = words;
+        rr1->neg = rr2->neg = 0;
+        bn_correct_top(rr1);
+        bn_correct_top(rr2);
+        ret = 1;
+ err:
+        OPENSSL_cleanse(in, sizeof(in));
+        if (mont1 != in_mont1)
+            BN_MONT_CTX_free(mont1);
+        if (mont2 != in_mont2)
+            BN_MONT_CTX_free(mont2);
+        return ret;
+    }
+#endif
+
+    return BN_mod_exp_mont_consttime(rr1, a1, p1, m1, ctx, in_mont1)
+           && BN_mod_exp_mont_consttime(rr2, a2, p2, m2, ctx, in_mont2);
+}
+
 int BN_mod_exp_mont_word(BIGNUM *rr, BN_ULONG a, const BIGNUM *p,
                          const BIGNUM *m, BN_CTX *ctx, BN_MONT_CTX *in_mont)
 {
@@ -223,6 +223,7 @@ struct bignum_st {
     int dmax;                   /* Size of the d array. */
     int neg;                    /* one if the number is negative */
     int flags;
+    OSSL_ARENA *arena;          /* If set |d| is allocated from here */
 };
 
 /* Used for montgomery multiplication */
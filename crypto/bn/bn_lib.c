@@ -144,7 +144,11 @@ int BN_num_bits(const BIGNUM *a)
 
 static void bn_free_d(BIGNUM *a, int clear)
 {
-    if (BN_get_flags(a, BN_FLG_SECURE))
+    if (a->arena != NULL) {
+        /* Given back when the arena is reset */
+        if (clear != 0)
+            OPENSSL_cleanse(a->d, a->dmax * sizeof(a->d[0]));
+    } else if (BN_get_flags(a, BN_FLG_SECURE))
         OPENSSL_secure_clear_free(a->d, a->dmax * sizeof(a->d[0]));
     else if (clear != 0)
         OPENSSL_clear_free(a->d, a->dmax * sizeof(a->d[0]));
@@ -218,10 +222,14 @@ static BN_ULONG *bn_expand_internal(const BIGNUM *b, int words)
         BNerr(BN_F_BN_EXPAND_INTERNAL, BN_R_EXPAND_ON_STATIC_BIGNUM_DATA);
         return NULL;
     }
-    if (BN_get_flags(b, BN_FLG_SECURE))
+    if (b->arena != NULL) {
+        if ((a = OSSL_ARENA_alloc(b->arena, words * sizeof(*a))) != NULL)
+            memset(a, 0, words * sizeof(*a));
+    } else if (BN_get_flags(b, BN_FLG_SECURE)) {
         a = OPENSSL_secure_zalloc(words * sizeof(*a));
-    else
+    } else {
         a = OPENSSL_zalloc(words * sizeof(*a));
+    }
     if (a == NULL) {
         BNerr(BN_F_BN_EXPAND_INTERNAL, ERR_R_MALLOC_FAILURE);
         return NULL;
@@ -305,6 +313,7 @@ void BN_swap(BIGNUM *a, BIGNUM *b)
 {
     int flags_old_a, flags_old_b;
     BN_ULONG *tmp_d;
+    OSSL_ARENA *tmp_arena;
     int tmp_top, tmp_dmax, tmp_neg;
 
     bn_check_top(a);
@@ -317,16 +326,19 @@ void BN_swap(BIGNUM *a, BIGNUM *b)
     tmp_top = a->top;
     tmp_dmax = a->dmax;
     tmp_neg = a->neg;
+    tmp_arena = a->arena;
 
     a->d = b->d;
     a->top = b->top;
     a->dmax = b->dmax;
     a->neg = b->neg;
+    a->arena = b->arena;
 
     b->d = tmp_d;
     b->top = tmp_top;
     b->dmax = tmp_dmax;
     b->neg = tmp_neg;
+    b->arena = tmp_arena;
 
     a->flags = FLAGS_STRUCT(flags_old_a) | FLAGS_DATA(flags_old_b);
     b->flags = FLAGS_STRUCT(flags_old_b) | FLAGS_DATA(flags_old_a);
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <openssl/opensslconf.h>
+#include <openssl/crypto.h>
+#include "rsaz_exp.h"
+
+#ifndef RSAZ_ENABLED
+NON_EMPTY_TRANSLATION_UNIT
+#else
+# include <string.h>
+# include "internal/constant_time_locl.h"
+# include "bn_lcl.h"
+
+/*
+ * See crypto/bn/asm/rsaz-avx512.pl for further details.
+ */
+void rsaz_amm52x20_x2_256(BN_ULONG *out, const BN_ULONG *a,
+                          const BN_ULONG *b, const BN_ULONG *m,
+                          const BN_ULONG k0[2]);
+void rsaz_amm52x32_x2_256(BN_ULONG *out, const BN_ULONG *a,
+                          const BN_ULONG *b, const BN_ULONG *m,
+                          const BN_ULONG k0[2]);
+void rsaz_extract52x20_x2_win5(BN_ULONG *out, const BN_ULONG *table,
+                               int idx0, int idx1);
+void rsaz_extract52x32_x2_win5(BN_ULONG *out, const BN_ULONG *table,
+                               int idx0, int idx1);
+
+# define DIGIT_SIZE     52
+# define DIGIT_MASK     (((BN_ULONG)1 << DIGIT_SIZE) - 1)
+# define EXP_WIN_SIZE   5
+# define EXP_WIN_MASK   ((1U << EXP_WIN_SIZE) - 1)
+# define TABLE_SIZE     (1U << EXP_WIN_SIZE)
+
+/* Convert |in_bits| bits from 64-bit words to |out_len| 52-bit digits */
+static void to_words52(BN_ULONG *out, int out_len, const BN_ULONG *in,
+                       int in_bits)
+{
+    int in_len = in_bits / BN_BITS2;
+    int i, pos, w, off;
+
+    for (i = 0; i < out_len; i++) {
+        pos = i * DIGIT_SIZE;
+        w = pos / BN_BITS2;
+        off = pos % BN_BITS2;
+        if (w >= in_len) {
+            out[i] = 0;
+            continue;
+        }
+        out[i] = in[w] >> off;
+        if (off > BN_BITS2 - DIGIT_SIZE && w + 1 < in_len)
+            out[i] |= in[w + 1] << (BN_BITS2 - off);
+        out[i] &= DIGIT_MASK;
+    }
+}
+
+/* Convert normalized 52-bit digits back to |out_len| 64-bit words */
+static void from_words52(BN_ULONG *out, int out_len, const BN_ULONG *in,
+                         int in_len)
+{
+    int i, pos, d, off, got;
+
+    for (i = 0; i < out_len; i++) {
+        pos = i * BN_BITS2;
+        d = pos / DIGIT_SIZE;
+        off = pos % DIGIT_SIZE;
+        out[i] = in[d] >> off;
+        for (got = DIGIT_SIZE - off; got < BN_BITS2 && ++d < in_len;
+             got += DIGIT_SIZE)
+            out[i] |= in[d] << got;
+    }
+}
+
+/* Return |len| (at most EXP_WIN_SIZE) exponent bits starting at bit |pos| */
+static int exp_window(const BN_ULONG *exp, int pos, int len)
+{
+    int w = pos / BN_BITS2, off = pos % BN_BITS2;
+    BN_ULONG v = exp[w] >> off;
+
+    if (off > BN_BITS2 - len)
+        v |= exp[w + 1] << (BN_BITS2 - off);
+    return (int)(v & ((1U << len) - 1));
+}
+
+/* r = r >= m ? r - m : r, in constant time */
+static void reduce_once(BN_ULONG *r, const BN_ULONG *m, BN_ULONG *tmp,
+                        int num)
+{
+    BN_ULONG borrow = bn_sub_words(tmp, r, m, num);
+    BN_ULONG mask = 0 - borrow;
+    int i;
+
+    for (i = 0; i < num; i++)
+        r[i] = constant_time_select_64(mask, r[i], tmp[i]);
+}
+
+/*
+ * Computes res1 = base1^exp1 mod m1 and res2 = base2^exp2 mod m2 with the
+ * two exponentiations running in the lanes of the same AVX512IFMA code.
+ * All inputs are |factor_size| bits (1024 or 1536) in 64-bit words, bases
+ * have to be reduced, RR is R^2 mod m for R = 2^factor_size as stored in
+ * BN_MONT_CTX and k0 the corresponding n0[0].  The sequence of operations
+ * and memory accesses does not depend on the bases or the exponents.
+ *
+ * Returns 1 on success and 0 on allocation failure or unsupported size.
+ */
+int RSAZ_mod_exp_avx512_x2(BN_ULONG *res1, const BN_ULONG *base1,
+                           const BN_ULONG *exp1, const BN_ULONG *m1,
+                           const BN_ULONG *RR1, BN_ULONG k0_1,
+                           BN_ULONG *res2, const BN_ULONG *base2,
+                           const BN_ULONG *exp2, const BN_ULONG *m2,
+                           const BN_ULONG *RR2, BN_ULONG k0_2,
+                           int factor_size)
+{
+    void (*amm)(BN_ULONG *, const BN_ULONG *, const BN_ULONG *,
+                const BN_ULONG *, const BN_ULONG *);
+    void (*extract)(BN_ULONG *, const BN_ULONG *, int, int);
+    int n, words = factor_size / BN_BITS2, num, i, pos, rem, coeff_bit;
+    size_t size;
+    unsigned char *storage;
+    BN_ULONG *p, *base, *m, *rr, *coeff, *one, *y, *x, *expz, *table;
+    BN_ULONG k0[2];
+
+    switch (factor_size) {
+    case 1024:
+        n = 20;
+        amm = rsaz_amm52x20_x2_256;
+        extract = rsaz_extract52x20_x2_win5;
+        break;
+    case 1536:
+        n = 32;
+        amm = rsaz_amm52x32_x2_256;
+        extract = rsaz_extract52x32_x2_win5;
+        break;
+    default:
+        return 0;
+    }
+    num = 2 * n;
+
+    /* Seven numbers, both exponents with a spare word, and the table */
+    size = (7 * num + 2 * (words + 1) + TABLE_SIZE * num) * sizeof(BN_ULONG);
+    if ((storage = OPENSSL_zalloc(size + 64)) == NULL)
+        return 0;
+    p = (BN_ULONG *)(storage + (64 - ((size_t)storage % 64)));
+    base = p;
+    m = base + num;
+    rr = m + num;
+    coeff = rr + num;
+    one = coeff + num;
+    y = one + num;
+    x = y + num;
+    expz = x + num;
+    table = expz + 2 * (words + 1);
+
+    to_words52(base, n, base1, factor_size);
+    to_words52(base + n, n, base2, factor_size);
+    to_words52(m, n, m1, factor_size);
+    to_words52(m + n, n, m2, factor_size);
+    to_words52(rr, n, RR1, factor_size);
+    to_words52(rr + n, n, RR2, factor_size);
+    k0[0] = k0_1 & DIGIT_MASK;
+    k0[1] = k0_2 & DIGIT_MASK;
+    memcpy(expz, exp1, words * sizeof(BN_ULONG));
+    memcpy(expz + words + 1, exp2, words * sizeof(BN_ULONG));
+
+    /*
+     * RR is 2^(2*factor_size) mod m, we need 2^(2*52*n). One AMM squaring
+     * gives 2^(4*factor_size - 52*n), and multiplying by 2^coeff_bit with
+     * coeff_bit = 4*(52*n - factor_size) gets there.
+     */
+    coeff_bit = 4 * (DIGIT_SIZE * n - factor_size);
+    coeff[coeff_bit / DIGIT_SIZE] = (BN_ULONG)1 << (coeff_bit % DIGIT_SIZE);
+    coeff[n + coeff_bit / DIGIT_SIZE] = coeff[coeff_bit / DIGIT_SIZE];
+    amm(rr, rr, rr, m, k0);
+    amm(rr, rr, coeff, m, k0);
+
+    one[0] = one[n] = 1;
+
+    /* table[i] = base^i in Montgomery form */
+    amm(table, rr, one, m, k0);
+    amm(table + num, base, rr, m, k0);
+    for (i = 2; i < (int)TABLE_SIZE; i++)
+        amm(table + i * num, table + (i - 1) * num, table + num, m, k0);
+
+    /* Fixed window exponentiation, starting with the topmost window */
+    rem = factor_size % EXP_WIN_SIZE;
+    if (rem == 0)
+        rem = EXP_WIN_SIZE;
+    pos = factor_size - rem;
+    extract(y, table, exp_window(expz, pos, rem),
+            exp_window(expz + words + 1, pos, rem));
+    while (pos > 0) {
+        pos -= EXP_WIN_SIZE;
+        for (i = 0; i < EXP_WIN_SIZE; i++)
+            amm(y, y, y, m, k0);
+        extract(x, table, exp_window(expz, pos, EXP_WIN_SIZE),
+                exp_window(expz + words + 1, pos, EXP_WIN_SIZE));
+        amm(y, y, x, m, k0);
+    }
+
+    /* Out of Montgomery form, the result is at most m */
+    amm(y, y, one, m, k0);
+    from_words52(res1, words, y, n);
+    from_words52(res2, words, y + n, n);
+    reduce_once(res1, m1, x, words);
+    reduce_once(res2, m2, x, words);
+
+    OPENSSL_clear_free(storage, size + 64);
+    return 1;
+}
+#endif
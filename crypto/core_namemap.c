@@ -11,6 +11,21 @@
 #include "internal/namemap.h"
 #include <openssl/lhash.h>
 #include "internal/lhash.h"      /* openssl_lh_strcasehash */
+#include "internal/cryptlib_int.h"
+
+/*
+ * Names are never removed from a namemap, so once a name is known its number
+ * never changes.  Successful lookups are therefore remembered in a small
+ * direct mapped table owned by the calling thread, which later lookups of the
+ * same name consult without taking the namemap lock.
+ */
+#ifndef FIPS_MODE
+# define NAMEMAP_PER_THREAD
+/* The number of entries in each per thread table, must be a power of two */
+# define NAMEMAP_THREAD_SLOTS           64
+/* Longer names are always looked up in the shared table */
+# define NAMEMAP_THREAD_NAME_MAX        32
+#endif
 
 /*-
  * The namenum entry
@@ -23,6 +38,19 @@ typedef struct {
 
 DEFINE_LHASH_OF(NAMENUM_ENTRY);
 
+#ifdef NAMEMAP_PER_THREAD
+typedef struct {
+    int number;
+    char name[NAMEMAP_THREAD_NAME_MAX];
+} THREAD_NAMENUM;
+
+typedef struct {
+    THREAD_NAMENUM slots[NAMEMAP_THREAD_SLOTS];
+} THREAD_NAMENUM_CACHE;
+
+DEFINE_STACK_OF(THREAD_NAMENUM_CACHE)
+#endif
+
 /*-
  * The namemap itself
  * ==================
@@ -35,6 +63,10 @@ struct ossl_namemap_st {
     CRYPTO_RWLOCK *lock;
     LHASH_OF(NAMENUM_ENTRY) *namenum;  /* Name->number mapping */
     int max_number;                    /* Current max number */
+#ifdef NAMEMAP_PER_THREAD
+    CRYPTO_THREAD_LOCAL thread_cache;
+    STACK_OF(THREAD_NAMENUM_CACHE) *thread_caches;
+#endif
 };
 
 /* LHASH callbacks */
@@ -56,6 +88,85 @@ static void namenum_free(NAMENUM_ENTRY *n)
     OPENSSL_free(n);
 }
 
+#ifdef NAMEMAP_PER_THREAD
+static void namenum_thread_free(THREAD_NAMENUM_CACHE *tc)
+{
+    OPENSSL_free(tc);
+}
+
+static THREAD_NAMENUM *namenum_thread_slot(THREAD_NAMENUM_CACHE *tc,
+                                           const char *name)
+{
+    unsigned long h = openssl_lh_strcasehash(name);
+
+    return &tc->slots[h & (NAMEMAP_THREAD_SLOTS - 1)];
+}
+
+static int namenum_thread_get(const OSSL_NAMEMAP *namemap, const char *name)
+{
+    THREAD_NAMENUM_CACHE *tc =
+        CRYPTO_THREAD_get_local((CRYPTO_THREAD_LOCAL *)&namemap->thread_cache);
+    THREAD_NAMENUM *tn;
+
+    if (tc == NULL)
+        return 0;
+    tn = namenum_thread_slot(tc, name);
+    if (tn->number == 0 || strcasecmp(tn->name, name) != 0)
+        return 0;
+    return tn->number;
+}
+
+static void namenum_thread_stop(void *arg)
+{
+    OSSL_NAMEMAP *namemap = arg;
+    THREAD_NAMENUM_CACHE *tc = CRYPTO_THREAD_get_local(&namemap->thread_cache);
+
+    if (tc == NULL)
+        return;
+    CRYPTO_THREAD_set_local(&namemap->thread_cache, NULL);
+    CRYPTO_THREAD_write_lock(namemap->lock);
+    sk_THREAD_NAMENUM_CACHE_delete_ptr(namemap->thread_caches, tc);
+    CRYPTO_THREAD_unlock(namemap->lock);
+    namenum_thread_free(tc);
+}
+
+static void namenum_thread_set(OSSL_NAMEMAP *namemap, const char *name,
+                               int number)
+{
+    THREAD_NAMENUM_CACHE *tc;
+    THREAD_NAMENUM *tn;
+    size_t len = strlen(name);
+
+    if (len >= NAMEMAP_THREAD_NAME_MAX)
+        return;
+
+    tc = CRYPTO_THREAD_get_local(&namemap->thread_cache);
+    if (tc == NULL) {
+        if ((tc = OPENSSL_zalloc(sizeof(*tc))) == NULL)
+            return;
+        CRYPTO_THREAD_write_lock(namemap->lock);
+        if (!sk_THREAD_NAMENUM_CACHE_push(namemap->thread_caches, tc)) {
+            CRYPTO_THREAD_unlock(namemap->lock);
+            namenum_thread_free(tc);
+            return;
+        }
+        CRYPTO_THREAD_unlock(namemap->lock);
+        if (!ossl_init_thread_start(namemap, namemap, namenum_thread_stop)
+                || !CRYPTO_THREAD_set_local(&namemap->thread_cache, tc)) {
+            CRYPTO_THREAD_write_lock(namemap->lock);
+            sk_THREAD_NAMENUM_CACHE_delete_ptr(namemap->thread_caches, tc);
+            CRYPTO_THREAD_unlock(namemap->lock);
+            namenum_thread_free(tc);
+            return;
+        }
+    }
+
+    tn = namenum_thread_slot(tc, name);
+    tn->number = number;
+    memcpy(tn->name, name, len + 1);
+}
+#endif
+
 /* OPENSSL_CTX_METHOD functions for a namemap stored in a library context */
 
 static void *stored_namemap_new(OPENSSL_CTX *libctx)
@@ -100,8 +211,19 @@ OSSL_NAMEMAP *ossl_namemap_new(void)
     if ((namemap = OPENSSL_zalloc(sizeof(*namemap))) != NULL
         && (namemap->lock = CRYPTO_THREAD_lock_new()) != NULL
         && (namemap->namenum =
-            lh_NAMENUM_ENTRY_new(namenum_hash, namenum_cmp)) != NULL)
+            lh_NAMENUM_ENTRY_new(namenum_hash, namenum_cmp)) != NULL) {
+#ifdef NAMEMAP_PER_THREAD
+        if ((namemap->thread_caches =
+             sk_THREAD_NAMENUM_CACHE_new_null()) == NULL
+            || !CRYPTO_THREAD_init_local(&namemap->thread_cache, NULL)) {
+            sk_THREAD_NAMENUM_CACHE_free(namemap->thread_caches);
+            namemap->thread_caches = NULL;
+            ossl_namemap_free(namemap);
+            return NULL;
+        }
+#endif
         return namemap;
+    }
 
     ossl_namemap_free(namemap);
     return NULL;
@@ -112,6 +234,18 @@ void ossl_namemap_free(OSSL_NAMEMAP *namemap)
     if (namemap == NULL || namemap->stored)
         return;
 
+#ifdef NAMEMAP_PER_THREAD
+    if (namemap->thread_caches != NULL) {
+        /*
+         * Threads that are still running lose their stop handler for this
+         * namemap, so their tables are reclaimed here instead.
+         */
+        ossl_init_thread_deregister(namemap);
+        CRYPTO_THREAD_cleanup_local(&namemap->thread_cache);
+        sk_THREAD_NAMENUM_CACHE_pop_free(namemap->thread_caches,
+                                         namenum_thread_free);
+    }
+#endif
     lh_NAMENUM_ENTRY_doall(namemap->namenum, namenum_free);
     lh_NAMENUM_ENTRY_free(namemap->namenum);
 
@@ -161,6 +295,11 @@ int ossl_namemap_name2num(const OSSL_NAMEMAP *namemap, const char *name)
     if (namemap == NULL)
         return 0;
 
+#ifdef NAMEMAP_PER_THREAD
+    if ((number = namenum_thread_get(namemap, name)) != 0)
+        return number;
+#endif
+
     namenum_tmpl.name = (char *)name;
     namenum_tmpl.number = 0;
     CRYPTO_THREAD_read_lock(namemap->lock);
@@ -170,6 +309,11 @@ int ossl_namemap_name2num(const OSSL_NAMEMAP *namemap, const char *name)
         number = namenum_entry->number;
     CRYPTO_THREAD_unlock(namemap->lock);
 
+#ifdef NAMEMAP_PER_THREAD
+    /* Only successes are remembered, the name may be added later */
+    if (number != 0)
+        namenum_thread_set((OSSL_NAMEMAP *)namemap, name, number);
+#endif
     return number;
 }
 
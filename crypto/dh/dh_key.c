@@ -92,7 +92,7 @@ static int generate_key(DH *dh)
         return 0;
     }
 
-    ctx = BN_CTX_new();
+    ctx = bn_ctx_new_scoped(NULL);
     if (ctx == NULL)
         goto err;
 
@@ -191,7 +191,7 @@ static int compute_key(unsigned char *key, const BIGNUM *pub_key, DH *dh)
         return 0;
     }
 
-    ctx = BN_CTX_new();
+    ctx = bn_ctx_new_scoped(NULL);
     if (ctx == NULL)
         goto err;
     BN_CTX_start(ctx);
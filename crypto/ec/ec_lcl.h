@@ -668,6 +668,9 @@ int ossl_ecdsa_verify(int type, const unsigned char *dgst, int dgst_len,
                       const unsigned char *sigbuf, int sig_len, EC_KEY *eckey);
 int ossl_ecdsa_verify_sig(const unsigned char *dgst, int dgst_len,
                           const ECDSA_SIG *sig, EC_KEY *eckey);
+int ossl_ecdsa_verify_batch(const unsigned char *dgst[], const int dgst_len[],
+                            const ECDSA_SIG *sig[], EC_KEY *eckey[],
+                            size_t num, int res[]);
 int ecdsa_simple_sign_setup(EC_KEY *eckey, BN_CTX *ctx_in, BIGNUM **kinvp,
                             BIGNUM **rp);
 ECDSA_SIG *ecdsa_simple_sign_sig(const unsigned char *dgst, int dgst_len,
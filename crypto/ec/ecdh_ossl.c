@@ -12,6 +12,7 @@
 #include <limits.h>
 
 #include "internal/cryptlib.h"
+#include "internal/bn_int.h"
 
 #include <openssl/err.h>
 #include <openssl/bn.h>
@@ -47,7 +48,7 @@ int ecdh_simple_compute_key(unsigned char **pout, size_t *poutlen,
     size_t buflen, len;
     unsigned char *buf = NULL;
 
-    if ((ctx = BN_CTX_new_ex(ecdh->libctx)) == NULL)
+    if ((ctx = bn_ctx_new_scoped(ecdh->libctx)) == NULL)
         goto err;
     BN_CTX_start(ctx);
     x = BN_CTX_get(ctx);
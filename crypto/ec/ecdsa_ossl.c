@@ -93,7 +93,7 @@ static int ecdsa_sign_setup(EC_KEY *eckey, BN_CTX *ctx_in,
     }
 
     if ((ctx = ctx_in) == NULL) {
-        if ((ctx = BN_CTX_new_ex(eckey->libctx)) == NULL) {
+        if ((ctx = bn_ctx_new_scoped(eckey->libctx)) == NULL) {
             ECerr(EC_F_ECDSA_SIGN_SETUP, ERR_R_MALLOC_FAILURE);
             return 0;
         }
@@ -228,7 +228,7 @@ ECDSA_SIG *ecdsa_simple_sign_sig(const unsigned char *dgst, int dgst_len,
     }
     s = ret->s;
 
-    if ((ctx = BN_CTX_new_ex(eckey->libctx)) == NULL
+    if ((ctx = bn_ctx_new_scoped(eckey->libctx)) == NULL
         || (m = BN_new()) == NULL) {
         ECerr(EC_F_ECDSA_SIMPLE_SIGN_SIG, ERR_R_MALLOC_FAILURE);
         goto err;
@@ -349,10 +349,29 @@ int ossl_ecdsa_verify(int type, const unsigned char *dgst, int dgst_len,
     return ret;
 }
 
+/* Convert digest |dgst| to |m|, truncated to the bit length of |order| */
+static int ecdsa_digest_to_bn(BIGNUM *m, const unsigned char *dgst,
+                              int dgst_len, const BIGNUM *order)
+{
+    int i = BN_num_bits(order);
+
+    /*
+     * Need to truncate digest if it is too long: first truncate whole bytes.
+     */
+    if (8 * dgst_len > i)
+        dgst_len = (i + 7) / 8;
+    if (!BN_bin2bn(dgst, dgst_len, m))
+        return 0;
+    /* If still too long truncate remaining bits with a shift */
+    if ((8 * dgst_len > i) && !BN_rshift(m, m, 8 - (i & 0x7)))
+        return 0;
+    return 1;
+}
+
 int ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
                             const ECDSA_SIG *sig, EC_KEY *eckey)
 {
-    int ret = -1, i;
+    int ret = -1;
     BN_CTX *ctx;
     const BIGNUM *order;
     BIGNUM *u1, *u2, *m, *X;
@@ -372,7 +391,7 @@ int ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
         return -1;
     }
 
-    ctx = BN_CTX_new_ex(eckey->libctx);
+    ctx = bn_ctx_new_scoped(eckey->libctx);
     if (ctx == NULL) {
         ECerr(EC_F_ECDSA_SIMPLE_VERIFY_SIG, ERR_R_MALLOC_FAILURE);
         return -1;
@@ -406,18 +425,7 @@ int ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
         goto err;
     }
     /* digest -> m */
-    i = BN_num_bits(order);
-    /*
-     * Need to truncate digest if it is too long: first truncate whole bytes.
-     */
-    if (8 * dgst_len > i)
-        dgst_len = (i + 7) / 8;
-    if (!BN_bin2bn(dgst, dgst_len, m)) {
-        ECerr(EC_F_ECDSA_SIMPLE_VERIFY_SIG, ERR_R_BN_LIB);
-        goto err;
-    }
-    /* If still too long truncate remaining bits with a shift */
-    if ((8 * dgst_len > i) && !BN_rshift(m, m, 8 - (i & 0x7))) {
+    if (!ecdsa_digest_to_bn(m, dgst, dgst_len, order)) {
         ECerr(EC_F_ECDSA_SIMPLE_VERIFY_SIG, ERR_R_BN_LIB);
         goto err;
     }
@@ -458,3 +466,207 @@ int ecdsa_simple_verify_sig(const unsigned char *dgst, int dgst_len,
     EC_POINT_free(point);
     return ret;
 }
+
+/* Returns |eckey|'s group if its signatures can be verified in a batch */
+static const EC_GROUP *ecdsa_batch_group(const EC_KEY *eckey)
+{
+    const EC_GROUP *group = eckey->group;
+
+    if (eckey->meth->verify_sig != ossl_ecdsa_verify_sig
+            || group == NULL
+            || group->meth->ecdsa_verify_sig != ecdsa_simple_verify_sig
+            || group->mont_data == NULL)
+        return NULL;
+    return group;
+}
+
+static int ecdsa_batch_same_group(const EC_GROUP *a, const EC_GROUP *b,
+                                  BN_CTX *ctx)
+{
+    if (a == b)
+        return 1;
+    if (a->meth != b->meth)
+        return 0;
+    if (a->curve_name != NID_undef && a->curve_name == b->curve_name)
+        return 1;
+    return EC_GROUP_cmp(a, b, ctx) == 0;
+}
+
+/*-
+ * Verifies |num| signatures, storing the result for each of them, as
+ * returned by ECDSA_do_verify(), in |res|.  Signatures by keys sharing the
+ * group of the first suitable key are verified together: a single inversion
+ * modulo the order gives all the s^-1 values and a single field inversion
+ * brings all the u1*G + u2*Q points to affine form (Montgomery's trick).
+ * Anything else is passed to ECDSA_do_verify() on its own.
+ *
+ * returns
+ *      1: all signatures correct
+ *      0: at least one incorrect signature
+ *     -1: error
+ */
+int ossl_ecdsa_verify_batch(const unsigned char *dgst[], const int dgst_len[],
+                            const ECDSA_SIG *sig[], EC_KEY *eckey[],
+                            size_t num, int res[])
+{
+    const EC_GROUP *group = NULL, *g;
+    const EC_POINT *pub_key;
+    const BIGNUM *order = NULL;
+    BN_MONT_CTX *mont = NULL;
+    BN_CTX *ctx = NULL;
+    BIGNUM **acc = NULL, *inv, *w, *u1, *u2, *m;
+    EC_POINT **points = NULL;
+    size_t *idx = NULL;
+    size_t i, j, n = 0;
+    int ret = 1;
+
+    /* Anything not reached because of an error reports it */
+    for (i = 0; i < num; i++)
+        res[i] = -1;
+
+    for (i = 0; i < num && group == NULL; i++)
+        group = ecdsa_batch_group(eckey[i]);
+
+    if (group != NULL) {
+        ctx = bn_ctx_new_scoped(eckey[i - 1]->libctx);
+        idx = OPENSSL_malloc(num * sizeof(*idx));
+        acc = OPENSSL_malloc(num * sizeof(*acc));
+        points = OPENSSL_zalloc(num * sizeof(*points));
+        if (ctx == NULL || idx == NULL || acc == NULL || points == NULL) {
+            ECerr(0, ERR_R_MALLOC_FAILURE);
+            BN_CTX_free(ctx);
+            ctx = NULL;
+            ret = -1;
+            goto end;
+        }
+        BN_CTX_start(ctx);
+        order = EC_GROUP_get0_order(group);
+        mont = group->mont_data;
+    }
+
+    /*
+     * Check the batched signatures and multiply their s values together,
+     * acc[j] being s[0] * ... * s[j] / R^j modulo the order.
+     */
+    for (i = 0; i < num; i++) {
+        if (group == NULL
+                || (g = ecdsa_batch_group(eckey[i])) == NULL
+                || !ecdsa_batch_same_group(g, group, ctx)) {
+            res[i] = ECDSA_do_verify(dgst[i], dgst_len[i], sig[i], eckey[i]);
+            continue;
+        }
+        if ((pub_key = EC_KEY_get0_public_key(eckey[i])) == NULL
+                || sig[i] == NULL) {
+            ECerr(0, EC_R_MISSING_PARAMETERS);
+            res[i] = -1;
+            continue;
+        }
+        if (!EC_KEY_can_sign(eckey[i])) {
+            ECerr(0, EC_R_CURVE_DOES_NOT_SUPPORT_SIGNING);
+            res[i] = -1;
+            continue;
+        }
+        if (BN_is_zero(sig[i]->r) || BN_is_negative(sig[i]->r) ||
+            BN_ucmp(sig[i]->r, order) >= 0 || BN_is_zero(sig[i]->s) ||
+            BN_is_negative(sig[i]->s) || BN_ucmp(sig[i]->s, order) >= 0) {
+            ECerr(0, EC_R_BAD_SIGNATURE);
+            res[i] = 0;
+            continue;
+        }
+        if ((acc[n] = BN_CTX_get(ctx)) == NULL
+                || (n == 0 && !BN_copy(acc[n], sig[i]->s))
+                || (n > 0 && !BN_mod_mul_montgomery(acc[n], acc[n - 1],
+                                                    sig[i]->s, mont, ctx)))
+            goto err;
+        idx[n++] = i;
+    }
+    if (n == 0)
+        goto end;
+
+    inv = BN_CTX_get(ctx);
+    w = BN_CTX_get(ctx);
+    u1 = BN_CTX_get(ctx);
+    u2 = BN_CTX_get(ctx);
+    m = BN_CTX_get(ctx);
+    if (m == NULL)
+        goto err;
+
+    /*
+     * One inversion for the whole batch, the result is kept multiplied by R
+     * so that Montgomery multiplication by m and r gives u1 and u2 directly.
+     */
+    if (!ec_group_do_inverse_ord(group, inv, acc[n - 1], ctx)
+            || !BN_to_montgomery(inv, inv, mont, ctx))
+        goto err;
+
+    for (j = n; j-- > 0; ) {
+        i = idx[j];
+
+        /* w = R/s[j], inv = R/acc[j-1] */
+        if (j > 0) {
+            if (!BN_mod_mul_montgomery(w, inv, acc[j - 1], mont, ctx)
+                    || !BN_mod_mul_montgomery(inv, inv, sig[i]->s, mont, ctx))
+                goto err;
+        } else if (!BN_copy(w, inv)) {
+            goto err;
+        }
+
+        /* The truncated digest is shorter than twice the order */
+        if (!ecdsa_digest_to_bn(m, dgst[i], dgst_len[i], order)
+                || (BN_ucmp(m, order) >= 0 && !BN_usub(m, m, order)))
+            goto err;
+
+        /* u1 = m * w mod order, u2 = r * w mod order */
+        if (!BN_mod_mul_montgomery(u1, m, w, mont, ctx)
+                || !BN_mod_mul_montgomery(u2, sig[i]->r, w, mont, ctx))
+            goto err;
+
+        if ((points[j] = EC_POINT_new(group)) == NULL
+                || !EC_POINT_mul(group, points[j], u1,
+                                 EC_KEY_get0_public_key(eckey[i]), u2, ctx))
+            goto err;
+    }
+
+    if (!EC_POINTs_make_affine(group, n, points, ctx))
+        goto err;
+
+    /* The signature is correct if the x coordinate is equal to r */
+    for (j = 0; j < n; j++) {
+        i = idx[j];
+        if (EC_POINT_is_at_infinity(group, points[j])) {
+            res[i] = 0;
+            continue;
+        }
+        if (group->meth->field_decode != NULL) {
+            if (!group->meth->field_decode(group, w, points[j]->X, ctx))
+                goto err;
+        } else if (!BN_copy(w, points[j]->X)) {
+            goto err;
+        }
+        if (!BN_nnmod(w, w, order, ctx))
+            goto err;
+        res[i] = BN_ucmp(w, sig[i]->r) == 0;
+    }
+    goto end;
+
+ err:
+    ECerr(0, ERR_R_EC_LIB);
+    for (j = 0; j < n; j++)
+        res[idx[j]] = -1;
+ end:
+    for (i = 0; i < num && ret != -1; i++) {
+        if (res[i] < 0)
+            ret = -1;
+        else if (res[i] == 0)
+            ret = 0;
+    }
+    if (points != NULL)
+        for (j = 0; j < n; j++)
+            EC_POINT_free(points[j]);
+    OPENSSL_free(points);
+    OPENSSL_free(acc);
+    OPENSSL_free(idx);
+    BN_CTX_end(ctx);
+    BN_CTX_free(ctx);
+    return ret;
+}
@@ -26,6 +26,20 @@ int ECDSA_do_verify(const unsigned char *dgst, int dgst_len,
     return 0;
 }
 
+/*-
+ * returns
+ *      1: all signatures correct
+ *      0: at least one incorrect signature
+ *     -1: error
+ * with the result for each signature in |res|.
+ */
+int ECDSA_do_verify_batch(const unsigned char *dgst[], const int dgst_len[],
+                          const ECDSA_SIG *sig[], EC_KEY *eckey[],
+                          size_t num, int res[])
+{
+    return ossl_ecdsa_verify_batch(dgst, dgst_len, sig, eckey, num, res);
+}
+
 /*-
  * returns
  *      1: correct signature
@@ -130,8 +130,8 @@ static void ctr64_inc(unsigned char *counter)
 
 #if defined(AESNI_CAPABLE)
 # if defined(__x86_64) || defined(__x86_64__) || defined(_M_AMD64) || defined(_M_X64)
-#  define AES_gcm_encrypt aesni_gcm_encrypt
-#  define AES_gcm_decrypt aesni_gcm_decrypt
+#  define AES_gcm_encrypt AESNI_GCM_ENCRYPT
+#  define AES_gcm_decrypt AESNI_GCM_DECRYPT
 #  define AES_GCM_ASM2(gctx)      (gctx->gcm.block==(block128_f)aesni_encrypt && \
                                  gctx->gcm.ghash==gcm_ghash_avx)
 #  undef AES_GCM_ASM2          /* minor size optimization */
@@ -4114,6 +4114,10 @@ static int aes_siv_ctrl(EVP_CIPHER_CTX *c, int type, int arg, void *ptr)
 
     case EVP_CTRL_COPY:
         sctx_out = EVP_C_DATA(SIV128_CONTEXT, (EVP_CIPHER_CTX*)ptr);
+        /* The byte copy of the context still points at our sub-contexts */
+        sctx_out->cipher_ctx = NULL;
+        sctx_out->mac = NULL;
+        sctx_out->mac_ctx_init = NULL;
         return CRYPTO_siv128_copy_ctx(sctx_out, sctx);
 
     default:
@@ -220,6 +220,7 @@ int EVP_CipherInit_ex(EVP_CIPHER_CTX *ctx, const EVP_CIPHER *cipher,
     }
 
     ctx->cipher = cipher;
+    ctx->iv_len = 0;
     if (ctx->provctx == NULL) {
         ctx->provctx = ctx->cipher->newctx(ossl_provider_ctx(cipher->prov));
         if (ctx->provctx == NULL) {
@@ -922,6 +923,129 @@ int EVP_DecryptFinal_ex(EVP_CIPHER_CTX *ctx, unsigned char *out, int *outl)
     return 1;
 }
 
+/*
+ * Single call AEAD encryption and decryption. Providers that implement the
+ * one-shot dispatch functions get the whole record in one call. Anything
+ * else is driven through the usual init/ctrl/update/final sequence.
+ */
+static int evp_aead_generic(EVP_CIPHER_CTX *ctx, int enc,
+                            const unsigned char *key,
+                            const unsigned char *iv, size_t ivlen,
+                            const unsigned char *aad, size_t aadlen,
+                            unsigned char *out, const unsigned char *in,
+                            size_t inl, unsigned char *tag, size_t taglen)
+{
+    int mode = EVP_CIPHER_CTX_mode(ctx);
+    int outl = 0, finl = 0, late_tag;
+
+    if (inl > INT_MAX || aadlen > INT_MAX || ivlen > INT_MAX
+            || taglen > INT_MAX) {
+        EVPerr(0, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+
+    if (EVP_CipherInit_ex(ctx, NULL, NULL, NULL, NULL, enc) <= 0)
+        return 0;
+    if (ivlen != (size_t)EVP_CIPHER_CTX_iv_length(ctx)
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, (int)ivlen,
+                                   NULL) <= 0)
+        return 0;
+    /*
+     * All but GCM need the tag length before the key is set, and CCM-like
+     * modes also want the expected tag itself before any data on decrypt
+     */
+    late_tag = mode == EVP_CIPH_GCM_MODE || mode == EVP_CIPH_OCB_MODE;
+    if (mode != EVP_CIPH_GCM_MODE
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, (int)taglen,
+                                   enc || late_tag ? NULL : tag) <= 0)
+        return 0;
+    if (EVP_CipherInit_ex(ctx, NULL, NULL, key, iv, -1) <= 0)
+        return 0;
+    /* CCM needs the total length before any AAD */
+    if (mode == EVP_CIPH_CCM_MODE
+            && EVP_CipherUpdate(ctx, NULL, &outl, NULL, (int)inl) <= 0)
+        return 0;
+    if (aadlen > 0
+            && EVP_CipherUpdate(ctx, NULL, &outl, aad, (int)aadlen) <= 0)
+        return 0;
+    if (!enc && late_tag
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, (int)taglen,
+                                   tag) <= 0)
+        return 0;
+
+    outl = 0;
+    if (EVP_CipherUpdate(ctx, out, &outl, in, (int)inl) <= 0
+            || EVP_CipherFinal_ex(ctx, out + outl, &finl) <= 0
+            || (size_t)outl + finl != inl) {
+        if (!enc)
+            OPENSSL_cleanse(out, inl);
+        return 0;
+    }
+
+    if (enc
+            && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, (int)taglen,
+                                   tag) <= 0)
+        return 0;
+    return 1;
+}
+
+int EVP_CIPHER_CTX_aead_seal(EVP_CIPHER_CTX *ctx, const unsigned char *key,
+                             const unsigned char *iv, size_t ivlen,
+                             const unsigned char *aad, size_t aadlen,
+                             unsigned char *out, const unsigned char *in,
+                             size_t inl, unsigned char *tag, size_t taglen)
+{
+    if (ctx == NULL || ctx->cipher == NULL) {
+        EVPerr(0, EVP_R_NO_CIPHER_SET);
+        return 0;
+    }
+    if (iv == NULL || tag == NULL) {
+        EVPerr(0, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+
+    if (ctx->cipher->prov != NULL && ctx->cipher->aead_seal != NULL) {
+        ctx->encrypt = 1;
+        return ctx->cipher->aead_seal(ctx->provctx, key,
+                                      key == NULL
+                                          ? 0 : EVP_CIPHER_CTX_key_length(ctx),
+                                      iv, ivlen, aad, aadlen, out, in, inl,
+                                      tag, taglen);
+    }
+
+    return evp_aead_generic(ctx, 1, key, iv, ivlen, aad, aadlen, out, in, inl,
+                            tag, taglen);
+}
+
+int EVP_CIPHER_CTX_aead_open(EVP_CIPHER_CTX *ctx, const unsigned char *key,
+                             const unsigned char *iv, size_t ivlen,
+                             const unsigned char *aad, size_t aadlen,
+                             unsigned char *out, const unsigned char *in,
+                             size_t inl, const unsigned char *tag,
+                             size_t taglen)
+{
+    if (ctx == NULL || ctx->cipher == NULL) {
+        EVPerr(0, EVP_R_NO_CIPHER_SET);
+        return 0;
+    }
+    if (iv == NULL || tag == NULL) {
+        EVPerr(0, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+
+    if (ctx->cipher->prov != NULL && ctx->cipher->aead_open != NULL) {
+        ctx->encrypt = 0;
+        return ctx->cipher->aead_open(ctx->provctx, key,
+                                      key == NULL
+                                          ? 0 : EVP_CIPHER_CTX_key_length(ctx),
+                                      iv, ivlen, aad, aadlen, out, in, inl,
+                                      tag, taglen);
+    }
+
+    return evp_aead_generic(ctx, 0, key, iv, ivlen, aad, aadlen, out, in, inl,
+                            (unsigned char *)tag, taglen);
+}
+
 int EVP_CIPHER_CTX_set_key_length(EVP_CIPHER_CTX *c, int keylen)
 {
     int ok;
@@ -994,6 +1118,7 @@ int EVP_CIPHER_CTX_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg, void *ptr)
     case EVP_CTRL_AEAD_SET_IVLEN:
         if (arg < 0)
             return 0;
+        ctx->iv_len = 0;
         sz = (size_t)arg;
         params[0] =
             OSSL_PARAM_construct_size_t(OSSL_CIPHER_PARAM_AEAD_IVLEN, &sz);
@@ -1060,8 +1185,10 @@ int EVP_CIPHER_get_params(EVP_CIPHER *cipher, OSSL_PARAM params[])
 
 int EVP_CIPHER_CTX_set_params(EVP_CIPHER_CTX *ctx, const OSSL_PARAM params[])
 {
-    if (ctx->cipher != NULL && ctx->cipher->set_ctx_params != NULL)
+    if (ctx->cipher != NULL && ctx->cipher->set_ctx_params != NULL) {
+        ctx->iv_len = 0;
         return ctx->cipher->set_ctx_params(ctx->provctx, params);
+    }
     return 0;
 }
 
@@ -1271,6 +1398,16 @@ static void *evp_cipher_from_dispatch(const char *name,
             cipher->settable_ctx_params =
                 OSSL_get_OP_cipher_settable_ctx_params(fns);
             break;
+        case OSSL_FUNC_CIPHER_AEAD_SEAL:
+            if (cipher->aead_seal != NULL)
+                break;
+            cipher->aead_seal = OSSL_get_OP_cipher_aead_seal(fns);
+            break;
+        case OSSL_FUNC_CIPHER_AEAD_OPEN:
+            if (cipher->aead_open != NULL)
+                break;
+            cipher->aead_open = OSSL_get_OP_cipher_aead_open(fns);
+            break;
         }
     }
     if ((fnciphcnt != 0 && fnciphcnt != 3 && fnciphcnt != 4)
@@ -53,6 +53,11 @@ struct evp_cipher_ctx_st {
     /* Provider ctx */
     void *provctx;
     EVP_CIPHER *fetched_cipher;
+    /*
+     * Cached IV length of the provider side context, 0 if unknown. Any call
+     * that can change it resets this.
+     */
+    int iv_len;
 } /* EVP_CIPHER_CTX */ ;
 
 struct evp_mac_ctx_st {
@@ -181,6 +181,26 @@ void gcm_ghash_avx(u64 Xi[2], const u128 Htable[16], const u8 *in, size_t len);
 
 #   define AES_GCM_ASM(ctx)    (ctx->ctr == aesni_ctr32_encrypt_blocks && \
                                 ctx->gcm.ghash == gcm_ghash_avx)
+
+size_t aes_gcm_encrypt_avx512(const unsigned char *in, unsigned char *out,
+                              size_t len, const void *key,
+                              unsigned char ivec[16], u64 *Xi);
+size_t aes_gcm_decrypt_avx512(const unsigned char *in, unsigned char *out,
+                              size_t len, const void *key,
+                              unsigned char ivec[16], u64 *Xi);
+
+/* AVX512F, AVX512BW, AVX512VL, VAES and VPCLMULQDQ */
+#   define AES_GCM_AVX512_CAPABLE \
+        ((OPENSSL_ia32cap_P[2] & 0xc0010000) == 0xc0010000 && \
+         (OPENSSL_ia32cap_P[3] & 0x600) == 0x600)
+#   define AESNI_GCM_ENCRYPT(in, out, len, key, ivec, Xi)                   \
+        (AES_GCM_AVX512_CAPABLE                                             \
+         ? aes_gcm_encrypt_avx512(in, out, len, key, ivec, Xi)              \
+         : aesni_gcm_encrypt(in, out, len, key, ivec, Xi))
+#   define AESNI_GCM_DECRYPT(in, out, len, key, ivec, Xi)                   \
+        (AES_GCM_AVX512_CAPABLE                                             \
+         ? aes_gcm_decrypt_avx512(in, out, len, key, ivec, Xi)              \
+         : aesni_gcm_decrypt(in, out, len, key, ivec, Xi))
 #  endif
 
 
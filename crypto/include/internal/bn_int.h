@@ -16,6 +16,8 @@
 BIGNUM *bn_wexpand(BIGNUM *a, int words);
 BIGNUM *bn_expand2(BIGNUM *a, int words);
 
+BN_CTX *bn_ctx_new_scoped(OPENSSL_CTX *libctx);
+
 void bn_correct_top(BIGNUM *a);
 
 /*
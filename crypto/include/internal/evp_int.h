@@ -270,6 +270,8 @@ struct evp_cipher_st {
     OSSL_OP_cipher_gettable_params_fn *gettable_params;
     OSSL_OP_cipher_gettable_ctx_params_fn *gettable_ctx_params;
     OSSL_OP_cipher_settable_ctx_params_fn *settable_ctx_params;
+    OSSL_OP_cipher_aead_seal_fn *aead_seal;
+    OSSL_OP_cipher_aead_open_fn *aead_open;
 } /* EVP_CIPHER */ ;
 
 /* Macros to code block cipher wrappers */
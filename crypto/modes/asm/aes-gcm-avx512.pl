@@ -0,0 +1,453 @@
+#! /usr/bin/env perl
+# Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+#
+# AES-CTR+GHASH for processors with VAES and VPCLMULQDQ on 512-bit
+# registers, i.e. Ice Lake and later Intel cores and AMD Zen 4.
+#
+# Each 512-bit register holds four counter blocks, so that the main
+# loop encrypts and hashes 16 blocks per iteration. GHASH is computed
+# as an aggregated sum of products with H^16..H^1, with a single
+# reduction per iteration. H^1..H^8 are taken from the table set up by
+# gcm_init_avx, H^9..H^16 are computed on entry. Encryption hashes the
+# ciphertext of the previous iteration while the current one is being
+# encrypted, decryption hashes the current input. Input shorter than
+# 16 blocks is processed 4 blocks at a time.
+#
+# The interface is the same as aesni_gcm_[en|de]crypt's, including the
+# requirement that Xi is followed by the gcm_init_avx table, but any
+# multiple of 64 bytes is processed. If the assembler is too old to
+# support VAES, or on Win64, calls are passed on to aesni_gcm_[en|de]crypt.
+
+$flavour = shift;
+$output  = shift;
+if ($flavour =~ /\./) { $output = $flavour; undef $flavour; }
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+$vaes=0;
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9])\.([0-9]+)/) {
+	$vaes = ($1>2 || $2>=30);
+}
+
+if (!$vaes && `$ENV{CC} -v 2>&1`
+		=~ /((?:^clang|LLVM) version|.*based on LLVM) ([0-9]+)\.([0-9]+)/) {
+	$vaes = ($2>=7);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\"";
+*STDOUT=*OUT;
+
+if ($vaes && !$win64) {{{
+
+($inp,$out,$len,$key,$ivp,$Xip)=("%rdi","%rsi","%rdx","%rcx","%r8","%r9");
+($ret,$rounds)=("%r10","%r11d");
+
+@B  = map("%zmm$_",(0..3));		# AES state, four blocks each
+@D  = map("%zmm$_",(4..7));		# byte-swapped blocks to hash
+($Lo,$Mi,$Hi,$Hkey,$T) = map("%zmm$_",(8..12));
+($Xi,$ctr,$rklast,$bswap,$four) = ("%xmm13","%zmm14","%zmm15","%zmm16","%zmm31");
+@rk = map("%zmm$_",(17..30));		# round keys 0-13
+
+$label=0;
+
+# GHASH the blocks in @_ into $Xi, the first one with H^(4*@_), using
+# the powers of H at the bottom of the stack. Returns the instructions
+# so that they can be interleaved with the AES rounds.
+sub ghash {
+my @d = @_;
+my $off = 0x100 - 0x40*@d;
+my @c;
+
+    push @c, "vpxorq	%zmm13,$d[0],$d[0]";	# Xi, upper lanes are zero
+    for (my $j=0; $j<@d; $j++) {
+	my $h = sprintf("0x%02x(%%rsp)",$off+0x40*$j);
+	push @c, "vmovdqa64	$h,$Hkey";
+	if ($j == 0) {
+	    push @c, "vpclmulqdq	\$0x00,$Hkey,$d[$j],$Lo",
+		     "vpclmulqdq	\$0x11,$Hkey,$d[$j],$Hi",
+		     "vpclmulqdq	\$0x01,$Hkey,$d[$j],$Mi",
+		     "vpclmulqdq	\$0x10,$Hkey,$d[$j],$T",
+		     "vpxorq	$T,$Mi,$Mi";
+	} else {
+	    push @c, "vpclmulqdq	\$0x00,$Hkey,$d[$j],$T",
+		     "vpxorq	$T,$Lo,$Lo",
+		     "vpclmulqdq	\$0x11,$Hkey,$d[$j],$T",
+		     "vpxorq	$T,$Hi,$Hi",
+		     "vpclmulqdq	\$0x01,$Hkey,$d[$j],$T",
+		     "vpxorq	$T,$Mi,$Mi",
+		     "vpclmulqdq	\$0x10,$Hkey,$d[$j],$T",
+		     "vpxorq	$T,$Mi,$Mi";
+	}
+    }
+    push @c,
+	"vpslldq	\$8,$Mi,$T",		# fold middle product
+	"vpsrldq	\$8,$Mi,$Mi",
+	"vpxorq	$T,$Lo,$Lo",
+	"vpxorq	$Mi,$Hi,$Hi",
+	"vextracti64x4	\$1,$Lo,%ymm12",	# sum up the four lanes
+	"vextracti64x4	\$1,$Hi,%ymm11",
+	"vpxor	%ymm12,%ymm8,%ymm8",
+	"vpxor	%ymm11,%ymm10,%ymm10",
+	"vextracti128	\$1,%ymm8,%xmm12",
+	"vextracti128	\$1,%ymm10,%xmm11",
+	"vpxor	%xmm12,%xmm8,%xmm8",
+	"vpxor	%xmm11,%xmm10,%xmm10",
+	"vpclmulqdq	\$0x10,.Lpoly(%rip),%xmm8,%xmm12",	# 1st phase
+	"vpshufd	\$0b01001110,%xmm8,%xmm8",
+	"vpxor	%xmm12,%xmm8,%xmm8",
+	"vpclmulqdq	\$0x10,.Lpoly(%rip),%xmm8,%xmm12",	# 2nd phase
+	"vpshufd	\$0b01001110,%xmm8,%xmm8",
+	"vpxor	%xmm12,%xmm8,%xmm8",
+	"vpxor	%xmm10,%xmm8,$Xi";
+    return @c;
+}
+
+# Set up counter blocks and AES rounds 0-9 for the registers in @_.
+sub aes_head {
+my @b = @_;
+my @c;
+
+    foreach (@b) {
+	push @c, "vpshufb	$bswap,$ctr,$_",
+		 "vpaddd	$four,$ctr,$ctr";
+    }
+    push @c, "vpxorq	$rk[0],$_,$_" foreach (@b);
+    for (my $i=1; $i<10; $i++) {
+	push @c, "vaesenc	$rk[$i],$_,$_" foreach (@b);
+    }
+    return @c;
+}
+
+# Remaining AES rounds of @b. The last round is folded with the xor of
+# the input in @t, which is clobbered.
+sub aes_tail {
+my ($b,$t) = @_;
+my @b = @$b;
+my @t = @$t;
+my $l = $label++;
+
+    $code.="	cmp	\$9,$rounds\n";		# 128-bit key
+    $code.="	je	.Laes_last$l\n";
+    $code.="	vaesenc	$rk[10],$_,$_\n" foreach (@b);
+    $code.="	vaesenc	$rk[11],$_,$_\n" foreach (@b);
+    $code.="	cmp	\$11,$rounds\n";		# 192-bit key
+    $code.="	je	.Laes_last$l\n";
+    $code.="	vaesenc	$rk[12],$_,$_\n" foreach (@b);
+    $code.="	vaesenc	$rk[13],$_,$_\n" foreach (@b);
+    $code.=".Laes_last$l:\n";
+    for (my $j=0; $j<@b; $j++) {
+	$code.="	vpxorq	".(0x40*$j)."($inp),$rklast,$t[$j]\n";
+    }
+    for (my $j=0; $j<@b; $j++) {
+	$code.="	vaesenclast	$t[$j],$b[$j],$b[$j]\n";
+    }
+    for (my $j=0; $j<@b; $j++) {
+	$code.="	vmovdqu64	$b[$j],".(0x40*$j)."($out)\n";
+    }
+}
+
+# Emit two instruction lists interleaved.
+sub interleave {
+my ($x,$y) = @_;
+my @x = @$x;
+my @y = @$y;
+
+    while (@x || @y) {
+	$code.="	".shift(@x)."\n" if (@x);
+	$code.="	".shift(@y)."\n" if (@y);
+    }
+}
+
+sub emit {
+    $code.="	$_\n" foreach (@_);
+}
+
+# Load the round keys, counter blocks and Xi, and put H^16..H^1 at the
+# bottom of the stack, H^k at 0x10*(16-k).
+sub setup {
+$code.=<<___;
+	vbroadcasti32x4	.Lbswap_mask(%rip),$bswap
+	vmovdqa64	.Lfour(%rip),$four
+	mov	240($key),$rounds		# key->rounds, 9, 11 or 13
+___
+for (my $i=0; $i<14; $i++) {
+    $code.="	vbroadcasti32x4	".(0x10*$i)."($key),$rk[$i]\n";
+}
+$code.=<<___;
+	lea	1(%r11),%eax
+	shl	\$4,%eax
+	vbroadcasti32x4	($key,%rax),$rklast
+
+	vbroadcasti32x4	($ivp),$ctr		# counter blocks
+	vpshufb		$bswap,$ctr,$ctr
+	vpaddd		.Lcounters(%rip),$ctr,$ctr
+
+	vmovdqu		($Xip),$Xi
+	vpshufb		.Lbswap_mask(%rip),$Xi,$Xi
+
+	vmovdqu		0x20+0x00($Xip),%xmm0	# H^1
+	vmovdqu		0x20+0x10($Xip),%xmm1	# H^2
+	vmovdqu		0x20+0x30($Xip),%xmm2	# H^3
+	vmovdqu		0x20+0x40($Xip),%xmm3	# H^4
+	vmovdqa		%xmm0,0xf0(%rsp)
+	vmovdqa		%xmm1,0xe0(%rsp)
+	vmovdqa		%xmm2,0xd0(%rsp)
+	vmovdqa		%xmm3,0xc0(%rsp)
+	vmovdqu		0x20+0x60($Xip),%xmm0	# H^5
+	vmovdqu		0x20+0x70($Xip),%xmm1	# H^6
+	vmovdqu		0x20+0x90($Xip),%xmm2	# H^7
+	vmovdqu		0x20+0xa0($Xip),%xmm3	# H^8
+	vmovdqa		%xmm0,0xb0(%rsp)
+	vmovdqa		%xmm1,0xa0(%rsp)
+	vmovdqa		%xmm2,0x90(%rsp)
+	vmovdqa		%xmm3,0x80(%rsp)
+
+	vbroadcasti32x4	.Lpoly(%rip),$T
+	vshufi64x2	\$0,%zmm3,%zmm3,%zmm3	# H^8 in all lanes
+	vmovdqa64	0xc0(%rsp),%zmm0	# H^4..H^1
+	vmovdqa64	0x80(%rsp),%zmm1	# H^8..H^5
+___
+# H^12..H^9 and H^16..H^13, lane by lane
+foreach my $p ("%zmm0","%zmm1") {
+$code.=<<___;
+	vpclmulqdq	\$0x00,%zmm3,$p,$Lo
+	vpclmulqdq	\$0x11,%zmm3,$p,$Hi
+	vpclmulqdq	\$0x01,%zmm3,$p,$Mi
+	vpclmulqdq	\$0x10,%zmm3,$p,$Hkey
+	vpxorq		$Hkey,$Mi,$Mi
+	vpslldq		\$8,$Mi,$Hkey
+	vpsrldq		\$8,$Mi,$Mi
+	vpxorq		$Hkey,$Lo,$Lo
+	vpxorq		$Mi,$Hi,$Hi
+	vpclmulqdq	\$0x10,$T,$Lo,$Hkey	# 1st phase
+	vpshufd		\$0b01001110,$Lo,$Lo
+	vpxorq		$Hkey,$Lo,$Lo
+	vpclmulqdq	\$0x10,$T,$Lo,$Hkey	# 2nd phase
+	vpshufd		\$0b01001110,$Lo,$Lo
+	vpxorq		$Hkey,$Lo,$Lo
+	vpxorq		$Hi,$Lo,$p
+___
+}
+$code.=<<___;
+	vmovdqa64	%zmm0,0x40(%rsp)
+	vmovdqa64	%zmm1,0x00(%rsp)
+___
+}
+
+sub prologue {
+my $name = shift;
+$code.=<<___;
+.globl	$name
+.type	$name,\@function,6
+.align	32
+$name:
+.cfi_startproc
+	xor	%eax,%eax
+	cmp	\$0x40,$len			# minimal accepted length
+	jb	.L${name}_abort
+
+	push	%rbp
+.cfi_push	%rbp
+	mov	%rsp,%rbp
+.cfi_def_cfa_register	%rbp
+	sub	\$0x100,%rsp
+	and	\$-64,%rsp
+	xor	$ret,$ret
+___
+&setup();
+}
+
+sub epilogue {
+my $name = shift;
+$code.=<<___;
+	vpshufb		.Lbswap_mask(%rip),$Xi,$Xi
+	vmovdqu		$Xi,($Xip)		# output Xi
+	vmovdqu		%xmm14,%xmm0
+	vpshufb		.Lbswap_mask(%rip),%xmm0,%xmm0
+	vmovdqu		%xmm0,($ivp)		# next counter value
+
+	vpxorq		%zmm0,%zmm0,%zmm0	# wipe powers of H
+	vmovdqa64	%zmm0,0x00(%rsp)
+	vmovdqa64	%zmm0,0x40(%rsp)
+	vmovdqa64	%zmm0,0x80(%rsp)
+	vmovdqa64	%zmm0,0xc0(%rsp)
+	vzeroupper
+
+	mov	$ret,%rax		# return value
+	mov	%rbp,%rsp
+.cfi_def_cfa_register	%rsp
+	pop	%rbp
+.cfi_pop	%rbp
+.L${name}_abort:
+	ret
+.cfi_endproc
+.size	$name,.-$name
+___
+}
+
+$code=<<___;
+.text
+
+___
+
+######################################################################
+#
+# size_t aes_gcm_[en|de]crypt_avx512(const void *inp, void *out,
+#		size_t len, const AES_KEY *key, unsigned char iv[16],
+#		struct { u128 Xi,H,Htbl[12]; } *Xip);
+{
+my $name = "aes_gcm_encrypt_avx512";
+
+&prologue($name);
+$code.=<<___;
+	cmp	\$0x100,$len
+	jb	.Lenc_tail4
+
+___
+&emit(&aes_head(@B));
+&aes_tail(\@B,\@D);
+$code.="	vpshufb	$bswap,$B[$_],$D[$_]\n" foreach (0..3);
+$code.=<<___;
+	lea	0x100($inp),$inp
+	lea	0x100($out),$out
+	add	\$0x100,$ret
+	sub	\$0x100,$len
+	jmp	.Lenc_loop16
+
+.align	32
+.Lenc_loop16:
+	cmp	\$0x100,$len
+	jb	.Lenc_flush16
+___
+# hash the previous 16 blocks of ciphertext while encrypting the next
+&interleave([&aes_head(@B)],[&ghash(@D)]);
+&aes_tail(\@B,\@D);
+$code.="	vpshufb	$bswap,$B[$_],$D[$_]\n" foreach (0..3);
+$code.=<<___;
+	lea	0x100($inp),$inp
+	lea	0x100($out),$out
+	add	\$0x100,$ret
+	sub	\$0x100,$len
+	jmp	.Lenc_loop16
+
+.align	32
+.Lenc_flush16:
+___
+&emit(&ghash(@D));
+$code.=<<___;
+
+.Lenc_tail4:
+	cmp	\$0x40,$len
+	jb	.Lenc_done
+___
+&emit(&aes_head($B[0]));
+&aes_tail([$B[0]],[$D[0]]);
+$code.="	vpshufb	$bswap,$B[0],$D[0]\n";
+&emit(&ghash($D[0]));
+$code.=<<___;
+	lea	0x40($inp),$inp
+	lea	0x40($out),$out
+	add	\$0x40,$ret
+	sub	\$0x40,$len
+	jmp	.Lenc_tail4
+
+.Lenc_done:
+___
+&epilogue($name);
+}
+
+{
+my $name = "aes_gcm_decrypt_avx512";
+
+&prologue($name);
+$code.=<<___;
+.align	32
+.Ldec_loop16:
+	cmp	\$0x100,$len
+	jb	.Ldec_tail4
+___
+for (my $j=0; $j<4; $j++) {
+    $code.="	vmovdqu64	".(0x40*$j)."($inp),$D[$j]\n";
+}
+$code.="	vpshufb	$bswap,$_,$_\n" foreach (@D);
+&interleave([&aes_head(@B)],[&ghash(@D)]);
+&aes_tail(\@B,\@D);
+$code.=<<___;
+	lea	0x100($inp),$inp
+	lea	0x100($out),$out
+	add	\$0x100,$ret
+	sub	\$0x100,$len
+	jmp	.Ldec_loop16
+
+.align	32
+.Ldec_tail4:
+	cmp	\$0x40,$len
+	jb	.Ldec_done
+	vmovdqu64	($inp),$D[0]
+	vpshufb	$bswap,$D[0],$D[0]
+___
+&interleave([&aes_head($B[0])],[&ghash($D[0])]);
+&aes_tail([$B[0]],[$D[0]]);
+$code.=<<___;
+	lea	0x40($inp),$inp
+	lea	0x40($out),$out
+	add	\$0x40,$ret
+	sub	\$0x40,$len
+	jmp	.Ldec_tail4
+
+.Ldec_done:
+___
+&epilogue($name);
+}
+
+$code.=<<___;
+.align	64
+.Lbswap_mask:
+	.byte	15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0
+.Lpoly:
+	.byte	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0xc2
+.align	64
+.Lcounters:
+	.long	0,0,0,0, 1,0,0,0, 2,0,0,0, 3,0,0,0
+.Lfour:
+	.long	4,0,0,0, 4,0,0,0, 4,0,0,0, 4,0,0,0
+.asciz	"AES-GCM module for x86_64 with VAES and VPCLMULQDQ"
+.align	64
+___
+}}} else {{{
+$code=<<___;	# assembler is too old or Win64
+.text
+.extern	aesni_gcm_encrypt
+.extern	aesni_gcm_decrypt
+
+.globl	aes_gcm_encrypt_avx512
+.type	aes_gcm_encrypt_avx512,\@abi-omnipotent
+aes_gcm_encrypt_avx512:
+	jmp	aesni_gcm_encrypt
+.size	aes_gcm_encrypt_avx512,.-aes_gcm_encrypt_avx512
+
+.globl	aes_gcm_decrypt_avx512
+.type	aes_gcm_decrypt_avx512,\@abi-omnipotent
+aes_gcm_decrypt_avx512:
+	jmp	aesni_gcm_decrypt
+.size	aes_gcm_decrypt_avx512,.-aes_gcm_decrypt_avx512
+___
+}}}
+
+$code =~ s/\`([^\`]*)\`/eval($1)/gem;
+
+print $code;
+
+close STDOUT;
@@ -214,12 +214,21 @@ int CRYPTO_siv128_init(SIV128_CONTEXT *ctx, const unsigned char *key, int klen,
 int CRYPTO_siv128_copy_ctx(SIV128_CONTEXT *dest, SIV128_CONTEXT *src)
 {
     memcpy(&dest->d, &src->d, sizeof(src->d));
+    if (dest->cipher_ctx == NULL
+            && (dest->cipher_ctx = EVP_CIPHER_CTX_new()) == NULL)
+        return 0;
     if (!EVP_CIPHER_CTX_copy(dest->cipher_ctx, src->cipher_ctx))
         return 0;
     EVP_MAC_CTX_free(dest->mac_ctx_init);
     dest->mac_ctx_init = EVP_MAC_CTX_dup(src->mac_ctx_init);
     if (dest->mac_ctx_init == NULL)
         return 0;
+    if (dest->mac != src->mac) {
+        if (!EVP_MAC_up_ref(src->mac))
+            return 0;
+        EVP_MAC_free(dest->mac);
+        dest->mac = src->mac;
+    }
     return 1;
 }
 
@@ -19,11 +19,29 @@
 #include "internal/thread_once.h"
 #include "internal/lhash.h"
 #include "internal/sparse_array.h"
+#include "internal/tsan_assist.h"
+#include "internal/cryptlib_int.h"
 #include "property_lcl.h"
 
 /* The number of elements in the query cache before we initiate a flush */
 #define IMPL_CACHE_FLUSH_THRESHOLD  500
 
+/*
+ * Where the compiler offers acquire/release loads and stores, query cache
+ * hits are served from a small direct mapped table owned by the calling
+ * thread.  Each entry is stamped with the store's generation number at the
+ * time it was filled.  Every change to the shared cache bumps the generation
+ * which invalidates all per thread tables at once.  A hit therefore takes no
+ * lock and performs no atomic write.
+ */
+#if defined(tsan_ld_acq) && !defined(FIPS_MODE)
+# define IMPL_CACHE_PER_THREAD
+/* The number of entries in each per thread table, must be a power of two */
+# define IMPL_CACHE_THREAD_SLOTS        64
+/* Longer queries are only held in the shared cache */
+# define IMPL_CACHE_THREAD_QUERY_MAX    48
+#endif
+
 typedef struct {
     OSSL_PROPERTY_LIST *properties;
     void *method;
@@ -40,6 +58,21 @@ typedef struct {
 
 DEFINE_LHASH_OF(QUERY);
 
+#ifdef IMPL_CACHE_PER_THREAD
+typedef struct {
+    unsigned int generation;
+    int nid;
+    void *method;
+    char query[IMPL_CACHE_THREAD_QUERY_MAX];
+} THREAD_QUERY;
+
+typedef struct {
+    THREAD_QUERY slots[IMPL_CACHE_THREAD_SLOTS];
+} THREAD_QUERY_CACHE;
+
+DEFINE_STACK_OF(THREAD_QUERY_CACHE)
+#endif
+
 typedef struct {
     int nid;
     STACK_OF(IMPLEMENTATION) *impls;
@@ -55,6 +88,12 @@ struct ossl_method_store_st {
     unsigned int nbits;
     unsigned char rand_bits[(IMPL_CACHE_FLUSH_THRESHOLD + 7) / 8];
     CRYPTO_RWLOCK *lock;
+#ifdef IMPL_CACHE_PER_THREAD
+    /* Only ever changed under a write lock, never zero */
+    unsigned int generation;
+    CRYPTO_THREAD_LOCAL thread_cache;
+    STACK_OF(THREAD_QUERY_CACHE) *thread_caches;
+#endif
 };
 
 typedef struct {
@@ -67,6 +106,7 @@ DEFINE_SPARSE_ARRAY_OF(ALGORITHM);
 
 static void ossl_method_cache_flush(OSSL_METHOD_STORE *store, int nid);
 static void ossl_method_cache_flush_all(OSSL_METHOD_STORE *c);
+static void impl_cache_invalidate(OSSL_METHOD_STORE *store);
 
 int ossl_property_read_lock(OSSL_METHOD_STORE *p)
 {
@@ -113,6 +153,13 @@ static void impl_cache_free(QUERY *elem)
     OPENSSL_free(elem);
 }
 
+#ifdef IMPL_CACHE_PER_THREAD
+static void impl_cache_thread_free(THREAD_QUERY_CACHE *tc)
+{
+    OPENSSL_free(tc);
+}
+#endif
+
 static void alg_cleanup(ossl_uintmax_t idx, ALGORITHM *a)
 {
     if (a != NULL) {
@@ -148,6 +195,17 @@ OSSL_METHOD_STORE *ossl_method_store_new(OPENSSL_CTX *ctx)
             OPENSSL_free(res);
             return NULL;
         }
+#ifdef IMPL_CACHE_PER_THREAD
+        res->generation = 1;
+        if ((res->thread_caches = sk_THREAD_QUERY_CACHE_new_null()) == NULL
+                || !CRYPTO_THREAD_init_local(&res->thread_cache, NULL)) {
+            sk_THREAD_QUERY_CACHE_free(res->thread_caches);
+            CRYPTO_THREAD_lock_free(res->lock);
+            OPENSSL_free(res->algs);
+            OPENSSL_free(res);
+            return NULL;
+        }
+#endif
     }
     return res;
 }
@@ -155,6 +213,16 @@ OSSL_METHOD_STORE *ossl_method_store_new(OPENSSL_CTX *ctx)
 void ossl_method_store_free(OSSL_METHOD_STORE *store)
 {
     if (store != NULL) {
+#ifdef IMPL_CACHE_PER_THREAD
+        /*
+         * Threads that are still running lose their stop handler for this
+         * store, so their tables are reclaimed here instead.
+         */
+        ossl_init_thread_deregister(store);
+        CRYPTO_THREAD_cleanup_local(&store->thread_cache);
+        sk_THREAD_QUERY_CACHE_pop_free(store->thread_caches,
+                                       &impl_cache_thread_free);
+#endif
         ossl_sa_ALGORITHM_doall(store->algs, &alg_cleanup);
         ossl_sa_ALGORITHM_free(store->algs);
         ossl_property_free(store->global_properties);
@@ -353,6 +421,22 @@ int ossl_method_store_set_global_properties(OSSL_METHOD_STORE *store,
     return ret;
 }
 
+/*
+ * Discard the contents of every per thread query cache.  This must be called
+ * with the write lock held whenever an entry in the shared cache is removed
+ * or replaced.
+ */
+static void impl_cache_invalidate(OSSL_METHOD_STORE *store)
+{
+#ifdef IMPL_CACHE_PER_THREAD
+    unsigned int gen = store->generation + 1;
+
+    if (gen == 0)
+        gen = 1;
+    tsan_st_rel((TSAN_QUALIFIER unsigned int *)&store->generation, gen);
+#endif
+}
+
 static void impl_cache_flush_alg(ossl_uintmax_t idx, ALGORITHM *alg)
 {
     lh_QUERY_doall(alg->cache, &impl_cache_free);
@@ -366,6 +450,7 @@ static void ossl_method_cache_flush(OSSL_METHOD_STORE *store, int nid)
     if (alg != NULL) {
         store->nelem -= lh_QUERY_num_items(alg->cache);
         impl_cache_flush_alg(0, alg);
+        impl_cache_invalidate(store);
     }
 }
 
@@ -373,6 +458,7 @@ static void ossl_method_cache_flush_all(OSSL_METHOD_STORE *store)
 {
     ossl_sa_ALGORITHM_doall(store->algs, &impl_cache_flush_alg);
     store->nelem = 0;
+    impl_cache_invalidate(store);
 }
 
 IMPLEMENT_LHASH_DOALL_ARG(QUERY, IMPL_CACHE_FLUSH);
@@ -436,16 +522,112 @@ static void ossl_method_cache_flush_some(OSSL_METHOD_STORE *store)
     store->need_flush = 0;
     ossl_sa_ALGORITHM_doall_arg(store->algs, &impl_cache_flush_one_alg, &state);
     store->nelem = state.nelem;
+    impl_cache_invalidate(store);
+}
+
+#ifdef IMPL_CACHE_PER_THREAD
+static THREAD_QUERY *impl_cache_thread_slot(THREAD_QUERY_CACHE *tc, int nid,
+                                            const char *prop_query)
+{
+    unsigned long h = OPENSSL_LH_strhash(prop_query) ^ (unsigned long)nid;
+
+    return &tc->slots[h & (IMPL_CACHE_THREAD_SLOTS - 1)];
 }
 
+static int impl_cache_thread_get(OSSL_METHOD_STORE *store, int nid,
+                                 const char *prop_query, void **method)
+{
+    THREAD_QUERY_CACHE *tc = CRYPTO_THREAD_get_local(&store->thread_cache);
+    THREAD_QUERY *tq;
+
+    if (tc == NULL)
+        return 0;
+    tq = impl_cache_thread_slot(tc, nid, prop_query);
+    if (tq->nid != nid
+            || tq->generation
+               != tsan_ld_acq((TSAN_QUALIFIER unsigned int *)&store->generation)
+            || strcmp(tq->query, prop_query) != 0)
+        return 0;
+    *method = tq->method;
+    return 1;
+}
+
+static void impl_cache_thread_stop(void *arg)
+{
+    OSSL_METHOD_STORE *store = arg;
+    THREAD_QUERY_CACHE *tc = CRYPTO_THREAD_get_local(&store->thread_cache);
+
+    if (tc == NULL)
+        return;
+    CRYPTO_THREAD_set_local(&store->thread_cache, NULL);
+    ossl_property_write_lock(store);
+    sk_THREAD_QUERY_CACHE_delete_ptr(store->thread_caches, tc);
+    ossl_property_unlock(store);
+    impl_cache_thread_free(tc);
+}
+
+/*
+ * Record a result from the shared cache in the calling thread's table.
+ * |generation| must have been read under the same lock as |method|.
+ */
+static void impl_cache_thread_set(OSSL_METHOD_STORE *store,
+                                  unsigned int generation, int nid,
+                                  const char *prop_query, void *method)
+{
+    THREAD_QUERY_CACHE *tc;
+    THREAD_QUERY *tq;
+    size_t len = strlen(prop_query);
+
+    if (len >= IMPL_CACHE_THREAD_QUERY_MAX)
+        return;
+
+    tc = CRYPTO_THREAD_get_local(&store->thread_cache);
+    if (tc == NULL) {
+        if ((tc = OPENSSL_zalloc(sizeof(*tc))) == NULL)
+            return;
+        ossl_property_write_lock(store);
+        if (!sk_THREAD_QUERY_CACHE_push(store->thread_caches, tc)) {
+            ossl_property_unlock(store);
+            impl_cache_thread_free(tc);
+            return;
+        }
+        ossl_property_unlock(store);
+        if (!ossl_init_thread_start(store, store, impl_cache_thread_stop)
+                || !CRYPTO_THREAD_set_local(&store->thread_cache, tc)) {
+            ossl_property_write_lock(store);
+            sk_THREAD_QUERY_CACHE_delete_ptr(store->thread_caches, tc);
+            ossl_property_unlock(store);
+            impl_cache_thread_free(tc);
+            return;
+        }
+    }
+
+    tq = impl_cache_thread_slot(tc, nid, prop_query);
+    tq->generation = generation;
+    tq->nid = nid;
+    tq->method = method;
+    memcpy(tq->query, prop_query, len + 1);
+}
+#endif
+
 int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, int nid,
                                 const char *prop_query, void **method)
 {
     ALGORITHM *alg;
     QUERY elem, *r;
+#ifdef IMPL_CACHE_PER_THREAD
+    unsigned int generation;
+#endif
 
     if (nid <= 0 || store == NULL)
         return 0;
+    if (prop_query == NULL)
+        prop_query = "";
+
+#ifdef IMPL_CACHE_PER_THREAD
+    if (impl_cache_thread_get(store, nid, prop_query, method))
+        return 1;
+#endif
 
     ossl_property_read_lock(store);
     alg = ossl_method_store_retrieve(store, nid);
@@ -454,14 +636,20 @@ int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, int nid,
         return 0;
     }
 
-    elem.query = prop_query != NULL ? prop_query : "";
+    elem.query = prop_query;
     r = lh_QUERY_retrieve(alg->cache, &elem);
     if (r == NULL) {
         ossl_property_unlock(store);
         return 0;
     }
     *method = r->method;
+#ifdef IMPL_CACHE_PER_THREAD
+    generation = store->generation;
+#endif
     ossl_property_unlock(store);
+#ifdef IMPL_CACHE_PER_THREAD
+    impl_cache_thread_set(store, generation, nid, prop_query, *method);
+#endif
     return 1;
 }
 
@@ -488,8 +676,11 @@ int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, int nid,
 
     if (method == NULL) {
         elem.query = prop_query;
-        if (lh_QUERY_delete(alg->cache, &elem) != NULL)
+        if ((old = lh_QUERY_delete(alg->cache, &elem)) != NULL) {
+            OPENSSL_free(old);
             store->nelem--;
+            impl_cache_invalidate(store);
+        }
         ossl_property_unlock(store);
         return 1;
     }
@@ -500,6 +691,7 @@ int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, int nid,
         memcpy((char *)p->query, prop_query, len + 1);
         if ((old = lh_QUERY_insert(alg->cache, p)) != NULL) {
             OPENSSL_free(old);
+            impl_cache_invalidate(store);
             ossl_property_unlock(store);
             return 1;
         }
@@ -137,6 +137,11 @@ void RSA_free(RSA *r)
     sk_RSA_PRIME_INFO_pop_free(r->prime_infos, rsa_multip_info_free);
     BN_BLINDING_free(r->blinding);
     BN_BLINDING_free(r->mt_blinding);
+    if (r->blinding_slots != NULL) {
+        for (i = 0; i < RSA_BLINDING_SLOTS; i++)
+            BN_BLINDING_free(r->blinding_slots[i].blinding);
+        OPENSSL_free(r->blinding_slots);
+    }
     OPENSSL_free(r->bignum_data);
     OPENSSL_free(r);
 }
@@ -12,6 +12,7 @@
 
 #include <openssl/rsa.h>
 #include "internal/refcount.h"
+#include "internal/tsan_assist.h"
 
 #define RSA_MAX_PRIME_NUM       5
 #define RSA_MIN_MODULUS_BITS    512
@@ -28,6 +29,18 @@ typedef struct rsa_prime_info_st {
 DECLARE_ASN1_ITEM(RSA_PRIME_INFO)
 DEFINE_STACK_OF(RSA_PRIME_INFO)
 
+/*
+ * Private key operations use a blinding owned by the calling thread, see
+ * rsa_get_blinding().  Threads beyond this many share |mt_blinding|.
+ */
+#define RSA_BLINDING_SLOTS      64
+
+typedef struct rsa_blinding_slot_st {
+    CRYPTO_THREAD_ID tid;
+    /* Published after |tid|, the slot is free while this is NULL */
+    BN_BLINDING *TSAN_QUALIFIER blinding;
+} RSA_BLINDING_SLOT;
+
 struct rsa_st {
     /*
      * The first parameter is used to pickup errors where this is passed
@@ -65,6 +78,8 @@ struct rsa_st {
     char *bignum_data;
     BN_BLINDING *blinding;
     BN_BLINDING *mt_blinding;
+    /* RSA_BLINDING_SLOTS entries, filled in order */
+    RSA_BLINDING_SLOT *TSAN_QUALIFIER blinding_slots;
     CRYPTO_RWLOCK *lock;
 };
 
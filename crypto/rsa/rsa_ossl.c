@@ -7,6 +7,7 @@
  * https://www.openssl.org/source/license.html
  */
 
+#include <openssl/async.h>
 #include "internal/cryptlib.h"
 #include "internal/bn_int.h"
 #include "rsa_locl.h"
@@ -91,7 +92,7 @@ static int rsa_ossl_public_encrypt(int flen, const unsigned char *from,
         }
     }
 
-    if ((ctx = BN_CTX_new()) == NULL)
+    if ((ctx = bn_ctx_new_scoped(NULL)) == NULL)
         goto err;
     BN_CTX_start(ctx);
     f = BN_CTX_get(ctx);
@@ -154,10 +155,95 @@ static int rsa_ossl_public_encrypt(int flen, const unsigned char *from,
     return r;
 }
 
+/*
+ * Each thread that does private key operations with |rsa| claims a slot of
+ * its own in |rsa->blinding_slots|, under the lock, the first time round.
+ * A slot is only ever matched by the thread that claimed it (or by a later
+ * thread that got the same id after it exited), and each blinding refreshes
+ * on its own schedule.  Slots are published with release stores, |tid|
+ * before |blinding|, so where acquire loads are available finding a slot
+ * again needs no lock.
+ */
+static BN_BLINDING *rsa_find_thread_blinding(RSA *rsa, CRYPTO_THREAD_ID tid)
+{
+    RSA_BLINDING_SLOT *slots;
+    BN_BLINDING *b = NULL;
+    int i;
+
+#ifdef tsan_ld_acq
+    slots = tsan_ld_acq(&rsa->blinding_slots);
+    if (slots == NULL)
+        return NULL;
+    for (i = 0; i < RSA_BLINDING_SLOTS
+                && (b = tsan_ld_acq(&slots[i].blinding)) != NULL; i++)
+        if (CRYPTO_THREAD_compare_id(slots[i].tid, tid))
+            return b;
+    return NULL;
+#else
+    CRYPTO_THREAD_read_lock(rsa->lock);
+    if ((slots = rsa->blinding_slots) != NULL) {
+        for (i = 0; i < RSA_BLINDING_SLOTS && slots[i].blinding != NULL; i++)
+            if (CRYPTO_THREAD_compare_id(slots[i].tid, tid)) {
+                b = slots[i].blinding;
+                break;
+            }
+    }
+    CRYPTO_THREAD_unlock(rsa->lock);
+    return b;
+#endif
+}
+
+static BN_BLINDING *rsa_get_thread_blinding(RSA *rsa, BN_CTX *ctx)
+{
+    CRYPTO_THREAD_ID tid = CRYPTO_THREAD_get_current_id();
+    RSA_BLINDING_SLOT *slots;
+    BN_BLINDING *ret;
+    int i;
+
+    if ((ret = rsa_find_thread_blinding(rsa, tid)) != NULL)
+        return ret;
+
+    CRYPTO_THREAD_write_lock(rsa->lock);
+    if ((slots = rsa->blinding_slots) == NULL) {
+        slots = OPENSSL_zalloc(RSA_BLINDING_SLOTS * sizeof(*slots));
+#ifdef tsan_st_rel
+        tsan_st_rel(&rsa->blinding_slots, slots);
+#else
+        rsa->blinding_slots = slots;
+#endif
+    }
+    if (slots != NULL) {
+        for (i = 0; i < RSA_BLINDING_SLOTS && slots[i].blinding != NULL; i++)
+            continue;
+        if (i < RSA_BLINDING_SLOTS
+                && (ret = RSA_setup_blinding(rsa, ctx)) != NULL) {
+            slots[i].tid = tid;
+#ifdef tsan_st_rel
+            tsan_st_rel(&slots[i].blinding, ret);
+#else
+            slots[i].blinding = ret;
+#endif
+        }
+    }
+    CRYPTO_THREAD_unlock(rsa->lock);
+    return ret;
+}
+
 static BN_BLINDING *rsa_get_blinding(RSA *rsa, int *local, BN_CTX *ctx)
 {
     BN_BLINDING *ret;
 
+    if ((ret = rsa_get_thread_blinding(rsa, ctx)) != NULL) {
+        /*
+         * An async job can be paused and another one started on this thread
+         * in the middle of an operation, so it must keep its unblinding
+         * factor to itself.
+         */
+        *local = ASYNC_get_current_job() == NULL;
+        return ret;
+    }
+
+    /* Out of slots, fall back to the shared blinding */
     CRYPTO_THREAD_write_lock(rsa->lock);
 
     if (rsa->blinding == NULL) {
@@ -246,7 +332,7 @@ static int rsa_ossl_private_encrypt(int flen, const unsigned char *from,
     BIGNUM *unblind = NULL;
     BN_BLINDING *blinding = NULL;
 
-    if ((ctx = BN_CTX_new()) == NULL)
+    if ((ctx = bn_ctx_new_scoped(NULL)) == NULL)
         goto err;
     BN_CTX_start(ctx);
     f = BN_CTX_get(ctx);
@@ -380,7 +466,7 @@ static int rsa_ossl_private_decrypt(int flen, const unsigned char *from,
     BIGNUM *unblind = NULL;
     BN_BLINDING *blinding = NULL;
 
-    if ((ctx = BN_CTX_new()) == NULL)
+    if ((ctx = bn_ctx_new_scoped(NULL)) == NULL)
         goto err;
     BN_CTX_start(ctx);
     f = BN_CTX_get(ctx);
@@ -525,7 +611,7 @@ static int rsa_ossl_public_decrypt(int flen, const unsigned char *from,
         }
     }
 
-    if ((ctx = BN_CTX_new()) == NULL)
+    if ((ctx = bn_ctx_new_scoped(NULL)) == NULL)
         goto err;
     BN_CTX_start(ctx);
     f = BN_CTX_get(ctx);
@@ -667,15 +753,17 @@ static int rsa_ossl_mod_exp(BIGNUM *r0, const BIGNUM *I, RSA *rsa, BN_CTX *ctx)
         if (/* m1 = I moq q */
             !bn_from_mont_fixed_top(m1, I, rsa->_method_mod_q, ctx)
             || !bn_to_mont_fixed_top(m1, m1, rsa->_method_mod_q, ctx)
-            /* m1 = m1^dmq1 mod q */
-            || !BN_mod_exp_mont_consttime(m1, m1, rsa->dmq1, rsa->q, ctx,
-                                          rsa->_method_mod_q)
             /* r1 = I mod p */
             || !bn_from_mont_fixed_top(r1, I, rsa->_method_mod_p, ctx)
             || !bn_to_mont_fixed_top(r1, r1, rsa->_method_mod_p, ctx)
-            /* r1 = r1^dmp1 mod p */
-            || !BN_mod_exp_mont_consttime(r1, r1, rsa->dmp1, rsa->p, ctx,
-                                          rsa->_method_mod_p)
+            /*
+             * m1 = m1^dmq1 mod q and r1 = r1^dmp1 mod p, side by side
+             * where the hardware allows
+             */
+            || !BN_mod_exp_mont_consttime_x2(m1, m1, rsa->dmq1, rsa->q,
+                                             rsa->_method_mod_q,
+                                             r1, r1, rsa->dmp1, rsa->p,
+                                             rsa->_method_mod_p, ctx)
             /* r1 = (r1 - m1) mod p */
             /*
              * bn_mod_sub_fixed_top is not regular modular subtraction,
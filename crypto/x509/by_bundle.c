@@ -0,0 +1,552 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "e_os.h"
+#include "internal/cryptlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/buffer.h>
+#include <openssl/asn1.h>
+#include <openssl/x509.h>
+#include "internal/x509_int.h"
+#include "x509_lcl.h"
+
+#if defined(OPENSSL_SYS_UNIX) && !defined(OPENSSL_NO_POSIX_IO) \
+    && !defined(OPENSSL_SYS_VXWORKS)
+# define BY_BUNDLE_MMAP
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+/*
+ * An indexed bundle starts with a header listing the subject name hash of
+ * every certificate, so that it can be loaded without parsing anything:
+ *
+ *      magic           8 bytes, BUNDLE_MAGIC
+ *      count           4 bytes
+ *      entries         count times 12 bytes: name hash, offset, length
+ *      certificates    DER encoded, at the offsets given by the entries
+ *
+ * All numbers are big endian and offsets are from the start of the file.
+ * A file without the magic is read as concatenated DER certificates, in
+ * which case only the subject names are decoded at load time.
+ */
+#define BUNDLE_MAGIC            "OSSLCAB\001"
+#define BUNDLE_MAGIC_LEN        8
+#define BUNDLE_ENTRY_LEN        12
+#define BUNDLE_HEADER_LEN       (BUNDLE_MAGIC_LEN + 4)
+
+typedef struct lookup_bundle_entry_st {
+    unsigned long hash;
+    size_t offset;
+    size_t length;
+    int loaded;
+} BY_BUNDLE_ENTRY;
+
+typedef struct lookup_bundle_file_st {
+    unsigned char *data;
+    size_t len;
+    int mapped;
+    BY_BUNDLE_ENTRY *entries;   /* Sorted by |hash| */
+    size_t num;
+} BY_BUNDLE_FILE;
+
+DEFINE_STACK_OF(BY_BUNDLE_FILE)
+
+typedef struct lookup_bundle_st {
+    STACK_OF(BY_BUNDLE_FILE) *files;
+    CRYPTO_RWLOCK *lock;
+} BY_BUNDLE;
+
+static int new_bundle(X509_LOOKUP *lu);
+static void free_bundle(X509_LOOKUP *lu);
+static int bundle_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp,
+                       long argl, char **ret);
+static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
+                               X509_NAME *name, X509_OBJECT *ret);
+static X509_LOOKUP_METHOD x509_bundle_lookup = {
+    "Load certificates from an indexed bundle",
+    new_bundle,                 /* new_item */
+    free_bundle,                /* free */
+    NULL,                       /* init */
+    NULL,                       /* shutdown */
+    bundle_ctrl,                /* ctrl */
+    get_cert_by_subject,        /* get_by_subject */
+    NULL,                       /* get_by_issuer_serial */
+    NULL,                       /* get_by_fingerprint */
+    NULL,                       /* get_by_alias */
+};
+
+X509_LOOKUP_METHOD *X509_LOOKUP_bundle(void)
+{
+    return &x509_bundle_lookup;
+}
+
+static int new_bundle(X509_LOOKUP *lu)
+{
+    BY_BUNDLE *a = OPENSSL_zalloc(sizeof(*a));
+
+    if (a == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    a->lock = CRYPTO_THREAD_lock_new();
+    if (a->lock == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        OPENSSL_free(a);
+        return 0;
+    }
+    lu->method_data = a;
+    return 1;
+}
+
+static void bundle_file_free(BY_BUNDLE_FILE *f)
+{
+    if (f == NULL)
+        return;
+#ifdef BY_BUNDLE_MMAP
+    if (f->mapped)
+        munmap(f->data, f->len);
+    else
+#endif
+        OPENSSL_free(f->data);
+    OPENSSL_free(f->entries);
+    OPENSSL_free(f);
+}
+
+static void free_bundle(X509_LOOKUP *lu)
+{
+    BY_BUNDLE *a = (BY_BUNDLE *)lu->method_data;
+
+    sk_BY_BUNDLE_FILE_pop_free(a->files, bundle_file_free);
+    CRYPTO_THREAD_lock_free(a->lock);
+    OPENSSL_free(a);
+}
+
+/* Map |file| read-only, or read it into memory where mmap() is missing. */
+static int bundle_map(BY_BUNDLE_FILE *f, const char *file)
+{
+#ifdef BY_BUNDLE_MMAP
+    struct stat st;
+    void *p;
+    int fd;
+
+    if ((fd = open(file, O_RDONLY)) < 0) {
+        SYSerr(SYS_F_OPEN, get_last_sys_error());
+        ERR_add_error_data(2, "file=", file);
+        return 0;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size <= 0
+            || (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        X509err(0, X509_R_INVALID_BUNDLE);
+        ERR_add_error_data(2, "file=", file);
+        return 0;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        SYSerr(0, get_last_sys_error());
+        ERR_add_error_data(2, "file=", file);
+        return 0;
+    }
+    f->data = p;
+    f->len = (size_t)st.st_size;
+    f->mapped = 1;
+    return 1;
+#else
+    BIO *in = BIO_new_file(file, "rb");
+    BUF_MEM *b = NULL;
+    size_t len = 0;
+    int n, ok = 0;
+
+    if (in == NULL)
+        return 0;
+    if ((b = BUF_MEM_new()) == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    for (;;) {
+        if (!BUF_MEM_grow(b, len + 4096)) {
+            X509err(0, ERR_R_MALLOC_FAILURE);
+            goto err;
+        }
+        if ((n = BIO_read(in, b->data + len, 4096)) <= 0)
+            break;
+        len += n;
+    }
+    if (len == 0) {
+        X509err(0, X509_R_INVALID_BUNDLE);
+        ERR_add_error_data(2, "file=", file);
+        goto err;
+    }
+    f->data = (unsigned char *)b->data;
+    f->len = len;
+    b->data = NULL;
+    ok = 1;
+ err:
+    BUF_MEM_free(b);
+    BIO_free(in);
+    return ok;
+#endif
+}
+
+static unsigned long bundle_get32(const unsigned char *p)
+{
+    return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16)
+           | ((unsigned long)p[2] << 8) | (unsigned long)p[3];
+}
+
+static void bundle_put32(unsigned char *p, unsigned long v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static int bundle_entry_cmp(const void *a, const void *b)
+{
+    const BY_BUNDLE_ENTRY *ea = a, *eb = b;
+
+    if (ea->hash != eb->hash)
+        return ea->hash > eb->hash ? 1 : -1;
+    if (ea->offset != eb->offset)
+        return ea->offset > eb->offset ? 1 : -1;
+    return 0;
+}
+
+/*
+ * Find the extent of the DER certificate at |p| and the hash of its subject
+ * name, decoding nothing else.  Returns the length of the certificate, or 0
+ * if it is malformed.
+ */
+static size_t bundle_scan_cert(const unsigned char *p, size_t len,
+                               unsigned long *hash)
+{
+    const unsigned char *q = p, *end, *field;
+    long plen;
+    int tag, xclass, i;
+    size_t total;
+    X509_NAME *nm;
+
+    if (len > LONG_MAX)
+        len = LONG_MAX;
+    if (ASN1_get_object(&q, &plen, &tag, &xclass,
+                        (long)len) != V_ASN1_CONSTRUCTED
+            || tag != V_ASN1_SEQUENCE || xclass != V_ASN1_UNIVERSAL)
+        return 0;
+    total = (size_t)(q - p) + (size_t)plen;
+
+    /* TBSCertificate */
+    if (ASN1_get_object(&q, &plen, &tag, &xclass, plen) != V_ASN1_CONSTRUCTED
+            || tag != V_ASN1_SEQUENCE || xclass != V_ASN1_UNIVERSAL)
+        return 0;
+    end = q + plen;
+
+    /* Skip the optional version */
+    field = q;
+    if (ASN1_get_object(&q, &plen, &tag, &xclass, (long)(end - q)) & 0x81)
+        return 0;
+    if (xclass == V_ASN1_CONTEXT_SPECIFIC && tag == 0)
+        q += plen;
+    else
+        q = field;
+
+    /* Skip the serial number, signature, issuer and validity */
+    for (i = 0; i < 4; i++) {
+        if (ASN1_get_object(&q, &plen, &tag, &xclass, (long)(end - q)) & 0x81)
+            return 0;
+        q += plen;
+    }
+
+    nm = d2i_X509_NAME(NULL, &q, (long)(end - q));
+    if (nm == NULL)
+        return 0;
+    *hash = X509_NAME_hash(nm);
+    X509_NAME_free(nm);
+    return total;
+}
+
+static int bundle_index_der(BY_BUNDLE_FILE *f)
+{
+    size_t pos = 0, n, max = 0;
+    BY_BUNDLE_ENTRY *tmp;
+    unsigned long hash;
+
+    while (pos < f->len) {
+        if ((n = bundle_scan_cert(f->data + pos, f->len - pos, &hash)) == 0)
+            return 0;
+        if (f->num == max) {
+            max = max == 0 ? 64 : max * 2;
+            tmp = OPENSSL_realloc(f->entries, max * sizeof(*tmp));
+            if (tmp == NULL) {
+                X509err(0, ERR_R_MALLOC_FAILURE);
+                return 0;
+            }
+            f->entries = tmp;
+        }
+        f->entries[f->num].hash = hash;
+        f->entries[f->num].offset = pos;
+        f->entries[f->num].length = n;
+        f->entries[f->num].loaded = 0;
+        f->num++;
+        pos += n;
+    }
+    return 1;
+}
+
+static int bundle_index_header(BY_BUNDLE_FILE *f)
+{
+    const unsigned char *p = f->data + BUNDLE_MAGIC_LEN;
+    size_t i, num, hdrlen;
+
+    if (f->len < BUNDLE_HEADER_LEN)
+        return 0;
+    num = bundle_get32(p);
+    p += 4;
+    if (num > (f->len - BUNDLE_HEADER_LEN) / BUNDLE_ENTRY_LEN)
+        return 0;
+    hdrlen = BUNDLE_HEADER_LEN + num * BUNDLE_ENTRY_LEN;
+    if (num == 0)
+        return 1;
+    if ((f->entries = OPENSSL_malloc(num * sizeof(*f->entries))) == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    for (i = 0; i < num; i++, p += BUNDLE_ENTRY_LEN) {
+        BY_BUNDLE_ENTRY *e = &f->entries[i];
+
+        e->hash = bundle_get32(p);
+        e->offset = bundle_get32(p + 4);
+        e->length = bundle_get32(p + 8);
+        e->loaded = 0;
+        if (e->offset < hdrlen || e->length == 0 || e->offset > f->len
+                || e->length > f->len - e->offset)
+            return 0;
+    }
+    f->num = num;
+    return 1;
+}
+
+static int add_bundle_file(BY_BUNDLE *ctx, const char *file)
+{
+    BY_BUNDLE_FILE *f;
+    int ok;
+
+    if (file == NULL) {
+        X509err(0, X509_R_INVALID_BUNDLE);
+        return 0;
+    }
+    if ((f = OPENSSL_zalloc(sizeof(*f))) == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    if (!bundle_map(f, file))
+        goto err;
+    if (f->len >= BUNDLE_MAGIC_LEN
+            && memcmp(f->data, BUNDLE_MAGIC, BUNDLE_MAGIC_LEN) == 0)
+        ok = bundle_index_header(f);
+    else
+        ok = bundle_index_der(f);
+    if (!ok) {
+        X509err(0, X509_R_INVALID_BUNDLE);
+        ERR_add_error_data(2, "file=", file);
+        goto err;
+    }
+    if (f->num > 1)
+        qsort(f->entries, f->num, sizeof(*f->entries), bundle_entry_cmp);
+
+    CRYPTO_THREAD_write_lock(ctx->lock);
+    if (ctx->files == NULL
+            && (ctx->files = sk_BY_BUNDLE_FILE_new_null()) == NULL)
+        ok = 0;
+    else
+        ok = sk_BY_BUNDLE_FILE_push(ctx->files, f) > 0;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    if (!ok) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    return 1;
+
+ err:
+    bundle_file_free(f);
+    return 0;
+}
+
+static int bundle_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp,
+                       long argl, char **ret)
+{
+    BY_BUNDLE *ld = (BY_BUNDLE *)ctx->method_data;
+
+    switch (cmd) {
+    case X509_L_FILE_LOAD:
+        if (argl != X509_FILETYPE_ASN1) {
+            X509err(0, X509_R_BAD_X509_FILETYPE);
+            return 0;
+        }
+        return add_bundle_file(ld, argp);
+    }
+    return 0;
+}
+
+/* Index of the first entry of |f| with |hash|, or f->num if there is none */
+static size_t bundle_find(const BY_BUNDLE_FILE *f, unsigned long hash)
+{
+    size_t lo = 0, hi = f->num;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (f->entries[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
+                               X509_NAME *name, X509_OBJECT *ret)
+{
+    BY_BUNDLE *ctx = (BY_BUNDLE *)xl->method_data;
+    X509_OBJECT *tmp;
+    unsigned long h;
+    int i, n, loaded, quiet;
+    size_t j;
+
+    if (type != X509_LU_X509 || name == NULL)
+        return 0;
+
+    h = X509_NAME_hash(name);
+    CRYPTO_THREAD_read_lock(ctx->lock);
+    n = sk_BY_BUNDLE_FILE_num(ctx->files);
+    CRYPTO_THREAD_unlock(ctx->lock);
+
+    /*
+     * Errors from entries that fail to decode are dropped on success, but
+     * only if nothing was queued before: d2i_X509() sets and pops a mark of
+     * its own, and marks don't nest, so one of ours could be lost and take
+     * the caller's errors with it.
+     */
+    quiet = ERR_peek_error() == 0;
+    for (i = 0; i < n; i++) {
+        BY_BUNDLE_FILE *f;
+
+        CRYPTO_THREAD_read_lock(ctx->lock);
+        f = sk_BY_BUNDLE_FILE_value(ctx->files, i);
+        CRYPTO_THREAD_unlock(ctx->lock);
+
+        /*
+         * Certificates are decoded on first use without holding the lock,
+         * and handed to the store, which keeps them from then on.  Entries
+         * that fail to decode are not retried.
+         */
+        for (j = bundle_find(f, h); j < f->num && f->entries[j].hash == h;
+             j++) {
+            BY_BUNDLE_ENTRY *e = &f->entries[j];
+            const unsigned char *p = f->data + e->offset;
+            X509 *x;
+
+            CRYPTO_THREAD_read_lock(ctx->lock);
+            loaded = e->loaded;
+            CRYPTO_THREAD_unlock(ctx->lock);
+            if (loaded)
+                continue;
+
+            x = d2i_X509(NULL, &p, (long)e->length);
+            if (x != NULL) {
+                X509_STORE_add_cert(xl->store_ctx, x);
+                X509_free(x);
+            }
+
+            CRYPTO_THREAD_write_lock(ctx->lock);
+            e->loaded = 1;
+            CRYPTO_THREAD_unlock(ctx->lock);
+        }
+    }
+
+    x509_store_read_lock(xl->store_ctx);
+    tmp = x509_store_get0_by_subject(xl->store_ctx, type, name);
+    X509_STORE_unlock(xl->store_ctx);
+    if (tmp == NULL)
+        return 0;
+
+    ret->type = tmp->type;
+    memcpy(&ret->data, &tmp->data, sizeof(ret->data));
+    if (quiet)
+        ERR_clear_error();
+    return 1;
+}
+
+int X509_bundle_write_bio(BIO *out, STACK_OF(X509) *certs)
+{
+    int i, num = sk_X509_num(certs), ok = 0;
+    size_t off, hdrlen;
+    BY_BUNDLE_ENTRY *entries = NULL;
+    unsigned char *buf = NULL, *p;
+
+    if (num < 0)
+        num = 0;
+    if ((size_t)num > (0xffffffffUL - BUNDLE_HEADER_LEN) / BUNDLE_ENTRY_LEN) {
+        X509err(0, X509_R_INVALID_BUNDLE);
+        return 0;
+    }
+    hdrlen = BUNDLE_HEADER_LEN + (size_t)num * BUNDLE_ENTRY_LEN;
+    buf = OPENSSL_malloc(hdrlen);
+    entries = OPENSSL_malloc(sizeof(*entries) * (num > 0 ? num : 1));
+    if (buf == NULL || entries == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    off = hdrlen;
+    for (i = 0; i < num; i++) {
+        X509 *x = sk_X509_value(certs, i);
+        int len = i2d_X509(x, NULL);
+
+        if (len <= 0)
+            goto err;
+        if ((size_t)len > 0xffffffffUL - off) {
+            X509err(0, X509_R_INVALID_BUNDLE);
+            goto err;
+        }
+        entries[i].hash = X509_NAME_hash(X509_get_subject_name(x));
+        entries[i].offset = off;
+        entries[i].length = len;
+        off += len;
+    }
+    if (num > 1)
+        qsort(entries, num, sizeof(*entries), bundle_entry_cmp);
+
+    memcpy(buf, BUNDLE_MAGIC, BUNDLE_MAGIC_LEN);
+    bundle_put32(buf + BUNDLE_MAGIC_LEN, num);
+    for (i = 0, p = buf + BUNDLE_HEADER_LEN; i < num;
+         i++, p += BUNDLE_ENTRY_LEN) {
+        bundle_put32(p, entries[i].hash);
+        bundle_put32(p + 4, (unsigned long)entries[i].offset);
+        bundle_put32(p + 8, (unsigned long)entries[i].length);
+    }
+    if (BIO_write(out, buf, (int)hdrlen) != (int)hdrlen)
+        goto err;
+    for (i = 0; i < num; i++)
+        if (!i2d_X509_bio(out, sk_X509_value(certs, i)))
+            goto err;
+    ok = 1;
+
+ err:
+    OPENSSL_free(entries);
+    OPENSSL_free(buf);
+    return ok;
+}
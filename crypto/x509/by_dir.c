@@ -16,27 +16,58 @@
 
 #ifndef OPENSSL_NO_POSIX_IO
 # include <sys/stat.h>
+# ifdef _WIN32
+#  define stat _stat
+# endif
 #endif
 
 #include <openssl/x509.h>
+#include "internal/ctype.h"
+#include "internal/o_dir.h"
 #include "internal/x509_int.h"
 #include "x509_lcl.h"
 
+/*
+ * Where directories can be listed and their modification time checked, each
+ * directory is indexed with a single pass over its entries.  Lookups then
+ * only open the files the index says exist, and hashes without files are
+ * answered without any system call until the index is revalidated.
+ */
+#if !defined(OPENSSL_NO_POSIX_IO) && !defined(OPENSSL_SYS_VMS)
+# define BY_DIR_INDEX
+#endif
+
 struct lookup_dir_hashes_st {
     unsigned long hash;
     int suffix;
 };
 
+/* The <hash>.<n> or <hash>.r<n> files of one hash in an indexed directory */
+typedef struct lookup_dir_name_st {
+    unsigned long hash;
+    int crl;
+    int count;                  /* Suffixes 0 to count - 1 exist */
+    int loaded;                 /* Suffixes below this have been loaded */
+} BY_DIR_NAME;
+
+DEFINE_STACK_OF(BY_DIR_NAME)
+
 struct lookup_dir_entry_st {
     char *dir;
     int dir_type;
     STACK_OF(BY_DIR_HASH) *hashes;
+    /* Directory index, NULL if the directory has not been listed */
+    STACK_OF(BY_DIR_NAME) *names;
+    time_t mtime;               /* Modification time when |names| was built */
+    time_t built;               /* Time |names| was built */
+    time_t checked;             /* Time |mtime| was last compared */
 };
 
 typedef struct lookup_dir_st {
     BUF_MEM *buffer;
     STACK_OF(BY_DIR_ENTRY) *dirs;
     CRYPTO_RWLOCK *lock;
+    long ttl;                   /* Seconds to trust an index without a stat */
 } BY_DIR;
 
 static int dir_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
@@ -86,6 +117,14 @@ static int dir_ctrl(X509_LOOKUP *ctx, int cmd, const char *argp, long argl,
         } else
             ret = add_cert_dir(ld, argp, (int)argl);
         break;
+    case X509_L_DIR_TTL:
+        if (argl < 0)
+            break;
+        CRYPTO_THREAD_write_lock(ld->lock);
+        ld->ttl = argl;
+        CRYPTO_THREAD_unlock(ld->lock);
+        ret = 1;
+        break;
     }
     return ret;
 }
@@ -104,6 +143,7 @@ static int new_dir(X509_LOOKUP *lu)
         goto err;
     }
     a->dirs = NULL;
+    a->ttl = 0;
     a->lock = CRYPTO_THREAD_lock_new();
     if (a->lock == NULL) {
         BUF_MEM_free(a->buffer);
@@ -133,10 +173,24 @@ static int by_dir_hash_cmp(const BY_DIR_HASH *const *a,
     return 0;
 }
 
+static void by_dir_name_free(BY_DIR_NAME *name)
+{
+    OPENSSL_free(name);
+}
+
+static int by_dir_name_cmp(const BY_DIR_NAME *const *a,
+                           const BY_DIR_NAME *const *b)
+{
+    if ((*a)->hash != (*b)->hash)
+        return (*a)->hash > (*b)->hash ? 1 : -1;
+    return (*a)->crl - (*b)->crl;
+}
+
 static void by_dir_entry_free(BY_DIR_ENTRY *ent)
 {
     OPENSSL_free(ent->dir);
     sk_BY_DIR_HASH_pop_free(ent->hashes, by_dir_hash_free);
+    sk_BY_DIR_NAME_pop_free(ent->names, by_dir_name_free);
     OPENSSL_free(ent);
 }
 
@@ -192,6 +246,8 @@ static int add_cert_dir(BY_DIR *ctx, const char *dir, int type)
                 return 0;
             }
             ent->dir_type = type;
+            ent->names = NULL;
+            ent->mtime = ent->built = ent->checked = 0;
             ent->hashes = sk_BY_DIR_HASH_new(by_dir_hash_cmp);
             ent->dir = OPENSSL_strndup(ss, len);
             if (ent->dir == NULL || ent->hashes == NULL) {
@@ -208,34 +264,238 @@ static int add_cert_dir(BY_DIR *ctx, const char *dir, int type)
     return 1;
 }
 
+#ifdef BY_DIR_INDEX
+static int by_dir_file_cmp(const BY_DIR_NAME *const *a,
+                           const BY_DIR_NAME *const *b)
+{
+    int ret = by_dir_name_cmp(a, b);
+
+    return ret != 0 ? ret : (*a)->count - (*b)->count;
+}
+
+/* Parse a file name of the form <hash>.<n> or <hash>.r<n> */
+static int by_dir_parse_name(const char *fn, unsigned long *hash, int *crl,
+                             int *suffix)
+{
+    unsigned long h = 0;
+    int i, n = 0;
+
+    for (i = 0; i < 8; i++) {
+        if (fn[i] >= '0' && fn[i] <= '9')
+            h = (h << 4) | (fn[i] - '0');
+        else if (fn[i] >= 'a' && fn[i] <= 'f')
+            h = (h << 4) | (fn[i] - 'a' + 10);
+        else
+            return 0;
+    }
+    if (fn[i++] != '.')
+        return 0;
+    if ((*crl = fn[i] == 'r'))
+        i++;
+    if (!ossl_isdigit(fn[i]))
+        return 0;
+    for (; ossl_isdigit(fn[i]); i++) {
+        n = n * 10 + (fn[i] - '0');
+        /* Must fit in the six digits get_cert_by_subject() allows for */
+        if (n > 999999)
+            return 0;
+    }
+    if (fn[i] != '\0')
+        return 0;
+    *hash = h;
+    *suffix = n;
+    return 1;
+}
+
+/*
+ * List |dir| and return the index of its certificate and CRL files, or NULL
+ * if the directory cannot be read.  Like the lookup without an index, only
+ * files with consecutive suffixes starting at 0 are used.
+ */
+static STACK_OF(BY_DIR_NAME) *by_dir_list(const char *dir)
+{
+    OPENSSL_DIR_CTX *d = NULL;
+    STACK_OF(BY_DIR_NAME) *files = sk_BY_DIR_NAME_new(by_dir_file_cmp);
+    STACK_OF(BY_DIR_NAME) *names = sk_BY_DIR_NAME_new(by_dir_name_cmp);
+    BY_DIR_NAME *file, *name = NULL;
+    const char *fn;
+    int i;
+
+    if (files == NULL || names == NULL)
+        goto err;
+
+    errno = 0;
+    while ((fn = OPENSSL_DIR_read(&d, dir)) != NULL) {
+        unsigned long hash;
+        int crl, suffix;
+
+        if (!by_dir_parse_name(fn, &hash, &crl, &suffix))
+            continue;
+        if ((file = OPENSSL_zalloc(sizeof(*file))) == NULL)
+            goto err;
+        file->hash = hash;
+        file->crl = crl;
+        file->count = suffix;
+        if (!sk_BY_DIR_NAME_push(files, file)) {
+            OPENSSL_free(file);
+            goto err;
+        }
+    }
+    if (errno != 0)
+        goto err;
+
+    /* Collapse the files of each hash into one entry */
+    sk_BY_DIR_NAME_sort(files);
+    for (i = 0; i < sk_BY_DIR_NAME_num(files); i++) {
+        file = sk_BY_DIR_NAME_value(files, i);
+        if (name == NULL || name->hash != file->hash
+                || name->crl != file->crl) {
+            if ((name = OPENSSL_zalloc(sizeof(*name))) == NULL)
+                goto err;
+            name->hash = file->hash;
+            name->crl = file->crl;
+            if (!sk_BY_DIR_NAME_push(names, name)) {
+                OPENSSL_free(name);
+                goto err;
+            }
+        }
+        if (file->count == name->count)
+            name->count++;
+    }
+    /* Sort now, so that lookups under the read lock do not have to */
+    sk_BY_DIR_NAME_sort(names);
+    sk_BY_DIR_NAME_pop_free(files, by_dir_name_free);
+    if (d != NULL)
+        OPENSSL_DIR_end(&d);
+    return names;
+
+ err:
+    sk_BY_DIR_NAME_pop_free(files, by_dir_name_free);
+    sk_BY_DIR_NAME_pop_free(names, by_dir_name_free);
+    if (d != NULL)
+        OPENSSL_DIR_end(&d);
+    return NULL;
+}
+
+/*
+ * Bring the index of |ent| up to date.  The index is trusted for the TTL of
+ * the lookup, after that the modification time of the directory is checked
+ * and the directory is listed again if it changed.  Returns 1 if the index
+ * can be used and 0 if files have to be probed one by one instead.
+ */
+static int by_dir_refresh(BY_DIR *ctx, BY_DIR_ENTRY *ent)
+{
+    STACK_OF(BY_DIR_NAME) *names;
+    struct stat st;
+    time_t now = time(NULL);
+    int fresh;
+
+    CRYPTO_THREAD_read_lock(ctx->lock);
+    fresh = ent->names != NULL && now - ent->checked < ctx->ttl;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    if (fresh)
+        return 1;
+
+    if (stat(ent->dir, &st) < 0)
+        return 0;
+
+    /*
+     * Changes made within the second the index was built may not show in
+     * the modification time, so such an index is not trusted.
+     */
+    CRYPTO_THREAD_write_lock(ctx->lock);
+    if (ent->names != NULL && st.st_mtime == ent->mtime
+            && ent->mtime < ent->built) {
+        ent->checked = now;
+        CRYPTO_THREAD_unlock(ctx->lock);
+        return 1;
+    }
+    CRYPTO_THREAD_unlock(ctx->lock);
+
+    if ((names = by_dir_list(ent->dir)) == NULL)
+        return 0;
+
+    CRYPTO_THREAD_write_lock(ctx->lock);
+    sk_BY_DIR_NAME_pop_free(ent->names, by_dir_name_free);
+    ent->names = names;
+    ent->mtime = st.st_mtime;
+    ent->built = ent->checked = now;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    return 1;
+}
+#endif
+
+/*
+ * Load the files for hash |h| from |ent| starting with suffix |k|, up to but
+ * not including |last|, or, if |last| is negative, until a file is missing.
+ * Returns the suffix after the last file loaded.
+ */
+static int by_dir_load(X509_LOOKUP *xl, BY_DIR_ENTRY *ent, BUF_MEM *b,
+                       X509_LOOKUP_TYPE type, unsigned long h, int k, int last)
+{
+    const char *postfix = type == X509_LU_CRL ? "r" : "";
+
+    for (; last < 0 || k < last; k++) {
+        char c = '/';
+#ifdef OPENSSL_SYS_VMS
+        c = ent->dir[strlen(ent->dir) - 1];
+        if (c != ':' && c != '>' && c != ']') {
+            /*
+             * If no separator is present, we assume the directory
+             * specifier is a logical name, and add a colon.  We really
+             * should use better VMS routines for merging things like
+             * this, but this will do for now... -- Richard Levitte
+             */
+            c = ':';
+        } else {
+            c = '\0';
+        }
+#endif
+        if (c == '\0') {
+            /*
+             * This is special.  When c == '\0', no directory separator
+             * should be added.
+             */
+            BIO_snprintf(b->data, b->max,
+                         "%s%08lx.%s%d", ent->dir, h, postfix, k);
+        } else {
+            BIO_snprintf(b->data, b->max,
+                         "%s%c%08lx.%s%d", ent->dir, c, h, postfix, k);
+        }
+#ifndef OPENSSL_NO_POSIX_IO
+        if (last < 0) {
+            struct stat st;
+            if (stat(b->data, &st) < 0)
+                break;
+        }
+#endif
+        /* found one. */
+        if (type == X509_LU_X509) {
+            if ((X509_load_cert_file(xl, b->data, ent->dir_type)) == 0)
+                break;
+        } else if (type == X509_LU_CRL) {
+            if ((X509_load_crl_file(xl, b->data, ent->dir_type)) == 0)
+                break;
+        }
+        /* else case will caught higher up */
+    }
+    return k;
+}
+
 static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
                                X509_NAME *name, X509_OBJECT *ret)
 {
     BY_DIR *ctx;
-    union {
-        X509 st_x509;
-        X509_CRL crl;
-    } data;
     int ok = 0;
     int i, j, k;
     unsigned long h;
     BUF_MEM *b = NULL;
-    X509_OBJECT stmp, *tmp;
-    const char *postfix = "";
+    X509_OBJECT *tmp;
 
     if (name == NULL)
         return 0;
 
-    stmp.type = type;
-    if (type == X509_LU_X509) {
-        data.st_x509.cert_info.subject = name;
-        stmp.data.x509 = &data.st_x509;
-        postfix = "";
-    } else if (type == X509_LU_CRL) {
-        data.crl.crl.issuer = name;
-        stmp.data.crl = &data.crl;
-        postfix = "r";
-    } else {
+    if (type != X509_LU_X509 && type != X509_LU_CRL) {
         X509err(X509_F_GET_CERT_BY_SUBJECT, X509_R_WRONG_LOOKUP_TYPE);
         goto finish;
     }
@@ -259,6 +519,45 @@ static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
             X509err(X509_F_GET_CERT_BY_SUBJECT, ERR_R_MALLOC_FAILURE);
             goto finish;
         }
+
+#ifdef BY_DIR_INDEX
+        if (by_dir_refresh(ctx, ent)) {
+            BY_DIR_NAME ntmp, *nent;
+            int last;
+
+            /*
+             * Only files not yet loaded since the directory was last listed
+             * are parsed, and that happens without holding the lock.
+             */
+            ntmp.hash = h;
+            ntmp.crl = type == X509_LU_CRL;
+            CRYPTO_THREAD_read_lock(ctx->lock);
+            idx = sk_BY_DIR_NAME_find(ent->names, &ntmp);
+            nent = sk_BY_DIR_NAME_value(ent->names, idx);
+            k = nent != NULL ? nent->loaded : 0;
+            last = nent != NULL ? nent->count : 0;
+            CRYPTO_THREAD_unlock(ctx->lock);
+
+            if (k < last) {
+                by_dir_load(xl, ent, b, type, h, k, last);
+
+                /*
+                 * Files that failed to load are not retried either until
+                 * the directory changes.
+                 */
+                CRYPTO_THREAD_write_lock(ctx->lock);
+                idx = sk_BY_DIR_NAME_find(ent->names, &ntmp);
+                nent = sk_BY_DIR_NAME_value(ent->names, idx);
+                if (nent != NULL && nent->loaded < last && nent->count == last)
+                    nent->loaded = last;
+                CRYPTO_THREAD_unlock(ctx->lock);
+            } else if (last == 0) {
+                continue;
+            }
+            goto pull;
+        }
+#endif
+
         if (type == X509_LU_CRL && ent->hashes) {
             htmp.hash = h;
             CRYPTO_THREAD_read_lock(ctx->lock);
@@ -275,62 +574,7 @@ static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
             k = 0;
             hent = NULL;
         }
-        for (;;) {
-            char c = '/';
-#ifdef OPENSSL_SYS_VMS
-            c = ent->dir[strlen(ent->dir) - 1];
-            if (c != ':' && c != '>' && c != ']') {
-                /*
-                 * If no separator is present, we assume the directory
-                 * specifier is a logical name, and add a colon.  We really
-                 * should use better VMS routines for merging things like
-                 * this, but this will do for now... -- Richard Levitte
-                 */
-                c = ':';
-            } else {
-                c = '\0';
-            }
-#endif
-            if (c == '\0') {
-                /*
-                 * This is special.  When c == '\0', no directory separator
-                 * should be added.
-                 */
-                BIO_snprintf(b->data, b->max,
-                             "%s%08lx.%s%d", ent->dir, h, postfix, k);
-            } else {
-                BIO_snprintf(b->data, b->max,
-                             "%s%c%08lx.%s%d", ent->dir, c, h, postfix, k);
-            }
-#ifndef OPENSSL_NO_POSIX_IO
-# ifdef _WIN32
-#  define stat _stat
-# endif
-            {
-                struct stat st;
-                if (stat(b->data, &st) < 0)
-                    break;
-            }
-#endif
-            /* found one. */
-            if (type == X509_LU_X509) {
-                if ((X509_load_cert_file(xl, b->data, ent->dir_type)) == 0)
-                    break;
-            } else if (type == X509_LU_CRL) {
-                if ((X509_load_crl_file(xl, b->data, ent->dir_type)) == 0)
-                    break;
-            }
-            /* else case will caught higher up */
-            k++;
-        }
-
-        /*
-         * we have added it to the cache so now pull it out again
-         */
-        X509_STORE_lock(xl->store_ctx);
-        j = sk_X509_OBJECT_find(xl->store_ctx->objs, &stmp);
-        tmp = sk_X509_OBJECT_value(xl->store_ctx->objs, j);
-        X509_STORE_unlock(xl->store_ctx);
+        k = by_dir_load(xl, ent, b, type, h, k, -1);
 
         /* If a CRL, update the last file suffix added for this */
 
@@ -370,6 +614,16 @@ static int get_cert_by_subject(X509_LOOKUP *xl, X509_LOOKUP_TYPE type,
 
         }
 
+#ifdef BY_DIR_INDEX
+ pull:
+#endif
+        /*
+         * we have added it to the cache so now pull it out again
+         */
+        x509_store_read_lock(xl->store_ctx);
+        tmp = x509_store_get0_by_subject(xl->store_ctx, type, name);
+        X509_STORE_unlock(xl->store_ctx);
+
         if (tmp != NULL) {
             ok = 1;
             ret->type = tmp->type;
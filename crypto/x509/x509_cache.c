@@ -0,0 +1,388 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <string.h>
+#include <time.h>
+#include "internal/cryptlib.h"
+#include <openssl/lhash.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+#include "internal/x509_int.h"
+#include "x509_lcl.h"
+
+/*
+ * Cache of successfully verified chains.  Entries are keyed by a SHA-256
+ * digest over the target certificate, the untrusted certificates supplied
+ * by the caller and the verification parameters, so that a hit implies
+ * that X509_verify_cert() would build and accept the same chain again.
+ * Entries live until the cache TTL runs out or the first certificate in
+ * the chain expires, whichever comes first.  The least recently used
+ * entry is evicted when the cache is full.
+ */
+
+typedef struct x509_chain_entry_st X509_CHAIN_ENTRY;
+
+struct x509_chain_entry_st {
+    unsigned char key[X509_CHAIN_CACHE_KEY_LEN];
+    STACK_OF(X509) *chain;
+    int num_untrusted;
+    time_t expires;
+    /* Least recently used list, most recently used first */
+    X509_CHAIN_ENTRY *prev, *next;
+};
+
+DEFINE_LHASH_OF(X509_CHAIN_ENTRY);
+
+struct x509_chain_cache_st {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(X509_CHAIN_ENTRY) *entries;
+    X509_CHAIN_ENTRY *head, *tail;
+    size_t num, max;
+    long ttl;
+    unsigned long hits, misses;
+};
+
+static unsigned long chain_entry_hash(const X509_CHAIN_ENTRY *a)
+{
+    unsigned long h;
+
+    /* The key is a digest, so any part of it hashes well */
+    memcpy(&h, a->key, sizeof(h));
+    return h;
+}
+
+static int chain_entry_cmp(const X509_CHAIN_ENTRY *a, const X509_CHAIN_ENTRY *b)
+{
+    return memcmp(a->key, b->key, sizeof(a->key));
+}
+
+static void chain_entry_free(X509_CHAIN_ENTRY *e)
+{
+    sk_X509_pop_free(e->chain, X509_free);
+    OPENSSL_free(e);
+}
+
+static void chain_cache_unlink(X509_CHAIN_CACHE *cache, X509_CHAIN_ENTRY *e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        cache->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        cache->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void chain_cache_link(X509_CHAIN_CACHE *cache, X509_CHAIN_ENTRY *e)
+{
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head != NULL)
+        cache->head->prev = e;
+    else
+        cache->tail = e;
+    cache->head = e;
+}
+
+static void chain_cache_remove(X509_CHAIN_CACHE *cache, X509_CHAIN_ENTRY *e)
+{
+    chain_cache_unlink(cache, e);
+    (void)lh_X509_CHAIN_ENTRY_delete(cache->entries, e);
+    cache->num--;
+    chain_entry_free(e);
+}
+
+/* Called with the write lock held */
+static void chain_cache_trim(X509_CHAIN_CACHE *cache, size_t max)
+{
+    while (cache->num > max && cache->tail != NULL)
+        chain_cache_remove(cache, cache->tail);
+}
+
+static X509_CHAIN_CACHE *chain_cache_new(void)
+{
+    X509_CHAIN_CACHE *cache = OPENSSL_zalloc(sizeof(*cache));
+
+    if (cache == NULL)
+        return NULL;
+    if ((cache->lock = CRYPTO_THREAD_lock_new()) == NULL
+        || (cache->entries = lh_X509_CHAIN_ENTRY_new(chain_entry_hash,
+                                                     chain_entry_cmp)) == NULL) {
+        x509_chain_cache_free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void x509_chain_cache_free(X509_CHAIN_CACHE *cache)
+{
+    if (cache == NULL)
+        return;
+    chain_cache_trim(cache, 0);
+    lh_X509_CHAIN_ENTRY_free(cache->entries);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+static int digest_cert(SHA256_CTX *sha, X509 *x)
+{
+    unsigned char *der = NULL;
+    int len = i2d_X509(x, &der);
+
+    if (len <= 0)
+        return 0;
+    SHA256_Update(sha, der, len);
+    OPENSSL_free(der);
+    return 1;
+}
+
+static void digest_len(SHA256_CTX *sha, size_t len)
+{
+    unsigned char buf[4];
+
+    buf[0] = (unsigned char)(len >> 24);
+    buf[1] = (unsigned char)(len >> 16);
+    buf[2] = (unsigned char)(len >> 8);
+    buf[3] = (unsigned char)len;
+    SHA256_Update(sha, buf, sizeof(buf));
+}
+
+static void digest_bytes(SHA256_CTX *sha, const void *data, size_t len)
+{
+    digest_len(sha, len);
+    if (len > 0)
+        SHA256_Update(sha, data, len);
+}
+
+static void digest_param(SHA256_CTX *sha, const X509_VERIFY_PARAM *vpm)
+{
+    int i;
+
+    digest_len(sha, vpm->flags);
+    digest_len(sha, (size_t)vpm->purpose);
+    digest_len(sha, (size_t)vpm->trust);
+    digest_len(sha, (size_t)vpm->depth);
+    digest_len(sha, (size_t)vpm->auth_level);
+    digest_len(sha, vpm->hostflags);
+    if ((vpm->flags & X509_V_FLAG_USE_CHECK_TIME) != 0)
+        digest_bytes(sha, &vpm->check_time, sizeof(vpm->check_time));
+    digest_len(sha, sk_OPENSSL_STRING_num(vpm->hosts));
+    for (i = 0; i < sk_OPENSSL_STRING_num(vpm->hosts); i++) {
+        const char *host = sk_OPENSSL_STRING_value(vpm->hosts, i);
+
+        digest_bytes(sha, host, strlen(host));
+    }
+    digest_bytes(sha, vpm->email, vpm->email != NULL ? vpm->emaillen : 0);
+    digest_bytes(sha, vpm->ip, vpm->ip != NULL ? vpm->iplen : 0);
+}
+
+/*
+ * Compute the cache key for the verification set up in |ctx|.  Returns 0 if
+ * the store has no chain cache or the result of this verification must not
+ * be cached: revocation and policy checks depend on more than the inputs
+ * that go into the key.
+ */
+int x509_chain_cache_key(X509_STORE_CTX *ctx, unsigned char *key)
+{
+    const X509_VERIFY_PARAM *vpm = ctx->param;
+    SHA256_CTX sha;
+    int i;
+
+    if (ctx->store == NULL || ctx->store->chain_cache == NULL)
+        return 0;
+    if ((vpm->flags & (X509_V_FLAG_CRL_CHECK | X509_V_FLAG_POLICY_CHECK
+                       | X509_V_FLAG_EXPLICIT_POLICY
+                       | X509_V_FLAG_INHIBIT_ANY
+                       | X509_V_FLAG_INHIBIT_MAP)) != 0
+        || vpm->policies != NULL)
+        return 0;
+
+    SHA256_Init(&sha);
+    if (!digest_cert(&sha, ctx->cert))
+        return 0;
+    digest_len(&sha, sk_X509_num(ctx->untrusted));
+    for (i = 0; i < sk_X509_num(ctx->untrusted); i++)
+        if (!digest_cert(&sha, sk_X509_value(ctx->untrusted, i)))
+            return 0;
+    digest_param(&sha, vpm);
+    SHA256_Final(key, &sha);
+    return 1;
+}
+
+/*
+ * Look up a chain for |key|.  On a hit returns a copy of the cached chain,
+ * with references to its certificates, and sets |*num_untrusted|.
+ */
+STACK_OF(X509) *x509_chain_cache_get(X509_STORE *store,
+                                     const unsigned char *key,
+                                     int *num_untrusted)
+{
+    X509_CHAIN_CACHE *cache = store->chain_cache;
+    X509_CHAIN_ENTRY tmp, *e;
+    STACK_OF(X509) *chain = NULL;
+
+    memcpy(tmp.key, key, sizeof(tmp.key));
+    CRYPTO_THREAD_write_lock(cache->lock);
+    if (cache->max == 0) {
+        CRYPTO_THREAD_unlock(cache->lock);
+        return NULL;
+    }
+    e = lh_X509_CHAIN_ENTRY_retrieve(cache->entries, &tmp);
+    if (e != NULL && e->expires <= time(NULL)) {
+        chain_cache_remove(cache, e);
+        e = NULL;
+    }
+    if (e != NULL && (chain = X509_chain_up_ref(e->chain)) != NULL) {
+        *num_untrusted = e->num_untrusted;
+        chain_cache_unlink(cache, e);
+        chain_cache_link(cache, e);
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    CRYPTO_THREAD_unlock(cache->lock);
+    return chain;
+}
+
+/*
+ * Remember the chain of a successful verification under |key|.  Failures to
+ * add an entry are not errors, the next verification simply misses again.
+ */
+void x509_chain_cache_put(X509_STORE_CTX *ctx, const unsigned char *key)
+{
+    X509_CHAIN_CACHE *cache = ctx->store->chain_cache;
+    X509_CHAIN_ENTRY *e, *old;
+    time_t now = time(NULL);
+    long lifetime;
+    int i;
+
+    CRYPTO_THREAD_read_lock(cache->lock);
+    lifetime = cache->ttl;
+    i = cache->max != 0;
+    CRYPTO_THREAD_unlock(cache->lock);
+    if (!i)
+        return;
+
+    /*
+     * Unless the validity period is ignored or evaluated at a fixed time,
+     * the chain is only good until its first certificate expires.
+     */
+    if ((ctx->param->flags
+         & (X509_V_FLAG_USE_CHECK_TIME | X509_V_FLAG_NO_CHECK_TIME)) == 0) {
+        for (i = 0; i < sk_X509_num(ctx->chain); i++) {
+            const ASN1_TIME *na = X509_get0_notAfter(sk_X509_value(ctx->chain,
+                                                                   i));
+            int days, secs;
+
+            if (!ASN1_TIME_diff(&days, &secs, NULL, na))
+                return;
+            if (days < 0 || secs < 0)
+                return;
+            if (days <= lifetime / 86400
+                && (long)days * 86400 + secs < lifetime)
+                lifetime = (long)days * 86400 + secs;
+        }
+    }
+    if (lifetime <= 0)
+        return;
+
+    if ((e = OPENSSL_zalloc(sizeof(*e))) == NULL)
+        return;
+    memcpy(e->key, key, sizeof(e->key));
+    e->num_untrusted = ctx->num_untrusted;
+    e->expires = now + lifetime;
+    if ((e->chain = X509_chain_up_ref(ctx->chain)) == NULL) {
+        OPENSSL_free(e);
+        return;
+    }
+
+    CRYPTO_THREAD_write_lock(cache->lock);
+    if (cache->max == 0) {
+        CRYPTO_THREAD_unlock(cache->lock);
+        chain_entry_free(e);
+        return;
+    }
+    if ((old = lh_X509_CHAIN_ENTRY_retrieve(cache->entries, e)) != NULL)
+        chain_cache_remove(cache, old);
+    chain_cache_trim(cache, cache->max - 1);
+    (void)lh_X509_CHAIN_ENTRY_insert(cache->entries, e);
+    if (lh_X509_CHAIN_ENTRY_error(cache->entries)) {
+        CRYPTO_THREAD_unlock(cache->lock);
+        chain_entry_free(e);
+        return;
+    }
+    chain_cache_link(cache, e);
+    cache->num++;
+    CRYPTO_THREAD_unlock(cache->lock);
+}
+
+void x509_chain_cache_flush(X509_CHAIN_CACHE *cache)
+{
+    if (cache == NULL)
+        return;
+    CRYPTO_THREAD_write_lock(cache->lock);
+    chain_cache_trim(cache, 0);
+    CRYPTO_THREAD_unlock(cache->lock);
+}
+
+int X509_STORE_set_chain_cache(X509_STORE *ctx, size_t max_entries, long ttl)
+{
+    X509_CHAIN_CACHE *cache = ctx->chain_cache;
+
+    if (max_entries > 0 && ttl <= 0) {
+        X509err(0, ERR_R_PASSED_INVALID_ARGUMENT);
+        return 0;
+    }
+    if (cache == NULL) {
+        if (max_entries == 0)
+            return 1;
+        if ((cache = chain_cache_new()) == NULL) {
+            X509err(0, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        ctx->chain_cache = cache;
+    }
+
+    CRYPTO_THREAD_write_lock(cache->lock);
+    cache->max = max_entries;
+    cache->ttl = ttl;
+    chain_cache_trim(cache, max_entries);
+    CRYPTO_THREAD_unlock(cache->lock);
+    return 1;
+}
+
+void X509_STORE_flush_chain_cache(X509_STORE *ctx)
+{
+    x509_chain_cache_flush(ctx->chain_cache);
+}
+
+static unsigned long chain_cache_stat(X509_STORE *ctx, int misses)
+{
+    X509_CHAIN_CACHE *cache = ctx->chain_cache;
+    unsigned long ret;
+
+    if (cache == NULL)
+        return 0;
+    CRYPTO_THREAD_read_lock(cache->lock);
+    ret = misses ? cache->misses : cache->hits;
+    CRYPTO_THREAD_unlock(cache->lock);
+    return ret;
+}
+
+unsigned long X509_STORE_get_chain_cache_hits(X509_STORE *ctx)
+{
+    return chain_cache_stat(ctx, 0);
+}
+
+unsigned long X509_STORE_get_chain_cache_misses(X509_STORE *ctx)
+{
+    return chain_cache_stat(ctx, 1);
+}
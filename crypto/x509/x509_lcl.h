@@ -97,6 +97,10 @@ struct x509_lookup_st {
     X509_STORE *store_ctx;      /* who owns us */
 };
 
+typedef struct x509_chain_cache_st X509_CHAIN_CACHE;
+typedef struct x509_store_bucket_st X509_STORE_BUCKET;
+DEFINE_LHASH_OF(X509_STORE_BUCKET);
+
 /*
  * This is used to hold everything.  It is used for all certificate
  * validation.  Once we have a certificate chain, the 'verify' function is
@@ -106,6 +110,9 @@ struct x509_store_st {
     /* The following is a cache of trusted certs */
     int cache;                  /* if true, stash any hits */
     STACK_OF(X509_OBJECT) *objs; /* Cache of all objects */
+    /* Hash index of |objs| by name and subject key identifier */
+    LHASH_OF(X509_STORE_BUCKET) *index;
+    int index_num;              /* Number of |objs| covered by |index| */
     /* These are external lookup methods */
     STACK_OF(X509_LOOKUP) *get_cert_methods;
     X509_VERIFY_PARAM *param;
@@ -134,6 +141,8 @@ struct x509_store_st {
     CRYPTO_EX_DATA ex_data;
     CRYPTO_REF_COUNT references;
     CRYPTO_RWLOCK *lock;
+    /* Verified chains, see X509_STORE_set_chain_cache() */
+    X509_CHAIN_CACHE *chain_cache;
 };
 
 typedef struct lookup_dir_hashes_st BY_DIR_HASH;
@@ -145,3 +154,18 @@ DEFINE_STACK_OF(STACK_OF_X509_NAME_ENTRY)
 
 void x509_set_signature_info(X509_SIG_INFO *siginf, const X509_ALGOR *alg,
                              const ASN1_STRING *sig);
+
+int x509_store_read_lock(X509_STORE *store);
+X509_OBJECT *x509_store_get0_by_subject(X509_STORE *store,
+                                        X509_LOOKUP_TYPE type,
+                                        X509_NAME *name);
+
+#define X509_CHAIN_CACHE_KEY_LEN        32
+
+int x509_chain_cache_key(X509_STORE_CTX *ctx, unsigned char *key);
+STACK_OF(X509) *x509_chain_cache_get(X509_STORE *store,
+                                     const unsigned char *key,
+                                     int *num_untrusted);
+void x509_chain_cache_put(X509_STORE_CTX *ctx, const unsigned char *key);
+void x509_chain_cache_flush(X509_CHAIN_CACHE *cache);
+void x509_chain_cache_free(X509_CHAIN_CACHE *cache);
@@ -157,6 +157,254 @@ static int x509_object_cmp(const X509_OBJECT *const *a,
     return ret;
 }
 
+/*
+ * Index of the objects in a store.  Certificates are indexed by subject name
+ * and, if they have one, by subject key identifier, CRLs by issuer name.  A
+ * bucket holds its own references to all objects with the same key, in the
+ * order they were added, so lookups need neither a sorted |objs| stack nor
+ * the write lock.
+ */
+
+#define X509_STORE_IDX_SKID     (X509_LU_CRL + 1)
+
+struct x509_store_bucket_st {
+    int kind;                   /* X509_LU_X509, X509_LU_CRL or SKID */
+    unsigned char *key;
+    int keylen;
+    unsigned long hash;
+    STACK_OF(X509_OBJECT) *objs;
+};
+
+static unsigned long x509_store_bucket_hash(const X509_STORE_BUCKET *a)
+{
+    return a->hash;
+}
+
+static int x509_store_bucket_cmp(const X509_STORE_BUCKET *a,
+                                 const X509_STORE_BUCKET *b)
+{
+    if (a->kind != b->kind)
+        return a->kind - b->kind;
+    if (a->keylen != b->keylen)
+        return a->keylen - b->keylen;
+    return a->keylen == 0 ? 0 : memcmp(a->key, b->key, a->keylen);
+}
+
+static void x509_store_bucket_free(X509_STORE_BUCKET *b)
+{
+    sk_X509_OBJECT_pop_free(b->objs, X509_OBJECT_free);
+    OPENSSL_free(b->key);
+    OPENSSL_free(b);
+}
+
+/* Set up |b| as a template for the key, pointing at but not copying it */
+static void x509_store_bucket_key(X509_STORE_BUCKET *b, int kind,
+                                  const unsigned char *key, int keylen)
+{
+    unsigned long h = 2166136261UL ^ (unsigned long)kind;
+    int i;
+
+    /* FNV-1a */
+    for (i = 0; i < keylen; i++)
+        h = ((h ^ key[i]) * 16777619UL) & 0xffffffffUL;
+    b->kind = kind;
+    b->key = (unsigned char *)key;
+    b->keylen = keylen;
+    b->hash = h;
+}
+
+/* The key of a name is its canonical encoding, as used by X509_NAME_cmp() */
+static int x509_store_name_key(X509_STORE_BUCKET *b, X509_LOOKUP_TYPE type,
+                               X509_NAME *name)
+{
+    if ((name->canon_enc == NULL || name->modified)
+            && i2d_X509_NAME(name, NULL) < 0)
+        return 0;
+    x509_store_bucket_key(b, type, name->canon_enc, name->canon_enclen);
+    return 1;
+}
+
+static int x509_store_index_add1(LHASH_OF(X509_STORE_BUCKET) *index,
+                                 X509_STORE_BUCKET *tmpl, X509_OBJECT *obj)
+{
+    X509_STORE_BUCKET *b = lh_X509_STORE_BUCKET_retrieve(index, tmpl);
+    X509_OBJECT *copy = X509_OBJECT_new();
+
+    if (copy == NULL)
+        return 0;
+    copy->type = obj->type;
+    copy->data = obj->data;
+    X509_OBJECT_up_ref_count(copy);
+
+    if (b == NULL) {
+        if ((b = OPENSSL_zalloc(sizeof(*b))) == NULL
+                || (b->objs = sk_X509_OBJECT_new_null()) == NULL
+                || (tmpl->keylen > 0
+                    && (b->key = OPENSSL_memdup(tmpl->key,
+                                                tmpl->keylen)) == NULL))
+            goto err;
+        b->kind = tmpl->kind;
+        b->keylen = tmpl->keylen;
+        b->hash = tmpl->hash;
+        (void)lh_X509_STORE_BUCKET_insert(index, b);
+        if (lh_X509_STORE_BUCKET_error(index))
+            goto err;
+    }
+    if (!sk_X509_OBJECT_push(b->objs, copy)) {
+        X509_OBJECT_free(copy);
+        return 0;
+    }
+    return 1;
+
+ err:
+    if (b != NULL)
+        x509_store_bucket_free(b);
+    X509_OBJECT_free(copy);
+    return 0;
+}
+
+static int x509_store_index_add(LHASH_OF(X509_STORE_BUCKET) *index,
+                                X509_OBJECT *obj)
+{
+    X509_STORE_BUCKET tmpl;
+    X509 *x;
+
+    switch (obj->type) {
+    case X509_LU_X509:
+        x = obj->data.x509;
+        if (!x509_store_name_key(&tmpl, X509_LU_X509,
+                                 X509_get_subject_name(x))
+                || !x509_store_index_add1(index, &tmpl, obj))
+            return 0;
+        /* Caches the extensions, including the SKID */
+        X509_check_purpose(x, -1, 0);
+        if (x->skid != NULL && x->skid->length > 0) {
+            x509_store_bucket_key(&tmpl, X509_STORE_IDX_SKID,
+                                  x->skid->data, x->skid->length);
+            if (!x509_store_index_add1(index, &tmpl, obj))
+                return 0;
+        }
+        return 1;
+    case X509_LU_CRL:
+        return x509_store_name_key(&tmpl, X509_LU_CRL,
+                                   X509_CRL_get_issuer(obj->data.crl))
+               && x509_store_index_add1(index, &tmpl, obj);
+    case X509_LU_NONE:
+        break;
+    }
+    return 1;
+}
+
+static void x509_store_index_free(LHASH_OF(X509_STORE_BUCKET) *index)
+{
+    lh_X509_STORE_BUCKET_doall(index, x509_store_bucket_free);
+    lh_X509_STORE_BUCKET_free(index);
+}
+
+/*
+ * Bring the index up to date with |objs| after the application changed the
+ * stack returned by X509_STORE_get0_objects() directly.  Objects added with
+ * X509_STORE_add_cert() and X509_STORE_add_crl() are indexed as they are
+ * added.  Must be called with the write lock held.
+ */
+static int x509_store_index_sync(X509_STORE *store)
+{
+    LHASH_OF(X509_STORE_BUCKET) *index;
+    int i, num = sk_X509_OBJECT_num(store->objs);
+
+    if (store->index_num == num)
+        return 1;
+    if ((index = lh_X509_STORE_BUCKET_new(x509_store_bucket_hash,
+                                          x509_store_bucket_cmp)) == NULL)
+        return 0;
+    for (i = 0; i < num; i++) {
+        if (!x509_store_index_add(index,
+                                  sk_X509_OBJECT_value(store->objs, i))) {
+            x509_store_index_free(index);
+            return 0;
+        }
+    }
+    x509_store_index_free(store->index);
+    store->index = index;
+    store->index_num = num;
+    return 1;
+}
+
+/*
+ * Take the store lock for reading, first updating the index if needed.
+ * Lookups through the index can then run concurrently.
+ */
+int x509_store_read_lock(X509_STORE *store)
+{
+    if (!CRYPTO_THREAD_read_lock(store->lock))
+        return 0;
+    if (store->index_num == sk_X509_OBJECT_num(store->objs))
+        return 1;
+    CRYPTO_THREAD_unlock(store->lock);
+
+    if (!X509_STORE_lock(store))
+        return 0;
+    x509_store_index_sync(store);
+    X509_STORE_unlock(store);
+    return CRYPTO_THREAD_read_lock(store->lock);
+}
+
+static STACK_OF(X509_OBJECT) *x509_store_get0_bucket(X509_STORE *store,
+                                                     X509_STORE_BUCKET *tmpl)
+{
+    X509_STORE_BUCKET *b = lh_X509_STORE_BUCKET_retrieve(store->index, tmpl);
+
+    return b != NULL ? b->objs : NULL;
+}
+
+static STACK_OF(X509_OBJECT) *x509_store_get0_by_name(X509_STORE *store,
+                                                      X509_LOOKUP_TYPE type,
+                                                      X509_NAME *name)
+{
+    X509_STORE_BUCKET tmpl;
+
+    if (!x509_store_name_key(&tmpl, type, name))
+        return NULL;
+    return x509_store_get0_bucket(store, &tmpl);
+}
+
+/*
+ * Return the first object of |type| with the subject or issuer |name|.  The
+ * store lock must be held, the object is only valid while it is.
+ */
+X509_OBJECT *x509_store_get0_by_subject(X509_STORE *store,
+                                        X509_LOOKUP_TYPE type,
+                                        X509_NAME *name)
+{
+    return sk_X509_OBJECT_value(x509_store_get0_by_name(store, type, name), 0);
+}
+
+/* Return the indexed object equal to |obj|.  The store lock must be held. */
+static X509_OBJECT *x509_store_index_match(X509_STORE *store, X509_OBJECT *obj)
+{
+    STACK_OF(X509_OBJECT) *objs;
+    X509_OBJECT *tmp;
+    int i;
+
+    if (obj->type == X509_LU_X509)
+        objs = x509_store_get0_by_name(store, X509_LU_X509,
+                                       X509_get_subject_name(obj->data.x509));
+    else if (obj->type == X509_LU_CRL)
+        objs = x509_store_get0_by_name(store, X509_LU_CRL,
+                                       X509_CRL_get_issuer(obj->data.crl));
+    else
+        return NULL;
+
+    for (i = 0; i < sk_X509_OBJECT_num(objs); i++) {
+        tmp = sk_X509_OBJECT_value(objs, i);
+        if (obj->type == X509_LU_X509
+                ? X509_cmp(tmp->data.x509, obj->data.x509) == 0
+                : X509_CRL_match(tmp->data.crl, obj->data.crl) == 0)
+            return tmp;
+    }
+    return NULL;
+}
+
 X509_STORE *X509_STORE_new(void)
 {
     X509_STORE *ret = OPENSSL_zalloc(sizeof(*ret));
@@ -169,6 +417,11 @@ X509_STORE *X509_STORE_new(void)
         X509err(X509_F_X509_STORE_NEW, ERR_R_MALLOC_FAILURE);
         goto err;
     }
+    if ((ret->index = lh_X509_STORE_BUCKET_new(x509_store_bucket_hash,
+                                               x509_store_bucket_cmp)) == NULL) {
+        X509err(X509_F_X509_STORE_NEW, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
     ret->cache = 1;
     if ((ret->get_cert_methods = sk_X509_LOOKUP_new_null()) == NULL) {
         X509err(X509_F_X509_STORE_NEW, ERR_R_MALLOC_FAILURE);
@@ -195,6 +448,8 @@ X509_STORE *X509_STORE_new(void)
 
 err:
     X509_VERIFY_PARAM_free(ret->param);
+    if (ret->index != NULL)
+        x509_store_index_free(ret->index);
     sk_X509_OBJECT_free(ret->objs);
     sk_X509_LOOKUP_free(ret->get_cert_methods);
     OPENSSL_free(ret);
@@ -222,10 +477,12 @@ void X509_STORE_free(X509_STORE *vfy)
         X509_LOOKUP_free(lu);
     }
     sk_X509_LOOKUP_free(sk);
+    x509_store_index_free(vfy->index);
     sk_X509_OBJECT_pop_free(vfy->objs, X509_OBJECT_free);
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_X509_STORE, vfy, &vfy->ex_data);
     X509_VERIFY_PARAM_free(vfy->param);
+    x509_chain_cache_free(vfy->chain_cache);
     CRYPTO_THREAD_lock_free(vfy->lock);
     OPENSSL_free(vfy);
 }
@@ -300,30 +557,40 @@ int X509_STORE_CTX_get_by_subject(X509_STORE_CTX *vs, X509_LOOKUP_TYPE type,
     stmp.type = X509_LU_NONE;
     stmp.data.ptr = NULL;
 
-
-    X509_STORE_lock(store);
-    tmp = X509_OBJECT_retrieve_by_subject(store->objs, type, name);
+    if (!x509_store_read_lock(store))
+        return 0;
+    tmp = x509_store_get0_by_subject(store, type, name);
+    if (tmp != NULL && type != X509_LU_CRL) {
+        ret->type = tmp->type;
+        ret->data.ptr = tmp->data.ptr;
+        X509_OBJECT_up_ref_count(ret);
+        X509_STORE_unlock(store);
+        return 1;
+    }
     X509_STORE_unlock(store);
 
-    if (tmp == NULL || type == X509_LU_CRL) {
-        for (i = 0; i < sk_X509_LOOKUP_num(store->get_cert_methods); i++) {
-            lu = sk_X509_LOOKUP_value(store->get_cert_methods, i);
-            j = X509_LOOKUP_by_subject(lu, type, name, &stmp);
-            if (j) {
-                tmp = &stmp;
-                break;
-            }
+    for (i = 0; i < sk_X509_LOOKUP_num(store->get_cert_methods); i++) {
+        lu = sk_X509_LOOKUP_value(store->get_cert_methods, i);
+        j = X509_LOOKUP_by_subject(lu, type, name, &stmp);
+        if (j) {
+            ret->type = stmp.type;
+            ret->data.ptr = stmp.data.ptr;
+            X509_OBJECT_up_ref_count(ret);
+            return 1;
         }
-        if (tmp == NULL)
-            return 0;
     }
 
-    ret->type = tmp->type;
-    ret->data.ptr = tmp->data.ptr;
-
-    X509_OBJECT_up_ref_count(ret);
-
-    return 1;
+    /* A CRL in the store that no lookup method knows about */
+    if (tmp == NULL || !x509_store_read_lock(store))
+        return 0;
+    tmp = x509_store_get0_by_subject(store, type, name);
+    if (tmp != NULL) {
+        ret->type = tmp->type;
+        ret->data.ptr = tmp->data.ptr;
+        X509_OBJECT_up_ref_count(ret);
+    }
+    X509_STORE_unlock(store);
+    return tmp != NULL;
 }
 
 static int x509_store_add(X509_STORE *store, void *x, int crl) {
@@ -346,16 +613,24 @@ static int x509_store_add(X509_STORE *store, void *x, int crl) {
     X509_OBJECT_up_ref_count(obj);
 
     X509_STORE_lock(store);
-    if (X509_OBJECT_retrieve_match(store->objs, obj)) {
+    if (!x509_store_index_sync(store)) {
+        ret = 0;
+    } else if (x509_store_index_match(store, obj)) {
+        ret = 1;
+    } else if ((added = sk_X509_OBJECT_push(store->objs, obj)) != 0) {
+        /* If indexing fails the index is rebuilt by the next lookup */
+        if (x509_store_index_add(store->index, obj))
+            store->index_num++;
+        else
+            store->index_num = -1;
         ret = 1;
-    } else {
-        added = sk_X509_OBJECT_push(store->objs, obj);
-        ret = added != 0;
     }
     X509_STORE_unlock(store);
 
     if (added == 0)             /* obj not pushed */
         X509_OBJECT_free(obj);
+    else                        /* cached chains may no longer be the best */
+        x509_chain_cache_flush(store->chain_cache);
 
     return ret;
 }
@@ -529,18 +804,16 @@ STACK_OF(X509_OBJECT) *X509_STORE_get0_objects(X509_STORE *v)
 
 STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
 {
-    int i, idx, cnt;
+    int i;
     STACK_OF(X509) *sk = NULL;
+    STACK_OF(X509_OBJECT) *objs;
     X509 *x;
-    X509_OBJECT *obj;
     X509_STORE *store = ctx->store;
 
-    if (store == NULL)
+    if (store == NULL || !x509_store_read_lock(store))
         return NULL;
-
-    X509_STORE_lock(store);
-    idx = x509_object_idx_cnt(store->objs, X509_LU_X509, nm, &cnt);
-    if (idx < 0) {
+    objs = x509_store_get0_by_name(store, X509_LU_X509, nm);
+    if (objs == NULL) {
         /*
          * Nothing found in cache: do lookup to possibly add new objects to
          * cache
@@ -556,18 +829,18 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
             return NULL;
         }
         X509_OBJECT_free(xobj);
-        X509_STORE_lock(store);
-        idx = x509_object_idx_cnt(store->objs, X509_LU_X509, nm, &cnt);
-        if (idx < 0) {
+        if (!x509_store_read_lock(store))
+            return NULL;
+        objs = x509_store_get0_by_name(store, X509_LU_X509, nm);
+        if (objs == NULL) {
             X509_STORE_unlock(store);
             return NULL;
         }
     }
 
     sk = sk_X509_new_null();
-    for (i = 0; i < cnt; i++, idx++) {
-        obj = sk_X509_OBJECT_value(store->objs, idx);
-        x = obj->data.x509;
+    for (i = 0; i < sk_X509_OBJECT_num(objs); i++) {
+        x = sk_X509_OBJECT_value(objs, i)->data.x509;
         X509_up_ref(x);
         if (!sk_X509_push(sk, x)) {
             X509_STORE_unlock(store);
@@ -582,33 +855,33 @@ STACK_OF(X509) *X509_STORE_CTX_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
 
 STACK_OF(X509_CRL) *X509_STORE_CTX_get1_crls(X509_STORE_CTX *ctx, X509_NAME *nm)
 {
-    int i, idx, cnt;
+    int i;
     STACK_OF(X509_CRL) *sk = sk_X509_CRL_new_null();
+    STACK_OF(X509_OBJECT) *objs;
     X509_CRL *x;
-    X509_OBJECT *obj, *xobj = X509_OBJECT_new();
+    X509_OBJECT *xobj = X509_OBJECT_new();
     X509_STORE *store = ctx->store;
 
     /* Always do lookup to possibly add new CRLs to cache */
     if (sk == NULL
             || xobj == NULL
             || store == NULL
-            || !X509_STORE_CTX_get_by_subject(ctx, X509_LU_CRL, nm, xobj)) {
+            || !X509_STORE_CTX_get_by_subject(ctx, X509_LU_CRL, nm, xobj)
+            || !x509_store_read_lock(store)) {
         X509_OBJECT_free(xobj);
         sk_X509_CRL_free(sk);
         return NULL;
     }
     X509_OBJECT_free(xobj);
-    X509_STORE_lock(store);
-    idx = x509_object_idx_cnt(store->objs, X509_LU_CRL, nm, &cnt);
-    if (idx < 0) {
+    objs = x509_store_get0_by_name(store, X509_LU_CRL, nm);
+    if (objs == NULL) {
         X509_STORE_unlock(store);
         sk_X509_CRL_free(sk);
         return NULL;
     }
 
-    for (i = 0; i < cnt; i++, idx++) {
-        obj = sk_X509_OBJECT_value(store->objs, idx);
-        x = obj->data.crl;
+    for (i = 0; i < sk_X509_OBJECT_num(objs); i++) {
+        x = sk_X509_OBJECT_value(objs, i)->data.crl;
         X509_CRL_up_ref(x);
         if (!sk_X509_CRL_push(sk, x)) {
             X509_STORE_unlock(store);
@@ -649,6 +922,29 @@ X509_OBJECT *X509_OBJECT_retrieve_match(STACK_OF(X509_OBJECT) *h,
     return NULL;
 }
 
+/*
+ * Look through |objs| for an issuer of |x|.  Returns 2 if one with a valid
+ * time was found, 1 if only others were found, leaving the last of those in
+ * |*issuer| so that the nearest match is returned, and 0 otherwise.
+ */
+static int x509_store_find_issuer(X509_STORE_CTX *ctx, X509 *x,
+                                  STACK_OF(X509_OBJECT) *objs, X509 **issuer)
+{
+    X509 *cand;
+    int i, ret = 0;
+
+    for (i = 0; i < sk_X509_OBJECT_num(objs); i++) {
+        cand = sk_X509_OBJECT_value(objs, i)->data.x509;
+        if (ctx->check_issued(ctx, x, cand)) {
+            *issuer = cand;
+            ret = 1;
+            if (x509_check_cert_time(ctx, cand, -1))
+                return 2;
+        }
+    }
+    return ret;
+}
+
 /*-
  * Try to get issuer certificate from store. Due to limitations
  * of the API this can only retrieve a single certificate matching
@@ -664,9 +960,9 @@ X509_OBJECT *X509_OBJECT_retrieve_match(STACK_OF(X509_OBJECT) *h,
 int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
 {
     X509_NAME *xn;
-    X509_OBJECT *obj = X509_OBJECT_new(), *pobj = NULL;
+    X509_OBJECT *obj = X509_OBJECT_new();
     X509_STORE *store = ctx->store;
-    int i, ok, idx, ret;
+    int ok, ret;
 
     if (obj == NULL)
         return -1;
@@ -691,39 +987,41 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
     if (store == NULL)
         return 0;
 
-    /* Else find index of first cert accepted by 'check_issued' */
+    /*
+     * Else find the first cert accepted by 'check_issued', trying those
+     * with a subject key identifier matching the authority key identifier
+     * of |x| first.
+     */
     ret = 0;
-    X509_STORE_lock(store);
-    idx = X509_OBJECT_idx_by_subject(store->objs, X509_LU_X509, xn);
-    if (idx != -1) {            /* should be true as we've had at least one
-                                 * match */
-        /* Look through all matching certs for suitable issuer */
-        for (i = idx; i < sk_X509_OBJECT_num(store->objs); i++) {
-            pobj = sk_X509_OBJECT_value(store->objs, i);
-            /* See if we've run past the matches */
-            if (pobj->type != X509_LU_X509)
-                break;
-            if (X509_NAME_cmp(xn, X509_get_subject_name(pobj->data.x509)))
-                break;
-            if (ctx->check_issued(ctx, x, pobj->data.x509)) {
-                *issuer = pobj->data.x509;
-                ret = 1;
-                /*
-                 * If times check, exit with match,
-                 * otherwise keep looking. Leave last
-                 * match in issuer so we return nearest
-                 * match if no certificate time is OK.
-                 */
-
-                if (x509_check_cert_time(ctx, *issuer, -1))
-                    break;
-            }
+    X509_check_purpose(x, -1, 0);
+    if (!x509_store_read_lock(store))
+        return -1;
+    if (x->akid != NULL && x->akid->keyid != NULL
+            && x->akid->keyid->length > 0) {
+        X509_STORE_BUCKET tmpl;
+
+        x509_store_bucket_key(&tmpl, X509_STORE_IDX_SKID,
+                              x->akid->keyid->data, x->akid->keyid->length);
+        ret = x509_store_find_issuer(ctx, x,
+                                     x509_store_get0_bucket(store, &tmpl),
+                                     issuer);
+    }
+    if (ret != 2) {
+        X509 *nearest = *issuer;
+
+        ret = x509_store_find_issuer(ctx, x,
+                                     x509_store_get0_by_name(store,
+                                                             X509_LU_X509, xn),
+                                     issuer);
+        if (ret == 0 && nearest != NULL) {
+            *issuer = nearest;
+            ret = 1;
         }
     }
-    X509_STORE_unlock(store);
     if (*issuer)
         X509_up_ref(*issuer);
-    return ret;
+    X509_STORE_unlock(store);
+    return ret != 0;
 }
 
 int X509_STORE_set_flags(X509_STORE *ctx, unsigned long flags)
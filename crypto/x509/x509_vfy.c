@@ -250,10 +250,45 @@ static int verify_chain(X509_STORE_CTX *ctx)
     return ok;
 }
 
+/*
+ * Accept a chain found in the store's chain cache.  The signatures, trust and
+ * validity of the chain were checked when it was added, so all that is left
+ * is to match the peer identity, which also records the matching peername,
+ * and to report success at each depth as internal_verify() would.
+ */
+static int verify_cached_chain(X509_STORE_CTX *ctx, STACK_OF(X509) *chain,
+                               int num_untrusted)
+{
+    int n = sk_X509_num(chain) - 1;
+
+    /* The cached chain may hold a different copy of the target */
+    X509_free(sk_X509_value(chain, 0));
+    X509_up_ref(ctx->cert);
+    (void)sk_X509_set(chain, 0, ctx->cert);
+    sk_X509_pop_free(ctx->chain, X509_free);
+    ctx->chain = chain;
+    ctx->num_untrusted = num_untrusted;
+
+    if (!check_id(ctx))
+        return 0;
+
+    ctx->current_issuer = sk_X509_value(chain, n);
+    for (; n >= 0; n--) {
+        ctx->current_cert = sk_X509_value(chain, n);
+        ctx->error_depth = n;
+        if (!ctx->verify_cb(1, ctx))
+            return 0;
+        ctx->current_issuer = ctx->current_cert;
+    }
+    return 1;
+}
+
 int X509_verify_cert(X509_STORE_CTX *ctx)
 {
     SSL_DANE *dane = ctx->dane;
-    int ret;
+    unsigned char key[X509_CHAIN_CACHE_KEY_LEN];
+    STACK_OF(X509) *cached = NULL;
+    int ret, num_untrusted, cacheable;
 
     if (ctx->cert == NULL) {
         X509err(X509_F_X509_VERIFY_CERT, X509_R_NO_CERT_SET_FOR_US_TO_VERIFY);
@@ -289,11 +324,33 @@ int X509_verify_cert(X509_STORE_CTX *ctx)
         !verify_cb_cert(ctx, ctx->cert, 0, X509_V_ERR_EE_KEY_TOO_SMALL))
         return 0;
 
-    if (DANETLS_ENABLED(dane))
+    /*
+     * Chains built from a caller supplied trusted stack, or found or checked
+     * by any non-default callback, depend on more than the store's chain
+     * cache key covers.
+     */
+    cacheable = !DANETLS_ENABLED(dane)
+        && ctx->get_issuer == X509_STORE_CTX_get1_issuer
+        && ctx->check_issued == check_issued
+        && ctx->lookup_certs == X509_STORE_CTX_get1_certs
+        && ctx->verify == internal_verify
+        && ctx->check_revocation == check_revocation
+        && ctx->get_crl == NULL
+        && ctx->check_policy == check_policy
+        && x509_chain_cache_key(ctx, key);
+    if (cacheable
+        && (cached = x509_chain_cache_get(ctx->store, key,
+                                          &num_untrusted)) != NULL)
+        ret = verify_cached_chain(ctx, cached, num_untrusted);
+    else if (DANETLS_ENABLED(dane))
         ret = dane_verify(ctx);
     else
         ret = verify_chain(ctx);
 
+    /* Only cache chains that verified without any overridden errors */
+    if (cacheable && cached == NULL && ret > 0 && ctx->error == X509_V_OK)
+        x509_chain_cache_put(ctx, key);
+
     /*
      * Safety-net.  If we are returning an error, we must also set ctx->error,
      * so that the chain is not considered verified should the error be ignored
@@ -10,10 +10,17 @@
 #include <stdio.h>
 #include "internal/cryptlib.h"
 #include <openssl/asn1t.h>
+#include <openssl/buffer.h>
+#include <openssl/rand.h>
 #include <openssl/x509.h>
+#include "internal/asn1_int.h"
 #include "internal/x509_int.h"
 #include <openssl/x509v3.h>
 #include "x509_lcl.h"
+#ifndef OPENSSL_NO_SIPHASH
+# include "internal/siphash.h"
+# include "../siphash/siphash_local.h"
+#endif
 
 static int X509_REVOKED_cmp(const X509_REVOKED *const *a,
                             const X509_REVOKED *const *b);
@@ -37,6 +44,21 @@ static X509_CRL_METHOD int_crl_meth = {
     def_crl_verify
 };
 
+#ifndef OPENSSL_NO_SIPHASH
+static int compact_crl_free(X509_CRL *crl);
+static int compact_crl_lookup(X509_CRL *crl,
+                              X509_REVOKED **ret, ASN1_INTEGER *serial,
+                              X509_NAME *issuer);
+
+/* Used by CRLs loaded with d2i_X509_CRL_compact() */
+static X509_CRL_METHOD compact_crl_meth = {
+    0,
+    0, compact_crl_free,
+    compact_crl_lookup,
+    def_crl_verify
+};
+#endif
+
 static const X509_CRL_METHOD *default_crl_method = &int_crl_meth;
 
 /*
@@ -429,6 +451,497 @@ static int def_crl_lookup(X509_CRL *crl,
     return 0;
 }
 
+#ifndef OPENSSL_NO_SIPHASH
+
+/*
+ * A compact CRL keeps the DER encoding of its revoked entries and a hash
+ * table of them keyed by serial number instead of a STACK_OF(X509_REVOKED):
+ * a revoked entry is only decoded when a lookup finds it.  The index is
+ * built before the CRL signature is checked, so serial numbers are hashed
+ * with SipHash under a random key of each index: whoever chose them can't
+ * make them collide.
+ */
+typedef struct crl_index_entry_st {
+    uint64_t prefix;            /* First 8 octets of |serial|, big endian */
+    const unsigned char *serial; /* Without leading zero octets */
+    uint32_t slen;
+    uint32_t offset;            /* Of the entry in |der| */
+} CRL_INDEX_ENTRY;
+
+typedef struct crl_index_st {
+    unsigned char *der;         /* Content of revokedCertificates */
+    size_t len;
+    CRL_INDEX_ENTRY *entries;   /* In CRL order */
+    size_t num;
+    uint32_t *slots;            /* 1 + index in |entries|, or 0 if free */
+    size_t mask;                /* Number of slots - 1 */
+    unsigned char key[SIPHASH_KEY_SIZE];
+    STACK_OF(X509_REVOKED) *decoded;
+} CRL_INDEX;
+
+/* DER encoded content of the certificateIssuer extension OID */
+static const unsigned char crl_cert_issuer_oid[] = { 0x55, 0x1d, 0x1d };
+
+static uint64_t crl_serial_prefix(const unsigned char *serial, size_t len)
+{
+    uint64_t prefix = 0;
+    size_t i;
+
+    for (i = 0; i < 8; i++)
+        prefix = (prefix << 8) | (i < len ? serial[i] : 0);
+    return prefix;
+}
+
+/*
+ * Check whether the serial number of |e| is |serial|, both without leading
+ * zeros.  The prefix settles most mismatches without touching the DER.
+ */
+static int crl_serial_eq(const CRL_INDEX_ENTRY *e,
+                         const unsigned char *serial, size_t slen,
+                         uint64_t prefix)
+{
+    return e->slen == slen && e->prefix == prefix
+           && (slen <= 8 || memcmp(e->serial + 8, serial + 8, slen - 8) == 0);
+}
+
+static size_t crl_serial_hash(const CRL_INDEX *idx,
+                              const unsigned char *serial, size_t slen)
+{
+    SIPHASH sip = { 0 };
+    unsigned char out[SIPHASH_MIN_DIGEST_SIZE];
+
+    /* Neither can fail with these arguments */
+    SipHash_set_hash_size(&sip, sizeof(out));
+    SipHash_Init(&sip, idx->key, 0, 0);
+    SipHash_Update(&sip, serial, slen);
+    SipHash_Final(&sip, out, sizeof(out));
+    return (size_t)out[0] | ((size_t)out[1] << 8) | ((size_t)out[2] << 16)
+           | ((size_t)out[3] << 24);
+}
+
+/*
+ * Returns the slot of the first entry of |idx| for |serial|, or the free slot
+ * where it would go.
+ */
+static size_t crl_index_find(const CRL_INDEX *idx,
+                             const unsigned char *serial, size_t slen,
+                             uint64_t prefix)
+{
+    size_t i = crl_serial_hash(idx, serial, slen) & idx->mask;
+
+    while (idx->slots[i] != 0
+           && !crl_serial_eq(&idx->entries[idx->slots[i] - 1],
+                             serial, slen, prefix))
+        i = (i + 1) & idx->mask;
+    return i;
+}
+
+/*
+ * Parse the revoked entry at |p|, setting |*serial| to its serial number
+ * without leading zero octets.  If |critical| isn't NULL the extensions are
+ * checked too, and |*critical| is set if one of them is critical.  Returns
+ * the length of the entry, or 0 if it is malformed, has a negative serial
+ * number or a certificate issuer extension, none of which compact CRLs
+ * handle.
+ */
+static size_t crl_scan_entry(const unsigned char *p, size_t len,
+                             const unsigned char **serial, size_t *slen,
+                             int *critical)
+{
+    const unsigned char *q = p, *end, *ext_end;
+    long plen;
+    int tag, xclass;
+    size_t total;
+
+    if (len > LONG_MAX)
+        len = LONG_MAX;
+    if (ASN1_get_object(&q, &plen, &tag, &xclass,
+                        (long)len) != V_ASN1_CONSTRUCTED
+            || tag != V_ASN1_SEQUENCE || xclass != V_ASN1_UNIVERSAL)
+        return 0;
+    total = (size_t)(q - p) + (size_t)plen;
+    end = q + plen;
+
+    if (ASN1_get_object(&q, &plen, &tag, &xclass, (long)(end - q)) != 0
+            || tag != V_ASN1_INTEGER || xclass != V_ASN1_UNIVERSAL
+            || plen == 0 || (*q & 0x80) != 0)
+        return 0;
+    *serial = q;
+    *slen = plen;
+    q += plen;
+    while (*slen > 0 && **serial == 0) {
+        (*serial)++;
+        (*slen)--;
+    }
+    if (critical == NULL)
+        return total;
+
+    /* revocationDate */
+    if (ASN1_get_object(&q, &plen, &tag, &xclass, (long)(end - q)) & 0x81)
+        return 0;
+    q += plen;
+    if (q == end)
+        return total;
+
+    /* crlEntryExtensions */
+    if (ASN1_get_object(&q, &plen, &tag, &xclass,
+                        (long)(end - q)) != V_ASN1_CONSTRUCTED
+            || tag != V_ASN1_SEQUENCE || q + plen != end)
+        return 0;
+    while (q < end) {
+        if (ASN1_get_object(&q, &plen, &tag, &xclass,
+                            (long)(end - q)) != V_ASN1_CONSTRUCTED
+                || tag != V_ASN1_SEQUENCE)
+            return 0;
+        ext_end = q + plen;
+        if (ASN1_get_object(&q, &plen, &tag, &xclass, (long)(ext_end - q)) != 0
+                || tag != V_ASN1_OBJECT)
+            return 0;
+        if (plen == sizeof(crl_cert_issuer_oid)
+                && memcmp(q, crl_cert_issuer_oid, plen) == 0)
+            return 0;
+        q += plen;
+        if (ASN1_get_object(&q, &plen, &tag, &xclass,
+                            (long)(ext_end - q)) & 0x81)
+            return 0;
+        if (tag == V_ASN1_BOOLEAN && plen == 1 && *q != 0)
+            *critical = 1;
+        q = ext_end;
+    }
+    return total;
+}
+
+static void crl_index_free(CRL_INDEX *idx)
+{
+    if (idx == NULL)
+        return;
+    OPENSSL_free(idx->der);
+    OPENSSL_free(idx->entries);
+    OPENSSL_free(idx->slots);
+    sk_X509_REVOKED_pop_free(idx->decoded, X509_REVOKED_free);
+    OPENSSL_free(idx);
+}
+
+/* Index the |len| bytes of revoked entries at |der| */
+static CRL_INDEX *crl_index_new(const unsigned char *der, size_t len,
+                                int *critical)
+{
+    CRL_INDEX *idx = NULL;
+    CRL_INDEX_ENTRY *e;
+    const unsigned char *serial;
+    size_t pos, n, slen, slot, num = 0, nslots = 1;
+
+    if (len > UINT32_MAX)
+        return NULL;
+
+    /* Check every entry and count them before allocating anything */
+    for (pos = 0; pos < len; pos += n, num++)
+        if ((n = crl_scan_entry(der + pos, len - pos, &serial, &slen,
+                                critical)) == 0)
+            return NULL;
+
+    /* At most half of the slots are used */
+    while (nslots < 2 * num)
+        nslots <<= 1;
+
+    if ((idx = OPENSSL_zalloc(sizeof(*idx))) == NULL
+            || (idx->der = OPENSSL_memdup(der, len)) == NULL
+            || (num > 0
+                && (idx->entries = OPENSSL_malloc(sizeof(*idx->entries)
+                                                  * num)) == NULL)
+            || (idx->slots = OPENSSL_zalloc(sizeof(*idx->slots)
+                                            * nslots)) == NULL
+            || (idx->decoded = sk_X509_REVOKED_new(X509_REVOKED_cmp)) == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        crl_index_free(idx);
+        return NULL;
+    }
+    if (RAND_bytes(idx->key, sizeof(idx->key)) <= 0) {
+        crl_index_free(idx);
+        return NULL;
+    }
+    sk_X509_REVOKED_sort(idx->decoded);
+    idx->len = len;
+    idx->num = num;
+    idx->mask = nslots - 1;
+
+    for (pos = 0, e = idx->entries; pos < len; pos += n, e++) {
+        n = crl_scan_entry(idx->der + pos, len - pos, &serial, &slen, NULL);
+        e->prefix = crl_serial_prefix(serial, slen);
+        e->serial = serial;
+        e->slen = (uint32_t)slen;
+        e->offset = (uint32_t)pos;
+
+        /* The first of several entries for the same serial number is kept */
+        slot = crl_index_find(idx, serial, slen, e->prefix);
+        if (idx->slots[slot] == 0)
+            idx->slots[slot] = (uint32_t)(e - idx->entries) + 1;
+    }
+    return idx;
+}
+
+/*
+ * Find the revokedCertificates field of the DER encoded CRL at |p| without
+ * decoding it.  On success |*tbs|, |*rev| and |*tail| are set to the start
+ * of the TBSCertList, the revoked entries and the signature algorithm, and
+ * the total length of the CRL is returned.
+ */
+static size_t crl_find_revoked(const unsigned char *p, long len,
+                               const unsigned char **tbs,
+                               const unsigned char **rev, size_t *revlen,
+                               const unsigned char **tail)
+{
+    const unsigned char *q = p, *end, *field;
+    long plen;
+    int tag, xclass, seqs = 0;
+    size_t total;
+
+    if (ASN1_get_object(&q, &plen, &tag, &xclass, len) != V_ASN1_CONSTRUCTED
+            || tag != V_ASN1_SEQUENCE || xclass != V_ASN1_UNIVERSAL)
+        return 0;
+    total = (size_t)(q - p) + (size_t)plen;
+
+    *tbs = q;
+    if (ASN1_get_object(&q, &plen, &tag, &xclass, plen) != V_ASN1_CONSTRUCTED
+            || tag != V_ASN1_SEQUENCE || xclass != V_ASN1_UNIVERSAL)
+        return 0;
+    end = q + plen;
+    *tail = end;
+
+    /* The signature, issuer and revokedCertificates are the SEQUENCEs */
+    while (q < end) {
+        field = q;
+        if (ASN1_get_object(&q, &plen, &tag, &xclass,
+                            (long)(end - q)) & 0x81)
+            return 0;
+        if (tag == V_ASN1_SEQUENCE && xclass == V_ASN1_UNIVERSAL
+                && ++seqs == 3) {
+            *rev = field;
+            *revlen = (size_t)(q - field) + (size_t)plen;
+            return total;
+        }
+        q += plen;
+    }
+    *rev = NULL;
+    return total;
+}
+
+X509_CRL *d2i_X509_CRL_compact(X509_CRL **a, const unsigned char **in,
+                               long len)
+{
+    const unsigned char *p = *in, *tbs, *rev, *tail, *content, *q;
+    size_t total, revlen, hdrlen, tbslen, outlen;
+    unsigned char *buf = NULL, *w;
+    CRL_INDEX *idx = NULL;
+    X509_CRL *crl = NULL;
+    ASN1_ENCODING *enc;
+    long tlen;
+    int tag, xclass, critical = 0;
+
+    /*
+     * Anything this can't index, or any CRL when a custom default method
+     * is in use, is decoded the usual way.
+     */
+    if (default_crl_method != &int_crl_meth
+            || (total = crl_find_revoked(p, len, &tbs, &rev, &revlen,
+                                         &tail)) == 0
+            || rev == NULL)
+        return d2i_X509_CRL(a, in, len);
+
+    q = rev;
+    if (ASN1_get_object(&q, &tlen, &tag, &xclass, (long)revlen) & 0x80)
+        return d2i_X509_CRL(a, in, len);
+    hdrlen = q - rev;
+    ERR_set_mark();
+    if ((idx = crl_index_new(q, revlen - hdrlen, &critical)) == NULL) {
+        ERR_pop_to_mark();
+        return d2i_X509_CRL(a, in, len);
+    }
+    ERR_clear_last_mark();
+
+    /* Decode a copy of the CRL with the revoked entries left out */
+    content = tbs;
+    ASN1_get_object(&content, &tlen, &tag, &xclass, (long)(tail - tbs));
+    tbslen = (tail - content) - revlen;
+    outlen = ASN1_object_size(1, (long)tbslen, V_ASN1_SEQUENCE)
+             + (p + total - tail);
+    if ((buf = OPENSSL_malloc(ASN1_object_size(1, (long)outlen,
+                                               V_ASN1_SEQUENCE))) == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+    w = buf;
+    ASN1_put_object(&w, 1, (long)outlen, V_ASN1_SEQUENCE, V_ASN1_UNIVERSAL);
+    ASN1_put_object(&w, 1, (long)tbslen, V_ASN1_SEQUENCE, V_ASN1_UNIVERSAL);
+    memcpy(w, content, rev - content);
+    w += rev - content;
+    memcpy(w, rev + revlen, tail - (rev + revlen));
+    w += tail - (rev + revlen);
+    memcpy(w, tail, p + total - tail);
+    w += p + total - tail;
+
+    q = buf;
+    if ((crl = d2i_X509_CRL(a, &q, (long)(w - buf))) == NULL)
+        goto err;
+
+    /*
+     * The cached encoding of the CRL info is the original one, so that the
+     * signature still verifies and the CRL is written out in full.
+     */
+    enc = &crl->crl.enc;
+    OPENSSL_free(enc->enc);
+    enc->len = (long)(tail - tbs);
+    enc->modified = 0;
+    if ((enc->enc = OPENSSL_memdup(tbs, enc->len)) == NULL) {
+        X509err(0, ERR_R_MALLOC_FAILURE);
+        enc->len = 0;
+        enc->modified = 1;
+        goto err;
+    }
+    /* X509_CRL_digest() would return the hash of the copy */
+    if (!ASN1_item_digest(ASN1_ITEM_rptr(X509_CRL), EVP_sha1(), crl,
+                          crl->sha1_hash, NULL))
+        goto err;
+    if (critical)
+        crl->flags |= EXFLAG_CRITICAL;
+    crl->meth = &compact_crl_meth;
+    crl->meth_data = idx;
+
+    OPENSSL_free(buf);
+    *in = p + total;
+    return crl;
+
+ err:
+    if (crl != NULL && (a == NULL || *a != crl))
+        X509_CRL_free(crl);
+    crl_index_free(idx);
+    OPENSSL_free(buf);
+    return NULL;
+}
+
+X509_CRL *d2i_X509_CRL_compact_bio(BIO *bp, X509_CRL **crl)
+{
+    BUF_MEM *b = NULL;
+    const unsigned char *p;
+    X509_CRL *ret = NULL;
+    int len;
+
+    if ((len = asn1_d2i_read_bio(bp, &b)) >= 0) {
+        p = (unsigned char *)b->data;
+        ret = d2i_X509_CRL_compact(crl, &p, len);
+    }
+    BUF_MEM_free(b);
+    return ret;
+}
+
+static int compact_crl_free(X509_CRL *crl)
+{
+    crl_index_free(crl->meth_data);
+    crl->meth_data = NULL;
+    return 1;
+}
+
+/* Decode the revoked entry at offset |off| of |idx|, for |serial| */
+static X509_REVOKED *crl_index_get(X509_CRL *crl, CRL_INDEX *idx,
+                                   uint32_t off, ASN1_INTEGER *serial)
+{
+    X509_REVOKED rtmp, *rev, *tmp;
+    const unsigned char *p;
+    ASN1_ENUMERATED *reason;
+    int j;
+
+    rtmp.serialNumber = *serial;
+    CRYPTO_THREAD_read_lock(crl->lock);
+    rev = sk_X509_REVOKED_value(idx->decoded,
+                                sk_X509_REVOKED_find(idx->decoded, &rtmp));
+    CRYPTO_THREAD_unlock(crl->lock);
+    if (rev != NULL)
+        return rev;
+
+    p = idx->der + off;
+    ERR_set_mark();
+    rev = d2i_X509_REVOKED(NULL, &p, (long)(idx->len - off));
+    if (rev != NULL) {
+        reason = X509_REVOKED_get_ext_d2i(rev, NID_crl_reason, &j, NULL);
+        rev->reason = reason != NULL ? ASN1_ENUMERATED_get(reason)
+                                     : CRL_REASON_NONE;
+        ASN1_ENUMERATED_free(reason);
+    } else if ((rev = X509_REVOKED_new()) == NULL
+               || !X509_REVOKED_set_serialNumber(rev, serial)) {
+        ERR_clear_last_mark();
+        X509_REVOKED_free(rev);
+        return NULL;
+    } else {
+        /* The serial number is listed, even if the rest is unusable */
+        rev->reason = CRL_REASON_NONE;
+    }
+    /* Drop any errors from decoding the entry, but nothing older */
+    ERR_pop_to_mark();
+
+    CRYPTO_THREAD_write_lock(crl->lock);
+    tmp = sk_X509_REVOKED_value(idx->decoded,
+                                sk_X509_REVOKED_find(idx->decoded, &rtmp));
+    if (tmp == NULL && sk_X509_REVOKED_push(idx->decoded, rev) > 0) {
+        sk_X509_REVOKED_sort(idx->decoded);
+        tmp = rev;
+        rev = NULL;
+    }
+    CRYPTO_THREAD_unlock(crl->lock);
+    X509_REVOKED_free(rev);
+    return tmp;
+}
+
+static int compact_crl_lookup(X509_CRL *crl,
+                              X509_REVOKED **ret, ASN1_INTEGER *serial,
+                              X509_NAME *issuer)
+{
+    CRL_INDEX *idx = crl->meth_data;
+    const unsigned char *key = serial->data;
+    size_t klen = serial->length;
+    uint32_t i;
+    X509_REVOKED *rev;
+
+    /* Compact CRLs are never indirect */
+    if (issuer != NULL && X509_NAME_cmp(issuer, X509_CRL_get_issuer(crl)))
+        return 0;
+    if (serial->type == V_ASN1_NEG_INTEGER)
+        return 0;
+    while (klen > 0 && *key == 0) {
+        key++;
+        klen--;
+    }
+
+    i = idx->slots[crl_index_find(idx, key, klen,
+                                  crl_serial_prefix(key, klen))];
+    if (i == 0)
+        return 0;
+
+    if ((rev = crl_index_get(crl, idx, idx->entries[i - 1].offset,
+                             serial)) == NULL)
+        return 0;
+    if (ret)
+        *ret = rev;
+    if (rev->reason == CRL_REASON_REMOVE_FROM_CRL)
+        return 2;
+    return 1;
+}
+
+#else
+
+/* Without SipHash there is no safe way to index the serial numbers */
+X509_CRL *d2i_X509_CRL_compact(X509_CRL **a, const unsigned char **in,
+                               long len)
+{
+    return d2i_X509_CRL(a, in, len);
+}
+
+X509_CRL *d2i_X509_CRL_compact_bio(BIO *bp, X509_CRL **crl)
+{
+    return d2i_X509_CRL_bio(bp, crl);
+}
+
+#endif
+
 void X509_CRL_set_default_method(const X509_CRL_METHOD *meth)
 {
     if (meth == NULL)
@@ -218,6 +218,8 @@ OPENSSL_ia32_cpuid:
 	and	%eax,%r9d		# clear AVX, FMA and AMD XOP bits
 	mov	\$0x3fdeffdf,%eax	# ~(1<<31|1<<30|1<<21|1<<16|1<<5)
 	and	%eax,8(%rdi)		# clear AVX2 and AVX512* bits
+	andl	\$0xfffff9ff,12(%rdi)	# ~(1<<10|1<<9)
+					# clear VAES and VPCLMULQDQ bits
 .Ldone:
 	shl	\$32,%r9
 	mov	%r10d,%eax
@@ -1,5 +1,5 @@
 /*
- * Copyright 2016-2018 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2016-2019 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -18,6 +18,7 @@
 #include <openssl/engine.h>
 #include <openssl/async.h>
 #include <openssl/err.h>
+#include <openssl/sha.h>
 #include "internal/nelem.h"
 
 #include <sys/socket.h>
@@ -52,39 +53,52 @@ void engine_load_afalg_int(void)
 #  define SOL_ALG 279
 # endif
 
-# ifdef ALG_ZERO_COPY
-#  ifndef SPLICE_F_GIFT
-#   define SPLICE_F_GIFT    (0x08)
-#  endif
+# ifndef ALG_SET_AEAD_ASSOCLEN
+#  define ALG_SET_AEAD_ASSOCLEN 4
+# endif
+# ifndef ALG_SET_AEAD_AUTHSIZE
+#  define ALG_SET_AEAD_AUTHSIZE 5
 # endif
 
 # define ALG_AES_IV_LEN 16
 # define ALG_IV_LEN(len) (sizeof(struct af_alg_iv) + (len))
 # define ALG_OP_TYPE     unsigned int
 # define ALG_OP_LEN      (sizeof(ALG_OP_TYPE))
+# define ALG_ASSOCLEN_LEN (sizeof(unsigned int))
 
 # ifdef OPENSSL_NO_DYNAMIC_ENGINE
 void engine_load_afalg_int(void);
 # endif
 
 /* Local Linkage Functions */
-static int afalg_init_aio(afalg_aio *aio);
-static int afalg_fin_cipher_aio(afalg_aio *ptr, int sfd,
-                                unsigned char *buf, size_t len);
-static int afalg_create_sk(afalg_ctx *actx, const char *ciphertype,
-                                const char *ciphername);
+static int afalg_init_aio(afalg_aio *aio, unsigned int n);
+static int afalg_fin_cipher_aio(afalg_aio *aio, unsigned int n);
+static int afalg_create_sk(int *bfd, const char *ciphertype,
+                           const char *ciphername);
 static int afalg_destroy(ENGINE *e);
 static int afalg_init(ENGINE *e);
 static int afalg_finish(ENGINE *e);
+static int afalg_ctrl(ENGINE *e, int cmd, long i, void *p, void (*f) (void));
 static const EVP_CIPHER *afalg_aes_cbc(int nid);
-static cbc_handles *get_cipher_handle(int nid);
+static const EVP_CIPHER *afalg_aes_gcm(int nid);
+static cipher_handles *get_cipher_handle(int nid);
 static int afalg_ciphers(ENGINE *e, const EVP_CIPHER **cipher,
                          const int **nids, int nid);
 static int afalg_cipher_init(EVP_CIPHER_CTX *ctx, const unsigned char *key,
                              const unsigned char *iv, int enc);
 static int afalg_do_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
                            const unsigned char *in, size_t inl);
+static int afalg_cipher_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg,
+                             void *ptr);
 static int afalg_cipher_cleanup(EVP_CIPHER_CTX *ctx);
+static int afalg_gcm_init(EVP_CIPHER_CTX *ctx, const unsigned char *key,
+                          const unsigned char *iv, int enc);
+static int afalg_gcm_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
+                            const unsigned char *in, size_t len);
+static int afalg_gcm_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg, void *ptr);
+static const EVP_MD *afalg_sha(int nid);
+static int afalg_digests(ENGINE *e, const EVP_MD **digest,
+                         const int **nids, int nid);
 static int afalg_chk_platform(void);
 
 /* Engine Id and Name */
@@ -95,11 +109,42 @@ static int afalg_cipher_nids[] = {
     NID_aes_128_cbc,
     NID_aes_192_cbc,
     NID_aes_256_cbc,
+    NID_aes_128_gcm,
+    NID_aes_192_gcm,
+    NID_aes_256_gcm,
+};
+
+static cipher_handles afalg_cipher_handles[] = {{AES_KEY_SIZE_128, NULL},
+                                         {AES_KEY_SIZE_192, NULL},
+                                         {AES_KEY_SIZE_256, NULL},
+                                         {AES_KEY_SIZE_128, NULL},
+                                         {AES_KEY_SIZE_192, NULL},
+                                         {AES_KEY_SIZE_256, NULL}};
+
+static int afalg_digest_nids[] = {
+    NID_sha256,
+    NID_sha512,
+};
+
+static digest_handles afalg_digest_handles[] = {
+    {SHA256_DIGEST_LENGTH, SHA256_CBLOCK, NULL},
+    {SHA512_DIGEST_LENGTH, SHA512_CBLOCK, NULL}
 };
 
-static cbc_handles cbc_handle[] = {{AES_KEY_SIZE_128, NULL},
-                                    {AES_KEY_SIZE_192, NULL},
-                                    {AES_KEY_SIZE_256, NULL}};
+/*
+ * Going through the kernel costs a few system calls per request, which only
+ * pays off for large requests or with hardware drivers. Requests below
+ * |kernel_min| bytes are processed in user space, and only buffers of at
+ * least |zero_copy_min| bytes are worth pinning and splicing into the
+ * kernel rather than copying. With |use_generic| the kernel's own software
+ * implementations are used instead of the highest priority drivers, which
+ * is mostly useful for benchmarking. AES-GCM messages other than TLS
+ * records only go to the kernel with |gcm_one_shot|, see afalg_gcm_cipher().
+ */
+static size_t kernel_min = AFALG_DEFAULT_KERNEL_MIN;
+static size_t zero_copy_min = AFALG_DEFAULT_ZERO_COPY_MIN;
+static int use_generic = 0;
+static int gcm_one_shot = 0;
 
 static ossl_inline int io_setup(unsigned n, aio_context_t *ctx)
 {
@@ -128,6 +173,27 @@ static ossl_inline int io_getevents(aio_context_t ctx, long min, long max,
     return syscall(__NR_io_getevents, ctx, min, max, events, timeout);
 }
 
+static const char *afalg_alg_name(int nid)
+{
+    switch (nid) {
+    case NID_aes_128_cbc:
+    case NID_aes_192_cbc:
+    case NID_aes_256_cbc:
+        return use_generic ? "cbc(aes-generic)" : "cbc(aes)";
+    case NID_aes_128_gcm:
+    case NID_aes_192_gcm:
+    case NID_aes_256_gcm:
+        return use_generic ? "gcm_base(ctr(aes-generic),ghash-generic)"
+                           : "gcm(aes)";
+    case NID_sha256:
+        return use_generic ? "sha256-generic" : "sha256";
+    case NID_sha512:
+        return use_generic ? "sha512-generic" : "sha512";
+    default:
+        return NULL;
+    }
+}
+
 static void afalg_waitfd_cleanup(ASYNC_WAIT_CTX *ctx, const void *key,
                                  OSSL_ASYNC_FD waitfd, void *custom)
 {
@@ -193,73 +259,100 @@ static int afalg_setup_async_event_notification(afalg_aio *aio)
     return 1;
 }
 
-static int afalg_init_aio(afalg_aio *aio)
+/*
+ * Sets up an AIO context for |n| requests in flight, replacing a smaller
+ * one. Every context counts against the system wide aio-max-nr, so don't
+ * ask for more than is going to be used.
+ */
+static int afalg_init_aio(afalg_aio *aio, unsigned int n)
 {
-    int r = -1;
+    aio_context_t aio_ctx = 0;
 
-    /* Initialise for AIO */
-    aio->aio_ctx = 0;
-    r = io_setup(MAX_INFLIGHTS, &aio->aio_ctx);
-    if (r < 0) {
+    if (io_setup(n, &aio_ctx) < 0) {
         ALG_PERR("%s(%d): io_setup error : ", __FILE__, __LINE__);
         AFALGerr(AFALG_F_AFALG_INIT_AIO, AFALG_R_IO_SETUP_FAILED);
         return 0;
     }
-
-    memset(aio->cbt, 0, sizeof(aio->cbt));
-    aio->efd = -1;
-    aio->mode = MODE_UNINIT;
+    if (aio->aio_ctx != 0)
+        io_destroy(aio->aio_ctx);
+    aio->aio_ctx = aio_ctx;
+    aio->aio_nr = n;
 
     return 1;
 }
 
-static int afalg_fin_cipher_aio(afalg_aio *aio, int sfd, unsigned char *buf,
-                                size_t len)
+/*
+ * Describes the read of the result of request |i| into |cnt| buffers at
+ * |iov|, or into |len| bytes at |buf| if |iov| is NULL.
+ */
+static void afalg_prep_read(afalg_aio *aio, unsigned int i, int sfd,
+                            unsigned char *buf, size_t len,
+                            struct iovec *iov, int cnt)
 {
-    int r;
-    int retry = 0;
-    unsigned int done = 0;
-    struct iocb *cb;
-    struct timespec timeout;
-    struct io_event events[MAX_INFLIGHTS];
-    u_int64_t eval = 0;
-
-    timeout.tv_sec = 0;
-    timeout.tv_nsec = 0;
-
-    /* if efd has not been initialised yet do it here */
-    if (aio->mode == MODE_UNINIT) {
-        r = afalg_setup_async_event_notification(aio);
-        if (r == 0)
-            return 0;
-    }
+    struct iocb *cb = &aio->cbt[i];
 
-    cb = &(aio->cbt[0 % MAX_INFLIGHTS]);
     memset(cb, '\0', sizeof(*cb));
     cb->aio_fildes = sfd;
-    cb->aio_lio_opcode = IOCB_CMD_PREAD;
     /*
      * The pointer has to be converted to unsigned value first to avoid
      * sign extension on cast to 64 bit value in 32-bit builds
      */
-    cb->aio_buf = (size_t)buf;
+    if (iov == NULL) {
+        cb->aio_lio_opcode = IOCB_CMD_PREAD;
+        cb->aio_buf = (size_t)buf;
+        cb->aio_nbytes = len;
+    } else {
+        cb->aio_lio_opcode = IOCB_CMD_PREADV;
+        cb->aio_buf = (size_t)iov;
+        cb->aio_nbytes = cnt;
+    }
     cb->aio_offset = 0;
-    cb->aio_data = 0;
-    cb->aio_nbytes = len;
+    cb->aio_data = i;
     cb->aio_flags = IOCB_FLAG_RESFD;
     cb->aio_resfd = aio->efd;
+}
+
+/*
+ * Reads the results of the first |n| requests described in aio->cbt with a
+ * single io_submit() and pauses the job until all of them have completed.
+ * Returns 1 on success, -1 if a request failed to authenticate and 0 on any
+ * other error.
+ */
+static int afalg_fin_cipher_aio(afalg_aio *aio, unsigned int n)
+{
+    int r, i;
+    int retry = 0;
+    int ret = 1;
+    unsigned int done = 0, submitted = 0;
+    struct iocb *cbs[MAX_INFLIGHTS];
+    struct timespec timeout;
+    struct io_event *events = aio->events;
+    u_int64_t eval = 0;
+
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = 0;
+
+    for (i = 0; i < (int)n; i++)
+        cbs[i] = &aio->cbt[i];
 
     /*
-     * Perform AIO read on AFALG socket, this in turn performs an async
-     * crypto operation in kernel space
+     * Perform AIO read on AFALG sockets, this in turn performs async
+     * crypto operations in kernel space
      */
-    r = io_read(aio->aio_ctx, 1, &cb);
-    if (r < 0) {
-        ALG_PWARN("%s(%d): io_read failed : ", __FILE__, __LINE__);
-        return 0;
+    while (submitted < n) {
+        r = io_read(aio->aio_ctx, n - submitted, cbs + submitted);
+        if (r <= 0) {
+            ALG_PWARN("%s(%d): io_read failed : ", __FILE__, __LINE__);
+            if (submitted == 0)
+                return 0;
+            /* Still have to wait for what is already in flight */
+            ret = 0;
+            break;
+        }
+        submitted += r;
     }
 
-    do {
+    while (done < submitted) {
         /* While AIO read is being performed pause job */
         ASYNC_pause_job();
 
@@ -274,53 +367,52 @@ static int afalg_fin_cipher_aio(afalg_aio *aio, int sfd, unsigned char *buf,
             ALG_WARN("%s(%d): eventfd read %d bytes, eval = %lu\n", __FILE__,
                      __LINE__, r, eval);
         }
-        if (eval > 0) {
+        if (eval == 0)
+            continue;
 
-            /* Get results of AIO read */
-            r = io_getevents(aio->aio_ctx, 1, MAX_INFLIGHTS,
-                             events, &timeout);
-            if (r > 0) {
+        /* Get results of AIO read */
+        r = io_getevents(aio->aio_ctx, 1, MAX_INFLIGHTS, events, &timeout);
+        if (r < 0) {
+            ALG_PERR("%s(%d): io_getevents failed : ", __FILE__, __LINE__);
+            return 0;
+        } else if (r == 0) {
+            ALG_WARN("%s(%d): io_geteventd read 0 bytes\n", __FILE__,
+                     __LINE__);
+        }
+        for (i = 0; i < r; i++) {
+            /*
+             * events.res indicates the actual status of the operation.
+             * Handle the error condition first.
+             */
+            if (events[i].res == -EBUSY && retry++ < 3) {
                 /*
-                 * events.res indicates the actual status of the operation.
-                 * Handle the error condition first.
+                 * Underlying operation cannot be completed at the time
+                 * of previous submission. Resubmit for the operation.
                  */
-                if (events[0].res < 0) {
-                    /*
-                     * Underlying operation cannot be completed at the time
-                     * of previous submission. Resubmit for the operation.
-                     */
-                    if (events[0].res == -EBUSY && retry++ < 3) {
-                        r = io_read(aio->aio_ctx, 1, &cb);
-                        if (r < 0) {
-                            ALG_PERR("%s(%d): retry %d for io_read failed : ",
-                                     __FILE__, __LINE__, retry);
-                            return 0;
-                        }
-                        continue;
-                    } else {
-                        /*
-                         * Retries exceed for -EBUSY or unrecoverable error
-                         * condition for this instance of operation.
-                         */
-                        ALG_WARN
-                            ("%s(%d): Crypto Operation failed with code %lld\n",
-                             __FILE__, __LINE__, events[0].res);
-                        return 0;
-                    }
-                }
-                /* Operation successful. */
-                done = 1;
-            } else if (r < 0) {
-                ALG_PERR("%s(%d): io_getevents failed : ", __FILE__, __LINE__);
-                return 0;
-            } else {
-                ALG_WARN("%s(%d): io_geteventd read 0 bytes\n", __FILE__,
-                         __LINE__);
+                if (io_read(aio->aio_ctx, 1,
+                            &cbs[events[i].data % MAX_INFLIGHTS]) == 1)
+                    continue;
+                ALG_PERR("%s(%d): retry %d for io_read failed : ",
+                         __FILE__, __LINE__, retry);
+                ret = 0;
+            } else if (events[i].res == -EBADMSG) {
+                if (ret == 1)
+                    ret = -1;
+            } else if (events[i].res < 0) {
+                /*
+                 * Retries exceed for -EBUSY or unrecoverable error
+                 * condition for this instance of operation.
+                 */
+                ALG_WARN
+                    ("%s(%d): Crypto Operation failed with code %lld\n",
+                     __FILE__, __LINE__, events[i].res);
+                ret = 0;
             }
+            done++;
         }
-    } while (!done);
+    }
 
-    return 1;
+    return ret;
 }
 
 static ossl_inline void afalg_set_op_sk(struct cmsghdr *cmsg,
@@ -345,6 +437,14 @@ static void afalg_set_iv_sk(struct cmsghdr *cmsg, const unsigned char *iv,
     memcpy(aiv->iv, iv, len);
 }
 
+static void afalg_set_assoclen_sk(struct cmsghdr *cmsg, unsigned int len)
+{
+    cmsg->cmsg_level = SOL_ALG;
+    cmsg->cmsg_type = ALG_SET_AEAD_ASSOCLEN;
+    cmsg->cmsg_len = CMSG_LEN(ALG_ASSOCLEN_LEN);
+    memcpy(CMSG_DATA(cmsg), &len, ALG_ASSOCLEN_LEN);
+}
+
 static ossl_inline int afalg_set_key(afalg_ctx *actx, const unsigned char *key,
                                 const int klen)
 {
@@ -358,68 +458,210 @@ static ossl_inline int afalg_set_key(afalg_ctx *actx, const unsigned char *key,
     return 1;
 }
 
-static int afalg_create_sk(afalg_ctx *actx, const char *ciphertype,
-                                const char *ciphername)
+static int afalg_create_sk(int *bfd, const char *ciphertype,
+                           const char *ciphername)
 {
     struct sockaddr_alg sa;
     int r = -1;
 
-    actx->bfd = actx->sfd = -1;
-
     memset(&sa, 0, sizeof(sa));
     sa.salg_family = AF_ALG;
     OPENSSL_strlcpy((char *) sa.salg_type, ciphertype, sizeof(sa.salg_type));
     OPENSSL_strlcpy((char *) sa.salg_name, ciphername, sizeof(sa.salg_name));
 
-    actx->bfd = socket(AF_ALG, SOCK_SEQPACKET, 0);
-    if (actx->bfd == -1) {
+    *bfd = socket(AF_ALG, SOCK_SEQPACKET, 0);
+    if (*bfd == -1) {
         ALG_PERR("%s(%d): Failed to open socket : ", __FILE__, __LINE__);
         AFALGerr(AFALG_F_AFALG_CREATE_SK, AFALG_R_SOCKET_CREATE_FAILED);
-        goto err;
+        return 0;
     }
 
-    r = bind(actx->bfd, (struct sockaddr *)&sa, sizeof(sa));
+    r = bind(*bfd, (struct sockaddr *)&sa, sizeof(sa));
     if (r < 0) {
         ALG_PERR("%s(%d): Failed to bind socket : ", __FILE__, __LINE__);
         AFALGerr(AFALG_F_AFALG_CREATE_SK, AFALG_R_SOCKET_BIND_FAILED);
-        goto err;
+        close(*bfd);
+        *bfd = -1;
+        return 0;
     }
 
-    actx->sfd = accept(actx->bfd, NULL, 0);
-    if (actx->sfd < 0) {
+    return 1;
+}
+
+static int afalg_accept_sk(int bfd)
+{
+    int sfd = accept(bfd, NULL, 0);
+
+    if (sfd < 0) {
         ALG_PERR("%s(%d): Socket Accept Failed : ", __FILE__, __LINE__);
-        AFALGerr(AFALG_F_AFALG_CREATE_SK, AFALG_R_SOCKET_ACCEPT_FAILED);
+        AFALGerr(AFALG_F_AFALG_ACCEPT_SK, AFALG_R_SOCKET_ACCEPT_FAILED);
+        return -1;
+    }
+    return sfd;
+}
+
+static void afalg_close_session(afalg_ctx *actx)
+{
+    int i;
+
+    for (i = 0; i < MAX_INFLIGHTS; i++) {
+        if (actx->sfd[i] >= 0)
+            close(actx->sfd[i]);
+        actx->sfd[i] = -1;
+    }
+    if (actx->bfd >= 0)
+        close(actx->bfd);
+    actx->bfd = -1;
+}
+
+/*
+ * Gets the kernel side of |actx| ready for |n| requests at once, the first
+ * time a request is large enough to go there: binds the algorithm, sets
+ * the key, accepts an operation socket per request and sets up AIO.
+ * Returns 0 if the kernel can't take the requests, for instance when the
+ * system has run out of AIO contexts. The caller then processes them in
+ * user space, so no errors are left behind.
+ */
+static int afalg_open_session(afalg_ctx *actx, int nid, unsigned int n)
+{
+    const int authsize = AES_GCM_TAG_LEN;
+    unsigned int i;
+
+    if (actx->sfd[n - 1] >= 0 && actx->aio.aio_nr >= n
+            && actx->aio.mode != MODE_UNINIT)
+        return 1;
+
+    ERR_set_mark();
+    if (actx->bfd < 0) {
+        if (!afalg_create_sk(&actx->bfd, actx->type, afalg_alg_name(nid)))
+            goto err;
+        if (!afalg_set_key(actx, actx->key, actx->keylen))
+            goto err;
+        /* The tag size can't be changed once there are operation sockets */
+        if (strcmp(actx->type, "aead") == 0
+                && setsockopt(actx->bfd, SOL_ALG, ALG_SET_AEAD_AUTHSIZE, NULL,
+                              authsize) < 0) {
+            ALG_PERR("%s(%d): Failed to set socket option : ", __FILE__,
+                     __LINE__);
+            AFALGerr(AFALG_F_AFALG_OPEN_SESSION,
+                     AFALG_R_SOCKET_OPERATION_FAILED);
+            goto err;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        if (actx->sfd[i] < 0 && (actx->sfd[i] = afalg_accept_sk(actx->bfd)) < 0)
+            goto err;
+
+    /* Setup AIO ctx to allow async AFALG crypto processing */
+    if (actx->aio.aio_nr < n && !afalg_init_aio(&actx->aio, n))
+        goto err;
+    if (actx->aio.mode == MODE_UNINIT
+            && !afalg_setup_async_event_notification(&actx->aio))
         goto err;
+
+    ERR_clear_last_mark();
+    return 1;
+
+ err:
+    ERR_pop_to_mark();
+    afalg_close_session(actx);
+    return 0;
+}
+
+/*
+ * Queues |len| bytes at |buf| on the operation socket |sfd|. Buffers of at
+ * least zero_copy_min bytes are not copied: their pages are spliced into
+ * the socket through the pipe |zc|, which is created on first use. |more|
+ * tells the kernel that further data of the same request follows.
+ */
+static int afalg_send_data(int zc[2], int sfd, const unsigned char *buf,
+                           size_t len, int more)
+{
+    struct iovec iov;
+    ssize_t n, m;
+
+    if (len >= zero_copy_min && len > 0 && zc[0] < 0 && pipe(zc) != 0) {
+        ALG_PWARN("%s(%d): pipe failed : ", __FILE__, __LINE__);
+        zc[0] = zc[1] = -1;
+    }
+
+    if (len < zero_copy_min || zc[0] < 0) {
+        while (len > 0) {
+            n = send(sfd, buf, len, more ? MSG_MORE : 0);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR)
+                    continue;
+                ALG_PERR("%s(%d): send failed : ", __FILE__, __LINE__);
+                return 0;
+            }
+            buf += n;
+            len -= n;
+        }
+        return 1;
     }
 
+    /*
+     * vmsplice and splice are used to pin the user space input buffer for
+     * kernel space processing avoiding copys from user to kernel space. A
+     * pipe only holds a limited number of pages, so this goes in chunks.
+     */
+    while (len > 0) {
+        iov.iov_base = (unsigned char *)buf;
+        iov.iov_len = len;
+        n = vmsplice(zc[1], &iov, 1, 0);
+        if (n <= 0) {
+            ALG_PERR("%s(%d): vmsplice failed : ", __FILE__, __LINE__);
+            goto err;
+        }
+        buf += n;
+        len -= n;
+        while (n > 0) {
+            m = splice(zc[0], NULL, sfd, NULL, n,
+                       len > 0 || more ? SPLICE_F_MORE : 0);
+            if (m <= 0) {
+                ALG_PERR("%s(%d): splice failed : ", __FILE__, __LINE__);
+                goto err;
+            }
+            n -= m;
+        }
+    }
     return 1;
 
  err:
-    if (actx->bfd >= 0)
-        close(actx->bfd);
-    if (actx->sfd >= 0)
-        close(actx->sfd);
-    actx->bfd = actx->sfd = -1;
+    /* Whatever is left in the pipe belongs to no one */
+    close(zc[0]);
+    close(zc[1]);
+    zc[0] = zc[1] = -1;
     return 0;
 }
 
-static int afalg_start_cipher_sk(afalg_ctx *actx, const unsigned char *in,
-                                 size_t inl, const unsigned char *iv,
-                                 unsigned int enc)
+/*
+ * Queues a request on |sfd|: the cipher direction, the IV and for AEADs
+ * the associated data go with sendmsg(), followed by the input and for
+ * AEAD decryption the expected tag.
+ */
+static int afalg_start_cipher_sk(afalg_ctx *actx, int sfd, unsigned int enc,
+                                 const unsigned char *iv, unsigned int ivlen,
+                                 const unsigned char *aad, size_t aadlen,
+                                 const unsigned char *in, size_t inl,
+                                 const unsigned char *tag, size_t taglen)
 {
     struct msghdr msg;
     struct cmsghdr *cmsg;
-    struct iovec iov;
+    struct iovec iov[3];
     ssize_t sbytes;
-# ifdef ALG_ZERO_COPY
-    int ret;
-# endif
-    char cbuf[CMSG_SPACE(ALG_IV_LEN(ALG_AES_IV_LEN)) + CMSG_SPACE(ALG_OP_LEN)];
+    size_t len = 0;
+    int zero_copy = inl >= zero_copy_min;
+    char cbuf[CMSG_SPACE(ALG_IV_LEN(ALG_AES_IV_LEN)) + CMSG_SPACE(ALG_OP_LEN)
+              + CMSG_SPACE(ALG_ASSOCLEN_LEN)];
 
     memset(&msg, 0, sizeof(msg));
     memset(cbuf, 0, sizeof(cbuf));
     msg.msg_control = cbuf;
-    msg.msg_controllen = sizeof(cbuf);
+    msg.msg_controllen = CMSG_SPACE(ALG_OP_LEN) + CMSG_SPACE(ALG_IV_LEN(ivlen));
+    if (aad != NULL)
+        msg.msg_controllen += CMSG_SPACE(ALG_ASSOCLEN_LEN);
 
     /*
      * cipher direction (i.e. encrypt or decrypt) and iv are sent to the
@@ -428,77 +670,205 @@ static int afalg_start_cipher_sk(afalg_ctx *actx, const unsigned char *in,
     cmsg = CMSG_FIRSTHDR(&msg);
     afalg_set_op_sk(cmsg, enc);
     cmsg = CMSG_NXTHDR(&msg, cmsg);
-    afalg_set_iv_sk(cmsg, iv, ALG_AES_IV_LEN);
+    afalg_set_iv_sk(cmsg, iv, ivlen);
+    if (aad != NULL) {
+        cmsg = CMSG_NXTHDR(&msg, cmsg);
+        afalg_set_assoclen_sk(cmsg, aadlen);
+    }
 
     /* iov that describes input data */
-    iov.iov_base = (unsigned char *)in;
-    iov.iov_len = inl;
-
-    msg.msg_flags = MSG_MORE;
+    msg.msg_iov = iov;
+    if (aadlen > 0) {
+        iov[msg.msg_iovlen].iov_base = (unsigned char *)aad;
+        iov[msg.msg_iovlen++].iov_len = aadlen;
+        len += aadlen;
+    }
+    if (!zero_copy) {
+        iov[msg.msg_iovlen].iov_base = (unsigned char *)in;
+        iov[msg.msg_iovlen++].iov_len = inl;
+        len += inl;
+        if (taglen > 0) {
+            iov[msg.msg_iovlen].iov_base = (unsigned char *)tag;
+            iov[msg.msg_iovlen++].iov_len = taglen;
+            len += taglen;
+        }
+    }
 
-# ifdef ALG_ZERO_COPY
     /*
-     * ZERO_COPY mode
-     * Works best when buffer is 4k aligned
-     * OPENS: out of place processing (i.e. out != in)
+     * Sendmsg() sends iv, cipher direction and the input data that is
+     * copied to the kernel. The rest follows with MSG_MORE.
      */
-
-    /* Input data is not sent as part of call to sendmsg() */
-    msg.msg_iovlen = 0;
-    msg.msg_iov = NULL;
-
-    /* Sendmsg() sends iv and cipher direction to the kernel */
-    sbytes = sendmsg(actx->sfd, &msg, 0);
+    sbytes = sendmsg(sfd, &msg, zero_copy ? MSG_MORE : 0);
     if (sbytes < 0) {
-        ALG_PERR("%s(%d): sendmsg failed for zero copy cipher operation : ",
-                 __FILE__, __LINE__);
+        ALG_PERR("%s(%d): sendmsg failed for cipher operation : ", __FILE__,
+                 __LINE__);
         return 0;
     }
 
-    /*
-     * vmsplice and splice are used to pin the user space input buffer for
-     * kernel space processing avoiding copys from user to kernel space
-     */
-    ret = vmsplice(actx->zc_pipe[1], &iov, 1, SPLICE_F_GIFT);
-    if (ret < 0) {
-        ALG_PERR("%s(%d): vmsplice failed : ", __FILE__, __LINE__);
+    if (sbytes != (ssize_t) len) {
+        ALG_WARN("Cipher operation send bytes %zd != inlen %zd\n", sbytes,
+                len);
         return 0;
     }
 
-    ret = splice(actx->zc_pipe[0], NULL, actx->sfd, NULL, inl, 0);
-    if (ret < 0) {
-        ALG_PERR("%s(%d): splice failed : ", __FILE__, __LINE__);
+    if (zero_copy
+            && (!afalg_send_data(actx->zc_pipe, sfd, in, inl, taglen > 0)
+                || !afalg_send_data(actx->zc_pipe, sfd, tag, taglen, 0)))
         return 0;
+
+    return 1;
+}
+
+/*
+ * The built in implementation works on its own cipher data, so the data
+ * pointer of |ctx| is swapped around each call, like the dasync engine does.
+ */
+static const EVP_CIPHER *afalg_sw_cipher(int nid)
+{
+    switch (nid) {
+    case NID_aes_128_cbc:
+        return EVP_aes_128_cbc();
+    case NID_aes_192_cbc:
+        return EVP_aes_192_cbc();
+    case NID_aes_256_cbc:
+        return EVP_aes_256_cbc();
+    case NID_aes_128_gcm:
+        return EVP_aes_128_gcm();
+    case NID_aes_192_gcm:
+        return EVP_aes_192_gcm();
+    case NID_aes_256_gcm:
+        return EVP_aes_256_gcm();
+    default:
+        return NULL;
     }
-# else
-    msg.msg_iovlen = 1;
-    msg.msg_iov = &iov;
+}
 
-    /* Sendmsg() sends iv, cipher direction and input data to the kernel */
-    sbytes = sendmsg(actx->sfd, &msg, 0);
-    if (sbytes < 0) {
-        ALG_PERR("%s(%d): sendmsg failed for cipher operation : ", __FILE__,
-                 __LINE__);
+static int afalg_sw_init(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                         const unsigned char *key, const unsigned char *iv,
+                         int enc)
+{
+    int ret;
+
+    EVP_CIPHER_CTX_set_cipher_data(ctx, actx->sw_data);
+    ret = EVP_CIPHER_meth_get_init(actx->sw)(ctx, key, iv, enc);
+    EVP_CIPHER_CTX_set_cipher_data(ctx, actx);
+    return ret;
+}
+
+static int afalg_sw_do_cipher(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                              unsigned char *out, const unsigned char *in,
+                              size_t len)
+{
+    int ret;
+
+    EVP_CIPHER_CTX_set_cipher_data(ctx, actx->sw_data);
+    ret = EVP_CIPHER_meth_get_do_cipher(actx->sw)(ctx, out, in, len);
+    EVP_CIPHER_CTX_set_cipher_data(ctx, actx);
+    return ret;
+}
+
+static int afalg_sw_ctrl(EVP_CIPHER_CTX *ctx, afalg_ctx *actx, int type,
+                         int arg, void *ptr)
+{
+    int ret;
+
+    if (EVP_CIPHER_meth_get_ctrl(actx->sw) == NULL)
+        return -1;
+    EVP_CIPHER_CTX_set_cipher_data(ctx, actx->sw_data);
+    ret = EVP_CIPHER_meth_get_ctrl(actx->sw)(ctx, type, arg, ptr);
+    EVP_CIPHER_CTX_set_cipher_data(ctx, actx);
+    return ret;
+}
+
+static int afalg_ctx_setup(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                           const char *type)
+{
+    int i;
+
+    if (actx->init_done == MAGIC_INIT_NUM)
+        return 1;
+
+    actx->sw = afalg_sw_cipher(EVP_CIPHER_CTX_nid(ctx));
+    if (actx->sw == NULL)
+        return 0;
+    actx->sw_data = OPENSSL_zalloc(EVP_CIPHER_impl_ctx_size(actx->sw));
+    if (actx->sw_data == NULL) {
+        AFALGerr(AFALG_F_AFALG_CTX_SETUP, AFALG_R_MEM_ALLOC_FAILED);
         return 0;
     }
+    actx->type = type;
+    for (i = 0; i < MAX_INFLIGHTS; i++)
+        actx->sfd[i] = -1;
+    actx->bfd = -1;
+    actx->zc_pipe[0] = actx->zc_pipe[1] = -1;
+    actx->aio.efd = -1;
+    actx->aio.mode = MODE_UNINIT;
+    actx->aio.aio_ctx = 0;
+    actx->aio.aio_nr = 0;
+    actx->init_done = MAGIC_INIT_NUM;
+    return 1;
+}
 
-    if (sbytes != (ssize_t) inl) {
-        ALG_WARN("Cipher operation send bytes %zd != inlen %zd\n", sbytes,
-                inl);
+/*
+ * A new key takes effect the next time a request goes to the kernel. The
+ * key of a socket that has operation sockets can't be changed, so start
+ * over with new ones, unless it is the same key again.
+ */
+static void afalg_new_key(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                          const unsigned char *key)
+{
+    if (actx->keylen == EVP_CIPHER_CTX_key_length(ctx)
+            && CRYPTO_memcmp(actx->key, key, actx->keylen) == 0)
+        return;
+    afalg_close_session(actx);
+    actx->keylen = EVP_CIPHER_CTX_key_length(ctx);
+    memcpy(actx->key, key, actx->keylen);
+}
+
+static int afalg_cipher_copy(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                             EVP_CIPHER_CTX *out)
+{
+    afalg_ctx *oactx = EVP_CIPHER_CTX_get_cipher_data(out);
+    size_t size;
+    int i, ret = 1;
+
+    if (actx->init_done != MAGIC_INIT_NUM)
+        return 1;
+
+    /* The copy opens its own sockets when it needs them */
+    for (i = 0; i < MAX_INFLIGHTS; i++)
+        oactx->sfd[i] = -1;
+    oactx->bfd = -1;
+    oactx->zc_pipe[0] = oactx->zc_pipe[1] = -1;
+    oactx->aio.aio_ctx = 0;
+    oactx->aio.aio_nr = 0;
+    oactx->aio.efd = -1;
+    oactx->aio.mode = MODE_UNINIT;
+    oactx->numpipes = 0;
+
+    size = EVP_CIPHER_impl_ctx_size(actx->sw);
+    if ((oactx->sw_data = OPENSSL_malloc(size)) == NULL) {
+        AFALGerr(AFALG_F_AFALG_CIPHER_COPY, AFALG_R_MEM_ALLOC_FAILED);
+        oactx->init_done = 0;
         return 0;
     }
-# endif
-
-    return 1;
+    memcpy(oactx->sw_data, actx->sw_data, size);
+
+    if (EVP_CIPHER_flags(actx->sw) & EVP_CIPH_CUSTOM_COPY) {
+        EVP_CIPHER_CTX_set_cipher_data(ctx, actx->sw_data);
+        EVP_CIPHER_CTX_set_cipher_data(out, oactx->sw_data);
+        ret = EVP_CIPHER_meth_get_ctrl(actx->sw)(ctx, EVP_CTRL_COPY, 0, out);
+        EVP_CIPHER_CTX_set_cipher_data(out, oactx);
+        EVP_CIPHER_CTX_set_cipher_data(ctx, actx);
+    }
+    return ret;
 }
 
 static int afalg_cipher_init(EVP_CIPHER_CTX *ctx, const unsigned char *key,
                              const unsigned char *iv, int enc)
 {
     int ciphertype;
-    int ret;
     afalg_ctx *actx;
-    const char *ciphername;
 
     if (ctx == NULL || key == NULL) {
         ALG_WARN("%s(%d): Null Parameter\n", __FILE__, __LINE__);
@@ -521,7 +891,6 @@ static int afalg_cipher_init(EVP_CIPHER_CTX *ctx, const unsigned char *key,
     case NID_aes_128_cbc:
     case NID_aes_192_cbc:
     case NID_aes_256_cbc:
-        ciphername = "cbc(aes)";
         break;
     default:
         ALG_WARN("%s(%d): Unsupported Cipher type %d\n", __FILE__, __LINE__,
@@ -535,54 +904,26 @@ static int afalg_cipher_init(EVP_CIPHER_CTX *ctx, const unsigned char *key,
         return 0;
     }
 
-    /* Setup AFALG socket for crypto processing */
-    ret = afalg_create_sk(actx, "skcipher", ciphername);
-    if (ret < 1)
+    /*
+     * Sockets are only opened once a request large enough for the kernel
+     * comes along, smaller ones are processed in user space
+     */
+    if (!afalg_ctx_setup(ctx, actx, "skcipher")
+            || !afalg_sw_init(ctx, actx, key, iv, enc))
         return 0;
-
-
-    ret = afalg_set_key(actx, key, EVP_CIPHER_CTX_key_length(ctx));
-    if (ret < 1)
-        goto err;
-
-    /* Setup AIO ctx to allow async AFALG crypto processing */
-    if (afalg_init_aio(&actx->aio) == 0)
-        goto err;
-
-# ifdef ALG_ZERO_COPY
-    pipe(actx->zc_pipe);
-# endif
-
-    actx->init_done = MAGIC_INIT_NUM;
+    afalg_new_key(ctx, actx, key);
+    actx->numpipes = 0;
 
     return 1;
-
-err:
-    close(actx->sfd);
-    close(actx->bfd);
-    return 0;
 }
 
-static int afalg_do_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
-                           const unsigned char *in, size_t inl)
+static int afalg_cbc_kernel(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                            unsigned char *out, const unsigned char *in,
+                            size_t inl)
 {
-    afalg_ctx *actx;
     int ret;
     char nxtiv[ALG_AES_IV_LEN] = { 0 };
 
-    if (ctx == NULL || out == NULL || in == NULL) {
-        ALG_WARN("NULL parameter passed to function %s(%d)\n", __FILE__,
-                 __LINE__);
-        return 0;
-    }
-
-    actx = (afalg_ctx *) EVP_CIPHER_CTX_get_cipher_data(ctx);
-    if (actx == NULL || actx->init_done != MAGIC_INIT_NUM) {
-        ALG_WARN("%s afalg ctx passed\n",
-                 ctx == NULL ? "NULL" : "Uninitialised");
-        return 0;
-    }
-
     /*
      * set iv now for decrypt operation as the input buffer can be
      * overwritten for inplace operation where in = out.
@@ -592,15 +933,17 @@ static int afalg_do_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
     }
 
     /* Send input data to kernel space */
-    ret = afalg_start_cipher_sk(actx, (unsigned char *)in, inl,
-                                EVP_CIPHER_CTX_iv(ctx),
-                                EVP_CIPHER_CTX_encrypting(ctx));
+    ret = afalg_start_cipher_sk(actx, actx->sfd[0],
+                                EVP_CIPHER_CTX_encrypting(ctx),
+                                EVP_CIPHER_CTX_iv(ctx), ALG_AES_IV_LEN,
+                                NULL, 0, in, inl, NULL, 0);
     if (ret < 1) {
         return 0;
     }
 
     /* Perform async crypto operation in kernel space */
-    ret = afalg_fin_cipher_aio(&actx->aio, actx->sfd, out, inl);
+    afalg_prep_read(&actx->aio, 0, actx->sfd[0], out, inl, NULL, 0);
+    ret = afalg_fin_cipher_aio(&actx->aio, 1);
     if (ret < 1)
         return 0;
 
@@ -614,46 +957,568 @@ static int afalg_do_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
     return 1;
 }
 
-static int afalg_cipher_cleanup(EVP_CIPHER_CTX *ctx)
+static int afalg_cbc_cipher(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                            unsigned char *out, const unsigned char *in,
+                            size_t inl)
 {
-    afalg_ctx *actx;
+    size_t len;
 
-    if (ctx == NULL) {
-        ALG_WARN("NULL parameter passed to function %s(%d)\n", __FILE__,
-                 __LINE__);
-        return 0;
-    }
+    /* Both implementations keep the running IV in |ctx| */
+    if (inl < kernel_min
+            || !afalg_open_session(actx, EVP_CIPHER_CTX_nid(ctx), 1))
+        return afalg_sw_do_cipher(ctx, actx, out, in, inl);
 
-    actx = (afalg_ctx *) EVP_CIPHER_CTX_get_cipher_data(ctx);
-    if (actx == NULL || actx->init_done != MAGIC_INIT_NUM) {
-        ALG_WARN("%s afalg ctx passed\n",
-                 ctx == NULL ? "NULL" : "Uninitialised");
-        return 0;
+    for (; inl > 0; inl -= len, in += len, out += len) {
+        len = inl > AFALG_MAX_REQUEST ? AFALG_MAX_REQUEST : inl;
+        if (!afalg_cbc_kernel(ctx, actx, out, in, len))
+            return 0;
     }
+    return 1;
+}
 
-    close(actx->sfd);
-    close(actx->bfd);
-# ifdef ALG_ZERO_COPY
-    close(actx->zc_pipe[0]);
-    close(actx->zc_pipe[1]);
-# endif
-    /* close efd in sync mode, async mode is closed in afalg_waitfd_cleanup() */
-    if (actx->aio.mode == MODE_SYNC)
+static int afalg_cbc_serial(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                            unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+        if (!afalg_cbc_cipher(ctx, actx, actx->outbufs[i], actx->inbufs[i],
+                              actx->lens[i]))
+            return 0;
+    return 1;
+}
+
+/*
+ * Encrypts the |n| pipes as a single request: CBC over the concatenated
+ * pipes is exactly what encrypting them in turn gives, so the input is
+ * gathered with one sendmsg() and the output scattered back with one
+ * preadv.
+ */
+static int afalg_cbc_chained(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                             unsigned int n, size_t total)
+{
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iniov[MAX_INFLIGHTS], outiov[MAX_INFLIGHTS];
+    char cbuf[CMSG_SPACE(ALG_IV_LEN(ALG_AES_IV_LEN)) + CMSG_SPACE(ALG_OP_LEN)];
+    ssize_t sbytes;
+    unsigned int i;
+
+    for (i = 0; i < n && i < MAX_INFLIGHTS; i++) {
+        iniov[i].iov_base = (unsigned char *)actx->inbufs[i];
+        iniov[i].iov_len = actx->lens[i];
+        outiov[i].iov_base = actx->outbufs[i];
+        outiov[i].iov_len = actx->lens[i];
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    afalg_set_op_sk(cmsg, 1);
+    cmsg = CMSG_NXTHDR(&msg, cmsg);
+    afalg_set_iv_sk(cmsg, EVP_CIPHER_CTX_iv(ctx), ALG_AES_IV_LEN);
+    msg.msg_iov = iniov;
+    msg.msg_iovlen = n;
+
+    sbytes = sendmsg(actx->sfd[0], &msg, 0);
+    if (sbytes != (ssize_t)total) {
+        ALG_PERR("%s(%d): sendmsg failed for cipher operation : ", __FILE__,
+                 __LINE__);
+        return 0;
+    }
+
+    afalg_prep_read(&actx->aio, 0, actx->sfd[0], NULL, 0, outiov, n);
+    if (afalg_fin_cipher_aio(&actx->aio, 1) < 1)
+        return 0;
+
+    memcpy(EVP_CIPHER_CTX_iv_noconst(ctx),
+           actx->outbufs[n - 1] + actx->lens[n - 1] - ALG_AES_IV_LEN,
+           ALG_AES_IV_LEN);
+    return 1;
+}
+
+/*
+ * Pipelined requests produce what processing the pipes in turn would.
+ * Encryption chains every pipe to the one before it and goes to the kernel
+ * as one request. Decryption doesn't have to wait for the previous pipe:
+ * each gets an operation socket of its own, all of them are read with a
+ * single io_submit().
+ */
+static int afalg_cbc_pipeline(EVP_CIPHER_CTX *ctx, afalg_ctx *actx)
+{
+    unsigned int i, n = actx->numpipes;
+    int enc = EVP_CIPHER_CTX_encrypting(ctx);
+    size_t total = 0;
+    unsigned char ivs[MAX_INFLIGHTS][ALG_AES_IV_LEN];
+    unsigned char nxtiv[ALG_AES_IV_LEN];
+
+    actx->numpipes = 0;
+
+    if (n == 0 || n > MAX_INFLIGHTS)
+        return afalg_cbc_serial(ctx, actx, n);
+
+    for (i = 0; i < n; i++) {
+        if (actx->lens[i] < ALG_AES_IV_LEN
+                || actx->lens[i] > AFALG_MAX_REQUEST
+                || actx->lens[i] % AES_BLOCK_SIZE != 0)
+            break;
+        total += actx->lens[i];
+    }
+    if (i < n || total < kernel_min || (enc && total > AFALG_MAX_REQUEST)
+            || !afalg_open_session(actx, EVP_CIPHER_CTX_nid(ctx),
+                                   enc ? 1 : n))
+        return afalg_cbc_serial(ctx, actx, n);
+
+    if (enc)
+        return afalg_cbc_chained(ctx, actx, n, total);
+
+    /* Input may be overwritten in place, so take the IVs first */
+    memcpy(ivs[0], EVP_CIPHER_CTX_iv(ctx), ALG_AES_IV_LEN);
+    for (i = 1; i < n && i < MAX_INFLIGHTS; i++)
+        memcpy(ivs[i], actx->inbufs[i - 1] + actx->lens[i - 1]
+                       - ALG_AES_IV_LEN, ALG_AES_IV_LEN);
+    memcpy(nxtiv, actx->inbufs[n - 1] + actx->lens[n - 1] - ALG_AES_IV_LEN,
+           ALG_AES_IV_LEN);
+
+    for (i = 0; i < n; i++) {
+        if (!afalg_start_cipher_sk(actx, actx->sfd[i], 0, ivs[i],
+                                   ALG_AES_IV_LEN, NULL, 0, actx->inbufs[i],
+                                   actx->lens[i], NULL, 0))
+            return 0;
+        afalg_prep_read(&actx->aio, i, actx->sfd[i], actx->outbufs[i],
+                        actx->lens[i], NULL, 0);
+    }
+    if (afalg_fin_cipher_aio(&actx->aio, n) < 1)
+        return 0;
+
+    memcpy(EVP_CIPHER_CTX_iv_noconst(ctx), nxtiv, ALG_AES_IV_LEN);
+    return 1;
+}
+
+static int afalg_do_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
+                           const unsigned char *in, size_t inl)
+{
+    afalg_ctx *actx;
+
+    if (ctx == NULL) {
+        ALG_WARN("NULL parameter passed to function %s(%d)\n", __FILE__,
+                 __LINE__);
+        return 0;
+    }
+
+    actx = (afalg_ctx *) EVP_CIPHER_CTX_get_cipher_data(ctx);
+    if (actx == NULL || actx->init_done != MAGIC_INIT_NUM) {
+        ALG_WARN("%s afalg ctx passed\n",
+                 ctx == NULL ? "NULL" : "Uninitialised");
+        return 0;
+    }
+
+    if (actx->numpipes > 0)
+        return afalg_cbc_pipeline(ctx, actx);
+
+    if (out == NULL || in == NULL) {
+        ALG_WARN("NULL parameter passed to function %s(%d)\n", __FILE__,
+                 __LINE__);
+        return 0;
+    }
+
+    return afalg_cbc_cipher(ctx, actx, out, in, inl);
+}
+
+static int afalg_cipher_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg,
+                             void *ptr)
+{
+    afalg_ctx *actx = EVP_CIPHER_CTX_get_cipher_data(ctx);
+
+    if (actx == NULL)
+        return 0;
+
+    switch (type) {
+    case EVP_CTRL_SET_PIPELINE_OUTPUT_BUFS:
+        actx->numpipes = arg;
+        actx->outbufs = (unsigned char **)ptr;
+        return 1;
+
+    case EVP_CTRL_SET_PIPELINE_INPUT_BUFS:
+        actx->numpipes = arg;
+        actx->inbufs = (const unsigned char **)ptr;
+        return 1;
+
+    case EVP_CTRL_SET_PIPELINE_INPUT_LENS:
+        actx->numpipes = arg;
+        actx->lens = (size_t *)ptr;
+        return 1;
+
+    case EVP_CTRL_COPY:
+        return afalg_cipher_copy(ctx, actx, ptr);
+
+    default:
+        return -1;
+    }
+}
+
+static int afalg_cipher_cleanup(EVP_CIPHER_CTX *ctx)
+{
+    afalg_ctx *actx;
+
+    if (ctx == NULL) {
+        ALG_WARN("NULL parameter passed to function %s(%d)\n", __FILE__,
+                 __LINE__);
+        return 0;
+    }
+
+    actx = (afalg_ctx *) EVP_CIPHER_CTX_get_cipher_data(ctx);
+    if (actx == NULL || actx->init_done != MAGIC_INIT_NUM)
+        return 1;
+
+    if (EVP_CIPHER_meth_get_cleanup(actx->sw) != NULL) {
+        EVP_CIPHER_CTX_set_cipher_data(ctx, actx->sw_data);
+        EVP_CIPHER_meth_get_cleanup(actx->sw)(ctx);
+        EVP_CIPHER_CTX_set_cipher_data(ctx, actx);
+    }
+    OPENSSL_clear_free(actx->sw_data, EVP_CIPHER_impl_ctx_size(actx->sw));
+    actx->sw_data = NULL;
+
+    afalg_close_session(actx);
+    if (actx->zc_pipe[0] >= 0) {
+        close(actx->zc_pipe[0]);
+        close(actx->zc_pipe[1]);
+    }
+    /* close efd in sync mode, async mode is closed in afalg_waitfd_cleanup() */
+    if (actx->aio.mode == MODE_SYNC)
         close(actx->aio.efd);
-    io_destroy(actx->aio.aio_ctx);
+    if (actx->aio.aio_ctx != 0)
+        io_destroy(actx->aio.aio_ctx);
+    OPENSSL_cleanse(actx->key, sizeof(actx->key));
+    actx->keylen = 0;
+    actx->init_done = 0;
 
     return 1;
 }
 
-static cbc_handles *get_cipher_handle(int nid)
+/*
+ * AES-GCM. The kernel interface takes a whole message at once, but an
+ * update can't tell whether more of the message will follow. So only TLS
+ * records go to the kernel by default. With GCM_ONE_SHOT the application
+ * promises to pass every other message in a single update, which then goes
+ * to the kernel if it comes after the key, the IV, any AAD and when
+ * decrypting the tag. Everything else goes to the built in implementation,
+ * which always sees the key, IV and AAD so that it can take over at any
+ * time.
+ */
+static void afalg_aead_reset(afalg_aead *aead)
+{
+    aead->state = AEAD_NEW;
+    aead->aad_ok = 1;
+    aead->aadlen = 0;
+    aead->tag_set = 0;
+    aead->failed = 0;
+}
+
+/*
+ * Processes one message in the kernel. The output is the AAD followed by
+ * the payload, and by the tag when encrypting. The AAD is read back into
+ * |aad| itself.
+ */
+static int afalg_aead_kernel(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                             const unsigned char *iv, unsigned char *aad,
+                             size_t aadlen, unsigned char *out,
+                             const unsigned char *in, size_t len,
+                             unsigned char *tag)
+{
+    afalg_aead *aead = &actx->aead;
+    int enc = EVP_CIPHER_CTX_encrypting(ctx);
+    int ret;
+
+    if (!afalg_start_cipher_sk(actx, actx->sfd[0], enc, iv, AES_GCM_IV_LEN,
+                               aad, aadlen, in, len, enc ? NULL : tag,
+                               enc ? 0 : AES_GCM_TAG_LEN))
+        return 0;
+
+    aead->iov[0].iov_base = aad;
+    aead->iov[0].iov_len = aadlen;
+    aead->iov[1].iov_base = out;
+    aead->iov[1].iov_len = len;
+    aead->iov[2].iov_base = tag;
+    aead->iov[2].iov_len = AES_GCM_TAG_LEN;
+    afalg_prep_read(&actx->aio, 0, actx->sfd[0], NULL, 0, aead->iov,
+                    enc ? 3 : 2);
+    ret = afalg_fin_cipher_aio(&actx->aio, 1);
+    if (ret < 0)
+        OPENSSL_cleanse(out, len);
+    return ret;
+}
+
+/*
+ * Handle TLS GCM packet format, see aes_gcm_tls_cipher(). The built in
+ * implementation generates the explicit IVs in either case.
+ */
+static int afalg_gcm_tls_cipher(EVP_CIPHER_CTX *ctx, afalg_ctx *actx,
+                                unsigned char *out, const unsigned char *in,
+                                size_t len)
+{
+    afalg_aead *aead = &actx->aead;
+    int enc = EVP_CIPHER_CTX_encrypting(ctx);
+    unsigned char iv[AES_GCM_IV_LEN];
+    size_t plen;
+    int rv = -1;
+
+    /* Encrypt/decrypt must be performed in place */
+    if (out != in
+        || len < (EVP_GCM_TLS_EXPLICIT_IV_LEN + EVP_GCM_TLS_TAG_LEN))
+        goto err;
+    plen = len - EVP_GCM_TLS_EXPLICIT_IV_LEN - EVP_GCM_TLS_TAG_LEN;
+
+    if (plen >= kernel_min && aead->ivlen == AES_GCM_IV_LEN
+            && plen <= AFALG_MAX_REQUEST
+            && afalg_open_session(actx, EVP_CIPHER_CTX_nid(ctx), 1)) {
+        if (afalg_sw_ctrl(ctx, actx, EVP_CTRL_GET_IV, AES_GCM_IV_LEN, iv) <= 0)
+            goto err;
+        if (enc) {
+            if (afalg_sw_ctrl(ctx, actx, EVP_CTRL_GCM_IV_GEN,
+                              EVP_GCM_TLS_EXPLICIT_IV_LEN, out) <= 0)
+                goto err;
+        }
+        memcpy(iv + AES_GCM_IV_LEN - EVP_GCM_TLS_EXPLICIT_IV_LEN, out,
+               EVP_GCM_TLS_EXPLICIT_IV_LEN);
+        if (afalg_aead_kernel(ctx, actx, iv, aead->tls_aad,
+                              EVP_AEAD_TLS1_AAD_LEN,
+                              out + EVP_GCM_TLS_EXPLICIT_IV_LEN,
+                              in + EVP_GCM_TLS_EXPLICIT_IV_LEN, plen,
+                              out + EVP_GCM_TLS_EXPLICIT_IV_LEN + plen) == 1)
+            rv = enc ? (int)len : (int)plen;
+        goto err;
+    }
+
+    if (afalg_sw_ctrl(ctx, actx, enc ? EVP_CTRL_GCM_IV_GEN
+                                     : EVP_CTRL_GCM_SET_IV_INV,
+                      EVP_GCM_TLS_EXPLICIT_IV_LEN, out) <= 0
+            || (!enc && afalg_sw_ctrl(ctx, actx, EVP_CTRL_AEAD_SET_TAG,
+                                      EVP_GCM_TLS_TAG_LEN,
+                                      out + EVP_GCM_TLS_EXPLICIT_IV_LEN
+                                      + plen) <= 0)
+            || afalg_sw_do_cipher(ctx, actx, NULL, aead->tls_aad,
+                                  EVP_AEAD_TLS1_AAD_LEN) < 0
+            || afalg_sw_do_cipher(ctx, actx, out + EVP_GCM_TLS_EXPLICIT_IV_LEN,
+                                  in + EVP_GCM_TLS_EXPLICIT_IV_LEN, plen) < 0)
+        goto err;
+    if (afalg_sw_do_cipher(ctx, actx, NULL, NULL, 0) < 0) {
+        /* If tag mismatch wipe buffer */
+        OPENSSL_cleanse(out + EVP_GCM_TLS_EXPLICIT_IV_LEN, plen);
+        goto err;
+    }
+    if (enc && afalg_sw_ctrl(ctx, actx, EVP_CTRL_AEAD_GET_TAG,
+                             EVP_GCM_TLS_TAG_LEN,
+                             out + EVP_GCM_TLS_EXPLICIT_IV_LEN + plen) <= 0)
+        goto err;
+    rv = enc ? (int)len : (int)plen;
+
+ err:
+    aead->tls_aad_len = -1;
+    return rv;
+}
+
+static int afalg_gcm_init(EVP_CIPHER_CTX *ctx, const unsigned char *key,
+                          const unsigned char *iv, int enc)
+{
+    afalg_ctx *actx = EVP_CIPHER_CTX_get_cipher_data(ctx);
+    afalg_aead *aead;
+
+    if (actx == NULL || actx->init_done != MAGIC_INIT_NUM) {
+        ALG_WARN("%s(%d): Cipher data NULL\n", __FILE__, __LINE__);
+        return 0;
+    }
+    aead = &actx->aead;
+
+    if (!afalg_sw_init(ctx, actx, key, iv, enc))
+        return 0;
+    if (key != NULL)
+        afalg_new_key(ctx, actx, key);
+    if (iv != NULL) {
+        aead->iv_set = aead->ivlen == AES_GCM_IV_LEN;
+        if (aead->iv_set)
+            memcpy(aead->iv, iv, AES_GCM_IV_LEN);
+    }
+    if (key != NULL || iv != NULL) {
+        afalg_aead_reset(aead);
+        aead->tag_ready = 0;
+    }
+    return 1;
+}
+
+static int afalg_gcm_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
+                            const unsigned char *in, size_t len)
+{
+    afalg_ctx *actx = EVP_CIPHER_CTX_get_cipher_data(ctx);
+    afalg_aead *aead;
+    int enc = EVP_CIPHER_CTX_encrypting(ctx);
+    int ret;
+
+    if (actx == NULL || actx->init_done != MAGIC_INIT_NUM)
+        return -1;
+    aead = &actx->aead;
+
+    if (aead->tls_aad_len >= 0)
+        return afalg_gcm_tls_cipher(ctx, actx, out, in, len);
+
+    if (in == NULL) {
+        if (aead->state == AEAD_KERNEL) {
+            ret = aead->failed ? -1 : 0;
+            aead->tag_ready = enc;
+        } else {
+            ret = afalg_sw_do_cipher(ctx, actx, NULL, NULL, 0);
+            aead->tag_ready = 0;
+        }
+        /* Don't reuse the IV */
+        afalg_aead_reset(aead);
+        aead->iv_set = 0;
+        return ret;
+    }
+
+    if (aead->state == AEAD_KERNEL) {
+        ALG_WARN("%s(%d): AEAD message already complete\n", __FILE__,
+                 __LINE__);
+        return -1;
+    }
+
+    aead->tag_ready = 0;
+    if (out == NULL) {
+        ret = afalg_sw_do_cipher(ctx, actx, NULL, in, len);
+        if (ret >= 0 && aead->state == AEAD_NEW && aead->aad_ok) {
+            if (len > AFALG_MAX_AAD - aead->aadlen) {
+                aead->aad_ok = 0;
+            } else {
+                memcpy(aead->aad + aead->aadlen, in, len);
+                aead->aadlen += len;
+            }
+        }
+        return ret;
+    }
+
+    if (gcm_one_shot && aead->state == AEAD_NEW && aead->iv_set
+            && aead->aad_ok && len >= kernel_min && len > 0
+            && len + aead->aadlen <= AFALG_MAX_REQUEST
+            && (enc || (aead->tag_set && aead->taglen == AES_GCM_TAG_LEN))
+            && afalg_open_session(actx, EVP_CIPHER_CTX_nid(ctx), 1)) {
+        aead->state = AEAD_KERNEL;
+        ret = afalg_aead_kernel(ctx, actx, aead->iv, aead->aad, aead->aadlen,
+                                out, in, len, aead->tag);
+        if (ret == 0)
+            return -1;
+        aead->failed = ret < 0;
+        return (int)len;
+    }
+
+    aead->state = AEAD_SOFTWARE;
+    return afalg_sw_do_cipher(ctx, actx, out, in, len);
+}
+
+static int afalg_gcm_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg, void *ptr)
+{
+    afalg_ctx *actx = EVP_CIPHER_CTX_get_cipher_data(ctx);
+    afalg_aead *aead;
+    int ret;
+
+    if (actx == NULL)
+        return 0;
+    aead = &actx->aead;
+
+    if (type == EVP_CTRL_INIT) {
+        if (!afalg_ctx_setup(ctx, actx, "aead"))
+            return 0;
+        aead->ivlen = AES_GCM_IV_LEN;
+        aead->iv_set = 0;
+        aead->tag_ready = 0;
+        aead->tls_aad_len = -1;
+        afalg_aead_reset(aead);
+    } else if (actx->init_done != MAGIC_INIT_NUM) {
+        return 0;
+    }
+
+    switch (type) {
+    case EVP_CTRL_AEAD_SET_IVLEN:
+        aead->ivlen = arg;
+        aead->iv_set = 0;
+        break;
+
+    case EVP_CTRL_AEAD_SET_TAG:
+        ret = afalg_sw_ctrl(ctx, actx, type, arg, ptr);
+        if (ret > 0 && ptr != NULL) {
+            memcpy(aead->tag, ptr, arg);
+            aead->taglen = arg;
+            aead->tag_set = 1;
+        }
+        return ret;
+
+    case EVP_CTRL_AEAD_GET_TAG:
+        if (!aead->tag_ready)
+            break;
+        if (arg <= 0 || arg > AES_GCM_TAG_LEN
+                || !EVP_CIPHER_CTX_encrypting(ctx))
+            return 0;
+        memcpy(ptr, aead->tag, arg);
+        return 1;
+
+    case EVP_CTRL_GCM_SET_IV_FIXED:
+    case EVP_CTRL_GCM_IV_GEN:
+    case EVP_CTRL_GCM_SET_IV_INV:
+        /* The IV is now only known to the built in implementation */
+        aead->iv_set = 0;
+        break;
+
+    case EVP_CTRL_AEAD_TLS1_AAD:
+        {
+            unsigned int len;
+
+            /* Save the AAD for later use */
+            if (arg != EVP_AEAD_TLS1_AAD_LEN)
+                return 0;
+            memcpy(aead->tls_aad, ptr, arg);
+            len = aead->tls_aad[arg - 2] << 8 | aead->tls_aad[arg - 1];
+            /* Correct length for explicit IV */
+            if (len < EVP_GCM_TLS_EXPLICIT_IV_LEN)
+                return 0;
+            len -= EVP_GCM_TLS_EXPLICIT_IV_LEN;
+            /* If decrypting correct for tag too */
+            if (!EVP_CIPHER_CTX_encrypting(ctx)) {
+                if (len < EVP_GCM_TLS_TAG_LEN)
+                    return 0;
+                len -= EVP_GCM_TLS_TAG_LEN;
+            }
+            aead->tls_aad[arg - 2] = len >> 8;
+            aead->tls_aad[arg - 1] = len & 0xff;
+            aead->tls_aad_len = arg;
+            /* Extra padding: tag appended to record */
+            return EVP_GCM_TLS_TAG_LEN;
+        }
+
+    case EVP_CTRL_COPY:
+        return afalg_cipher_copy(ctx, actx, ptr);
+
+    default:
+        break;
+    }
+
+    return afalg_sw_ctrl(ctx, actx, type, arg, ptr);
+}
+
+static cipher_handles *get_cipher_handle(int nid)
 {
     switch (nid) {
     case NID_aes_128_cbc:
-        return &cbc_handle[AES_CBC_128];
+        return &afalg_cipher_handles[AES_CBC_128];
     case NID_aes_192_cbc:
-        return &cbc_handle[AES_CBC_192];
+        return &afalg_cipher_handles[AES_CBC_192];
     case NID_aes_256_cbc:
-        return &cbc_handle[AES_CBC_256];
+        return &afalg_cipher_handles[AES_CBC_256];
+    case NID_aes_128_gcm:
+        return &afalg_cipher_handles[AES_GCM_128];
+    case NID_aes_192_gcm:
+        return &afalg_cipher_handles[AES_GCM_192];
+    case NID_aes_256_gcm:
+        return &afalg_cipher_handles[AES_GCM_256];
     default:
         return NULL;
     }
@@ -661,7 +1526,7 @@ static cbc_handles *get_cipher_handle(int nid)
 
 static const EVP_CIPHER *afalg_aes_cbc(int nid)
 {
-    cbc_handles *cipher_handle = get_cipher_handle(nid);
+    cipher_handles *cipher_handle = get_cipher_handle(nid);
     if (cipher_handle->_hidden == NULL
         && ((cipher_handle->_hidden =
          EVP_CIPHER_meth_new(nid,
@@ -671,11 +1536,49 @@ static const EVP_CIPHER *afalg_aes_cbc(int nid)
                                           AES_IV_LEN)
         || !EVP_CIPHER_meth_set_flags(cipher_handle->_hidden,
                                       EVP_CIPH_CBC_MODE |
-                                      EVP_CIPH_FLAG_DEFAULT_ASN1)
+                                      EVP_CIPH_FLAG_DEFAULT_ASN1 |
+                                      EVP_CIPH_FLAG_PIPELINE |
+                                      EVP_CIPH_CUSTOM_COPY)
         || !EVP_CIPHER_meth_set_init(cipher_handle->_hidden,
                                      afalg_cipher_init)
         || !EVP_CIPHER_meth_set_do_cipher(cipher_handle->_hidden,
                                           afalg_do_cipher)
+        || !EVP_CIPHER_meth_set_ctrl(cipher_handle->_hidden,
+                                     afalg_cipher_ctrl)
+        || !EVP_CIPHER_meth_set_cleanup(cipher_handle->_hidden,
+                                        afalg_cipher_cleanup)
+        || !EVP_CIPHER_meth_set_impl_ctx_size(cipher_handle->_hidden,
+                                              sizeof(afalg_ctx)))) {
+        EVP_CIPHER_meth_free(cipher_handle->_hidden);
+        cipher_handle->_hidden= NULL;
+    }
+    return cipher_handle->_hidden;
+}
+
+static const EVP_CIPHER *afalg_aes_gcm(int nid)
+{
+    cipher_handles *cipher_handle = get_cipher_handle(nid);
+    if (cipher_handle->_hidden == NULL
+        && ((cipher_handle->_hidden =
+         EVP_CIPHER_meth_new(nid, 1, cipher_handle->key_size)) == NULL
+        || !EVP_CIPHER_meth_set_iv_length(cipher_handle->_hidden,
+                                          AES_GCM_IV_LEN)
+        || !EVP_CIPHER_meth_set_flags(cipher_handle->_hidden,
+                                      EVP_CIPH_GCM_MODE |
+                                      EVP_CIPH_FLAG_AEAD_CIPHER |
+                                      EVP_CIPH_FLAG_DEFAULT_ASN1 |
+                                      EVP_CIPH_CUSTOM_IV |
+                                      EVP_CIPH_FLAG_CUSTOM_CIPHER |
+                                      EVP_CIPH_ALWAYS_CALL_INIT |
+                                      EVP_CIPH_CTRL_INIT |
+                                      EVP_CIPH_CUSTOM_COPY |
+                                      EVP_CIPH_CUSTOM_IV_LENGTH)
+        || !EVP_CIPHER_meth_set_init(cipher_handle->_hidden,
+                                     afalg_gcm_init)
+        || !EVP_CIPHER_meth_set_do_cipher(cipher_handle->_hidden,
+                                          afalg_gcm_cipher)
+        || !EVP_CIPHER_meth_set_ctrl(cipher_handle->_hidden,
+                                     afalg_gcm_ctrl)
         || !EVP_CIPHER_meth_set_cleanup(cipher_handle->_hidden,
                                         afalg_cipher_cleanup)
         || !EVP_CIPHER_meth_set_impl_ctx_size(cipher_handle->_hidden,
@@ -702,6 +1605,11 @@ static int afalg_ciphers(ENGINE *e, const EVP_CIPHER **cipher,
     case NID_aes_256_cbc:
         *cipher = afalg_aes_cbc(nid);
         break;
+    case NID_aes_128_gcm:
+    case NID_aes_192_gcm:
+    case NID_aes_256_gcm:
+        *cipher = afalg_aes_gcm(nid);
+        break;
     default:
         *cipher = NULL;
         r = 0;
@@ -709,6 +1617,243 @@ static int afalg_ciphers(ENGINE *e, const EVP_CIPHER **cipher,
     return r;
 }
 
+/*
+ * Digests. The kernel hashes data as it is sent, so there is no AIO here.
+ * The first update decides whether a message is hashed in the kernel or
+ * in user space.
+ */
+static int afalg_digest_init(EVP_MD_CTX *ctx)
+{
+    afalg_digest_ctx *dctx = EVP_MD_CTX_md_data(ctx);
+
+    if (dctx->init_done != MAGIC_INIT_NUM) {
+        dctx->sfd = -1;
+        dctx->zc_pipe[0] = dctx->zc_pipe[1] = -1;
+        dctx->init_done = MAGIC_INIT_NUM;
+    } else if (dctx->state == DIGEST_KERNEL) {
+        /* Drop what an unfinished message left in the kernel */
+        close(dctx->sfd);
+        dctx->sfd = -1;
+    }
+    dctx->state = DIGEST_UNDECIDED;
+
+    if (EVP_MD_CTX_type(ctx) == NID_sha256)
+        return SHA256_Init(&dctx->sw.sha256);
+    return SHA512_Init(&dctx->sw.sha512);
+}
+
+static int afalg_digest_update(EVP_MD_CTX *ctx, const void *data,
+                               size_t count)
+{
+    afalg_digest_ctx *dctx = EVP_MD_CTX_md_data(ctx);
+    int bfd;
+
+    if (dctx->state == DIGEST_UNDECIDED) {
+        if (count < kernel_min) {
+            dctx->state = DIGEST_SOFTWARE;
+        } else {
+            /* Hash in user space if the kernel can't take the message */
+            if (dctx->sfd < 0) {
+                ERR_set_mark();
+                if (afalg_create_sk(&bfd, "hash",
+                                    afalg_alg_name(EVP_MD_CTX_type(ctx)))) {
+                    dctx->sfd = afalg_accept_sk(bfd);
+                    close(bfd);
+                }
+                ERR_pop_to_mark();
+            }
+            dctx->state = dctx->sfd >= 0 ? DIGEST_KERNEL : DIGEST_SOFTWARE;
+        }
+    }
+
+    if (dctx->state == DIGEST_KERNEL)
+        return afalg_send_data(dctx->zc_pipe, dctx->sfd, data, count, 1);
+    if (EVP_MD_CTX_type(ctx) == NID_sha256)
+        return SHA256_Update(&dctx->sw.sha256, data, count);
+    return SHA512_Update(&dctx->sw.sha512, data, count);
+}
+
+static int afalg_digest_final(EVP_MD_CTX *ctx, unsigned char *md)
+{
+    afalg_digest_ctx *dctx = EVP_MD_CTX_md_data(ctx);
+    int size = EVP_MD_CTX_size(ctx);
+
+    if (dctx->state == DIGEST_KERNEL) {
+        /* The socket can be reused for the next message */
+        dctx->state = DIGEST_UNDECIDED;
+        if (read(dctx->sfd, md, size) != size) {
+            ALG_PERR("%s(%d): read failed for digest : ", __FILE__,
+                     __LINE__);
+            return 0;
+        }
+        return 1;
+    }
+    if (EVP_MD_CTX_type(ctx) == NID_sha256)
+        return SHA256_Final(md, &dctx->sw.sha256);
+    return SHA512_Final(md, &dctx->sw.sha512);
+}
+
+static int afalg_digest_copy(EVP_MD_CTX *to, const EVP_MD_CTX *from)
+{
+    afalg_digest_ctx *dfrom = EVP_MD_CTX_md_data(from);
+    afalg_digest_ctx *dto = EVP_MD_CTX_md_data(to);
+
+    if (dfrom == NULL || dfrom->init_done != MAGIC_INIT_NUM)
+        return 1;
+
+    dto->sfd = -1;
+    dto->zc_pipe[0] = dto->zc_pipe[1] = -1;
+    /* Accepting on an operation socket clones its hash state */
+    if (dfrom->state == DIGEST_KERNEL
+            && (dto->sfd = accept(dfrom->sfd, NULL, 0)) < 0) {
+        ALG_PERR("%s(%d): Socket Accept Failed : ", __FILE__, __LINE__);
+        AFALGerr(AFALG_F_AFALG_DIGEST_COPY, AFALG_R_SOCKET_ACCEPT_FAILED);
+        dto->init_done = 0;
+        return 0;
+    }
+    return 1;
+}
+
+static int afalg_digest_cleanup(EVP_MD_CTX *ctx)
+{
+    afalg_digest_ctx *dctx = EVP_MD_CTX_md_data(ctx);
+
+    if (dctx == NULL || dctx->init_done != MAGIC_INIT_NUM)
+        return 1;
+
+    if (dctx->sfd >= 0)
+        close(dctx->sfd);
+    if (dctx->zc_pipe[0] >= 0) {
+        close(dctx->zc_pipe[0]);
+        close(dctx->zc_pipe[1]);
+    }
+    OPENSSL_cleanse(&dctx->sw, sizeof(dctx->sw));
+    dctx->init_done = 0;
+    return 1;
+}
+
+static digest_handles *get_digest_handle(int nid)
+{
+    switch (nid) {
+    case NID_sha256:
+        return &afalg_digest_handles[AFALG_SHA256];
+    case NID_sha512:
+        return &afalg_digest_handles[AFALG_SHA512];
+    default:
+        return NULL;
+    }
+}
+
+static const EVP_MD *afalg_sha(int nid)
+{
+    digest_handles *digest_handle = get_digest_handle(nid);
+    if (digest_handle->_hidden == NULL
+        && ((digest_handle->_hidden = EVP_MD_meth_new(nid, NID_undef)) == NULL
+        || !EVP_MD_meth_set_input_blocksize(digest_handle->_hidden,
+                                            digest_handle->block_size)
+        || !EVP_MD_meth_set_result_size(digest_handle->_hidden,
+                                        digest_handle->md_size)
+        || !EVP_MD_meth_set_init(digest_handle->_hidden, afalg_digest_init)
+        || !EVP_MD_meth_set_update(digest_handle->_hidden,
+                                   afalg_digest_update)
+        || !EVP_MD_meth_set_final(digest_handle->_hidden, afalg_digest_final)
+        || !EVP_MD_meth_set_copy(digest_handle->_hidden, afalg_digest_copy)
+        || !EVP_MD_meth_set_cleanup(digest_handle->_hidden,
+                                    afalg_digest_cleanup)
+        || !EVP_MD_meth_set_app_datasize(digest_handle->_hidden,
+                                         sizeof(afalg_digest_ctx)))) {
+        EVP_MD_meth_free(digest_handle->_hidden);
+        digest_handle->_hidden = NULL;
+    }
+    return digest_handle->_hidden;
+}
+
+static int afalg_digests(ENGINE *e, const EVP_MD **digest,
+                         const int **nids, int nid)
+{
+    if (digest == NULL) {
+        *nids = afalg_digest_nids;
+        return OSSL_NELEM(afalg_digest_nids);
+    }
+
+    switch (nid) {
+    case NID_sha256:
+    case NID_sha512:
+        *digest = afalg_sha(nid);
+        return 1;
+    default:
+        *digest = NULL;
+        return 0;
+    }
+}
+
+/* Engine ctrls */
+# define AFALG_CMD_KERNEL_MIN       ENGINE_CMD_BASE
+# define AFALG_CMD_ZERO_COPY_MIN    (ENGINE_CMD_BASE + 1)
+# define AFALG_CMD_USE_GENERIC      (ENGINE_CMD_BASE + 2)
+# define AFALG_CMD_GCM_ONE_SHOT     (ENGINE_CMD_BASE + 3)
+
+static const ENGINE_CMD_DEFN afalg_cmds[] = {
+    {AFALG_CMD_KERNEL_MIN,
+     "KERNEL_MIN",
+     "smallest request in bytes that is passed to the kernel, smaller ones "
+     "are processed in user space [default="
+     OPENSSL_MSTR(AFALG_DEFAULT_KERNEL_MIN) "]",
+     ENGINE_CMD_FLAG_NUMERIC},
+    {AFALG_CMD_ZERO_COPY_MIN,
+     "ZERO_COPY_MIN",
+     "smallest buffer in bytes that is spliced into the kernel rather than "
+     "copied [default=" OPENSSL_MSTR(AFALG_DEFAULT_ZERO_COPY_MIN) "]",
+     ENGINE_CMD_FLAG_NUMERIC},
+    {AFALG_CMD_USE_GENERIC,
+     "USE_GENERIC",
+     "use the kernel's generic software implementations (1) instead of the "
+     "highest priority drivers (0) [default=0]",
+     ENGINE_CMD_FLAG_NUMERIC},
+    {AFALG_CMD_GCM_ONE_SHOT,
+     "GCM_ONE_SHOT",
+     "pass AES-GCM messages other than TLS records to the kernel (1), the "
+     "payload of each must then come in a single update [default=0]",
+     ENGINE_CMD_FLAG_NUMERIC},
+    {0, NULL, NULL, 0}
+};
+
+static int afalg_ctrl(ENGINE *e, int cmd, long i, void *p, void (*f) (void))
+{
+    switch (cmd) {
+    case AFALG_CMD_KERNEL_MIN:
+        if (i < 0)
+            break;
+        kernel_min = (size_t)i;
+        return 1;
+
+    case AFALG_CMD_ZERO_COPY_MIN:
+        if (i < 0)
+            break;
+        zero_copy_min = (size_t)i;
+        return 1;
+
+    case AFALG_CMD_USE_GENERIC:
+        if (i != 0 && i != 1)
+            break;
+        use_generic = (int)i;
+        return 1;
+
+    case AFALG_CMD_GCM_ONE_SHOT:
+        if (i != 0 && i != 1)
+            break;
+        gcm_one_shot = (int)i;
+        return 1;
+
+    default:
+        AFALGerr(AFALG_F_AFALG_CTRL, AFALG_R_UNKNOWN_COMMAND);
+        return 0;
+    }
+
+    AFALGerr(AFALG_F_AFALG_CTRL, AFALG_R_INVALID_ARGUMENT);
+    return 0;
+}
+
 static int bind_afalg(ENGINE *e)
 {
     /* Ensure the afalg error handling is set up */
@@ -719,24 +1864,35 @@ static int bind_afalg(ENGINE *e)
         || !ENGINE_set_name(e, engine_afalg_name)
         || !ENGINE_set_destroy_function(e, afalg_destroy)
         || !ENGINE_set_init_function(e, afalg_init)
-        || !ENGINE_set_finish_function(e, afalg_finish)) {
+        || !ENGINE_set_finish_function(e, afalg_finish)
+        || !ENGINE_set_ctrl_function(e, afalg_ctrl)
+        || !ENGINE_set_cmd_defns(e, afalg_cmds)) {
         AFALGerr(AFALG_F_BIND_AFALG, AFALG_R_INIT_FAILED);
         return 0;
     }
 
     /*
-     * Create _hidden_aes_xxx_cbc by calling afalg_aes_xxx_cbc
-     * now, as bind_aflag can only be called by one thread at a
-     * time.
+     * Create _hidden_aes_xxx_cbc, _hidden_aes_xxx_gcm and the digests now,
+     * as bind_aflag can only be called by one thread at a time.
      */
     for(i = 0; i < OSSL_NELEM(afalg_cipher_nids); i++) {
-        if (afalg_aes_cbc(afalg_cipher_nids[i]) == NULL) {
+        const EVP_CIPHER *cipher;
+
+        if (!afalg_ciphers(e, &cipher, NULL, afalg_cipher_nids[i])
+                || cipher == NULL) {
+            AFALGerr(AFALG_F_BIND_AFALG, AFALG_R_INIT_FAILED);
+            return 0;
+        }
+    }
+    for(i = 0; i < OSSL_NELEM(afalg_digest_nids); i++) {
+        if (afalg_sha(afalg_digest_nids[i]) == NULL) {
             AFALGerr(AFALG_F_BIND_AFALG, AFALG_R_INIT_FAILED);
             return 0;
         }
     }
 
-    if (!ENGINE_set_ciphers(e, afalg_ciphers)) {
+    if (!ENGINE_set_ciphers(e, afalg_ciphers)
+        || !ENGINE_set_digests(e, afalg_digests)) {
         AFALGerr(AFALG_F_BIND_AFALG, AFALG_R_INIT_FAILED);
         return 0;
     }
@@ -845,12 +2001,16 @@ static int afalg_finish(ENGINE *e)
     return 1;
 }
 
-static int free_cbc(void)
+static int free_ciphers(void)
 {
     short unsigned int i;
     for(i = 0; i < OSSL_NELEM(afalg_cipher_nids); i++) {
-        EVP_CIPHER_meth_free(cbc_handle[i]._hidden);
-        cbc_handle[i]._hidden = NULL;
+        EVP_CIPHER_meth_free(afalg_cipher_handles[i]._hidden);
+        afalg_cipher_handles[i]._hidden = NULL;
+    }
+    for(i = 0; i < OSSL_NELEM(afalg_digest_nids); i++) {
+        EVP_MD_meth_free(afalg_digest_handles[i]._hidden);
+        afalg_digest_handles[i]._hidden = NULL;
     }
     return 1;
 }
@@ -858,7 +2018,7 @@ static int free_cbc(void)
 static int afalg_destroy(ENGINE *e)
 {
     ERR_unload_AFALG_strings();
-    free_cbc();
+    free_ciphers();
     return 1;
 }
 
@@ -1,5 +1,5 @@
 /*
- * Copyright 2016 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2016-2019 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -44,8 +44,31 @@
 # define AES_KEY_SIZE_192 24
 # define AES_KEY_SIZE_256 32
 # define AES_IV_LEN       16
+# define AES_GCM_IV_LEN   12
+# define AES_GCM_TAG_LEN  16
 
-# define MAX_INFLIGHTS 1
+/*
+ * One request per pipeline, see SSL_MAX_PIPELINES. The AIO context of a
+ * cipher only has room for as many as it has actually used at once.
+ */
+# define MAX_INFLIGHTS 32
+
+/*
+ * Largest request queued on an operation socket in one go, it has to fit
+ * in the socket's send buffer. Must be a multiple of AES_BLOCK_SIZE.
+ */
+# define AFALG_MAX_REQUEST 65536
+/* Largest AEAD associated data kept for the kernel */
+# define AFALG_MAX_AAD 512
+
+/* Requests smaller than this are processed in user space, see KERNEL_MIN */
+# define AFALG_DEFAULT_KERNEL_MIN 4096
+/* Buffers at least this large are spliced into the kernel, see ZERO_COPY_MIN */
+# ifdef ALG_ZERO_COPY
+#  define AFALG_DEFAULT_ZERO_COPY_MIN 0
+# else
+#  define AFALG_DEFAULT_ZERO_COPY_MIN 16384
+# endif
 
 typedef enum {
     MODE_UNINIT = 0,
@@ -56,20 +79,37 @@ typedef enum {
 enum {
     AES_CBC_128 = 0,
     AES_CBC_192,
-    AES_CBC_256
+    AES_CBC_256,
+    AES_GCM_128,
+    AES_GCM_192,
+    AES_GCM_256
 };
 
-struct cbc_cipher_handles {
+struct cipher_handles {
     int key_size;
     EVP_CIPHER *_hidden;
 };
 
-typedef struct cbc_cipher_handles cbc_handles;
+typedef struct cipher_handles cipher_handles;
+
+enum {
+    AFALG_SHA256 = 0,
+    AFALG_SHA512
+};
+
+struct digest_handles {
+    int md_size;
+    int block_size;
+    EVP_MD *_hidden;
+};
+
+typedef struct digest_handles digest_handles;
 
 struct afalg_aio_st {
     int efd;
     op_mode mode;
     aio_context_t aio_ctx;
+    unsigned int aio_nr;
     struct io_event events[MAX_INFLIGHTS];
     struct iocb cbt[MAX_INFLIGHTS];
 };
@@ -81,15 +121,72 @@ typedef struct afalg_aio_st afalg_aio;
  */
 # define MAGIC_INIT_NUM 0x1890671
 
+typedef enum {
+    AEAD_NEW = 0,       /* nothing but AAD seen for this message */
+    AEAD_SOFTWARE,      /* payload is being processed in user space */
+    AEAD_KERNEL         /* payload was processed in one go by the kernel */
+} aead_state;
+
+struct afalg_aead_st {
+    aead_state state;
+    int ivlen;
+    /* IV of the current message, if set with the key */
+    int iv_set;
+    unsigned char iv[AES_GCM_IV_LEN];
+    /* Copy of the AAD fed to the user space implementation */
+    int aad_ok;
+    size_t aadlen;
+    unsigned char aad[AFALG_MAX_AAD];
+    /* Expected tag when decrypting, computed tag when encrypting */
+    int tag_set;
+    int tag_ready;
+    int taglen;
+    unsigned char tag[AES_GCM_TAG_LEN];
+    int failed;
+    int tls_aad_len;
+    unsigned char tls_aad[EVP_AEAD_TLS1_AAD_LEN];
+    struct iovec iov[3];
+};
+typedef struct afalg_aead_st afalg_aead;
+
 struct afalg_ctx_st {
     int init_done;
-    int sfd;
+    /* Operation sockets, sfd[0] is used for requests that are not pipelined */
+    int sfd[MAX_INFLIGHTS];
     int bfd;
-# ifdef ALG_ZERO_COPY
     int zc_pipe[2];
-# endif
     afalg_aio aio;
+    const char *type;
+    int keylen;
+    unsigned char key[AES_KEY_SIZE_256];
+    /* The built in implementation, for requests below KERNEL_MIN */
+    const EVP_CIPHER *sw;
+    void *sw_data;
+    unsigned int numpipes;
+    unsigned char **outbufs;
+    const unsigned char **inbufs;
+    size_t *lens;
+    afalg_aead aead;
 };
 
 typedef struct afalg_ctx_st afalg_ctx;
+
+typedef enum {
+    DIGEST_UNDECIDED = 0,
+    DIGEST_SOFTWARE,
+    DIGEST_KERNEL
+} digest_state;
+
+struct afalg_digest_ctx_st {
+    int init_done;
+    int sfd;
+    int zc_pipe[2];
+    digest_state state;
+    union {
+        SHA256_CTX sha256;
+        SHA512_CTX sha512;
+    } sw;
+};
+
+typedef struct afalg_digest_ctx_st afalg_digest_ctx;
 #endif
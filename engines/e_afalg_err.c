@@ -18,6 +18,7 @@ static ERR_STRING_DATA AFALG_str_reasons[] = {
     {ERR_PACK(0, 0, AFALG_R_FAILED_TO_GET_PLATFORM_INFO),
     "failed to get platform info"},
     {ERR_PACK(0, 0, AFALG_R_INIT_FAILED), "init failed"},
+    {ERR_PACK(0, 0, AFALG_R_INVALID_ARGUMENT), "invalid argument"},
     {ERR_PACK(0, 0, AFALG_R_IO_SETUP_FAILED), "io setup failed"},
     {ERR_PACK(0, 0, AFALG_R_KERNEL_DOES_NOT_SUPPORT_AFALG),
     "kernel does not support afalg"},
@@ -30,6 +31,7 @@ static ERR_STRING_DATA AFALG_str_reasons[] = {
     {ERR_PACK(0, 0, AFALG_R_SOCKET_OPERATION_FAILED),
     "socket operation failed"},
     {ERR_PACK(0, 0, AFALG_R_SOCKET_SET_KEY_FAILED), "socket set key failed"},
+    {ERR_PACK(0, 0, AFALG_R_UNKNOWN_COMMAND), "unknown command"},
     {0, NULL}
 };
 
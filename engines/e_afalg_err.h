@@ -22,9 +22,15 @@
  * AFALG function codes.
  */
 # if !OPENSSL_API_3
+#  define AFALG_F_AFALG_ACCEPT_SK                          0
 #  define AFALG_F_AFALG_CHK_PLATFORM                       0
+#  define AFALG_F_AFALG_CIPHER_COPY                        0
 #  define AFALG_F_AFALG_CREATE_SK                          0
+#  define AFALG_F_AFALG_CTRL                               0
+#  define AFALG_F_AFALG_CTX_SETUP                          0
+#  define AFALG_F_AFALG_DIGEST_COPY                        0
 #  define AFALG_F_AFALG_INIT_AIO                           0
+#  define AFALG_F_AFALG_OPEN_SESSION                       0
 #  define AFALG_F_AFALG_SETUP_ASYNC_EVENT_NOTIFICATION     0
 #  define AFALG_F_AFALG_SET_KEY                            0
 #  define AFALG_F_BIND_AFALG                               0
@@ -36,6 +42,7 @@
 # define AFALG_R_EVENTFD_FAILED                           108
 # define AFALG_R_FAILED_TO_GET_PLATFORM_INFO              111
 # define AFALG_R_INIT_FAILED                              100
+# define AFALG_R_INVALID_ARGUMENT                         112
 # define AFALG_R_IO_SETUP_FAILED                          105
 # define AFALG_R_KERNEL_DOES_NOT_SUPPORT_AFALG            101
 # define AFALG_R_KERNEL_DOES_NOT_SUPPORT_ASYNC_AFALG      107
@@ -45,5 +52,6 @@
 # define AFALG_R_SOCKET_CREATE_FAILED                     109
 # define AFALG_R_SOCKET_OPERATION_FAILED                  104
 # define AFALG_R_SOCKET_SET_KEY_FAILED                    106
+# define AFALG_R_UNKNOWN_COMMAND                          113
 
 #endif
@@ -0,0 +1,792 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A test engine that behaves like a crypto accelerator with a request queue.
+ * RSA, ECDSA and AES-GCM operations started from an ASYNC_JOB are queued for
+ * a pool of worker threads and the job is paused until a worker has carried
+ * the operation out.  Unlike dasync, which only pretends, the job really is
+ * in flight while paused, so the application gets to start other jobs in the
+ * meantime.  Workers signal completion through the ASYNC_WAIT_CTX of the
+ * job: by calling its callback if one is set, otherwise by making a wait fd
+ * readable.  A worker takes up to BATCH queued requests at a time and checks
+ * all ECDSA signatures among them with a single ECDSA_do_verify_batch().
+ *
+ * Operations that are not started from a job, or all of them if THREADS is
+ * 0, are carried out inline.
+ *
+ * To measure an async TLS server end to end, with an RSA or ECDSA key:
+ *
+ *   openssl s_server -engine offload -async -cert cert.pem -key key.pem
+ *   openssl s_time -connect localhost:4433 -new -time 10
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <openssl/engine.h>
+#include <openssl/async.h>
+#include <openssl/crypto.h>
+#include <openssl/rsa.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/err.h>
+
+#if defined(OPENSSL_SYS_UNIX) && defined(OPENSSL_THREADS)
+# include <unistd.h>
+# include <pthread.h>
+# define OFFLOAD_THREADS
+#endif
+
+#include "e_offload_err.c"
+
+/* Engine Id and Name */
+static const char *engine_offload_id = "offload";
+static const char *engine_offload_name =
+    "Threaded batching offload test engine";
+
+#define OFFLOAD_DEFAULT_THREADS 2
+#define OFFLOAD_DEFAULT_BATCH   32
+
+#define OFFLOAD_CMD_THREADS     ENGINE_CMD_BASE
+#define OFFLOAD_CMD_BATCH       (ENGINE_CMD_BASE + 1)
+
+static const ENGINE_CMD_DEFN offload_cmd_defns[] = {
+    {OFFLOAD_CMD_THREADS,
+     "THREADS",
+     "Number of worker threads, 0 carries out all operations inline "
+     "[default=" OPENSSL_MSTR(OFFLOAD_DEFAULT_THREADS) "]",
+     ENGINE_CMD_FLAG_NUMERIC},
+    {OFFLOAD_CMD_BATCH,
+     "BATCH",
+     "Maximum number of requests a worker takes off the queue at a time "
+     "[default=" OPENSSL_MSTR(OFFLOAD_DEFAULT_BATCH) "]",
+     ENGINE_CMD_FLAG_NUMERIC},
+    {0, NULL, NULL, 0}
+};
+
+static long offload_threads = OFFLOAD_DEFAULT_THREADS;
+static long offload_batch = OFFLOAD_DEFAULT_BATCH;
+
+static RSA_METHOD *offload_rsa_method = NULL;
+static EC_KEY_METHOD *offload_ec_method = NULL;
+static EVP_CIPHER *_hidden_aes_128_gcm = NULL;
+static EVP_CIPHER *_hidden_aes_256_gcm = NULL;
+
+static int offload_cipher_nids[] = {
+    NID_aes_128_gcm,
+    NID_aes_256_gcm,
+    0
+};
+
+/* The ECDSA implementation the work is handed to */
+static ECDSA_SIG *(*ecdsa_sign_sig)(const unsigned char *dgst, int dgst_len,
+                                    const BIGNUM *kinv, const BIGNUM *r,
+                                    EC_KEY *eckey);
+static int (*ecdsa_verify_sig)(const unsigned char *dgst, int dgst_len,
+                               const ECDSA_SIG *sig, EC_KEY *eckey);
+
+/* Requests */
+
+#define REQ_RSA_PUB_ENC         0
+#define REQ_RSA_PUB_DEC         1
+#define REQ_RSA_PRIV_ENC        2
+#define REQ_RSA_PRIV_DEC        3
+#define REQ_ECDSA_SIGN          4
+#define REQ_ECDSA_VERIFY        5
+#define REQ_CIPHER              6
+
+typedef struct offload_req_st OFFLOAD_REQ;
+
+/* Lives on the stack of the job that submitted it */
+struct offload_req_st {
+    int type;
+    union {
+        struct {
+            int flen;
+            const unsigned char *from;
+            unsigned char *to;
+            RSA *rsa;
+            int padding;
+        } rsa;
+        struct {
+            const unsigned char *dgst;
+            int dgst_len;
+            const BIGNUM *kinv, *r;
+            const ECDSA_SIG *sig;   /* Only when verifying */
+            EC_KEY *eckey;
+        } ecdsa;
+        struct {
+            EVP_CIPHER_CTX *ctx;
+            unsigned char *out;
+            const unsigned char *in;
+            size_t inl;
+        } cipher;
+    } u;
+    int ret;
+    ECDSA_SIG *sig;                 /* Result of signing */
+#ifdef OFFLOAD_THREADS
+    /* How to tell the job that the request has been carried out */
+    ASYNC_callback_fn callback;
+    void *callback_arg;
+    OSSL_ASYNC_FD writefd;
+    int done;
+    OFFLOAD_REQ *next;
+#endif
+};
+
+static void offload_run(OFFLOAD_REQ *req)
+{
+    const EVP_CIPHER *cipher;
+
+    switch (req->type) {
+    case REQ_RSA_PUB_ENC:
+        req->ret = RSA_meth_get_pub_enc(RSA_PKCS1_OpenSSL())
+            (req->u.rsa.flen, req->u.rsa.from, req->u.rsa.to, req->u.rsa.rsa,
+             req->u.rsa.padding);
+        break;
+    case REQ_RSA_PUB_DEC:
+        req->ret = RSA_meth_get_pub_dec(RSA_PKCS1_OpenSSL())
+            (req->u.rsa.flen, req->u.rsa.from, req->u.rsa.to, req->u.rsa.rsa,
+             req->u.rsa.padding);
+        break;
+    case REQ_RSA_PRIV_ENC:
+        req->ret = RSA_meth_get_priv_enc(RSA_PKCS1_OpenSSL())
+            (req->u.rsa.flen, req->u.rsa.from, req->u.rsa.to, req->u.rsa.rsa,
+             req->u.rsa.padding);
+        break;
+    case REQ_RSA_PRIV_DEC:
+        req->ret = RSA_meth_get_priv_dec(RSA_PKCS1_OpenSSL())
+            (req->u.rsa.flen, req->u.rsa.from, req->u.rsa.to, req->u.rsa.rsa,
+             req->u.rsa.padding);
+        break;
+    case REQ_ECDSA_SIGN:
+        req->sig = ecdsa_sign_sig(req->u.ecdsa.dgst, req->u.ecdsa.dgst_len,
+                                  req->u.ecdsa.kinv, req->u.ecdsa.r,
+                                  req->u.ecdsa.eckey);
+        break;
+    case REQ_ECDSA_VERIFY:
+        req->ret = ecdsa_verify_sig(req->u.ecdsa.dgst, req->u.ecdsa.dgst_len,
+                                    req->u.ecdsa.sig, req->u.ecdsa.eckey);
+        break;
+    case REQ_CIPHER:
+        cipher = EVP_CIPHER_CTX_nid(req->u.cipher.ctx) == NID_aes_128_gcm
+                 ? EVP_aes_128_gcm() : EVP_aes_256_gcm();
+        req->ret = EVP_CIPHER_meth_get_do_cipher(cipher)
+            (req->u.cipher.ctx, req->u.cipher.out, req->u.cipher.in,
+             req->u.cipher.inl);
+        break;
+    }
+}
+
+#ifdef OFFLOAD_THREADS
+
+/*
+ * The request queue and the worker pool.  |offload_lock| protects all of it
+ * as well as the |done| flag of every queued request.
+ */
+static pthread_mutex_t offload_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t offload_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t offload_done = PTHREAD_COND_INITIALIZER;
+static OFFLOAD_REQ *queue_first = NULL, *queue_last = NULL;
+static pthread_t *workers = NULL;
+static long num_workers = 0;
+static int stopping = 0;
+
+typedef struct {
+    OFFLOAD_REQ **reqs;
+    /* Arguments of ECDSA_do_verify_batch() */
+    const unsigned char **dgst;
+    int *dgst_len;
+    const ECDSA_SIG **sig;
+    EC_KEY **eckey;
+    int *res;
+    OFFLOAD_REQ **verify;
+} OFFLOAD_WORKER;
+
+static void worker_free(OFFLOAD_WORKER *w)
+{
+    OPENSSL_free(w->reqs);
+    OPENSSL_free(w->dgst);
+    OPENSSL_free(w->dgst_len);
+    OPENSSL_free(w->sig);
+    OPENSSL_free(w->eckey);
+    OPENSSL_free(w->res);
+    OPENSSL_free(w->verify);
+}
+
+static int worker_alloc(OFFLOAD_WORKER *w, size_t batch)
+{
+    memset(w, 0, sizeof(*w));
+    if ((w->reqs = OPENSSL_malloc(batch * sizeof(*w->reqs))) == NULL
+            || (w->dgst = OPENSSL_malloc(batch * sizeof(*w->dgst))) == NULL
+            || (w->dgst_len = OPENSSL_malloc(batch * sizeof(*w->dgst_len)))
+               == NULL
+            || (w->sig = OPENSSL_malloc(batch * sizeof(*w->sig))) == NULL
+            || (w->eckey = OPENSSL_malloc(batch * sizeof(*w->eckey))) == NULL
+            || (w->res = OPENSSL_malloc(batch * sizeof(*w->res))) == NULL
+            || (w->verify = OPENSSL_malloc(batch * sizeof(*w->verify)))
+               == NULL) {
+        worker_free(w);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * ECDSA_do_verify_batch() only batches keys that use the built-in method,
+ * which the keys handed to this engine do not, so verify against copies of
+ * the public keys.
+ */
+static EC_KEY *verify_key_dup(const EC_KEY *eckey)
+{
+    EC_KEY *key = EC_KEY_new();
+
+    if (key == NULL
+            || !EC_KEY_set_method(key, EC_KEY_OpenSSL())
+            || !EC_KEY_set_group(key, EC_KEY_get0_group(eckey))
+            || !EC_KEY_set_public_key(key, EC_KEY_get0_public_key(eckey))) {
+        EC_KEY_free(key);
+        return NULL;
+    }
+    return key;
+}
+
+static void worker_verify(OFFLOAD_WORKER *w, size_t n)
+{
+    size_t i;
+
+    /* Anything not verified by the batch is verified on its own below */
+    for (i = 0; i < n; i++)
+        w->res[i] = -1;
+    for (i = 0; i < n; i++) {
+        w->dgst[i] = w->verify[i]->u.ecdsa.dgst;
+        w->dgst_len[i] = w->verify[i]->u.ecdsa.dgst_len;
+        w->sig[i] = w->verify[i]->u.ecdsa.sig;
+        if ((w->eckey[i] = verify_key_dup(w->verify[i]->u.ecdsa.eckey))
+                == NULL)
+            break;
+    }
+    if (i == n)
+        ECDSA_do_verify_batch(w->dgst, w->dgst_len, w->sig, w->eckey, n,
+                              w->res);
+    while (i-- > 0)
+        EC_KEY_free(w->eckey[i]);
+
+    for (i = 0; i < n; i++) {
+        if (w->res[i] >= 0)
+            w->verify[i]->ret = w->res[i];
+        else
+            offload_run(w->verify[i]);
+    }
+}
+
+static void worker_process(OFFLOAD_WORKER *w, size_t n)
+{
+    size_t i, nverify = 0;
+
+    for (i = 0; i < n; i++) {
+        if (w->reqs[i]->type == REQ_ECDSA_VERIFY)
+            w->verify[nverify++] = w->reqs[i];
+        else
+            offload_run(w->reqs[i]);
+    }
+    if (nverify == 1)
+        offload_run(w->verify[0]);
+    else if (nverify > 1)
+        worker_verify(w, nverify);
+    /* Errors on this thread mean nothing to the jobs */
+    ERR_clear_error();
+}
+
+static void *offload_worker(void *arg)
+{
+    OFFLOAD_WORKER w;
+    OFFLOAD_REQ *req;
+    size_t batch = (size_t)arg, n, i;
+    char buf = 0;
+
+    if (!worker_alloc(&w, batch)) {
+        /* Still drain the queue, one request at a time */
+        batch = 1;
+        w.reqs = &req;
+    }
+
+    pthread_mutex_lock(&offload_lock);
+    for (;;) {
+        while (queue_first == NULL && !stopping)
+            pthread_cond_wait(&offload_work, &offload_lock);
+        if (queue_first == NULL)
+            break;
+        for (n = 0; n < batch && queue_first != NULL; n++) {
+            w.reqs[n] = queue_first;
+            queue_first = queue_first->next;
+        }
+        if (queue_first == NULL)
+            queue_last = NULL;
+        pthread_mutex_unlock(&offload_lock);
+
+        if (batch > 1)
+            worker_process(&w, n);
+        else
+            offload_run(w.reqs[0]);
+
+        /*
+         * Wake the jobs before marking the requests done: a job that resumes
+         * waits for |done| and may return as soon as it is set, which ends
+         * the life of the request and possibly that of its wait fds.
+         */
+        for (i = 0; i < n; i++) {
+            if (w.reqs[i]->callback != NULL) {
+                w.reqs[i]->callback(w.reqs[i]->callback_arg);
+            } else if (write(w.reqs[i]->writefd, &buf, 1) < 0) {
+                /* Ignore errors - there is no other way to wake the job */
+            }
+        }
+
+        pthread_mutex_lock(&offload_lock);
+        for (i = 0; i < n; i++)
+            w.reqs[i]->done = 1;
+        pthread_cond_broadcast(&offload_done);
+    }
+    pthread_mutex_unlock(&offload_lock);
+
+    if (batch > 1)
+        worker_free(&w);
+    OPENSSL_thread_stop();
+    return NULL;
+}
+
+/* Called with |offload_lock| held */
+static void workers_stop(void)
+{
+    long i;
+
+    stopping = 1;
+    pthread_cond_broadcast(&offload_work);
+    pthread_mutex_unlock(&offload_lock);
+    for (i = 0; i < num_workers; i++)
+        pthread_join(workers[i], NULL);
+    pthread_mutex_lock(&offload_lock);
+    OPENSSL_free(workers);
+    workers = NULL;
+    num_workers = 0;
+    stopping = 0;
+}
+
+static int workers_start(void)
+{
+    int ret = 1;
+
+    pthread_mutex_lock(&offload_lock);
+    if (offload_threads > 0
+            && (workers = OPENSSL_malloc(offload_threads * sizeof(*workers)))
+               == NULL) {
+        OFFLOADerr(0, ERR_R_MALLOC_FAILURE);
+        ret = 0;
+        goto end;
+    }
+    while (num_workers < offload_threads) {
+        if (pthread_create(&workers[num_workers], NULL, offload_worker,
+                           (void *)(size_t)offload_batch) != 0) {
+            OFFLOADerr(0, OFFLOAD_R_INIT_FAILED);
+            workers_stop();
+            ret = 0;
+            goto end;
+        }
+        num_workers++;
+    }
+ end:
+    pthread_mutex_unlock(&offload_lock);
+    return ret;
+}
+
+static void wait_cleanup(ASYNC_WAIT_CTX *ctx, const void *key,
+                         OSSL_ASYNC_FD readfd, void *pvwritefd)
+{
+    OSSL_ASYNC_FD *pwritefd = (OSSL_ASYNC_FD *)pvwritefd;
+
+    close(readfd);
+    close(*pwritefd);
+    OPENSSL_free(pwritefd);
+}
+
+/* Gets the wait fds of this engine in |waitctx|, creating them if needed */
+static int get_wait_fds(ASYNC_WAIT_CTX *waitctx, OSSL_ASYNC_FD *readfd,
+                        OSSL_ASYNC_FD *writefd)
+{
+    OSSL_ASYNC_FD pipefds[2], *pwritefd;
+
+    if (ASYNC_WAIT_CTX_get_fd(waitctx, engine_offload_id, readfd,
+                              (void **)&pwritefd)) {
+        *writefd = *pwritefd;
+        return 1;
+    }
+
+    if ((pwritefd = OPENSSL_malloc(sizeof(*pwritefd))) == NULL)
+        return 0;
+    if (pipe(pipefds) != 0) {
+        OPENSSL_free(pwritefd);
+        return 0;
+    }
+    *pwritefd = pipefds[1];
+    if (!ASYNC_WAIT_CTX_set_wait_fd(waitctx, engine_offload_id, pipefds[0],
+                                    pwritefd, wait_cleanup)) {
+        wait_cleanup(waitctx, engine_offload_id, pipefds[0], pwritefd);
+        return 0;
+    }
+    *readfd = pipefds[0];
+    *writefd = pipefds[1];
+    return 1;
+}
+
+/*
+ * Queues |req| and pauses the current job until a worker has carried it
+ * out.  Falls back to carrying it out inline when there is no job to pause
+ * or no worker to hand it to.
+ */
+static void offload_submit(OFFLOAD_REQ *req)
+{
+    ASYNC_JOB *job;
+    ASYNC_WAIT_CTX *waitctx;
+    OSSL_ASYNC_FD readfd = OSSL_BAD_ASYNC_FD;
+    char buf;
+
+    if ((job = ASYNC_get_current_job()) == NULL) {
+        offload_run(req);
+        return;
+    }
+
+    waitctx = ASYNC_get_wait_ctx(job);
+    req->writefd = OSSL_BAD_ASYNC_FD;
+    if (!ASYNC_WAIT_CTX_get_callback(waitctx, &req->callback,
+                                     &req->callback_arg))
+        req->callback = NULL;
+    if (req->callback == NULL
+            && !get_wait_fds(waitctx, &readfd, &req->writefd)) {
+        offload_run(req);
+        return;
+    }
+
+    req->done = 0;
+    req->next = NULL;
+    pthread_mutex_lock(&offload_lock);
+    if (num_workers == 0) {
+        pthread_mutex_unlock(&offload_lock);
+        offload_run(req);
+        return;
+    }
+    if (queue_last == NULL)
+        queue_first = req;
+    else
+        queue_last->next = req;
+    queue_last = req;
+    pthread_cond_signal(&offload_work);
+    pthread_mutex_unlock(&offload_lock);
+
+    /* Ignore errors - if we cannot pause we simply wait below */
+    ASYNC_pause_job();
+
+    /*
+     * Normally we are only resumed once a worker has signalled, which is
+     * just before it marks the request done
+     */
+    pthread_mutex_lock(&offload_lock);
+    while (!req->done)
+        pthread_cond_wait(&offload_done, &offload_lock);
+    pthread_mutex_unlock(&offload_lock);
+
+    /* Clear the wake signal */
+    if (req->callback == NULL && read(readfd, &buf, 1) < 0)
+        return;
+}
+
+#else
+
+static void offload_submit(OFFLOAD_REQ *req)
+{
+    offload_run(req);
+}
+
+#endif
+
+/*
+ * RSA implementation
+ */
+
+static int offload_rsa(int type, int flen, const unsigned char *from,
+                       unsigned char *to, RSA *rsa, int padding)
+{
+    OFFLOAD_REQ req;
+
+    memset(&req, 0, sizeof(req));
+    req.type = type;
+    req.u.rsa.flen = flen;
+    req.u.rsa.from = from;
+    req.u.rsa.to = to;
+    req.u.rsa.rsa = rsa;
+    req.u.rsa.padding = padding;
+    offload_submit(&req);
+    return req.ret;
+}
+
+static int offload_rsa_pub_enc(int flen, const unsigned char *from,
+                               unsigned char *to, RSA *rsa, int padding)
+{
+    return offload_rsa(REQ_RSA_PUB_ENC, flen, from, to, rsa, padding);
+}
+
+static int offload_rsa_pub_dec(int flen, const unsigned char *from,
+                               unsigned char *to, RSA *rsa, int padding)
+{
+    return offload_rsa(REQ_RSA_PUB_DEC, flen, from, to, rsa, padding);
+}
+
+static int offload_rsa_priv_enc(int flen, const unsigned char *from,
+                                unsigned char *to, RSA *rsa, int padding)
+{
+    return offload_rsa(REQ_RSA_PRIV_ENC, flen, from, to, rsa, padding);
+}
+
+static int offload_rsa_priv_dec(int flen, const unsigned char *from,
+                                unsigned char *to, RSA *rsa, int padding)
+{
+    return offload_rsa(REQ_RSA_PRIV_DEC, flen, from, to, rsa, padding);
+}
+
+/*
+ * ECDSA implementation
+ */
+
+static ECDSA_SIG *offload_ecdsa_sign_sig(const unsigned char *dgst,
+                                         int dgst_len, const BIGNUM *kinv,
+                                         const BIGNUM *r, EC_KEY *eckey)
+{
+    OFFLOAD_REQ req;
+
+    memset(&req, 0, sizeof(req));
+    req.type = REQ_ECDSA_SIGN;
+    req.u.ecdsa.dgst = dgst;
+    req.u.ecdsa.dgst_len = dgst_len;
+    req.u.ecdsa.kinv = kinv;
+    req.u.ecdsa.r = r;
+    req.u.ecdsa.eckey = eckey;
+    offload_submit(&req);
+    return req.sig;
+}
+
+static int offload_ecdsa_verify_sig(const unsigned char *dgst, int dgst_len,
+                                    const ECDSA_SIG *sig, EC_KEY *eckey)
+{
+    OFFLOAD_REQ req;
+
+    memset(&req, 0, sizeof(req));
+    req.type = REQ_ECDSA_VERIFY;
+    req.u.ecdsa.dgst = dgst;
+    req.u.ecdsa.dgst_len = dgst_len;
+    req.u.ecdsa.sig = sig;
+    req.u.ecdsa.eckey = eckey;
+    offload_submit(&req);
+    return req.ret;
+}
+
+/*
+ * AES-GCM implementation.  The ciphers are copies of the built-in ones, with
+ * the same context data, except that encryption and decryption of data is
+ * queued.  Setting the AAD and computing the tag are not worth the round
+ * trip.
+ */
+
+static int offload_aes_gcm_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
+                                  const unsigned char *in, size_t inl)
+{
+    OFFLOAD_REQ req;
+
+    memset(&req, 0, sizeof(req));
+    req.type = REQ_CIPHER;
+    req.u.cipher.ctx = ctx;
+    req.u.cipher.out = out;
+    req.u.cipher.in = in;
+    req.u.cipher.inl = inl;
+    if (in == NULL || out == NULL)
+        offload_run(&req);
+    else
+        offload_submit(&req);
+    return req.ret;
+}
+
+static EVP_CIPHER *offload_cipher_new(const EVP_CIPHER *inner)
+{
+    EVP_CIPHER *cipher = EVP_CIPHER_meth_dup(inner);
+
+    if (cipher == NULL
+            || !EVP_CIPHER_meth_set_do_cipher(cipher,
+                                              offload_aes_gcm_cipher)) {
+        EVP_CIPHER_meth_free(cipher);
+        return NULL;
+    }
+    return cipher;
+}
+
+static int offload_ciphers(ENGINE *e, const EVP_CIPHER **cipher,
+                           const int **nids, int nid)
+{
+    int ok = 1;
+
+    if (cipher == NULL) {
+        /* We are returning a list of supported nids */
+        *nids = offload_cipher_nids;
+        return (sizeof(offload_cipher_nids) - 1)
+               / sizeof(offload_cipher_nids[0]);
+    }
+    /* We are being asked for a specific cipher */
+    switch (nid) {
+    case NID_aes_128_gcm:
+        *cipher = _hidden_aes_128_gcm;
+        break;
+    case NID_aes_256_gcm:
+        *cipher = _hidden_aes_256_gcm;
+        break;
+    default:
+        *cipher = NULL;
+        break;
+    }
+    if (*cipher == NULL)
+        ok = 0;
+    return ok;
+}
+
+/*
+ * Engine lifetime
+ */
+
+static int offload_init(ENGINE *e)
+{
+#ifdef OFFLOAD_THREADS
+    return workers_start();
+#else
+    return 1;
+#endif
+}
+
+static int offload_finish(ENGINE *e)
+{
+#ifdef OFFLOAD_THREADS
+    pthread_mutex_lock(&offload_lock);
+    workers_stop();
+    pthread_mutex_unlock(&offload_lock);
+#endif
+    return 1;
+}
+
+static int offload_destroy(ENGINE *e)
+{
+    RSA_meth_free(offload_rsa_method);
+    offload_rsa_method = NULL;
+    EC_KEY_METHOD_free(offload_ec_method);
+    offload_ec_method = NULL;
+    EVP_CIPHER_meth_free(_hidden_aes_128_gcm);
+    EVP_CIPHER_meth_free(_hidden_aes_256_gcm);
+    _hidden_aes_128_gcm = NULL;
+    _hidden_aes_256_gcm = NULL;
+    ERR_unload_OFFLOAD_strings();
+    return 1;
+}
+
+static int offload_ctrl(ENGINE *e, int cmd, long i, void *p, void (*f) (void))
+{
+    switch (cmd) {
+    case OFFLOAD_CMD_THREADS:
+        if (i < 0) {
+            OFFLOADerr(0, OFFLOAD_R_INVALID_ARGUMENT);
+            return 0;
+        }
+        /* Takes effect the next time the engine is initialised */
+        offload_threads = i;
+        return 1;
+    case OFFLOAD_CMD_BATCH:
+        if (i < 1) {
+            OFFLOADerr(0, OFFLOAD_R_INVALID_ARGUMENT);
+            return 0;
+        }
+        offload_batch = i;
+        return 1;
+    }
+    OFFLOADerr(0, OFFLOAD_R_UNKNOWN_COMMAND);
+    return 0;
+}
+
+static int bind_offload(ENGINE *e)
+{
+    int (*sign)(int type, const unsigned char *dgst, int dlen,
+                unsigned char *sig, unsigned int *siglen,
+                const BIGNUM *kinv, const BIGNUM *r, EC_KEY *eckey);
+    int (*sign_setup)(EC_KEY *eckey, BN_CTX *ctx, BIGNUM **kinv, BIGNUM **r);
+    int (*verify)(int type, const unsigned char *dgst, int dgst_len,
+                  const unsigned char *sigbuf, int sig_len, EC_KEY *eckey);
+
+    /* Ensure the offload error handling is set up */
+    ERR_load_OFFLOAD_strings();
+
+    EC_KEY_METHOD_get_sign(EC_KEY_OpenSSL(), &sign, &sign_setup,
+                           &ecdsa_sign_sig);
+    EC_KEY_METHOD_get_verify(EC_KEY_OpenSSL(), &verify, &ecdsa_verify_sig);
+
+    if ((offload_rsa_method = RSA_meth_dup(RSA_PKCS1_OpenSSL())) == NULL
+        || RSA_meth_set1_name(offload_rsa_method,
+                              "Offload RSA method") == 0
+        || RSA_meth_set_pub_enc(offload_rsa_method, offload_rsa_pub_enc) == 0
+        || RSA_meth_set_pub_dec(offload_rsa_method, offload_rsa_pub_dec) == 0
+        || RSA_meth_set_priv_enc(offload_rsa_method,
+                                 offload_rsa_priv_enc) == 0
+        || RSA_meth_set_priv_dec(offload_rsa_method,
+                                 offload_rsa_priv_dec) == 0
+        || (offload_ec_method = EC_KEY_METHOD_new(EC_KEY_OpenSSL())) == NULL
+        || (_hidden_aes_128_gcm = offload_cipher_new(EVP_aes_128_gcm()))
+           == NULL
+        || (_hidden_aes_256_gcm = offload_cipher_new(EVP_aes_256_gcm()))
+           == NULL) {
+        OFFLOADerr(0, OFFLOAD_R_INIT_FAILED);
+        return 0;
+    }
+    EC_KEY_METHOD_set_sign(offload_ec_method, sign, sign_setup,
+                           offload_ecdsa_sign_sig);
+    EC_KEY_METHOD_set_verify(offload_ec_method, verify,
+                             offload_ecdsa_verify_sig);
+
+    if (!ENGINE_set_id(e, engine_offload_id)
+        || !ENGINE_set_name(e, engine_offload_name)
+        || !ENGINE_set_RSA(e, offload_rsa_method)
+        || !ENGINE_set_EC(e, offload_ec_method)
+        || !ENGINE_set_ciphers(e, offload_ciphers)
+        || !ENGINE_set_destroy_function(e, offload_destroy)
+        || !ENGINE_set_init_function(e, offload_init)
+        || !ENGINE_set_finish_function(e, offload_finish)
+        || !ENGINE_set_ctrl_function(e, offload_ctrl)
+        || !ENGINE_set_cmd_defns(e, offload_cmd_defns)) {
+        OFFLOADerr(0, OFFLOAD_R_INIT_FAILED);
+        return 0;
+    }
+
+    return 1;
+}
+
+# ifndef OPENSSL_NO_DYNAMIC_ENGINE
+static int bind_helper(ENGINE *e, const char *id)
+{
+    if (id && (strcmp(id, engine_offload_id) != 0))
+        return 0;
+    if (!bind_offload(e))
+        return 0;
+    return 1;
+}
+
+IMPLEMENT_DYNAMIC_CHECK_FN()
+    IMPLEMENT_DYNAMIC_BIND_FN(bind_helper)
+# endif
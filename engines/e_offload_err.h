@@ -0,0 +1,34 @@
+/*
+ * Generated by util/mkerr.pl DO NOT EDIT
+ * Copyright 1995-2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#ifndef HEADER_OFFLOADERR_H
+# define HEADER_OFFLOADERR_H
+
+# include <openssl/opensslconf.h>
+# include <openssl/symhacks.h>
+
+
+# define OFFLOADerr(f, r) ERR_OFFLOAD_error(0, (r), OPENSSL_FILE, OPENSSL_LINE)
+
+
+/*
+ * OFFLOAD function codes.
+ */
+# if !OPENSSL_API_3
+# endif
+
+/*
+ * OFFLOAD reason codes.
+ */
+# define OFFLOAD_R_INIT_FAILED                            100
+# define OFFLOAD_R_INVALID_ARGUMENT                       101
+# define OFFLOAD_R_UNKNOWN_COMMAND                        102
+
+#endif
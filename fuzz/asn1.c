@@ -310,6 +310,16 @@ int FuzzerTestOneInput(const uint8_t *buf, size_t len)
             OPENSSL_free(der);
             ASN1_item_free(o, i);
         }
+
+        /* The same again with values borrowed from the input */
+        b = buf;
+        der = NULL;
+        o = ASN1_item_d2i_flags(NULL, &b, len, i, ASN1_D2I_FLAG_BORROW);
+        if (o != NULL) {
+            ASN1_item_i2d(o, &der, i);
+            OPENSSL_free(der);
+            ASN1_item_free(o, i);
+        }
     }
 
 #ifndef OPENSSL_NO_TS
@@ -8,6 +8,7 @@
  * or in the file LICENSE in the source distribution.
  */
 
+#include <string.h>
 #include <openssl/x509.h>
 #include <openssl/bio.h>
 #include <openssl/err.h>
@@ -42,6 +43,33 @@ int FuzzerTestOneInput(const uint8_t *buf, size_t len)
 
         X509_free(x509);
     }
+
+    /* Decode again borrowing from |buf|, and check it encodes the same */
+    p = buf;
+    der = NULL;
+    x509 = (X509 *)ASN1_item_d2i_flags(NULL, &p, len, ASN1_ITEM_rptr(X509),
+                                       ASN1_D2I_FLAG_BORROW);
+    if (x509 != NULL) {
+        BIO *bio = BIO_new(BIO_s_null());
+        unsigned char *der2 = NULL;
+        int derlen, derlen2;
+
+        X509_print(bio, x509);
+        BIO_free(bio);
+
+        derlen = i2d_X509(x509, &der);
+        X509_free(x509);
+
+        p = buf;
+        x509 = d2i_X509(NULL, &p, len);
+        OPENSSL_assert(x509 != NULL);
+        derlen2 = i2d_X509(x509, &der2);
+        OPENSSL_assert(derlen == derlen2
+                       && (derlen <= 0 || memcmp(der, der2, derlen) == 0));
+        OPENSSL_free(der);
+        OPENSSL_free(der2);
+        X509_free(x509);
+    }
     ERR_clear_error();
     return 0;
 }
@@ -78,9 +78,17 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off, size_t s
     return -1;
 }
 
+static ossl_inline int ktls_rekey_probe(void)
+{
+    return 0;
+}
+
 #   else                        /* KERNEL_VERSION */
 
 #    include <sys/sendfile.h>
+#    include <sys/socket.h>
+#    include <unistd.h>
+#    include <netinet/in.h>
 #    include <netinet/tcp.h>
 #    include <linux/tls.h>
 #    include <linux/socket.h>
@@ -173,6 +181,49 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off, size_t s
     return sendfile(s, fd, &off, size);
 }
 
+/*
+ * A TLSv1.3 KeyUpdate has to be followed on a socket that is already
+ * offloaded, which older kernels refuse with EBUSY. Find out whether the
+ * running kernel accepts new TLSv1.3 transmit keys by offloading a
+ * loopback connection twice. Returns 1 if it does and 0 otherwise,
+ * including when kernel TLS is not available at all. This opens sockets,
+ * so callers should only probe once and remember the result.
+ */
+static ossl_inline int ktls_rekey_probe(void)
+{
+    struct tls12_crypto_info_aes_gcm_128 crypto_info;
+    struct sockaddr_in sin;
+    socklen_t sinlen = sizeof(sin);
+    int lfd, cfd = -1, ret = 0;
+
+    if ((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+        return 0;
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(lfd, (struct sockaddr *)&sin, sizeof(sin)) != 0
+        || listen(lfd, 1) != 0
+        || getsockname(lfd, (struct sockaddr *)&sin, &sinlen) != 0
+        || (cfd = socket(AF_INET, SOCK_STREAM, 0)) < 0
+        || connect(cfd, (struct sockaddr *)&sin, sinlen) != 0)
+        goto end;
+
+    /* The keys don't matter, nothing is ever sent */
+    memset(&crypto_info, 0, sizeof(crypto_info));
+    crypto_info.info.version = TLS1_3_VERSION;
+    crypto_info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+    ret = ktls_enable(cfd)
+          && ktls_start(cfd, &crypto_info, sizeof(crypto_info), 1)
+          && ktls_start(cfd, &crypto_info, sizeof(crypto_info), 1);
+
+ end:
+    if (cfd >= 0)
+        close(cfd);
+    close(lfd);
+    return ret;
+}
+
 #    define K_MIN1_RX  17
 #    if LINUX_VERSION_CODE < KERNEL_VERSION(K_MAJ, K_MIN1_RX, K_MIN2)
 
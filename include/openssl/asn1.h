@@ -142,6 +142,11 @@ DEFINE_STACK_OF(X509_ALGOR)
 # define ASN1_STRING_FLAG_EMBED 0x080
 /* String should be parsed in RFC 5280's time format */
 # define ASN1_STRING_FLAG_X509_TIME 0x100
+/*
+ * Content points into the buffer the string was decoded from and is not
+ * freed with the string, see ASN1_D2I_FLAG_BORROW.
+ */
+# define ASN1_STRING_FLAG_BORROWED 0x200
 /* This is the base type that holds just about everything :-) */
 struct asn1_string_st {
     int length;
@@ -765,6 +770,11 @@ ASN1_VALUE *ASN1_item_new(const ASN1_ITEM *it);
 void ASN1_item_free(ASN1_VALUE *val, const ASN1_ITEM *it);
 ASN1_VALUE *ASN1_item_d2i(ASN1_VALUE **val, const unsigned char **in,
                           long len, const ASN1_ITEM *it);
+/* Let decoded strings point into the input instead of copying it */
+# define ASN1_D2I_FLAG_BORROW    0x1
+ASN1_VALUE *ASN1_item_d2i_flags(ASN1_VALUE **val, const unsigned char **in,
+                                long len, const ASN1_ITEM *it,
+                                unsigned long flags);
 int ASN1_item_i2d(const ASN1_VALUE *val, unsigned char **out, const ASN1_ITEM *it);
 int ASN1_item_ndef_i2d(const ASN1_VALUE *val, unsigned char **out,
                        const ASN1_ITEM *it);
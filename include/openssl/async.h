@@ -31,7 +31,10 @@ extern "C" {
 
 typedef struct async_job_st ASYNC_JOB;
 typedef struct async_wait_ctx_st ASYNC_WAIT_CTX;
+typedef struct async_sched_st ASYNC_SCHED;
+typedef struct async_ring_st ASYNC_RING;
 typedef int (*ASYNC_callback_fn)(void *arg);
+typedef void (*ASYNC_SCHED_done_fn)(int status, int ret, void *arg);
 
 #define ASYNC_ERR      0
 #define ASYNC_NO_JOBS  1
@@ -70,6 +73,13 @@ int ASYNC_WAIT_CTX_get_changed_fds(ASYNC_WAIT_CTX *ctx, OSSL_ASYNC_FD *addfd,
                                    size_t *numaddfds, OSSL_ASYNC_FD *delfd,
                                    size_t *numdelfds);
 int ASYNC_WAIT_CTX_clear_fd(ASYNC_WAIT_CTX *ctx, const void *key);
+int ASYNC_WAIT_CTX_set_ring(ASYNC_WAIT_CTX *ctx, ASYNC_RING *ring,
+                            void *user_data);
+
+ASYNC_RING *ASYNC_RING_new(size_t size);
+void ASYNC_RING_free(ASYNC_RING *ring);
+int ASYNC_RING_get_fd(ASYNC_RING *ring, OSSL_ASYNC_FD *fd);
+size_t ASYNC_RING_drain(ASYNC_RING *ring, void **user_data, size_t max);
 #endif
 
 int ASYNC_is_capable(void);
@@ -82,6 +92,15 @@ ASYNC_JOB *ASYNC_get_current_job(void);
 ASYNC_WAIT_CTX *ASYNC_get_wait_ctx(ASYNC_JOB *job);
 void ASYNC_block_pause(void);
 void ASYNC_unblock_pause(void);
+int ASYNC_set_stack_size(size_t size);
+size_t ASYNC_get_stack_size(void);
+
+ASYNC_SCHED *ASYNC_SCHED_new(void);
+void ASYNC_SCHED_free(ASYNC_SCHED *sched);
+int ASYNC_SCHED_submit(ASYNC_SCHED *sched, int (*func)(void *), void *args,
+                       size_t size, ASYNC_SCHED_done_fn done, void *done_arg);
+int ASYNC_SCHED_run(ASYNC_SCHED *sched);
+void ASYNC_SCHED_stop(ASYNC_SCHED *sched);
 
 
 # ifdef  __cplusplus
@@ -193,6 +193,8 @@ OSSL_CORE_MAKE_FUNC(const OSSL_PARAM *, OP_digest_gettable_ctx_params, (void))
 # define OSSL_FUNC_CIPHER_GETTABLE_PARAMS           12
 # define OSSL_FUNC_CIPHER_GETTABLE_CTX_PARAMS       13
 # define OSSL_FUNC_CIPHER_SETTABLE_CTX_PARAMS       14
+# define OSSL_FUNC_CIPHER_AEAD_SEAL                 15
+# define OSSL_FUNC_CIPHER_AEAD_OPEN                 16
 
 OSSL_CORE_MAKE_FUNC(void *, OP_cipher_newctx, (void *provctx))
 OSSL_CORE_MAKE_FUNC(int, OP_cipher_encrypt_init, (void *cctx,
@@ -229,6 +231,20 @@ OSSL_CORE_MAKE_FUNC(const OSSL_PARAM *, OP_cipher_settable_ctx_params,
                     (void))
 OSSL_CORE_MAKE_FUNC(const OSSL_PARAM *, OP_cipher_gettable_ctx_params,
                     (void))
+OSSL_CORE_MAKE_FUNC(int, OP_cipher_aead_seal,
+                    (void *cctx,
+                     const unsigned char *key, size_t keylen,
+                     const unsigned char *iv, size_t ivlen,
+                     const unsigned char *aad, size_t aadlen,
+                     unsigned char *out, const unsigned char *in, size_t inl,
+                     unsigned char *tag, size_t taglen))
+OSSL_CORE_MAKE_FUNC(int, OP_cipher_aead_open,
+                    (void *cctx,
+                     const unsigned char *key, size_t keylen,
+                     const unsigned char *iv, size_t ivlen,
+                     const unsigned char *aad, size_t aadlen,
+                     unsigned char *out, const unsigned char *in, size_t inl,
+                     const unsigned char *tag, size_t taglen))
 
 /* MACs */
 
@@ -313,6 +313,13 @@ size_t CRYPTO_secure_used(void);
 
 void OPENSSL_cleanse(void *ptr, size_t len);
 
+OSSL_ARENA *OSSL_ARENA_new(size_t block_size);
+void OSSL_ARENA_free(OSSL_ARENA *arena);
+void *OSSL_ARENA_alloc(OSSL_ARENA *arena, size_t num);
+void OSSL_ARENA_reset(OSSL_ARENA *arena);
+void OSSL_ARENA_get_stats(const OSSL_ARENA *arena, size_t *num_allocs,
+                          size_t *num_blocks, size_t *peak);
+
 # ifndef OPENSSL_NO_CRYPTO_MDEBUG
 #  if !OPENSSL_API_3
 #    define OPENSSL_mem_debug_push(info) \
@@ -1267,6 +1267,22 @@ ECDSA_SIG *ECDSA_do_sign_ex(const unsigned char *dgst, int dgstlen,
 int ECDSA_do_verify(const unsigned char *dgst, int dgst_len,
                     const ECDSA_SIG *sig, EC_KEY *eckey);
 
+/** Verifies a batch of ECDSA signatures
+ *  \param  dgst      array of pointers to the hash values
+ *  \param  dgst_len  array of lengths of the hash values
+ *  \param  sig       array of pointers to the ECDSA_SIG structures
+ *  \param  eckey     array of pointers to the EC_KEY objects containing
+ *                    the public keys
+ *  \param  num       number of signatures
+ *  \param  res       array of num ints receiving the result for each
+ *                    signature as returned by ECDSA_do_verify
+ *  \return 1 if all signatures are valid, 0 if at least one of them is
+ *          invalid and -1 on error
+ */
+int ECDSA_do_verify_batch(const unsigned char *dgst[], const int dgst_len[],
+                          const ECDSA_SIG *sig[], EC_KEY *eckey[],
+                          size_t num, int res[]);
+
 /** Precompute parts of the signing operation
  *  \param  eckey  EC_KEY object containing a private EC key
  *  \param  ctx    BN_CTX object (optional)
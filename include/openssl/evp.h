@@ -640,6 +640,20 @@ __owur int EVP_CipherFinal(EVP_CIPHER_CTX *ctx, unsigned char *outm,
                            int *outl);
 __owur int EVP_CipherFinal_ex(EVP_CIPHER_CTX *ctx, unsigned char *outm,
                               int *outl);
+__owur int EVP_CIPHER_CTX_aead_seal(EVP_CIPHER_CTX *ctx,
+                                    const unsigned char *key,
+                                    const unsigned char *iv, size_t ivlen,
+                                    const unsigned char *aad, size_t aadlen,
+                                    unsigned char *out,
+                                    const unsigned char *in, size_t inl,
+                                    unsigned char *tag, size_t taglen);
+__owur int EVP_CIPHER_CTX_aead_open(EVP_CIPHER_CTX *ctx,
+                                    const unsigned char *key,
+                                    const unsigned char *iv, size_t ivlen,
+                                    const unsigned char *aad, size_t aadlen,
+                                    unsigned char *out,
+                                    const unsigned char *in, size_t inl,
+                                    const unsigned char *tag, size_t taglen);
 
 __owur int EVP_SignFinal(EVP_MD_CTX *ctx, unsigned char *md, unsigned int *s,
                          EVP_PKEY *pkey);
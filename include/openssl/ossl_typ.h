@@ -188,6 +188,8 @@ typedef struct ossl_store_search_st OSSL_STORE_SEARCH;
 
 typedef struct openssl_ctx_st OPENSSL_CTX;
 
+typedef struct ossl_arena_st OSSL_ARENA;
+
 typedef struct ossl_dispatch_st OSSL_DISPATCH;
 typedef struct ossl_item_st OSSL_ITEM;
 typedef struct ossl_algorithm_st OSSL_ALGORITHM;
@@ -669,6 +669,8 @@ __owur int SRP_Calc_A_param(SSL *s);
 # define SSL_MAX_CERT_LIST_DEFAULT 1024*100
 
 # define SSL_SESSION_CACHE_MAX_SIZE_DEFAULT      (1024*20)
+/* Number of shards used by SSL_SESS_CACHE_SHARDED unless otherwise set */
+# define SSL_SESSION_CACHE_SHARDS_DEFAULT        16
 
 /*
  * This callback type is used inside SSL_CTX, SSL, and in the functions that
@@ -695,6 +697,7 @@ typedef int (*GEN_SESSION_CB) (SSL *ssl, unsigned char *id,
 # define SSL_SESS_CACHE_NO_INTERNAL_STORE        0x0200
 # define SSL_SESS_CACHE_NO_INTERNAL \
         (SSL_SESS_CACHE_NO_INTERNAL_LOOKUP|SSL_SESS_CACHE_NO_INTERNAL_STORE)
+# define SSL_SESS_CACHE_SHARDED                  0x0400
 
 LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx);
 # define SSL_CTX_sess_number(ctx) \
@@ -721,6 +724,14 @@ LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx);
         SSL_CTX_ctrl(ctx,SSL_CTRL_SESS_TIMEOUTS,0,NULL)
 # define SSL_CTX_sess_cache_full(ctx) \
         SSL_CTX_ctrl(ctx,SSL_CTRL_SESS_CACHE_FULL,0,NULL)
+# define SSL_CTX_sess_shard_number(ctx,i) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_SESS_SHARD_NUMBER,i,NULL)
+# define SSL_CTX_sess_shard_hits(ctx,i) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_SESS_SHARD_HITS,i,NULL)
+# define SSL_CTX_sess_shard_misses(ctx,i) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_SESS_SHARD_MISSES,i,NULL)
+# define SSL_CTX_sess_shard_evictions(ctx,i) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_SESS_SHARD_EVICTIONS,i,NULL)
 
 void SSL_CTX_sess_set_new_cb(SSL_CTX *ctx,
                              int (*new_session_cb) (struct ssl_st *ssl,
@@ -1317,6 +1328,18 @@ DECLARE_PEM_rw(SSL_SESSION, SSL_SESSION)
 # define SSL_CTRL_GET_SIGNATURE_NID              132
 # define SSL_CTRL_GET_TMP_KEY                    133
 # define SSL_CTRL_GET_NEGOTIATED_GROUP           134
+# define SSL_CTRL_SET_SESS_CACHE_SHARDS          135
+# define SSL_CTRL_GET_SESS_CACHE_SHARDS          136
+# define SSL_CTRL_SESS_SHARD_NUMBER              137
+# define SSL_CTRL_SESS_SHARD_HITS                138
+# define SSL_CTRL_SESS_SHARD_MISSES              139
+# define SSL_CTRL_SESS_SHARD_EVICTIONS           140
+# define SSL_CTRL_SET_BUFFER_POOL_MAX            141
+# define SSL_CTRL_GET_BUFFER_POOL_MAX            142
+# define SSL_CTRL_BUFFER_POOL_CACHED             143
+# define SSL_CTRL_BUFFER_POOL_HITS               144
+# define SSL_CTRL_BUFFER_POOL_MISSES             145
+# define SSL_CTRL_BUFFER_POOL_DROPS              146
 # define SSL_CERT_SET_FIRST                      1
 # define SSL_CERT_SET_NEXT                       2
 # define SSL_CERT_SET_SERVER                     3
@@ -2057,6 +2080,24 @@ __owur int SSL_get_ex_data_X509_STORE_CTX_idx(void);
         SSL_CTX_ctrl(ctx,SSL_CTRL_SET_SESS_CACHE_MODE,m,NULL)
 # define SSL_CTX_get_session_cache_mode(ctx) \
         SSL_CTX_ctrl(ctx,SSL_CTRL_GET_SESS_CACHE_MODE,0,NULL)
+# define SSL_CTX_sess_set_cache_shards(ctx,n) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_SET_SESS_CACHE_SHARDS,n,NULL)
+# define SSL_CTX_sess_get_cache_shards(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_GET_SESS_CACHE_SHARDS,0,NULL)
+
+# define SSL_BUFFER_POOL_MAX_DEFAULT 32
+# define SSL_CTX_set_buffer_pool_max(ctx,n) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_SET_BUFFER_POOL_MAX,n,NULL)
+# define SSL_CTX_get_buffer_pool_max(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_GET_BUFFER_POOL_MAX,0,NULL)
+# define SSL_CTX_buffer_pool_cached(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_BUFFER_POOL_CACHED,0,NULL)
+# define SSL_CTX_buffer_pool_hits(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_BUFFER_POOL_HITS,0,NULL)
+# define SSL_CTX_buffer_pool_misses(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_BUFFER_POOL_MISSES,0,NULL)
+# define SSL_CTX_buffer_pool_drops(ctx) \
+        SSL_CTX_ctrl(ctx,SSL_CTRL_BUFFER_POOL_DROPS,0,NULL)
 
 # define SSL_CTX_get_default_read_ahead(ctx) SSL_CTX_get_read_ahead(ctx)
 # define SSL_CTX_set_default_read_ahead(ctx,m) SSL_CTX_set_read_ahead(ctx,m)
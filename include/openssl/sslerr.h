@@ -271,6 +271,7 @@ int ERR_load_SSL_strings(void);
 #  define SSL_F_TLS13_RESTORE_HANDSHAKE_DIGEST_FOR_PHA     0
 #  define SSL_F_TLS13_SAVE_HANDSHAKE_DIGEST_FOR_PHA        0
 #  define SSL_F_TLS13_SETUP_KEY_BLOCK                      0
+#  define SSL_F_TLS13_UPDATE_KEY                           0
 #  define SSL_F_TLS1_CHANGE_CIPHER_STATE                   0
 #  define SSL_F_TLS1_CHECK_DUPLICATE_EXTENSIONS            0
 #  define SSL_F_TLS1_ENC                                   0
@@ -0,0 +1,586 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <openssl/core_numbers.h>
+#include <openssl/core_names.h>
+#include "internal/provider_algs.h"
+#include "internal/providercommonerr.h"
+#include "ciphers_locl.h"
+
+/* The flags of EVP_aes_128_ccm(), the nonce length depends on L */
+#define AEAD_CCM_FLAGS (EVP_CIPH_FLAG_AEAD_CIPHER | EVP_CIPH_FLAG_DEFAULT_ASN1 \
+                       | EVP_CIPH_CUSTOM_IV | EVP_CIPH_FLAG_CUSTOM_CIPHER      \
+                       | EVP_CIPH_ALWAYS_CALL_INIT | EVP_CIPH_CTRL_INIT        \
+                       | EVP_CIPH_CUSTOM_COPY | EVP_CIPH_CUSTOM_IV_LENGTH)
+
+static OSSL_OP_cipher_encrypt_init_fn ccm_einit;
+static OSSL_OP_cipher_decrypt_init_fn ccm_dinit;
+static OSSL_OP_cipher_get_ctx_params_fn ccm_get_ctx_params;
+static OSSL_OP_cipher_set_ctx_params_fn ccm_set_ctx_params;
+static OSSL_OP_cipher_cipher_fn ccm_cipher;
+static OSSL_OP_cipher_update_fn ccm_stream_update;
+static OSSL_OP_cipher_final_fn ccm_stream_final;
+static OSSL_OP_cipher_aead_seal_fn ccm_aead_seal;
+static OSSL_OP_cipher_aead_open_fn ccm_aead_open;
+
+static int ccm_cipher_internal(PROV_CCM_CTX *ctx, unsigned char *out,
+                               size_t *padlen, const unsigned char *in,
+                               size_t len);
+
+static void ccm_initctx(PROV_CCM_CTX *ctx, size_t keybits,
+                        const PROV_CCM_HW *hw)
+{
+    ctx->keylen = keybits / 8;
+    ctx->key_set = 0;
+    ctx->iv_set = 0;
+    ctx->tag_set = 0;
+    ctx->len_set = 0;
+    ctx->l = CCM_L_DEFAULT;
+    ctx->m = CCM_M_DEFAULT;
+    ctx->tls_aad_len = -1;
+    ctx->hw = hw;
+}
+
+static void ccm_deinitctx(PROV_CCM_CTX *ctx)
+{
+    OPENSSL_cleanse(ctx->iv, sizeof(ctx->iv));
+}
+
+static size_t ccm_get_ivlen(PROV_CCM_CTX *ctx)
+{
+    return 15 - ctx->l;
+}
+
+static int ccm_init(void *vctx, const unsigned char *key, size_t keylen,
+                    const unsigned char *iv, size_t ivlen, int enc)
+{
+    PROV_CCM_CTX *ctx = (PROV_CCM_CTX *)vctx;
+
+    ctx->enc = enc;
+
+    if (iv != NULL) {
+        if (ivlen != ccm_get_ivlen(ctx)) {
+            PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+            return 0;
+        }
+        memcpy(ctx->iv, iv, ivlen);
+        ctx->iv_set = 1;
+    }
+    if (key != NULL) {
+        if (keylen != ctx->keylen) {
+            PROVerr(0, PROV_R_INVALID_KEY_LENGTH);
+            return 0;
+        }
+        return ctx->hw->setkey(ctx, key, keylen);
+    }
+    return 1;
+}
+
+static int ccm_einit(void *vctx, const unsigned char *key, size_t keylen,
+                     const unsigned char *iv, size_t ivlen)
+{
+    return ccm_init(vctx, key, keylen, iv, ivlen, 1);
+}
+
+static int ccm_dinit(void *vctx, const unsigned char *key, size_t keylen,
+                     const unsigned char *iv, size_t ivlen)
+{
+    return ccm_init(vctx, key, keylen, iv, ivlen, 0);
+}
+
+static int ccm_tls_init(PROV_CCM_CTX *ctx, unsigned char *aad, size_t alen)
+{
+    size_t len;
+
+    if (alen != EVP_AEAD_TLS1_AAD_LEN)
+        return 0;
+
+    /* Save the aad for later use. */
+    memcpy(ctx->buf, aad, alen);
+    ctx->tls_aad_len = alen;
+
+    len = ctx->buf[alen - 2] << 8 | ctx->buf[alen - 1];
+    if (len < EVP_CCM_TLS_EXPLICIT_IV_LEN)
+        return 0;
+
+    /* Correct length for explicit iv. */
+    len -= EVP_CCM_TLS_EXPLICIT_IV_LEN;
+
+    if (!ctx->enc) {
+        if (len < ctx->m)
+            return 0;
+        /* Correct length for tag. */
+        len -= ctx->m;
+    }
+    ctx->buf[alen - 2] = (unsigned char)(len >> 8);
+    ctx->buf[alen - 1] = (unsigned char)(len & 0xff);
+
+    /* Extra padding: tag appended to record. */
+    return ctx->m;
+}
+
+static int ccm_tls_iv_set_fixed(PROV_CCM_CTX *ctx, unsigned char *fixed,
+                                size_t flen)
+{
+    if (flen != EVP_CCM_TLS_FIXED_IV_LEN)
+        return 0;
+
+    /* Copy to first part of the iv. */
+    memcpy(ctx->iv, fixed, flen);
+    return 1;
+}
+
+static int ccm_get_ctx_params(void *vctx, OSSL_PARAM params[])
+{
+    PROV_CCM_CTX *ctx = (PROV_CCM_CTX *)vctx;
+    OSSL_PARAM *p;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_IVLEN);
+    if (p != NULL && !OSSL_PARAM_set_int(p, ccm_get_ivlen(ctx))) {
+        PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL && !OSSL_PARAM_set_int(p, ctx->keylen)) {
+        PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TLS1_AAD_PAD);
+    if (p != NULL && !OSSL_PARAM_set_size_t(p, ctx->tls_aad_pad_sz)) {
+        PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        if (!ctx->enc || !ctx->tag_set) {
+            PROVerr(0, PROV_R_INVALID_TAG);
+            return 0;
+        }
+        if (p->data_type != OSSL_PARAM_OCTET_STRING
+                || p->data_size == 0 || p->data_size > ctx->m) {
+            PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+            return 0;
+        }
+        if (!ctx->hw->gettag(ctx, p->data, p->data_size))
+            return 0;
+        p->return_size = p->data_size;
+        ctx->tag_set = 0;
+        ctx->iv_set = 0;
+        ctx->len_set = 0;
+    }
+    return 1;
+}
+
+static int ccm_set_ctx_params(void *vctx, const OSSL_PARAM params[])
+{
+    PROV_CCM_CTX *ctx = (PROV_CCM_CTX *)vctx;
+    const OSSL_PARAM *p;
+    size_t sz;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        if (p->data_type != OSSL_PARAM_OCTET_STRING) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        /* A NULL tag only sets the tag length (M) */
+        if ((p->data_size & 1) || p->data_size < 4 || p->data_size > 16) {
+            PROVerr(0, PROV_R_INVALID_TAG);
+            return 0;
+        }
+        if (p->data != NULL) {
+            if (ctx->enc) {
+                PROVerr(0, PROV_R_INVALID_TAG);
+                return 0;
+            }
+            memcpy(ctx->buf, p->data, p->data_size);
+            ctx->tag_set = 1;
+        }
+        ctx->m = p->data_size;
+    }
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_IVLEN);
+    if (p != NULL) {
+        size_t ivlen;
+
+        if (!OSSL_PARAM_get_size_t(p, &sz)) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        ivlen = 15 - sz;
+        if (ivlen < 2 || ivlen > 8) {
+            PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+            return 0;
+        }
+        ctx->l = ivlen;
+    }
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TLS1_AAD);
+    if (p != NULL) {
+        if (p->data_type != OSSL_PARAM_OCTET_STRING) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        sz = ccm_tls_init(ctx, p->data, p->data_size);
+        if (sz == 0) {
+            PROVerr(0, PROV_R_INVALID_AAD);
+            return 0;
+        }
+        ctx->tls_aad_pad_sz = sz;
+    }
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TLS1_IV_FIXED);
+    if (p != NULL) {
+        if (p->data_type != OSSL_PARAM_OCTET_STRING) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        if (ccm_tls_iv_set_fixed(ctx, p->data, p->data_size) == 0) {
+            PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+            return 0;
+        }
+    }
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL) {
+        int keylen;
+
+        if (!OSSL_PARAM_get_int(p, &keylen)) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        /* The key length can not be modified for ccm mode */
+        if (keylen != (int)ctx->keylen)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int ccm_stream_update(void *vctx, unsigned char *out, size_t *outl,
+                             size_t outsize, const unsigned char *in,
+                             size_t inl)
+{
+    PROV_CCM_CTX *ctx = (PROV_CCM_CTX *)vctx;
+
+    if (out != NULL && outsize < inl) {
+        PROVerr(0, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return 0;
+    }
+
+    if (!ccm_cipher_internal(ctx, out, outl, in, inl)) {
+        PROVerr(0, PROV_R_CIPHER_OPERATION_FAILED);
+        return 0;
+    }
+    return 1;
+}
+
+static int ccm_stream_final(void *vctx, unsigned char *out, size_t *outl,
+                            size_t outsize)
+{
+    PROV_CCM_CTX *ctx = (PROV_CCM_CTX *)vctx;
+    int i;
+
+    i = ccm_cipher_internal(ctx, out, outl, NULL, 0);
+    if (i <= 0)
+        return 0;
+
+    *outl = 0;
+    return 1;
+}
+
+static int ccm_cipher(void *vctx,
+                      unsigned char *out, size_t *outl, size_t outsize,
+                      const unsigned char *in, size_t inl)
+{
+    PROV_CCM_CTX *ctx = (PROV_CCM_CTX *)vctx;
+
+    if (outsize < inl) {
+        PROVerr(0, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return -1;
+    }
+
+    if (ccm_cipher_internal(ctx, out, outl, in, inl) <= 0)
+        return -1;
+
+    *outl = inl;
+    return 1;
+}
+
+/* Copy the buffered iv */
+static int ccm_set_iv(PROV_CCM_CTX *ctx, size_t mlen)
+{
+    const PROV_CCM_HW *hw = ctx->hw;
+
+    if (!hw->setiv(ctx, ctx->iv, ccm_get_ivlen(ctx), mlen))
+        return 0;
+    ctx->len_set = 1;
+    return 1;
+}
+
+/*
+ * Handle TLS CCM packet format. This consists of the last portion of the IV
+ * followed by the payload and finally the tag. On encrypt the explicit IV is
+ * taken from the sequence number at the start of the AAD.
+ */
+static int ccm_tls_cipher(PROV_CCM_CTX *ctx,
+                          unsigned char *out, size_t *padlen,
+                          const unsigned char *in, size_t len)
+{
+    int rv = 0;
+    size_t olen = 0;
+
+    /* Encrypt/decrypt must be performed in place */
+    if (in == NULL || out != in || len < EVP_CCM_TLS_EXPLICIT_IV_LEN + ctx->m)
+        goto err;
+
+    /* If encrypting set explicit IV from sequence number (start of AAD) */
+    if (ctx->enc)
+        memcpy(out, ctx->buf, EVP_CCM_TLS_EXPLICIT_IV_LEN);
+    /* Get rest of IV from explicit IV */
+    memcpy(ctx->iv + EVP_CCM_TLS_FIXED_IV_LEN, in, EVP_CCM_TLS_EXPLICIT_IV_LEN);
+    /* Correct length value */
+    len -= EVP_CCM_TLS_EXPLICIT_IV_LEN + ctx->m;
+    if (!ccm_set_iv(ctx, len))
+        goto err;
+
+    /* Use saved AAD */
+    if (!ctx->hw->setaad(ctx, ctx->buf, ctx->tls_aad_len))
+        goto err;
+
+    /* Fix buffer to point to payload */
+    in += EVP_CCM_TLS_EXPLICIT_IV_LEN;
+    out += EVP_CCM_TLS_EXPLICIT_IV_LEN;
+    if (ctx->enc) {
+        if (!ctx->hw->auth_encrypt(ctx, in, out, len,  out + len, ctx->m))
+            goto err;
+        olen = len + EVP_CCM_TLS_EXPLICIT_IV_LEN + ctx->m;
+    } else {
+        if (!ctx->hw->auth_decrypt(ctx, in, out, len,
+                                   (unsigned char *)in + len, ctx->m))
+            goto err;
+        olen = len;
+    }
+    rv = 1;
+err:
+    ctx->tls_aad_len = -1;
+    *padlen = olen;
+    return rv;
+}
+
+static int ccm_cipher_internal(PROV_CCM_CTX *ctx, unsigned char *out,
+                               size_t *padlen, const unsigned char *in,
+                               size_t len)
+{
+    int rv = 0;
+    size_t olen = 0;
+    const PROV_CCM_HW *hw = ctx->hw;
+
+    /* If no key set, return error */
+    if (!ctx->key_set)
+        return 0;
+
+    if (ctx->tls_aad_len >= 0)
+        return ccm_tls_cipher(ctx, out, padlen, in, len);
+
+    /* EVP_*Final() doesn't return any data */
+    if (in == NULL && out != NULL)
+        goto finish;
+
+    if (!ctx->iv_set)
+        goto err;
+
+    if (out == NULL) {
+        if (in == NULL) {
+            /* The total message length is being set */
+            if (!ccm_set_iv(ctx, len))
+                goto err;
+        } else {
+            /* If we have AAD, we need a message length */
+            if (!ctx->len_set && len)
+                goto err;
+            if (!hw->setaad(ctx, in, len))
+                goto err;
+        }
+    } else {
+        /* The tag must be set before actually decrypting data */
+        if (!ctx->enc && !ctx->tag_set)
+            goto err;
+
+        /* If not set length yet do it */
+        if (!ctx->len_set && !ccm_set_iv(ctx, len))
+            goto err;
+
+        if (ctx->enc) {
+            if (!hw->auth_encrypt(ctx, in, out, len, NULL, 0))
+                goto err;
+            ctx->tag_set = 1;
+        } else {
+            /* The tag is checked (and the output cleansed on failure) here */
+            ctx->iv_set = 0;
+            ctx->tag_set = 0;
+            ctx->len_set = 0;
+            if (!hw->auth_decrypt(ctx, in, out, len, ctx->buf, ctx->m))
+                goto err;
+        }
+    }
+    olen = len;
+finish:
+    rv = 1;
+err:
+    *padlen = olen;
+    return rv;
+}
+
+/*
+ * One-shot AEAD. The nonce length selects L and the tag length selects M for
+ * this message; both are reapplied by the hw setiv call.
+ */
+static int ccm_aead_init(PROV_CCM_CTX *ctx, int enc, const unsigned char *key,
+                         size_t keylen, const unsigned char *iv, size_t ivlen,
+                         size_t taglen, size_t inl)
+{
+    ctx->enc = enc;
+    ctx->tls_aad_len = -1;
+    ctx->iv_set = 0;
+    ctx->tag_set = 0;
+    ctx->len_set = 0;
+
+    if ((taglen & 1) || taglen < 4 || taglen > 16) {
+        PROVerr(0, PROV_R_INVALID_TAG);
+        return 0;
+    }
+    if (ivlen < 7 || ivlen > 13) {
+        PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+        return 0;
+    }
+    ctx->m = taglen;
+    ctx->l = 15 - ivlen;
+    if (key != NULL) {
+        if (keylen != ctx->keylen) {
+            PROVerr(0, PROV_R_INVALID_KEY_LENGTH);
+            return 0;
+        }
+        if (!ctx->hw->setkey(ctx, key, keylen))
+            return 0;
+    }
+    if (!ctx->key_set) {
+        PROVerr(0, PROV_R_NO_KEY_SET);
+        return 0;
+    }
+    return ctx->hw->setiv(ctx, iv, ivlen, inl);
+}
+
+static int ccm_aead_seal(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen,
+                         const unsigned char *aad, size_t aadlen,
+                         unsigned char *out, const unsigned char *in,
+                         size_t inl, unsigned char *tag, size_t taglen)
+{
+    PROV_CCM_CTX *ctx = (PROV_CCM_CTX *)vctx;
+
+    return ccm_aead_init(ctx, 1, key, keylen, iv, ivlen, taglen, inl)
+           && ctx->hw->setaad(ctx, aad, aadlen)
+           && ctx->hw->auth_encrypt(ctx, in, out, inl, tag, taglen);
+}
+
+static int ccm_aead_open(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen,
+                         const unsigned char *aad, size_t aadlen,
+                         unsigned char *out, const unsigned char *in,
+                         size_t inl, const unsigned char *tag, size_t taglen)
+{
+    PROV_CCM_CTX *ctx = (PROV_CCM_CTX *)vctx;
+
+    if (!ccm_aead_init(ctx, 0, key, keylen, iv, ivlen, taglen, inl))
+        return 0;
+    memcpy(ctx->buf, tag, taglen);
+    return ctx->hw->setaad(ctx, aad, aadlen)
+           && ctx->hw->auth_decrypt(ctx, in, out, inl, ctx->buf, taglen);
+}
+
+#define IMPLEMENT_cipher(alg, lcmode, UCMODE, flags, kbits, blkbits, ivbits)   \
+    static OSSL_OP_cipher_get_params_fn alg##_##kbits##_##lcmode##_get_params; \
+    static int alg##_##kbits##_##lcmode##_get_params(OSSL_PARAM params[])      \
+    {                                                                          \
+        return aes_get_params(params, EVP_CIPH_##UCMODE##_MODE, flags,         \
+                               kbits, blkbits, ivbits);                        \
+    }                                                                          \
+    static OSSL_OP_cipher_newctx_fn alg##kbits##lcmode##_newctx;               \
+    static void *alg##kbits##lcmode##_newctx(void *provctx)                    \
+    {                                                                          \
+        return alg##_##lcmode##_newctx(provctx, kbits);                        \
+    }                                                                          \
+    const OSSL_DISPATCH alg##kbits##lcmode##_functions[] = {                   \
+        { OSSL_FUNC_CIPHER_ENCRYPT_INIT, (void (*)(void))ccm_einit },          \
+        { OSSL_FUNC_CIPHER_DECRYPT_INIT, (void (*)(void))ccm_dinit },          \
+        { OSSL_FUNC_CIPHER_UPDATE, (void (*)(void))ccm_stream_update },        \
+        { OSSL_FUNC_CIPHER_FINAL, (void (*)(void))ccm_stream_final },          \
+        { OSSL_FUNC_CIPHER_CIPHER, (void (*)(void))ccm_cipher },               \
+        { OSSL_FUNC_CIPHER_NEWCTX,                                             \
+            (void (*)(void)) alg##kbits##lcmode##_newctx },                    \
+        { OSSL_FUNC_CIPHER_FREECTX, (void (*)(void)) alg##_##lcmode##_freectx },\
+        { OSSL_FUNC_CIPHER_DUPCTX, (void (*)(void)) alg##_##lcmode##_dupctx },  \
+        { OSSL_FUNC_CIPHER_GET_PARAMS,                                         \
+            (void (*)(void)) alg##_##kbits##_##lcmode##_get_params },          \
+        { OSSL_FUNC_CIPHER_GET_CTX_PARAMS,                                     \
+            (void (*)(void))ccm_get_ctx_params },                              \
+        { OSSL_FUNC_CIPHER_SET_CTX_PARAMS,                                     \
+            (void (*)(void))ccm_set_ctx_params },                              \
+        { OSSL_FUNC_CIPHER_AEAD_SEAL, (void (*)(void))ccm_aead_seal },         \
+        { OSSL_FUNC_CIPHER_AEAD_OPEN, (void (*)(void))ccm_aead_open },         \
+        { 0, NULL }                                                            \
+    }
+
+static void *aes_ccm_newctx(void *provctx, size_t keybits)
+{
+    PROV_AES_CCM_CTX *ctx = OPENSSL_zalloc(sizeof(*ctx));
+
+    if (ctx != NULL)
+        ccm_initctx((PROV_CCM_CTX *)ctx, keybits, PROV_AES_HW_ccm(keybits));
+    return ctx;
+}
+
+static OSSL_OP_cipher_freectx_fn aes_ccm_freectx;
+static void aes_ccm_freectx(void *vctx)
+{
+    PROV_AES_CCM_CTX *ctx = (PROV_AES_CCM_CTX *)vctx;
+
+    ccm_deinitctx((PROV_CCM_CTX *)ctx);
+    OPENSSL_clear_free(ctx,  sizeof(*ctx));
+}
+
+static OSSL_OP_cipher_dupctx_fn aes_ccm_dupctx;
+static void *aes_ccm_dupctx(void *vctx)
+{
+    PROV_AES_CCM_CTX *in = (PROV_AES_CCM_CTX *)vctx;
+    PROV_AES_CCM_CTX *ret = OPENSSL_malloc(sizeof(*ret));
+
+    if (ret == NULL) {
+        PROVerr(0, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    *ret = *in;
+    /* The CCM context points at the key schedule, which has moved */
+    if (in->base.ccm_ctx.key != NULL)
+        ret->base.ccm_ctx.key = &ret->ks.ks;
+    return ret;
+}
+
+/* aes128ccm_functions */
+IMPLEMENT_cipher(aes, ccm, CCM, AEAD_CCM_FLAGS, 128, 8, 96);
+/* aes192ccm_functions */
+IMPLEMENT_cipher(aes, ccm, CCM, AEAD_CCM_FLAGS, 192, 8, 96);
+/* aes256ccm_functions */
+IMPLEMENT_cipher(aes, ccm, CCM, AEAD_CCM_FLAGS, 256, 8, 96);
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2001-2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include "ciphers_locl.h"
+#include "internal/aes_platform.h"
+
+#define CCM_HW_SET_KEY_FN(fn_set_enc_key, fn_blk)                              \
+    fn_set_enc_key(key, keylen * 8, &actx->ks.ks);                             \
+    CRYPTO_ccm128_init(&ctx->ccm_ctx, ctx->m, ctx->l, &actx->ks.ks,            \
+                       (block128_f)fn_blk);                                    \
+    ctx->key_set = 1;
+
+static int ccm_generic_setiv(PROV_CCM_CTX *ctx, const unsigned char *nonce,
+                             size_t nlen, size_t mlen)
+{
+    /* L and M may have changed since the key was set */
+    CRYPTO_ccm128_init(&ctx->ccm_ctx, ctx->m, ctx->l, ctx->ccm_ctx.key,
+                       ctx->ccm_ctx.block);
+    return CRYPTO_ccm128_setiv(&ctx->ccm_ctx, nonce, nlen, mlen) == 0;
+}
+
+static int ccm_generic_setaad(PROV_CCM_CTX *ctx, const unsigned char *aad,
+                              size_t alen)
+{
+    CRYPTO_ccm128_aad(&ctx->ccm_ctx, aad, alen);
+    return 1;
+}
+
+static int ccm_generic_gettag(PROV_CCM_CTX *ctx, unsigned char *tag,
+                              size_t tlen)
+{
+    return CRYPTO_ccm128_tag(&ctx->ccm_ctx, tag, tlen) > 0;
+}
+
+/*
+ * Encrypt and, if |tag| is not NULL, write the tag. Decrypt and compare the
+ * tag against |expected_tag|. The |str| stream function is optional.
+ */
+static int ccm_generic_encrypt(PROV_CCM_CTX *ctx, const unsigned char *in,
+                               unsigned char *out, size_t len,
+                               unsigned char *tag, size_t taglen,
+                               ccm128_f str)
+{
+    int rv;
+
+    if (str != NULL)
+        rv = CRYPTO_ccm128_encrypt_ccm64(&ctx->ccm_ctx, in, out, len, str) == 0;
+    else
+        rv = CRYPTO_ccm128_encrypt(&ctx->ccm_ctx, in, out, len) == 0;
+
+    if (rv == 1 && tag != NULL)
+        rv = (CRYPTO_ccm128_tag(&ctx->ccm_ctx, tag, taglen) > 0);
+    return rv;
+}
+
+static int ccm_generic_decrypt(PROV_CCM_CTX *ctx, const unsigned char *in,
+                               unsigned char *out, size_t len,
+                               unsigned char *expected_tag, size_t taglen,
+                               ccm128_f str)
+{
+    int rv = 0;
+
+    if (str != NULL)
+        rv = CRYPTO_ccm128_decrypt_ccm64(&ctx->ccm_ctx, in, out, len, str) == 0;
+    else
+        rv = CRYPTO_ccm128_decrypt(&ctx->ccm_ctx, in, out, len) == 0;
+    if (rv) {
+        unsigned char tag[16];
+
+        if (!ccm_generic_gettag(ctx, tag, taglen)
+            || CRYPTO_memcmp(tag, expected_tag, taglen) != 0)
+            rv = 0;
+    }
+    if (rv == 0)
+        OPENSSL_cleanse(out, len);
+    return rv;
+}
+
+static int ccm_generic_auth_encrypt(PROV_CCM_CTX *ctx, const unsigned char *in,
+                                    unsigned char *out, size_t len,
+                                    unsigned char *tag, size_t taglen)
+{
+    return ccm_generic_encrypt(ctx, in, out, len, tag, taglen, NULL);
+}
+
+static int ccm_generic_auth_decrypt(PROV_CCM_CTX *ctx, const unsigned char *in,
+                                    unsigned char *out, size_t len,
+                                    unsigned char *expected_tag, size_t taglen)
+{
+    return ccm_generic_decrypt(ctx, in, out, len, expected_tag, taglen, NULL);
+}
+
+static int generic_aes_ccm_initkey(PROV_CCM_CTX *ctx, const unsigned char *key,
+                                   size_t keylen)
+{
+    PROV_AES_CCM_CTX *actx = (PROV_AES_CCM_CTX *)ctx;
+
+#ifdef HWAES_CAPABLE
+    if (HWAES_CAPABLE) {
+        CCM_HW_SET_KEY_FN(HWAES_set_encrypt_key, HWAES_encrypt);
+    } else
+#endif /* HWAES_CAPABLE */
+#ifdef VPAES_CAPABLE
+    if (VPAES_CAPABLE) {
+        CCM_HW_SET_KEY_FN(vpaes_set_encrypt_key, vpaes_encrypt);
+    } else
+#endif
+    {
+        CCM_HW_SET_KEY_FN(AES_set_encrypt_key, AES_encrypt);
+    }
+    return 1;
+}
+
+static const PROV_CCM_HW aes_ccm = {
+    generic_aes_ccm_initkey,
+    ccm_generic_setiv,
+    ccm_generic_setaad,
+    ccm_generic_auth_encrypt,
+    ccm_generic_auth_decrypt,
+    ccm_generic_gettag
+};
+
+#if defined(AESNI_CAPABLE)
+
+/* AES-NI section */
+static int aesni_ccm_initkey(PROV_CCM_CTX *ctx, const unsigned char *key,
+                             size_t keylen)
+{
+    PROV_AES_CCM_CTX *actx = (PROV_AES_CCM_CTX *)ctx;
+
+    CCM_HW_SET_KEY_FN(aesni_set_encrypt_key, aesni_encrypt);
+    return 1;
+}
+
+/*
+ * The stitched CBC-MAC/CTR routines are direction specific, so they are
+ * chosen per call rather than when the key is set.
+ */
+static int aesni_ccm_auth_encrypt(PROV_CCM_CTX *ctx, const unsigned char *in,
+                                  unsigned char *out, size_t len,
+                                  unsigned char *tag, size_t taglen)
+{
+    return ccm_generic_encrypt(ctx, in, out, len, tag, taglen,
+                               (ccm128_f)aesni_ccm64_encrypt_blocks);
+}
+
+static int aesni_ccm_auth_decrypt(PROV_CCM_CTX *ctx, const unsigned char *in,
+                                  unsigned char *out, size_t len,
+                                  unsigned char *expected_tag, size_t taglen)
+{
+    return ccm_generic_decrypt(ctx, in, out, len, expected_tag, taglen,
+                               (ccm128_f)aesni_ccm64_decrypt_blocks);
+}
+
+static const PROV_CCM_HW aesni_ccm = {
+    aesni_ccm_initkey,
+    ccm_generic_setiv,
+    ccm_generic_setaad,
+    aesni_ccm_auth_encrypt,
+    aesni_ccm_auth_decrypt,
+    ccm_generic_gettag
+};
+
+const PROV_CCM_HW *PROV_AES_HW_ccm(size_t keybits)
+{
+    return AESNI_CAPABLE ? &aesni_ccm : &aes_ccm;
+}
+
+#else
+const PROV_CCM_HW *PROV_AES_HW_ccm(size_t keybits)
+{
+    return &aes_ccm;
+}
+#endif
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <openssl/aes.h>
+
+typedef struct prov_ccm_hw_st PROV_CCM_HW;
+
+#define CCM_L_DEFAULT       8   /* L and M defaults as for the legacy cipher */
+#define CCM_M_DEFAULT       12
+
+typedef struct prov_ccm_ctx_st {
+    int enc;                /* Set to 1 if we are encrypting or 0 otherwise */
+    int key_set;            /* Set if key initialised */
+    int iv_set;             /* Set if an iv is set */
+    int tag_set;            /* Set if tag is valid */
+    int len_set;            /* Set if message length set */
+    size_t l, m;            /* L and M parameters from RFC3610 */
+    size_t keylen;
+    int tls_aad_len;        /* TLS AAD length */
+    int tls_aad_pad_sz;
+    unsigned char iv[AES_BLOCK_SIZE];
+    unsigned char buf[AES_BLOCK_SIZE];
+    CCM128_CONTEXT ccm_ctx;
+    const PROV_CCM_HW *hw;  /* hardware specific methods */
+} PROV_CCM_CTX;
+
+typedef struct prov_aes_ccm_ctx_st {
+    PROV_CCM_CTX base;          /* must be first entry in struct */
+    union {
+        OSSL_UNION_ALIGN;
+        AES_KEY ks;
+    } ks;                       /* AES key schedule to use */
+} PROV_AES_CCM_CTX;
+
+OSSL_CIPHER_FUNC(int, CCM_setkey, (PROV_CCM_CTX *ctx,
+                                   const unsigned char *key, size_t keylen));
+OSSL_CIPHER_FUNC(int, CCM_setiv, (PROV_CCM_CTX *dat,
+                                  const unsigned char *iv, size_t ivlen,
+                                  size_t mlen));
+OSSL_CIPHER_FUNC(int, CCM_setaad, (PROV_CCM_CTX *ctx,
+                                   const unsigned char *aad, size_t aadlen));
+OSSL_CIPHER_FUNC(int, CCM_auth_encrypt, (PROV_CCM_CTX *ctx,
+                                         const unsigned char *in,
+                                         unsigned char *out, size_t len,
+                                         unsigned char *tag, size_t taglen));
+OSSL_CIPHER_FUNC(int, CCM_auth_decrypt, (PROV_CCM_CTX *ctx,
+                                         const unsigned char *in,
+                                         unsigned char *out, size_t len,
+                                         unsigned char *tag, size_t taglen));
+OSSL_CIPHER_FUNC(int, CCM_gettag, (PROV_CCM_CTX *ctx,
+                                   unsigned char *tag, size_t taglen));
+
+/*
+ * CCM Mode internal method table used to handle hardware specific differences,
+ * (and different algorithms).
+ */
+struct prov_ccm_hw_st {
+    OSSL_CCM_setkey_fn setkey;
+    OSSL_CCM_setiv_fn setiv;
+    OSSL_CCM_setaad_fn setaad;
+    OSSL_CCM_auth_encrypt_fn auth_encrypt;
+    OSSL_CCM_auth_decrypt_fn auth_decrypt;
+    OSSL_CCM_gettag_fn gettag;
+};
+
+const PROV_CCM_HW *PROV_AES_HW_ccm(size_t keylen);
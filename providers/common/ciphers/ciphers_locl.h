@@ -129,6 +129,7 @@ struct prov_aes_cipher_st {
 #define OSSL_CIPHER_FUNC(type, name, args) typedef type (* OSSL_##name##_fn)args
 
 #include "ciphers_gcm.h"
+#include "ciphers_ccm.h"
 
 const PROV_AES_CIPHER *PROV_AES_CIPHER_ecb(size_t keylen);
 const PROV_AES_CIPHER *PROV_AES_CIPHER_cbc(size_t keylen);
@@ -30,6 +30,8 @@ static OSSL_OP_cipher_set_ctx_params_fn gcm_set_ctx_params;
 static OSSL_OP_cipher_cipher_fn gcm_cipher;
 static OSSL_OP_cipher_update_fn gcm_stream_update;
 static OSSL_OP_cipher_final_fn gcm_stream_final;
+static OSSL_OP_cipher_aead_seal_fn gcm_aead_seal;
+static OSSL_OP_cipher_aead_open_fn gcm_aead_open;
 
 static int gcm_tls_init(PROV_GCM_CTX *dat, unsigned char *aad, size_t aad_len);
 static int gcm_tls_iv_set_fixed(PROV_GCM_CTX *ctx, unsigned char *iv,
@@ -59,6 +61,19 @@ static void gcm_deinitctx(PROV_GCM_CTX *ctx)
     OPENSSL_cleanse(ctx->iv, sizeof(ctx->iv));
 }
 
+/*
+ * A duplicated context is a byte copy of the original, so the pointers to
+ * the key schedule must be moved to the copy's own schedule |ks|.
+ */
+static void gcm_dupctx_fixup(PROV_GCM_CTX *out, const PROV_GCM_CTX *in,
+                             const void *ks)
+{
+    if (in->ks != NULL)
+        out->ks = ks;
+    if (in->gcm.key != NULL)
+        out->gcm.key = (void *)ks;
+}
+
 static int gcm_init(void *vctx, const unsigned char *key, size_t keylen,
                     const unsigned char *iv, size_t ivlen, int enc)
 {
@@ -281,6 +296,82 @@ static int gcm_cipher(void *vctx,
     return 1;
 }
 
+/*
+ * One-shot AEAD: the key (optional), IV, AAD, payload and tag are all passed
+ * in a single call. The IV is used for this record only and is not kept for
+ * later streaming calls.
+ */
+static int gcm_aead_init(PROV_GCM_CTX *ctx, int enc, const unsigned char *key,
+                         size_t keylen, const unsigned char *iv, size_t ivlen,
+                         size_t taglen)
+{
+    ctx->enc = enc;
+    ctx->tls_aad_len = -1;
+    ctx->iv_state = IV_STATE_FINISHED;
+
+    if (taglen == 0 || taglen > GCM_TAG_MAX_SIZE) {
+        PROVerr(0, PROV_R_INVALID_TAG);
+        return 0;
+    }
+    if (ivlen < ctx->ivlen_min || ivlen > sizeof(ctx->iv)) {
+        PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+        return 0;
+    }
+    if (key != NULL) {
+        if (keylen != ctx->keylen) {
+            PROVerr(0, PROV_R_INVALID_KEY_LENGTH);
+            return 0;
+        }
+        if (!ctx->hw->setkey(ctx, key, ctx->keylen))
+            return 0;
+    }
+    if (!ctx->key_set)
+        return 0;
+    return ctx->hw->setiv(ctx, iv, ivlen);
+}
+
+static int gcm_aead_seal(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen,
+                         const unsigned char *aad, size_t aadlen,
+                         unsigned char *out, const unsigned char *in,
+                         size_t inl, unsigned char *tag, size_t taglen)
+{
+    PROV_GCM_CTX *ctx = (PROV_GCM_CTX *)vctx;
+    const PROV_GCM_HW *hw = ctx->hw;
+    unsigned char buf[GCM_TAG_MAX_SIZE];
+
+    if (!gcm_aead_init(ctx, 1, key, keylen, iv, ivlen, taglen)
+            || (aadlen > 0 && !hw->aadupdate(ctx, aad, aadlen))
+            || (inl > 0 && !hw->cipherupdate(ctx, in, inl, out))
+            || !hw->cipherfinal(ctx, buf))
+        return 0;
+    memcpy(tag, buf, taglen);
+    return 1;
+}
+
+static int gcm_aead_open(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen,
+                         const unsigned char *aad, size_t aadlen,
+                         unsigned char *out, const unsigned char *in,
+                         size_t inl, const unsigned char *tag, size_t taglen)
+{
+    PROV_GCM_CTX *ctx = (PROV_GCM_CTX *)vctx;
+    const PROV_GCM_HW *hw = ctx->hw;
+    unsigned char buf[GCM_TAG_MAX_SIZE];
+
+    if (!gcm_aead_init(ctx, 0, key, keylen, iv, ivlen, taglen))
+        return 0;
+    memcpy(buf, tag, taglen);
+    ctx->taglen = taglen;
+    if ((aadlen > 0 && !hw->aadupdate(ctx, aad, aadlen))
+            || (inl > 0 && !hw->cipherupdate(ctx, in, inl, out))
+            || !hw->cipherfinal(ctx, buf)) {
+        OPENSSL_cleanse(out, inl);
+        return 0;
+    }
+    return 1;
+}
+
 /*
  * See SP800-38D (GCM) Section 8 "Uniqueness requirement on IVS and keys"
  *
@@ -533,12 +624,15 @@ err:
         { OSSL_FUNC_CIPHER_CIPHER, (void (*)(void))gcm_cipher },               \
         { OSSL_FUNC_CIPHER_NEWCTX, (void (*)(void)) alg##kbits##gcm_newctx },  \
         { OSSL_FUNC_CIPHER_FREECTX, (void (*)(void)) alg##_gcm_freectx },      \
+        { OSSL_FUNC_CIPHER_DUPCTX, (void (*)(void)) alg##_gcm_dupctx },        \
         { OSSL_FUNC_CIPHER_GET_PARAMS,                                         \
             (void (*)(void)) alg##_##kbits##_##lcmode##_get_params },          \
         { OSSL_FUNC_CIPHER_GET_CTX_PARAMS,                                     \
             (void (*)(void))gcm_get_ctx_params },                              \
         { OSSL_FUNC_CIPHER_SET_CTX_PARAMS,                                     \
             (void (*)(void))gcm_set_ctx_params },                              \
+        { OSSL_FUNC_CIPHER_AEAD_SEAL, (void (*)(void))gcm_aead_seal },         \
+        { OSSL_FUNC_CIPHER_AEAD_OPEN, (void (*)(void))gcm_aead_open },         \
         { 0, NULL }                                                            \
     }
 
@@ -561,6 +655,22 @@ static void aes_gcm_freectx(void *vctx)
     OPENSSL_clear_free(ctx,  sizeof(*ctx));
 }
 
+static OSSL_OP_cipher_dupctx_fn aes_gcm_dupctx;
+static void *aes_gcm_dupctx(void *vctx)
+{
+    PROV_AES_GCM_CTX *in = (PROV_AES_GCM_CTX *)vctx;
+    PROV_AES_GCM_CTX *ret = OPENSSL_malloc(sizeof(*ret));
+
+    if (ret == NULL) {
+        PROVerr(0, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    /* The key schedule and GHASH table come along without being rederived */
+    *ret = *in;
+    gcm_dupctx_fixup(&ret->base, &in->base, &ret->ks.ks);
+    return ret;
+}
+
 /* aes128gcm_functions */
 IMPLEMENT_cipher(aes, gcm, GCM, AEAD_GCM_FLAGS, 128, 8, 96);
 /* aes192gcm_functions */
@@ -589,6 +699,21 @@ static void aria_gcm_freectx(void *vctx)
     OPENSSL_clear_free(ctx,  sizeof(*ctx));
 }
 
+static OSSL_OP_cipher_dupctx_fn aria_gcm_dupctx;
+static void *aria_gcm_dupctx(void *vctx)
+{
+    PROV_ARIA_GCM_CTX *in = (PROV_ARIA_GCM_CTX *)vctx;
+    PROV_ARIA_GCM_CTX *ret = OPENSSL_malloc(sizeof(*ret));
+
+    if (ret == NULL) {
+        PROVerr(0, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    *ret = *in;
+    gcm_dupctx_fixup(&ret->base, &in->base, &ret->ks.ks);
+    return ret;
+}
+
 /* aria128gcm_functions */
 IMPLEMENT_cipher(aria, gcm, GCM, AEAD_GCM_FLAGS, 128, 8, 96);
 /* aria192gcm_functions */
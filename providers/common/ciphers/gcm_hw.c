@@ -175,7 +175,7 @@ static int gcm_cipher_update(PROV_GCM_CTX *ctx, const unsigned char *in,
 
                 if (CRYPTO_gcm128_encrypt(&ctx->gcm, in, out, res))
                     return 0;
-                bulk = aesni_gcm_encrypt(in + res, out + res, len - res,
+                bulk = AESNI_GCM_ENCRYPT(in + res, out + res, len - res,
                                          ctx->gcm.key,
                                          ctx->gcm.Yi.c, ctx->gcm.Xi.u);
                 ctx->gcm.len.u[1] += bulk;
@@ -203,7 +203,7 @@ static int gcm_cipher_update(PROV_GCM_CTX *ctx, const unsigned char *in,
                 if (CRYPTO_gcm128_decrypt(&ctx->gcm, in, out, res))
                     return -1;
 
-                bulk = aesni_gcm_decrypt(in + res, out + res, len - res,
+                bulk = AESNI_GCM_DECRYPT(in + res, out + res, len - res,
                                          ctx->gcm.key,
                                          ctx->gcm.Yi.c, ctx->gcm.Xi.u);
                 ctx->gcm.len.u[1] += bulk;
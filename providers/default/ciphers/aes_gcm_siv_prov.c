@@ -0,0 +1,622 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* AES-GCM-SIV (RFC 8452), nonce misuse resistant AEAD */
+
+#include <string.h>
+#include <openssl/core_numbers.h>
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#include <openssl/evp.h>
+#include "internal/cryptlib.h"
+#include "internal/providercommonerr.h"
+#include "internal/provider_algs.h"
+#include "ciphers_locl.h"
+#include "internal/aes_platform.h"
+
+#define GCM_SIV_NONCE_LEN       12
+#define GCM_SIV_TAG_LEN         16
+/* RFC 8452 section 6: P_MAX and A_MAX are both 2^36 bytes */
+#define GCM_SIV_MAX_LEN         ((uint64_t)1 << 36)
+/*
+ * As for the other AEAD modes, less EVP_CIPH_CUSTOM_IV_LENGTH since the nonce
+ * is always 12 bytes and EVP_CIPH_FLAG_DEFAULT_ASN1 since GCM-SIV has no OID.
+ */
+#define AEAD_GCM_SIV_FLAGS (EVP_CIPH_FLAG_AEAD_CIPHER | EVP_CIPH_CUSTOM_IV     \
+                            | EVP_CIPH_FLAG_CUSTOM_CIPHER                      \
+                            | EVP_CIPH_ALWAYS_CALL_INIT | EVP_CIPH_CTRL_INIT   \
+                            | EVP_CIPH_CUSTOM_COPY)
+
+static OSSL_OP_cipher_encrypt_init_fn gcm_siv_einit;
+static OSSL_OP_cipher_decrypt_init_fn gcm_siv_dinit;
+static OSSL_OP_cipher_get_ctx_params_fn gcm_siv_get_ctx_params;
+static OSSL_OP_cipher_set_ctx_params_fn gcm_siv_set_ctx_params;
+static OSSL_OP_cipher_cipher_fn gcm_siv_cipher;
+static OSSL_OP_cipher_update_fn gcm_siv_stream_update;
+static OSSL_OP_cipher_final_fn gcm_siv_stream_final;
+static OSSL_OP_cipher_aead_seal_fn gcm_siv_aead_seal;
+static OSSL_OP_cipher_aead_open_fn gcm_siv_aead_open;
+static OSSL_OP_cipher_freectx_fn aes_gcm_siv_freectx;
+static OSSL_OP_cipher_dupctx_fn aes_gcm_siv_dupctx;
+
+typedef int (*gcm_siv_set_key_fn)(const unsigned char *key, const int bits,
+                                  AES_KEY *ks);
+
+typedef struct prov_aes_gcm_siv_ctx_st {
+    union {
+        OSSL_UNION_ALIGN;
+        AES_KEY ks;
+    } ks;                       /* key-generating key */
+    union {
+        OSSL_UNION_ALIGN;
+        AES_KEY ks;
+    } msg_ks;                   /* per nonce message-encryption key */
+    gcm_siv_set_key_fn set_key;
+    block128_f block;
+    /*
+     * POLYVAL is computed with the GHASH code: it is GHASH over byte
+     * reversed blocks keyed with mulX_GHASH(ByteReverse(H)), RFC 8452
+     * appendix A.
+     */
+    GCM128_CONTEXT polyval;
+    unsigned char hkey[16];
+    unsigned char nonce[GCM_SIV_NONCE_LEN];
+    unsigned char tag[GCM_SIV_TAG_LEN];
+    unsigned char aad_buf[16];
+    size_t aad_buf_len;
+    uint64_t aad_len;
+    size_t keylen;
+    int enc;
+    int key_set;
+    int iv_set;
+    int tag_set;
+    int done;                   /* Set once the payload has been processed */
+} PROV_AES_GCM_SIV_CTX;
+
+/* The "block cipher" handed to the GHASH code just returns the hash key */
+static void gcm_siv_hkey_block(const unsigned char in[16],
+                               unsigned char out[16], const void *key)
+{
+    memcpy(out, key, 16);
+}
+
+static void gcm_siv_select(PROV_AES_GCM_SIV_CTX *ctx)
+{
+#if defined(AESNI_CAPABLE)
+    if (AESNI_CAPABLE) {
+        ctx->set_key = aesni_set_encrypt_key;
+        ctx->block = (block128_f)aesni_encrypt;
+        return;
+    }
+#endif
+#ifdef HWAES_CAPABLE
+    if (HWAES_CAPABLE) {
+        ctx->set_key = HWAES_set_encrypt_key;
+        ctx->block = (block128_f)HWAES_encrypt;
+        return;
+    }
+#endif
+#ifdef VPAES_CAPABLE
+    if (VPAES_CAPABLE) {
+        ctx->set_key = vpaes_set_encrypt_key;
+        ctx->block = (block128_f)vpaes_encrypt;
+        return;
+    }
+#endif
+    ctx->set_key = AES_set_encrypt_key;
+    ctx->block = (block128_f)AES_encrypt;
+}
+
+/* Feed whole 16 byte blocks to POLYVAL */
+static int gcm_siv_polyval(PROV_AES_GCM_SIV_CTX *ctx, const unsigned char *in,
+                           size_t len)
+{
+    unsigned char buf[256];
+    size_t i, n;
+
+    while (len > 0) {
+        n = len < sizeof(buf) ? len : sizeof(buf);
+        for (i = 0; i < n; i++)
+            buf[i] = in[(i & ~(size_t)15) + 15 - (i & 15)];
+        if (CRYPTO_gcm128_aad(&ctx->polyval, buf, n) != 0)
+            return 0;
+        in += n;
+        len -= n;
+    }
+    return 1;
+}
+
+/* Derive the per nonce keys, RFC 8452 section 4 */
+static int gcm_siv_derive_keys(PROV_AES_GCM_SIV_CTX *ctx)
+{
+    static const unsigned char zero[12] = { 0 };
+    unsigned char in[16], out[16], keys[8 * 6], carry;
+    size_t i, n = ctx->keylen == 32 ? 6 : 4;
+
+    memcpy(in + 4, ctx->nonce, GCM_SIV_NONCE_LEN);
+    for (i = 0; i < n; i++) {
+        in[0] = (unsigned char)i;
+        in[1] = in[2] = in[3] = 0;
+        ctx->block(in, out, &ctx->ks.ks);
+        memcpy(keys + 8 * i, out, 8);
+    }
+
+    /* The GHASH key is mulX_GHASH(ByteReverse(auth key)) */
+    for (i = 0; i < 16; i++)
+        ctx->hkey[i] = keys[15 - i];
+    carry = ctx->hkey[15] & 1;
+    for (i = 15; i > 0; i--)
+        ctx->hkey[i] = (unsigned char)((ctx->hkey[i] >> 1)
+                                       | (ctx->hkey[i - 1] << 7));
+    ctx->hkey[0] >>= 1;
+    if (carry)
+        ctx->hkey[0] ^= 0xe1;
+    CRYPTO_gcm128_init(&ctx->polyval, ctx->hkey,
+                       (block128_f)gcm_siv_hkey_block);
+    CRYPTO_gcm128_setiv(&ctx->polyval, zero, sizeof(zero));
+
+    ctx->set_key(keys + 16, (int)ctx->keylen * 8, &ctx->msg_ks.ks);
+    OPENSSL_cleanse(keys, sizeof(keys));
+    OPENSSL_cleanse(out, sizeof(out));
+
+    ctx->aad_len = 0;
+    ctx->aad_buf_len = 0;
+    ctx->done = 0;
+    return 1;
+}
+
+static int gcm_siv_init(void *vctx, const unsigned char *key, size_t keylen,
+                        const unsigned char *iv, size_t ivlen, int enc)
+{
+    PROV_AES_GCM_SIV_CTX *ctx = (PROV_AES_GCM_SIV_CTX *)vctx;
+
+    ctx->enc = enc;
+    if (key != NULL) {
+        if (keylen != ctx->keylen) {
+            PROVerr(0, PROV_R_INVALID_KEY_LENGTH);
+            return 0;
+        }
+        ctx->set_key(key, (int)keylen * 8, &ctx->ks.ks);
+        ctx->key_set = 1;
+    }
+    if (iv != NULL) {
+        if (ivlen != GCM_SIV_NONCE_LEN) {
+            PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+            return 0;
+        }
+        memcpy(ctx->nonce, iv, ivlen);
+        ctx->iv_set = 1;
+    }
+    if ((key != NULL || iv != NULL) && ctx->key_set && ctx->iv_set)
+        return gcm_siv_derive_keys(ctx);
+    return 1;
+}
+
+static int gcm_siv_einit(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen)
+{
+    return gcm_siv_init(vctx, key, keylen, iv, ivlen, 1);
+}
+
+static int gcm_siv_dinit(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen)
+{
+    return gcm_siv_init(vctx, key, keylen, iv, ivlen, 0);
+}
+
+/* AAD may be supplied in pieces, but only before the payload */
+static int gcm_siv_aad(PROV_AES_GCM_SIV_CTX *ctx, const unsigned char *aad,
+                       size_t len)
+{
+    size_t n;
+
+    if (ctx->done || len > GCM_SIV_MAX_LEN - ctx->aad_len)
+        return 0;
+    ctx->aad_len += len;
+
+    if (ctx->aad_buf_len > 0) {
+        n = 16 - ctx->aad_buf_len;
+        if (n > len)
+            n = len;
+        memcpy(ctx->aad_buf + ctx->aad_buf_len, aad, n);
+        ctx->aad_buf_len += n;
+        aad += n;
+        len -= n;
+        if (ctx->aad_buf_len < 16)
+            return 1;
+        if (!gcm_siv_polyval(ctx, ctx->aad_buf, 16))
+            return 0;
+        ctx->aad_buf_len = 0;
+    }
+    n = len & ~(size_t)15;
+    if (n > 0 && !gcm_siv_polyval(ctx, aad, n))
+        return 0;
+    if (len > n) {
+        memcpy(ctx->aad_buf, aad + n, len - n);
+        ctx->aad_buf_len = len - n;
+    }
+    return 1;
+}
+
+/* Zero pad and hash a trailing partial block */
+static int gcm_siv_polyval_padded(PROV_AES_GCM_SIV_CTX *ctx,
+                                  const unsigned char *in, size_t len)
+{
+    unsigned char buf[16];
+    size_t n = len & ~(size_t)15;
+
+    if (n > 0 && !gcm_siv_polyval(ctx, in, n))
+        return 0;
+    if (len > n) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, in + n, len - n);
+        if (!gcm_siv_polyval(ctx, buf, sizeof(buf)))
+            return 0;
+    }
+    return 1;
+}
+
+static int gcm_siv_compute_tag(PROV_AES_GCM_SIV_CTX *ctx,
+                               const unsigned char *text, size_t len,
+                               unsigned char tag[GCM_SIV_TAG_LEN])
+{
+    unsigned char lens[16], s[16];
+    uint64_t bits;
+    size_t i;
+
+    if (!gcm_siv_polyval_padded(ctx, text, len))
+        return 0;
+    bits = ctx->aad_len * 8;
+    for (i = 0; i < 8; i++)
+        lens[i] = (unsigned char)(bits >> (8 * i));
+    bits = (uint64_t)len * 8;
+    for (i = 0; i < 8; i++)
+        lens[8 + i] = (unsigned char)(bits >> (8 * i));
+    if (!gcm_siv_polyval(ctx, lens, sizeof(lens)))
+        return 0;
+
+    for (i = 0; i < 16; i++)
+        s[i] = ctx->polyval.Xi.c[15 - i];
+    for (i = 0; i < GCM_SIV_NONCE_LEN; i++)
+        s[i] ^= ctx->nonce[i];
+    s[15] &= 0x7f;
+    ctx->block(s, tag, &ctx->msg_ks.ks);
+    return 1;
+}
+
+/* AES-CTR with a little endian 32 bit counter in the first word */
+static void gcm_siv_ctr(PROV_AES_GCM_SIV_CTX *ctx, unsigned char *out,
+                        const unsigned char *in, size_t len,
+                        const unsigned char tag[GCM_SIV_TAG_LEN])
+{
+    unsigned char ctr[16], ks[16];
+    uint32_t c;
+    size_t i, n;
+
+    memcpy(ctr, tag, sizeof(ctr));
+    ctr[15] |= 0x80;
+    c = (uint32_t)ctr[0] | (uint32_t)ctr[1] << 8 | (uint32_t)ctr[2] << 16
+        | (uint32_t)ctr[3] << 24;
+    while (len > 0) {
+        ctx->block(ctr, ks, &ctx->msg_ks.ks);
+        n = len < 16 ? len : 16;
+        for (i = 0; i < n; i++)
+            out[i] = in[i] ^ ks[i];
+        in += n;
+        out += n;
+        len -= n;
+        c++;
+        ctr[0] = (unsigned char)c;
+        ctr[1] = (unsigned char)(c >> 8);
+        ctr[2] = (unsigned char)(c >> 16);
+        ctr[3] = (unsigned char)(c >> 24);
+    }
+    OPENSSL_cleanse(ks, sizeof(ks));
+}
+
+/*
+ * The whole payload is needed to compute the tag before any output can be
+ * produced, so it must be passed in a single call.
+ */
+static int gcm_siv_text(PROV_AES_GCM_SIV_CTX *ctx, unsigned char *out,
+                        const unsigned char *in, size_t len)
+{
+    unsigned char tag[GCM_SIV_TAG_LEN];
+    int ok;
+
+    if (!ctx->key_set || !ctx->iv_set || ctx->done
+            || (uint64_t)len > GCM_SIV_MAX_LEN)
+        return 0;
+    ctx->done = 1;
+
+    if (ctx->aad_buf_len > 0) {
+        memset(ctx->aad_buf + ctx->aad_buf_len, 0, 16 - ctx->aad_buf_len);
+        if (!gcm_siv_polyval(ctx, ctx->aad_buf, 16))
+            return 0;
+        ctx->aad_buf_len = 0;
+    }
+
+    if (ctx->enc) {
+        if (!gcm_siv_compute_tag(ctx, in, len, ctx->tag))
+            return 0;
+        gcm_siv_ctr(ctx, out, in, len, ctx->tag);
+        ctx->tag_set = 1;
+        return 1;
+    }
+
+    if (!ctx->tag_set)
+        return 0;
+    gcm_siv_ctr(ctx, out, in, len, ctx->tag);
+    ok = gcm_siv_compute_tag(ctx, out, len, tag)
+         && CRYPTO_memcmp(tag, ctx->tag, GCM_SIV_TAG_LEN) == 0;
+    if (!ok)
+        OPENSSL_cleanse(out, len);
+    return ok;
+}
+
+static int gcm_siv_cipher_internal(PROV_AES_GCM_SIV_CTX *ctx,
+                                   unsigned char *out, size_t *outl,
+                                   const unsigned char *in, size_t len)
+{
+    *outl = 0;
+    if (!ctx->key_set || !ctx->iv_set)
+        return 0;
+
+    /* Finished when in == NULL */
+    if (in == NULL)
+        return ctx->done || gcm_siv_text(ctx, out, NULL, 0);
+
+    /* The input is AAD if out is NULL */
+    if (out == NULL)
+        return gcm_siv_aad(ctx, in, len);
+
+    if (!gcm_siv_text(ctx, out, in, len))
+        return 0;
+    *outl = len;
+    return 1;
+}
+
+static int gcm_siv_stream_update(void *vctx, unsigned char *out, size_t *outl,
+                                 size_t outsize, const unsigned char *in,
+                                 size_t inl)
+{
+    PROV_AES_GCM_SIV_CTX *ctx = (PROV_AES_GCM_SIV_CTX *)vctx;
+
+    if (out != NULL && outsize < inl) {
+        PROVerr(0, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return 0;
+    }
+    if (!gcm_siv_cipher_internal(ctx, out, outl, in, inl)) {
+        PROVerr(0, PROV_R_CIPHER_OPERATION_FAILED);
+        return 0;
+    }
+    return 1;
+}
+
+static int gcm_siv_stream_final(void *vctx, unsigned char *out, size_t *outl,
+                                size_t outsize)
+{
+    PROV_AES_GCM_SIV_CTX *ctx = (PROV_AES_GCM_SIV_CTX *)vctx;
+
+    return gcm_siv_cipher_internal(ctx, out, outl, NULL, 0);
+}
+
+static int gcm_siv_cipher(void *vctx, unsigned char *out, size_t *outl,
+                          size_t outsize, const unsigned char *in, size_t inl)
+{
+    PROV_AES_GCM_SIV_CTX *ctx = (PROV_AES_GCM_SIV_CTX *)vctx;
+
+    if (outsize < inl) {
+        PROVerr(0, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return 0;
+    }
+    return gcm_siv_cipher_internal(ctx, out, outl, in, inl);
+}
+
+static int gcm_siv_get_ctx_params(void *vctx, OSSL_PARAM params[])
+{
+    PROV_AES_GCM_SIV_CTX *ctx = (PROV_AES_GCM_SIV_CTX *)vctx;
+    OSSL_PARAM *p;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_IVLEN);
+    if (p != NULL && !OSSL_PARAM_set_int(p, GCM_SIV_NONCE_LEN)) {
+        PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL && !OSSL_PARAM_set_int(p, (int)ctx->keylen)) {
+        PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        if (!ctx->enc || !ctx->done || p->data_size != GCM_SIV_TAG_LEN) {
+            PROVerr(0, PROV_R_INVALID_TAG);
+            return 0;
+        }
+        if (!OSSL_PARAM_set_octet_string(p, ctx->tag, GCM_SIV_TAG_LEN)) {
+            PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int gcm_siv_set_ctx_params(void *vctx, const OSSL_PARAM params[])
+{
+    PROV_AES_GCM_SIV_CTX *ctx = (PROV_AES_GCM_SIV_CTX *)vctx;
+    const OSSL_PARAM *p;
+    size_t sz;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        if (p->data_type != OSSL_PARAM_OCTET_STRING
+                || p->data_size != GCM_SIV_TAG_LEN) {
+            PROVerr(0, PROV_R_INVALID_TAG);
+            return 0;
+        }
+        /* A NULL tag only sets the (fixed) tag length */
+        if (p->data != NULL) {
+            if (ctx->enc) {
+                PROVerr(0, PROV_R_INVALID_TAG);
+                return 0;
+            }
+            memcpy(ctx->tag, p->data, GCM_SIV_TAG_LEN);
+            ctx->tag_set = 1;
+        }
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_IVLEN);
+    if (p != NULL) {
+        if (!OSSL_PARAM_get_size_t(p, &sz)) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        if (sz != GCM_SIV_NONCE_LEN) {
+            PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+            return 0;
+        }
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL) {
+        int keylen;
+
+        if (!OSSL_PARAM_get_int(p, &keylen)) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        /* The key length can not be modified */
+        if (keylen != (int)ctx->keylen)
+            return 0;
+    }
+    return 1;
+}
+
+static int gcm_siv_aead_init(PROV_AES_GCM_SIV_CTX *ctx, int enc,
+                             const unsigned char *key, size_t keylen,
+                             const unsigned char *iv, size_t ivlen,
+                             const unsigned char *aad, size_t aadlen,
+                             size_t taglen)
+{
+    if (taglen != GCM_SIV_TAG_LEN) {
+        PROVerr(0, PROV_R_INVALID_TAG);
+        return 0;
+    }
+    if (ivlen != GCM_SIV_NONCE_LEN) {
+        PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+        return 0;
+    }
+    if (key == NULL && !ctx->key_set) {
+        PROVerr(0, PROV_R_NO_KEY_SET);
+        return 0;
+    }
+    return gcm_siv_init(ctx, key, keylen, iv, ivlen, enc)
+           && gcm_siv_aad(ctx, aad, aadlen);
+}
+
+static int gcm_siv_aead_seal(void *vctx, const unsigned char *key,
+                             size_t keylen, const unsigned char *iv,
+                             size_t ivlen, const unsigned char *aad,
+                             size_t aadlen, unsigned char *out,
+                             const unsigned char *in, size_t inl,
+                             unsigned char *tag, size_t taglen)
+{
+    PROV_AES_GCM_SIV_CTX *ctx = (PROV_AES_GCM_SIV_CTX *)vctx;
+
+    if (!gcm_siv_aead_init(ctx, 1, key, keylen, iv, ivlen, aad, aadlen, taglen)
+            || !gcm_siv_text(ctx, out, in, inl))
+        return 0;
+    memcpy(tag, ctx->tag, GCM_SIV_TAG_LEN);
+    return 1;
+}
+
+static int gcm_siv_aead_open(void *vctx, const unsigned char *key,
+                             size_t keylen, const unsigned char *iv,
+                             size_t ivlen, const unsigned char *aad,
+                             size_t aadlen, unsigned char *out,
+                             const unsigned char *in, size_t inl,
+                             const unsigned char *tag, size_t taglen)
+{
+    PROV_AES_GCM_SIV_CTX *ctx = (PROV_AES_GCM_SIV_CTX *)vctx;
+
+    if (!gcm_siv_aead_init(ctx, 0, key, keylen, iv, ivlen, aad, aadlen,
+                           taglen))
+        return 0;
+    memcpy(ctx->tag, tag, GCM_SIV_TAG_LEN);
+    ctx->tag_set = 1;
+    return gcm_siv_text(ctx, out, in, inl);
+}
+
+static void *aes_gcm_siv_newctx(void *provctx, size_t kbits)
+{
+    PROV_AES_GCM_SIV_CTX *ctx = OPENSSL_zalloc(sizeof(*ctx));
+
+    if (ctx != NULL) {
+        ctx->keylen = kbits / 8;
+        gcm_siv_select(ctx);
+    }
+    return ctx;
+}
+
+static void aes_gcm_siv_freectx(void *vctx)
+{
+    OPENSSL_clear_free(vctx, sizeof(PROV_AES_GCM_SIV_CTX));
+}
+
+static void *aes_gcm_siv_dupctx(void *vctx)
+{
+    PROV_AES_GCM_SIV_CTX *in = (PROV_AES_GCM_SIV_CTX *)vctx;
+    PROV_AES_GCM_SIV_CTX *ret = OPENSSL_malloc(sizeof(*ret));
+
+    if (ret == NULL) {
+        PROVerr(0, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    *ret = *in;
+    if (in->polyval.key != NULL)
+        ret->polyval.key = ret->hkey;
+    return ret;
+}
+
+#define IMPLEMENT_cipher(kbits)                                                \
+    static OSSL_OP_cipher_get_params_fn aes_##kbits##_gcm_siv_get_params;      \
+    static int aes_##kbits##_gcm_siv_get_params(OSSL_PARAM params[])           \
+    {                                                                          \
+        return aes_get_params(params, EVP_CIPH_SIV_MODE, AEAD_GCM_SIV_FLAGS,   \
+                              kbits, 8, GCM_SIV_NONCE_LEN * 8);                \
+    }                                                                          \
+    static OSSL_OP_cipher_newctx_fn aes##kbits##gcm_siv_newctx;                \
+    static void *aes##kbits##gcm_siv_newctx(void *provctx)                     \
+    {                                                                          \
+        return aes_gcm_siv_newctx(provctx, kbits);                             \
+    }                                                                          \
+    const OSSL_DISPATCH aes##kbits##gcm_siv_functions[] = {                    \
+        { OSSL_FUNC_CIPHER_ENCRYPT_INIT, (void (*)(void))gcm_siv_einit },      \
+        { OSSL_FUNC_CIPHER_DECRYPT_INIT, (void (*)(void))gcm_siv_dinit },      \
+        { OSSL_FUNC_CIPHER_UPDATE, (void (*)(void))gcm_siv_stream_update },    \
+        { OSSL_FUNC_CIPHER_FINAL, (void (*)(void))gcm_siv_stream_final },      \
+        { OSSL_FUNC_CIPHER_CIPHER, (void (*)(void))gcm_siv_cipher },           \
+        { OSSL_FUNC_CIPHER_NEWCTX,                                             \
+            (void (*)(void))aes##kbits##gcm_siv_newctx },                      \
+        { OSSL_FUNC_CIPHER_FREECTX, (void (*)(void))aes_gcm_siv_freectx },     \
+        { OSSL_FUNC_CIPHER_DUPCTX, (void (*)(void))aes_gcm_siv_dupctx },       \
+        { OSSL_FUNC_CIPHER_GET_PARAMS,                                         \
+            (void (*)(void))aes_##kbits##_gcm_siv_get_params },                \
+        { OSSL_FUNC_CIPHER_GET_CTX_PARAMS,                                     \
+            (void (*)(void))gcm_siv_get_ctx_params },                          \
+        { OSSL_FUNC_CIPHER_SET_CTX_PARAMS,                                     \
+            (void (*)(void))gcm_siv_set_ctx_params },                          \
+        { OSSL_FUNC_CIPHER_AEAD_SEAL, (void (*)(void))gcm_siv_aead_seal },     \
+        { OSSL_FUNC_CIPHER_AEAD_OPEN, (void (*)(void))gcm_siv_aead_open },     \
+        { 0, NULL }                                                            \
+    }
+
+/* aes256gcm_siv_functions */
+IMPLEMENT_cipher(256);
+/* aes128gcm_siv_functions */
+IMPLEMENT_cipher(128);
@@ -0,0 +1,576 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* AES-OCB (RFC 7253) */
+
+#include <openssl/opensslconf.h>
+#ifndef OPENSSL_NO_OCB
+
+# include <string.h>
+# include <openssl/core_numbers.h>
+# include <openssl/core_names.h>
+# include <openssl/params.h>
+# include <openssl/evp.h>
+# include "internal/cryptlib.h"
+# include "internal/providercommonerr.h"
+# include "internal/provider_algs.h"
+# include "ciphers_locl.h"
+# include "internal/aes_platform.h"
+
+# define OCB_DEFAULT_TAG_LEN     16
+# define OCB_DEFAULT_IV_LEN      12
+# define OCB_MIN_IV_LEN          1
+# define OCB_MAX_IV_LEN          15
+/* The flags of EVP_aes_128_ocb(), the nonce can be 1 to 15 bytes long */
+# define AEAD_OCB_FLAGS (EVP_CIPH_FLAG_AEAD_CIPHER | EVP_CIPH_FLAG_DEFAULT_ASN1 \
+                        | EVP_CIPH_CUSTOM_IV | EVP_CIPH_FLAG_CUSTOM_CIPHER     \
+                        | EVP_CIPH_ALWAYS_CALL_INIT | EVP_CIPH_CTRL_INIT       \
+                        | EVP_CIPH_CUSTOM_COPY | EVP_CIPH_CUSTOM_IV_LENGTH)
+
+static OSSL_OP_cipher_encrypt_init_fn ocb_einit;
+static OSSL_OP_cipher_decrypt_init_fn ocb_dinit;
+static OSSL_OP_cipher_get_ctx_params_fn ocb_get_ctx_params;
+static OSSL_OP_cipher_set_ctx_params_fn ocb_set_ctx_params;
+static OSSL_OP_cipher_cipher_fn ocb_cipher;
+static OSSL_OP_cipher_update_fn ocb_stream_update;
+static OSSL_OP_cipher_final_fn ocb_stream_final;
+static OSSL_OP_cipher_aead_seal_fn ocb_aead_seal;
+static OSSL_OP_cipher_aead_open_fn ocb_aead_open;
+static OSSL_OP_cipher_freectx_fn aes_ocb_freectx;
+static OSSL_OP_cipher_dupctx_fn aes_ocb_dupctx;
+
+typedef struct prov_aes_ocb_ctx_st {
+    union {
+        OSSL_UNION_ALIGN;
+        AES_KEY ks;
+    } ksenc;                    /* AES key schedule to use for encryption */
+    union {
+        OSSL_UNION_ALIGN;
+        AES_KEY ks;
+    } ksdec;                    /* AES key schedule to use for decryption */
+    OCB128_CONTEXT ocb;
+    /* The bulk routines are direction specific, so keep both */
+    ocb128_f stream_enc, stream_dec;
+    int enc;
+    int key_set;
+    int iv_buffered;            /* Set if |iv| holds an IV */
+    int iv_set;                 /* Set if the IV has been applied */
+    size_t keylen;
+    size_t ivlen;
+    size_t taglen;
+    unsigned char iv[OCB_MAX_IV_LEN];
+    unsigned char tag[OCB_DEFAULT_TAG_LEN];
+    unsigned char data_buf[AES_BLOCK_SIZE]; /* Store partial data blocks */
+    unsigned char aad_buf[AES_BLOCK_SIZE];  /* Store partial AAD blocks */
+    size_t data_buf_len;
+    size_t aad_buf_len;
+} PROV_AES_OCB_CTX;
+
+static int ocb_set_key(PROV_AES_OCB_CTX *ctx, const unsigned char *key)
+{
+    int bits = (int)ctx->keylen * 8;
+    block128_f enc, dec;
+
+    /* Drop the L table of any previous key */
+    CRYPTO_ocb128_cleanup(&ctx->ocb);
+    ctx->stream_enc = ctx->stream_dec = NULL;
+# if defined(AESNI_CAPABLE)
+    if (AESNI_CAPABLE) {
+        aesni_set_encrypt_key(key, bits, &ctx->ksenc.ks);
+        aesni_set_decrypt_key(key, bits, &ctx->ksdec.ks);
+        enc = (block128_f)aesni_encrypt;
+        dec = (block128_f)aesni_decrypt;
+        ctx->stream_enc = (ocb128_f)aesni_ocb_encrypt;
+        ctx->stream_dec = (ocb128_f)aesni_ocb_decrypt;
+    } else
+# endif
+# ifdef HWAES_CAPABLE
+    if (HWAES_CAPABLE) {
+        HWAES_set_encrypt_key(key, bits, &ctx->ksenc.ks);
+        HWAES_set_decrypt_key(key, bits, &ctx->ksdec.ks);
+        enc = (block128_f)HWAES_encrypt;
+        dec = (block128_f)HWAES_decrypt;
+        ctx->stream_enc = HWAES_ocb_encrypt;
+        ctx->stream_dec = HWAES_ocb_decrypt;
+    } else
+# endif
+# ifdef VPAES_CAPABLE
+    if (VPAES_CAPABLE) {
+        vpaes_set_encrypt_key(key, bits, &ctx->ksenc.ks);
+        vpaes_set_decrypt_key(key, bits, &ctx->ksdec.ks);
+        enc = (block128_f)vpaes_encrypt;
+        dec = (block128_f)vpaes_decrypt;
+    } else
+# endif
+    {
+        AES_set_encrypt_key(key, bits, &ctx->ksenc.ks);
+        AES_set_decrypt_key(key, bits, &ctx->ksdec.ks);
+        enc = (block128_f)AES_encrypt;
+        dec = (block128_f)AES_decrypt;
+    }
+    if (!CRYPTO_ocb128_init(&ctx->ocb, &ctx->ksenc.ks, &ctx->ksdec.ks,
+                            enc, dec, NULL)) {
+        ctx->key_set = 0;
+        return 0;
+    }
+    ctx->key_set = 1;
+    return 1;
+}
+
+/* Start a new message with the buffered IV */
+static int ocb_set_iv(PROV_AES_OCB_CTX *ctx, const unsigned char *iv,
+                      size_t ivlen)
+{
+    ctx->ocb.stream = ctx->enc ? ctx->stream_enc : ctx->stream_dec;
+    ctx->data_buf_len = 0;
+    ctx->aad_buf_len = 0;
+    if (CRYPTO_ocb128_setiv(&ctx->ocb, iv, ivlen, ctx->taglen) != 1)
+        return 0;
+    ctx->iv_set = 1;
+    return 1;
+}
+
+static int ocb_init(void *vctx, const unsigned char *key, size_t keylen,
+                    const unsigned char *iv, size_t ivlen, int enc)
+{
+    PROV_AES_OCB_CTX *ctx = (PROV_AES_OCB_CTX *)vctx;
+
+    ctx->enc = enc;
+    if (iv != NULL) {
+        if (ivlen != ctx->ivlen) {
+            PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+            return 0;
+        }
+        memcpy(ctx->iv, iv, ivlen);
+        ctx->iv_buffered = 1;
+    }
+    if (key != NULL) {
+        if (keylen != ctx->keylen) {
+            PROVerr(0, PROV_R_INVALID_KEY_LENGTH);
+            return 0;
+        }
+        if (!ocb_set_key(ctx, key))
+            return 0;
+    }
+    /* The IV can only be applied once there is a key */
+    if (!ctx->key_set || !ctx->iv_buffered)
+        return 1;
+    return ocb_set_iv(ctx, ctx->iv, ctx->ivlen);
+}
+
+static int ocb_einit(void *vctx, const unsigned char *key, size_t keylen,
+                     const unsigned char *iv, size_t ivlen)
+{
+    return ocb_init(vctx, key, keylen, iv, ivlen, 1);
+}
+
+static int ocb_dinit(void *vctx, const unsigned char *key, size_t keylen,
+                     const unsigned char *iv, size_t ivlen)
+{
+    return ocb_init(vctx, key, keylen, iv, ivlen, 0);
+}
+
+static int ocb_process(PROV_AES_OCB_CTX *ctx, unsigned char *out,
+                       const unsigned char *in, size_t len)
+{
+    if (out == NULL)
+        return CRYPTO_ocb128_aad(&ctx->ocb, in, len);
+    if (ctx->enc)
+        return CRYPTO_ocb128_encrypt(&ctx->ocb, in, out, len);
+    return CRYPTO_ocb128_decrypt(&ctx->ocb, in, out, len);
+}
+
+/*
+ * Only full blocks are passed to the low level OCB routines, both for the
+ * payload and for the AAD; partial blocks are buffered until more data or
+ * the final call arrives.
+ */
+static int ocb_cipher_update(PROV_AES_OCB_CTX *ctx, unsigned char *out,
+                             size_t *outl, const unsigned char *in, size_t len)
+{
+    unsigned char *buf;
+    size_t *buf_len;
+    size_t written = 0, trailing;
+
+    if (!ctx->key_set || !ctx->iv_set)
+        return 0;
+
+    if (out == NULL) {
+        buf = ctx->aad_buf;
+        buf_len = &ctx->aad_buf_len;
+    } else {
+        buf = ctx->data_buf;
+        buf_len = &ctx->data_buf_len;
+    }
+
+    if (*buf_len > 0) {
+        size_t remaining = AES_BLOCK_SIZE - *buf_len;
+
+        if (remaining > len) {
+            memcpy(buf + *buf_len, in, len);
+            *buf_len += len;
+            *outl = 0;
+            return 1;
+        }
+        memcpy(buf + *buf_len, in, remaining);
+        len -= remaining;
+        in += remaining;
+        if (!ocb_process(ctx, out, buf, AES_BLOCK_SIZE))
+            return 0;
+        *buf_len = 0;
+        if (out != NULL) {
+            out += AES_BLOCK_SIZE;
+            written = AES_BLOCK_SIZE;
+        }
+    }
+
+    trailing = len % AES_BLOCK_SIZE;
+    if (len != trailing) {
+        if (!ocb_process(ctx, out, in, len - trailing))
+            return 0;
+        if (out != NULL)
+            written += len - trailing;
+        in += len - trailing;
+    }
+
+    if (trailing > 0) {
+        memcpy(buf, in, trailing);
+        *buf_len = trailing;
+    }
+    *outl = written;
+    return 1;
+}
+
+static int ocb_cipher_final(PROV_AES_OCB_CTX *ctx, unsigned char *out,
+                            size_t *outl)
+{
+    size_t written = 0;
+
+    if (!ctx->key_set || !ctx->iv_set)
+        return 0;
+
+    /* Flush any partial blocks of the payload and AAD */
+    if (ctx->data_buf_len > 0) {
+        if (out == NULL || !ocb_process(ctx, out, ctx->data_buf,
+                                        ctx->data_buf_len))
+            return 0;
+        written = ctx->data_buf_len;
+        ctx->data_buf_len = 0;
+    }
+    if (ctx->aad_buf_len > 0) {
+        if (!ocb_process(ctx, NULL, ctx->aad_buf, ctx->aad_buf_len))
+            return 0;
+        ctx->aad_buf_len = 0;
+    }
+
+    /* Don't reuse the IV */
+    ctx->iv_set = 0;
+    if (ctx->enc) {
+        if (CRYPTO_ocb128_tag(&ctx->ocb, ctx->tag, OCB_DEFAULT_TAG_LEN) != 1)
+            return 0;
+    } else if (CRYPTO_ocb128_finish(&ctx->ocb, ctx->tag, ctx->taglen) != 0) {
+        OPENSSL_cleanse(out, written);
+        return 0;
+    }
+    *outl = written;
+    return 1;
+}
+
+static int ocb_stream_update(void *vctx, unsigned char *out, size_t *outl,
+                             size_t outsize, const unsigned char *in,
+                             size_t inl)
+{
+    PROV_AES_OCB_CTX *ctx = (PROV_AES_OCB_CTX *)vctx;
+
+    if (out != NULL && outsize < ctx->data_buf_len + inl) {
+        PROVerr(0, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return 0;
+    }
+    if (!ocb_cipher_update(ctx, out, outl, in, inl)) {
+        PROVerr(0, PROV_R_CIPHER_OPERATION_FAILED);
+        return 0;
+    }
+    return 1;
+}
+
+static int ocb_stream_final(void *vctx, unsigned char *out, size_t *outl,
+                            size_t outsize)
+{
+    PROV_AES_OCB_CTX *ctx = (PROV_AES_OCB_CTX *)vctx;
+
+    if (outsize < ctx->data_buf_len) {
+        PROVerr(0, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return 0;
+    }
+    return ocb_cipher_final(ctx, out, outl);
+}
+
+static int ocb_cipher(void *vctx, unsigned char *out, size_t *outl,
+                      size_t outsize, const unsigned char *in, size_t inl)
+{
+    PROV_AES_OCB_CTX *ctx = (PROV_AES_OCB_CTX *)vctx;
+
+    if (in == NULL)
+        return ocb_cipher_final(ctx, out, outl);
+    if (outsize < inl + ctx->data_buf_len) {
+        PROVerr(0, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return 0;
+    }
+    return ocb_cipher_update(ctx, out, outl, in, inl);
+}
+
+static int ocb_get_ctx_params(void *vctx, OSSL_PARAM params[])
+{
+    PROV_AES_OCB_CTX *ctx = (PROV_AES_OCB_CTX *)vctx;
+    OSSL_PARAM *p;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_IVLEN);
+    if (p != NULL && !OSSL_PARAM_set_int(p, (int)ctx->ivlen)) {
+        PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL && !OSSL_PARAM_set_int(p, (int)ctx->keylen)) {
+        PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        if (p->data_type != OSSL_PARAM_OCTET_STRING) {
+            PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+            return 0;
+        }
+        if (!ctx->enc || p->data_size != ctx->taglen) {
+            PROVerr(0, PROV_R_INVALID_TAG);
+            return 0;
+        }
+        memcpy(p->data, ctx->tag, ctx->taglen);
+        p->return_size = ctx->taglen;
+    }
+    return 1;
+}
+
+static int ocb_set_ctx_params(void *vctx, const OSSL_PARAM params[])
+{
+    PROV_AES_OCB_CTX *ctx = (PROV_AES_OCB_CTX *)vctx;
+    const OSSL_PARAM *p;
+    size_t sz;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        if (p->data_type != OSSL_PARAM_OCTET_STRING) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        if (p->data == NULL) {
+            /* A NULL tag only sets the tag length */
+            if (p->data_size > OCB_DEFAULT_TAG_LEN) {
+                PROVerr(0, PROV_R_INVALID_TAG);
+                return 0;
+            }
+            ctx->taglen = p->data_size;
+        } else {
+            if (p->data_size != ctx->taglen || ctx->enc) {
+                PROVerr(0, PROV_R_INVALID_TAG);
+                return 0;
+            }
+            memcpy(ctx->tag, p->data, p->data_size);
+        }
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_IVLEN);
+    if (p != NULL) {
+        if (!OSSL_PARAM_get_size_t(p, &sz)) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        if (sz < OCB_MIN_IV_LEN || sz > OCB_MAX_IV_LEN) {
+            PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+            return 0;
+        }
+        ctx->ivlen = sz;
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL) {
+        int keylen;
+
+        if (!OSSL_PARAM_get_int(p, &keylen)) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        /* The key length can not be modified for ocb mode */
+        if (keylen != (int)ctx->keylen)
+            return 0;
+    }
+    return 1;
+}
+
+static int ocb_aead_init(PROV_AES_OCB_CTX *ctx, int enc,
+                         const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen, size_t taglen)
+{
+    ctx->enc = enc;
+    if (taglen == 0 || taglen > OCB_DEFAULT_TAG_LEN) {
+        PROVerr(0, PROV_R_INVALID_TAG);
+        return 0;
+    }
+    if (ivlen < OCB_MIN_IV_LEN || ivlen > OCB_MAX_IV_LEN) {
+        PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+        return 0;
+    }
+    if (key != NULL) {
+        if (keylen != ctx->keylen) {
+            PROVerr(0, PROV_R_INVALID_KEY_LENGTH);
+            return 0;
+        }
+        if (!ocb_set_key(ctx, key))
+            return 0;
+    }
+    if (!ctx->key_set) {
+        PROVerr(0, PROV_R_NO_KEY_SET);
+        return 0;
+    }
+    ctx->taglen = taglen;
+    return ocb_set_iv(ctx, iv, ivlen);
+}
+
+/*
+ * The one-shot calls hand whole buffers to the OCB routines, but like the
+ * streaming path they keep the full blocks and the trailing partial block
+ * in separate calls.
+ */
+static int ocb_aead_process(PROV_AES_OCB_CTX *ctx, unsigned char *out,
+                            const unsigned char *in, size_t len)
+{
+    size_t full = len & ~(size_t)(AES_BLOCK_SIZE - 1);
+
+    if (full > 0 && !ocb_process(ctx, out, in, full))
+        return 0;
+    if (len > full && !ocb_process(ctx, out + full, in + full, len - full))
+        return 0;
+    return 1;
+}
+
+static int ocb_aead_seal(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen,
+                         const unsigned char *aad, size_t aadlen,
+                         unsigned char *out, const unsigned char *in,
+                         size_t inl, unsigned char *tag, size_t taglen)
+{
+    PROV_AES_OCB_CTX *ctx = (PROV_AES_OCB_CTX *)vctx;
+    int ok;
+
+    ok = ocb_aead_init(ctx, 1, key, keylen, iv, ivlen, taglen)
+         && (aadlen == 0 || CRYPTO_ocb128_aad(&ctx->ocb, aad, aadlen))
+         && ocb_aead_process(ctx, out, in, inl)
+         && CRYPTO_ocb128_tag(&ctx->ocb, tag, taglen) == 1;
+    ctx->iv_set = 0;
+    return ok;
+}
+
+static int ocb_aead_open(void *vctx, const unsigned char *key, size_t keylen,
+                         const unsigned char *iv, size_t ivlen,
+                         const unsigned char *aad, size_t aadlen,
+                         unsigned char *out, const unsigned char *in,
+                         size_t inl, const unsigned char *tag, size_t taglen)
+{
+    PROV_AES_OCB_CTX *ctx = (PROV_AES_OCB_CTX *)vctx;
+
+    if (!ocb_aead_init(ctx, 0, key, keylen, iv, ivlen, taglen))
+        return 0;
+    ctx->iv_set = 0;
+    if ((aadlen > 0 && !CRYPTO_ocb128_aad(&ctx->ocb, aad, aadlen))
+            || !ocb_aead_process(ctx, out, in, inl)
+            || CRYPTO_ocb128_finish(&ctx->ocb, tag, taglen) != 0) {
+        OPENSSL_cleanse(out, inl);
+        return 0;
+    }
+    return 1;
+}
+
+static void *aes_ocb_newctx(void *provctx, size_t kbits)
+{
+    PROV_AES_OCB_CTX *ctx = OPENSSL_zalloc(sizeof(*ctx));
+
+    if (ctx != NULL) {
+        ctx->keylen = kbits / 8;
+        ctx->ivlen = OCB_DEFAULT_IV_LEN;
+        ctx->taglen = OCB_DEFAULT_TAG_LEN;
+    }
+    return ctx;
+}
+
+static void aes_ocb_freectx(void *vctx)
+{
+    PROV_AES_OCB_CTX *ctx = (PROV_AES_OCB_CTX *)vctx;
+
+    if (ctx != NULL) {
+        CRYPTO_ocb128_cleanup(&ctx->ocb);
+        OPENSSL_clear_free(ctx, sizeof(*ctx));
+    }
+}
+
+static void *aes_ocb_dupctx(void *vctx)
+{
+    PROV_AES_OCB_CTX *in = (PROV_AES_OCB_CTX *)vctx;
+    PROV_AES_OCB_CTX *ret = OPENSSL_malloc(sizeof(*ret));
+
+    if (ret == NULL) {
+        PROVerr(0, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    *ret = *in;
+    /* This also gives the copy its own L table */
+    if (!CRYPTO_ocb128_copy_ctx(&ret->ocb, &in->ocb, &ret->ksenc.ks,
+                                &ret->ksdec.ks)) {
+        OPENSSL_clear_free(ret, sizeof(*ret));
+        return NULL;
+    }
+    return ret;
+}
+
+# define IMPLEMENT_cipher(kbits)                                               \
+    static OSSL_OP_cipher_get_params_fn aes_##kbits##_ocb_get_params;          \
+    static int aes_##kbits##_ocb_get_params(OSSL_PARAM params[])               \
+    {                                                                          \
+        return aes_get_params(params, EVP_CIPH_OCB_MODE, AEAD_OCB_FLAGS,       \
+                              kbits, 128, OCB_DEFAULT_IV_LEN * 8);             \
+    }                                                                          \
+    static OSSL_OP_cipher_newctx_fn aes##kbits##ocb_newctx;                    \
+    static void *aes##kbits##ocb_newctx(void *provctx)                         \
+    {                                                                          \
+        return aes_ocb_newctx(provctx, kbits);                                 \
+    }                                                                          \
+    const OSSL_DISPATCH aes##kbits##ocb_functions[] = {                        \
+        { OSSL_FUNC_CIPHER_ENCRYPT_INIT, (void (*)(void))ocb_einit },          \
+        { OSSL_FUNC_CIPHER_DECRYPT_INIT, (void (*)(void))ocb_dinit },          \
+        { OSSL_FUNC_CIPHER_UPDATE, (void (*)(void))ocb_stream_update },        \
+        { OSSL_FUNC_CIPHER_FINAL, (void (*)(void))ocb_stream_final },          \
+        { OSSL_FUNC_CIPHER_CIPHER, (void (*)(void))ocb_cipher },               \
+        { OSSL_FUNC_CIPHER_NEWCTX, (void (*)(void))aes##kbits##ocb_newctx },   \
+        { OSSL_FUNC_CIPHER_FREECTX, (void (*)(void))aes_ocb_freectx },         \
+        { OSSL_FUNC_CIPHER_DUPCTX, (void (*)(void))aes_ocb_dupctx },           \
+        { OSSL_FUNC_CIPHER_GET_PARAMS,                                         \
+            (void (*)(void))aes_##kbits##_ocb_get_params },                    \
+        { OSSL_FUNC_CIPHER_GET_CTX_PARAMS,                                     \
+            (void (*)(void))ocb_get_ctx_params },                              \
+        { OSSL_FUNC_CIPHER_SET_CTX_PARAMS,                                     \
+            (void (*)(void))ocb_set_ctx_params },                              \
+        { OSSL_FUNC_CIPHER_AEAD_SEAL, (void (*)(void))ocb_aead_seal },         \
+        { OSSL_FUNC_CIPHER_AEAD_OPEN, (void (*)(void))ocb_aead_open },         \
+        { 0, NULL }                                                            \
+    }
+
+/* aes256ocb_functions */
+IMPLEMENT_cipher(256);
+/* aes192ocb_functions */
+IMPLEMENT_cipher(192);
+/* aes128ocb_functions */
+IMPLEMENT_cipher(128);
+
+#endif /* OPENSSL_NO_OCB */
@@ -0,0 +1,668 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* ChaCha20-Poly1305 AEAD (RFC 8439), including the TLS nonce of RFC 7905 */
+
+#include <openssl/opensslconf.h>
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+
+# include <string.h>
+# include <openssl/core_numbers.h>
+# include <openssl/core_names.h>
+# include <openssl/params.h>
+# include <openssl/evp.h>
+# include "internal/cryptlib.h"
+# include "internal/chacha.h"
+# include "internal/poly1305.h"
+/* See the comment in providers/default/macs/poly1305_prov.c */
+# include "../../../crypto/poly1305/poly1305_local.h"
+# include "internal/providercommonerr.h"
+# include "internal/provider_algs.h"
+# include "ciphers_locl.h"
+
+# define CHACHA20_POLY1305_KEYLEN        CHACHA_KEY_SIZE
+# define CHACHA20_POLY1305_MAX_IVLEN     12
+# define CHACHA20_POLY1305_MODE          0
+/*
+ * The flags of EVP_chacha20_poly1305(), less EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
+ * which this implementation doesn't support
+ */
+# define CHACHA20_POLY1305_FLAGS (EVP_CIPH_FLAG_AEAD_CIPHER                    \
+                                  | EVP_CIPH_CUSTOM_IV                         \
+                                  | EVP_CIPH_ALWAYS_CALL_INIT                  \
+                                  | EVP_CIPH_CTRL_INIT                         \
+                                  | EVP_CIPH_CUSTOM_COPY                       \
+                                  | EVP_CIPH_CUSTOM_IV_LENGTH                  \
+                                  | EVP_CIPH_FLAG_CUSTOM_CIPHER)
+# define NO_TLS_PAYLOAD_LENGTH ((size_t)-1)
+
+static OSSL_OP_cipher_newctx_fn chacha20_poly1305_newctx;
+static OSSL_OP_cipher_freectx_fn chacha20_poly1305_freectx;
+static OSSL_OP_cipher_dupctx_fn chacha20_poly1305_dupctx;
+static OSSL_OP_cipher_encrypt_init_fn chacha20_poly1305_einit;
+static OSSL_OP_cipher_decrypt_init_fn chacha20_poly1305_dinit;
+static OSSL_OP_cipher_get_params_fn chacha20_poly1305_get_params;
+static OSSL_OP_cipher_get_ctx_params_fn chacha20_poly1305_get_ctx_params;
+static OSSL_OP_cipher_set_ctx_params_fn chacha20_poly1305_set_ctx_params;
+static OSSL_OP_cipher_cipher_fn chacha20_poly1305_cipher;
+static OSSL_OP_cipher_update_fn chacha20_poly1305_update;
+static OSSL_OP_cipher_final_fn chacha20_poly1305_final;
+static OSSL_OP_cipher_aead_seal_fn chacha20_poly1305_aead_seal;
+static OSSL_OP_cipher_aead_open_fn chacha20_poly1305_aead_open;
+
+typedef struct {
+    union {
+        OSSL_UNION_ALIGN;
+        unsigned int d[CHACHA_KEY_SIZE / 4];
+    } key;
+    unsigned int counter[CHACHA_CTR_SIZE / 4];
+    unsigned int nonce[CHACHA20_POLY1305_MAX_IVLEN / 4];
+    unsigned char buf[CHACHA_BLK_SIZE];
+    unsigned int partial_len;
+    POLY1305 poly1305;
+    unsigned char tag[POLY1305_BLOCK_SIZE];
+    unsigned char tls_aad[POLY1305_BLOCK_SIZE];
+    struct { uint64_t aad, text; } len;
+    int enc, key_set, aad, mac_inited;
+    size_t tag_len, nonce_len;
+    size_t tls_payload_length;
+} PROV_CHACHA20_POLY1305_CTX;
+
+static void *chacha20_poly1305_newctx(void *provctx)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = OPENSSL_zalloc(sizeof(*ctx));
+
+    if (ctx != NULL) {
+        ctx->nonce_len = CHACHA20_POLY1305_MAX_IVLEN;
+        ctx->tls_payload_length = NO_TLS_PAYLOAD_LENGTH;
+    }
+    return ctx;
+}
+
+static void chacha20_poly1305_freectx(void *vctx)
+{
+    OPENSSL_clear_free(vctx, sizeof(PROV_CHACHA20_POLY1305_CTX));
+}
+
+static void *chacha20_poly1305_dupctx(void *vctx)
+{
+    PROV_CHACHA20_POLY1305_CTX *ret;
+
+    ret = OPENSSL_memdup(vctx, sizeof(PROV_CHACHA20_POLY1305_CTX));
+    if (ret == NULL)
+        PROVerr(0, ERR_R_MALLOC_FAILURE);
+    return ret;
+}
+
+static int chacha20_poly1305_get_params(OSSL_PARAM params[])
+{
+    return aes_get_params(params, CHACHA20_POLY1305_MODE,
+                          CHACHA20_POLY1305_FLAGS,
+                          CHACHA20_POLY1305_KEYLEN * 8, 8,
+                          CHACHA20_POLY1305_MAX_IVLEN * 8);
+}
+
+static void chacha20_poly1305_set_key(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                      const unsigned char *key)
+{
+    size_t i;
+
+    for (i = 0; i < CHACHA_KEY_SIZE; i += 4)
+        ctx->key.d[i / 4] = CHACHA_U8TOU32(key + i);
+    ctx->key_set = 1;
+}
+
+/* The nonce is padded on the left, as for the legacy implementation */
+static void chacha20_poly1305_set_nonce(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                        const unsigned char *iv, size_t ivlen)
+{
+    unsigned char temp[CHACHA20_POLY1305_MAX_IVLEN] = { 0 };
+
+    memcpy(temp + sizeof(temp) - ivlen, iv, ivlen);
+    ctx->nonce[0] = ctx->counter[1] = CHACHA_U8TOU32(temp);
+    ctx->nonce[1] = ctx->counter[2] = CHACHA_U8TOU32(temp + 4);
+    ctx->nonce[2] = ctx->counter[3] = CHACHA_U8TOU32(temp + 8);
+}
+
+static int chacha20_poly1305_init(void *vctx, const unsigned char *key,
+                                  size_t keylen, const unsigned char *iv,
+                                  size_t ivlen, int enc)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)vctx;
+
+    ctx->enc = enc;
+    if (key == NULL && iv == NULL)
+        return 1;
+
+    ctx->len.aad = 0;
+    ctx->len.text = 0;
+    ctx->aad = 0;
+    ctx->mac_inited = 0;
+    ctx->tls_payload_length = NO_TLS_PAYLOAD_LENGTH;
+
+    if (key != NULL) {
+        if (keylen != CHACHA20_POLY1305_KEYLEN) {
+            PROVerr(0, PROV_R_INVALID_KEY_LENGTH);
+            return 0;
+        }
+        chacha20_poly1305_set_key(ctx, key);
+    }
+    if (iv != NULL) {
+        if (ivlen != ctx->nonce_len) {
+            PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+            return 0;
+        }
+        chacha20_poly1305_set_nonce(ctx, iv, ivlen);
+    }
+    return 1;
+}
+
+static int chacha20_poly1305_einit(void *vctx, const unsigned char *key,
+                                   size_t keylen, const unsigned char *iv,
+                                   size_t ivlen)
+{
+    return chacha20_poly1305_init(vctx, key, keylen, iv, ivlen, 1);
+}
+
+static int chacha20_poly1305_dinit(void *vctx, const unsigned char *key,
+                                   size_t keylen, const unsigned char *iv,
+                                   size_t ivlen)
+{
+    return chacha20_poly1305_init(vctx, key, keylen, iv, ivlen, 0);
+}
+
+/* Encrypt or decrypt |len| bytes, keeping any unused key stream for later */
+static void chacha20_poly1305_xor(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                  unsigned char *out, const unsigned char *in,
+                                  size_t len)
+{
+    unsigned int n, rem, ctr32;
+
+    if ((n = ctx->partial_len) != 0) {
+        while (len > 0 && n < CHACHA_BLK_SIZE) {
+            *out++ = *in++ ^ ctx->buf[n++];
+            len--;
+        }
+        ctx->partial_len = n;
+
+        if (len == 0)
+            return;
+
+        if (n == CHACHA_BLK_SIZE) {
+            ctx->partial_len = 0;
+            ctx->counter[0]++;
+            if (ctx->counter[0] == 0)
+                ctx->counter[1]++;
+        }
+    }
+
+    rem = (unsigned int)(len % CHACHA_BLK_SIZE);
+    len -= rem;
+    ctr32 = ctx->counter[0];
+    while (len >= CHACHA_BLK_SIZE) {
+        size_t blocks = len / CHACHA_BLK_SIZE;
+
+        /* See chacha_cipher() in crypto/evp/e_chacha20_poly1305.c */
+        if (sizeof(size_t) > sizeof(unsigned int) && blocks > (1U << 28))
+            blocks = (1U << 28);
+        ctr32 += (unsigned int)blocks;
+        if (ctr32 < blocks) {
+            blocks -= ctr32;
+            ctr32 = 0;
+        }
+        blocks *= CHACHA_BLK_SIZE;
+        ChaCha20_ctr32(out, in, blocks, ctx->key.d, ctx->counter);
+        len -= blocks;
+        in += blocks;
+        out += blocks;
+
+        ctx->counter[0] = ctr32;
+        if (ctr32 == 0)
+            ctx->counter[1]++;
+    }
+
+    if (rem > 0) {
+        memset(ctx->buf, 0, sizeof(ctx->buf));
+        ChaCha20_ctr32(ctx->buf, ctx->buf, CHACHA_BLK_SIZE,
+                       ctx->key.d, ctx->counter);
+        for (n = 0; n < rem; n++)
+            out[n] = in[n] ^ ctx->buf[n];
+        ctx->partial_len = rem;
+    }
+}
+
+static void chacha20_poly1305_pad16(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                    uint64_t len)
+{
+    static const unsigned char zero[POLY1305_BLOCK_SIZE] = { 0 };
+    size_t rem = (size_t)len % POLY1305_BLOCK_SIZE;
+
+    if (rem != 0)
+        Poly1305_Update(&ctx->poly1305, zero, POLY1305_BLOCK_SIZE - rem);
+}
+
+/* Derive the one-time Poly1305 key from block 0 of the key stream */
+static void chacha20_poly1305_mac_init(PROV_CHACHA20_POLY1305_CTX *ctx)
+{
+    ctx->counter[0] = 0;
+    memset(ctx->buf, 0, sizeof(ctx->buf));
+    ChaCha20_ctr32(ctx->buf, ctx->buf, CHACHA_BLK_SIZE,
+                   ctx->key.d, ctx->counter);
+    Poly1305_Init(&ctx->poly1305, ctx->buf);
+    OPENSSL_cleanse(ctx->buf, sizeof(ctx->buf));
+    ctx->counter[0] = 1;
+    ctx->partial_len = 0;
+    ctx->len.aad = ctx->len.text = 0;
+    ctx->aad = 0;
+    ctx->mac_inited = 1;
+    if (ctx->tls_payload_length != NO_TLS_PAYLOAD_LENGTH) {
+        Poly1305_Update(&ctx->poly1305, ctx->tls_aad, EVP_AEAD_TLS1_AAD_LEN);
+        ctx->len.aad = EVP_AEAD_TLS1_AAD_LEN;
+        ctx->aad = 1;
+    }
+}
+
+static void chacha20_poly1305_mac_final(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                        unsigned char tag[POLY1305_BLOCK_SIZE])
+{
+    unsigned char temp[POLY1305_BLOCK_SIZE];
+
+    if (ctx->aad) {
+        chacha20_poly1305_pad16(ctx, ctx->len.aad);
+        ctx->aad = 0;
+    }
+    chacha20_poly1305_pad16(ctx, ctx->len.text);
+
+    /* Lengths are encoded little-endian */
+    temp[0]  = (unsigned char)(ctx->len.aad);
+    temp[1]  = (unsigned char)(ctx->len.aad >> 8);
+    temp[2]  = (unsigned char)(ctx->len.aad >> 16);
+    temp[3]  = (unsigned char)(ctx->len.aad >> 24);
+    temp[4]  = (unsigned char)(ctx->len.aad >> 32);
+    temp[5]  = (unsigned char)(ctx->len.aad >> 40);
+    temp[6]  = (unsigned char)(ctx->len.aad >> 48);
+    temp[7]  = (unsigned char)(ctx->len.aad >> 56);
+    temp[8]  = (unsigned char)(ctx->len.text);
+    temp[9]  = (unsigned char)(ctx->len.text >> 8);
+    temp[10] = (unsigned char)(ctx->len.text >> 16);
+    temp[11] = (unsigned char)(ctx->len.text >> 24);
+    temp[12] = (unsigned char)(ctx->len.text >> 32);
+    temp[13] = (unsigned char)(ctx->len.text >> 40);
+    temp[14] = (unsigned char)(ctx->len.text >> 48);
+    temp[15] = (unsigned char)(ctx->len.text >> 56);
+    Poly1305_Update(&ctx->poly1305, temp, POLY1305_BLOCK_SIZE);
+    Poly1305_Final(&ctx->poly1305, tag);
+    ctx->mac_inited = 0;
+}
+
+static void chacha20_poly1305_aad(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                  const unsigned char *aad, size_t len)
+{
+    Poly1305_Update(&ctx->poly1305, aad, len);
+    ctx->len.aad += len;
+    ctx->aad = 1;
+}
+
+static void chacha20_poly1305_text(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                   unsigned char *out, const unsigned char *in,
+                                   size_t len)
+{
+    if (ctx->aad) {
+        chacha20_poly1305_pad16(ctx, ctx->len.aad);
+        ctx->aad = 0;
+    }
+    if (ctx->enc) {
+        chacha20_poly1305_xor(ctx, out, in, len);
+        Poly1305_Update(&ctx->poly1305, out, len);
+    } else {
+        Poly1305_Update(&ctx->poly1305, in, len);
+        chacha20_poly1305_xor(ctx, out, in, len);
+    }
+    ctx->len.text += len;
+}
+
+/*
+ * A TLS record is processed in place: the payload is followed by room for
+ * (or the value of) the tag.
+ */
+static int chacha20_poly1305_tls_cipher(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                        unsigned char *out, size_t *outl,
+                                        const unsigned char *in, size_t len)
+{
+    size_t plen = ctx->tls_payload_length;
+    unsigned char tag[POLY1305_BLOCK_SIZE];
+
+    if (len != plen + POLY1305_BLOCK_SIZE)
+        return 0;
+
+    chacha20_poly1305_mac_init(ctx);
+    chacha20_poly1305_text(ctx, out, in, plen);
+    chacha20_poly1305_mac_final(ctx, tag);
+    ctx->tls_payload_length = NO_TLS_PAYLOAD_LENGTH;
+
+    if (ctx->enc) {
+        memcpy(out + plen, tag, POLY1305_BLOCK_SIZE);
+        *outl = len;
+        return 1;
+    }
+    if (CRYPTO_memcmp(tag, in + plen, POLY1305_BLOCK_SIZE) != 0) {
+        OPENSSL_cleanse(out, plen);
+        return 0;
+    }
+    *outl = plen;
+    return 1;
+}
+
+static int chacha20_poly1305_cipher_internal(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                             unsigned char *out, size_t *outl,
+                                             const unsigned char *in,
+                                             size_t len)
+{
+    if (!ctx->key_set) {
+        PROVerr(0, PROV_R_NO_KEY_SET);
+        return 0;
+    }
+
+    if (in != NULL && ctx->tls_payload_length != NO_TLS_PAYLOAD_LENGTH)
+        return chacha20_poly1305_tls_cipher(ctx, out, outl, in, len);
+
+    if (!ctx->mac_inited)
+        chacha20_poly1305_mac_init(ctx);
+
+    *outl = 0;
+    if (in != NULL) {
+        /* The input is AAD if out is NULL */
+        if (out == NULL)
+            chacha20_poly1305_aad(ctx, in, len);
+        else
+            chacha20_poly1305_text(ctx, out, in, len);
+        *outl = len;
+        return 1;
+    }
+
+    /* Finished when in == NULL */
+    if (ctx->enc) {
+        chacha20_poly1305_mac_final(ctx, ctx->tag);
+        ctx->tag_len = POLY1305_BLOCK_SIZE;
+    } else {
+        unsigned char tag[POLY1305_BLOCK_SIZE];
+
+        chacha20_poly1305_mac_final(ctx, tag);
+        if (ctx->tag_len == 0
+                || CRYPTO_memcmp(tag, ctx->tag, ctx->tag_len) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+static int chacha20_poly1305_update(void *vctx, unsigned char *out,
+                                    size_t *outl, size_t outsize,
+                                    const unsigned char *in, size_t inl)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)vctx;
+
+    if (out != NULL && outsize < inl) {
+        PROVerr(0, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return 0;
+    }
+    if (in == NULL) {
+        *outl = 0;
+        return 1;
+    }
+    if (!chacha20_poly1305_cipher_internal(ctx, out, outl, in, inl)) {
+        PROVerr(0, PROV_R_CIPHER_OPERATION_FAILED);
+        return 0;
+    }
+    return 1;
+}
+
+static int chacha20_poly1305_final(void *vctx, unsigned char *out,
+                                   size_t *outl, size_t outsize)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)vctx;
+
+    return chacha20_poly1305_cipher_internal(ctx, out, outl, NULL, 0);
+}
+
+static int chacha20_poly1305_cipher(void *vctx, unsigned char *out,
+                                    size_t *outl, size_t outsize,
+                                    const unsigned char *in, size_t inl)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)vctx;
+
+    if (outsize < inl) {
+        PROVerr(0, PROV_R_OUTPUT_BUFFER_TOO_SMALL);
+        return 0;
+    }
+    return chacha20_poly1305_cipher_internal(ctx, out, outl, in, inl);
+}
+
+static int chacha20_poly1305_get_ctx_params(void *vctx, OSSL_PARAM params[])
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)vctx;
+    OSSL_PARAM *p;
+
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_IVLEN);
+    if (p != NULL && !OSSL_PARAM_set_int(p, (int)ctx->nonce_len)) {
+        PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL && !OSSL_PARAM_set_int(p, CHACHA20_POLY1305_KEYLEN)) {
+        PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TLS1_AAD_PAD);
+    if (p != NULL && !OSSL_PARAM_set_size_t(p, POLY1305_BLOCK_SIZE)) {
+        PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+        return 0;
+    }
+    p = OSSL_PARAM_locate(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        if (p->data_type != OSSL_PARAM_OCTET_STRING) {
+            PROVerr(0, PROV_R_FAILED_TO_SET_PARAMETER);
+            return 0;
+        }
+        if (!ctx->enc || p->data_size == 0
+                || p->data_size > POLY1305_BLOCK_SIZE) {
+            PROVerr(0, PROV_R_INVALID_TAG);
+            return 0;
+        }
+        memcpy(p->data, ctx->tag, p->data_size);
+        p->return_size = p->data_size;
+    }
+    return 1;
+}
+
+static int chacha20_poly1305_set_ctx_params(void *vctx,
+                                            const OSSL_PARAM params[])
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)vctx;
+    const OSSL_PARAM *p;
+    size_t len;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_KEYLEN);
+    if (p != NULL) {
+        int keylen;
+
+        if (!OSSL_PARAM_get_int(p, &keylen)) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        if (keylen != CHACHA20_POLY1305_KEYLEN) {
+            PROVerr(0, PROV_R_INVALID_KEY_LENGTH);
+            return 0;
+        }
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_IVLEN);
+    if (p != NULL) {
+        if (!OSSL_PARAM_get_size_t(p, &len)) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        if (len == 0 || len > CHACHA20_POLY1305_MAX_IVLEN) {
+            PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+            return 0;
+        }
+        ctx->nonce_len = len;
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TAG);
+    if (p != NULL) {
+        if (p->data_type != OSSL_PARAM_OCTET_STRING) {
+            PROVerr(0, PROV_R_FAILED_TO_GET_PARAMETER);
+            return 0;
+        }
+        if (p->data_size == 0 || p->data_size > POLY1305_BLOCK_SIZE) {
+            PROVerr(0, PROV_R_INVALID_TAG);
+            return 0;
+        }
+        if (p->data != NULL) {
+            if (ctx->enc) {
+                PROVerr(0, PROV_R_INVALID_TAG);
+                return 0;
+            }
+            memcpy(ctx->tag, p->data, p->data_size);
+            ctx->tag_len = p->data_size;
+        }
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TLS1_AAD);
+    if (p != NULL) {
+        unsigned char *aad = p->data;
+
+        if (p->data_type != OSSL_PARAM_OCTET_STRING
+                || p->data_size != EVP_AEAD_TLS1_AAD_LEN) {
+            PROVerr(0, PROV_R_INVALID_AAD);
+            return 0;
+        }
+        memcpy(ctx->tls_aad, aad, EVP_AEAD_TLS1_AAD_LEN);
+        len = aad[EVP_AEAD_TLS1_AAD_LEN - 2] << 8
+              | aad[EVP_AEAD_TLS1_AAD_LEN - 1];
+        if (!ctx->enc) {
+            if (len < POLY1305_BLOCK_SIZE) {
+                PROVerr(0, PROV_R_INVALID_AAD);
+                return 0;
+            }
+            len -= POLY1305_BLOCK_SIZE;     /* discount attached tag */
+            ctx->tls_aad[EVP_AEAD_TLS1_AAD_LEN - 2] = (unsigned char)(len >> 8);
+            ctx->tls_aad[EVP_AEAD_TLS1_AAD_LEN - 1] = (unsigned char)len;
+        }
+        ctx->tls_payload_length = len;
+
+        /* merge record sequence number as per RFC7905 */
+        ctx->counter[1] = ctx->nonce[0];
+        ctx->counter[2] = ctx->nonce[1] ^ CHACHA_U8TOU32(ctx->tls_aad);
+        ctx->counter[3] = ctx->nonce[2] ^ CHACHA_U8TOU32(ctx->tls_aad + 4);
+        ctx->mac_inited = 0;
+    }
+    p = OSSL_PARAM_locate_const(params, OSSL_CIPHER_PARAM_AEAD_TLS1_IV_FIXED);
+    if (p != NULL) {
+        if (p->data_type != OSSL_PARAM_OCTET_STRING
+                || p->data_size != CHACHA20_POLY1305_MAX_IVLEN) {
+            PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+            return 0;
+        }
+        chacha20_poly1305_set_nonce(ctx, p->data, p->data_size);
+    }
+    return 1;
+}
+
+static int chacha20_poly1305_aead_init(PROV_CHACHA20_POLY1305_CTX *ctx,
+                                       int enc, const unsigned char *key,
+                                       size_t keylen, const unsigned char *iv,
+                                       size_t ivlen, size_t taglen)
+{
+    ctx->enc = enc;
+    ctx->tls_payload_length = NO_TLS_PAYLOAD_LENGTH;
+
+    if (taglen == 0 || taglen > POLY1305_BLOCK_SIZE) {
+        PROVerr(0, PROV_R_INVALID_TAG);
+        return 0;
+    }
+    if (ivlen == 0 || ivlen > CHACHA20_POLY1305_MAX_IVLEN) {
+        PROVerr(0, PROV_R_INVALID_IV_LENGTH);
+        return 0;
+    }
+    if (key != NULL) {
+        if (keylen != CHACHA20_POLY1305_KEYLEN) {
+            PROVerr(0, PROV_R_INVALID_KEY_LENGTH);
+            return 0;
+        }
+        chacha20_poly1305_set_key(ctx, key);
+    }
+    if (!ctx->key_set) {
+        PROVerr(0, PROV_R_NO_KEY_SET);
+        return 0;
+    }
+    chacha20_poly1305_set_nonce(ctx, iv, ivlen);
+    chacha20_poly1305_mac_init(ctx);
+    return 1;
+}
+
+static int chacha20_poly1305_aead_seal(void *vctx, const unsigned char *key,
+                                       size_t keylen, const unsigned char *iv,
+                                       size_t ivlen, const unsigned char *aad,
+                                       size_t aadlen, unsigned char *out,
+                                       const unsigned char *in, size_t inl,
+                                       unsigned char *tag, size_t taglen)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)vctx;
+
+    if (!chacha20_poly1305_aead_init(ctx, 1, key, keylen, iv, ivlen, taglen))
+        return 0;
+    chacha20_poly1305_aad(ctx, aad, aadlen);
+    chacha20_poly1305_text(ctx, out, in, inl);
+    chacha20_poly1305_mac_final(ctx, ctx->tag);
+    ctx->tag_len = POLY1305_BLOCK_SIZE;
+    memcpy(tag, ctx->tag, taglen);
+    return 1;
+}
+
+static int chacha20_poly1305_aead_open(void *vctx, const unsigned char *key,
+                                       size_t keylen, const unsigned char *iv,
+                                       size_t ivlen, const unsigned char *aad,
+                                       size_t aadlen, unsigned char *out,
+                                       const unsigned char *in, size_t inl,
+                                       const unsigned char *tag, size_t taglen)
+{
+    PROV_CHACHA20_POLY1305_CTX *ctx = (PROV_CHACHA20_POLY1305_CTX *)vctx;
+    unsigned char buf[POLY1305_BLOCK_SIZE];
+
+    if (!chacha20_poly1305_aead_init(ctx, 0, key, keylen, iv, ivlen, taglen))
+        return 0;
+    chacha20_poly1305_aad(ctx, aad, aadlen);
+    chacha20_poly1305_text(ctx, out, in, inl);
+    chacha20_poly1305_mac_final(ctx, buf);
+    if (CRYPTO_memcmp(buf, tag, taglen) != 0) {
+        OPENSSL_cleanse(out, inl);
+        return 0;
+    }
+    return 1;
+}
+
+const OSSL_DISPATCH chacha20_poly1305_functions[] = {
+    { OSSL_FUNC_CIPHER_NEWCTX, (void (*)(void))chacha20_poly1305_newctx },
+    { OSSL_FUNC_CIPHER_FREECTX, (void (*)(void))chacha20_poly1305_freectx },
+    { OSSL_FUNC_CIPHER_DUPCTX, (void (*)(void))chacha20_poly1305_dupctx },
+    { OSSL_FUNC_CIPHER_ENCRYPT_INIT, (void (*)(void))chacha20_poly1305_einit },
+    { OSSL_FUNC_CIPHER_DECRYPT_INIT, (void (*)(void))chacha20_poly1305_dinit },
+    { OSSL_FUNC_CIPHER_UPDATE, (void (*)(void))chacha20_poly1305_update },
+    { OSSL_FUNC_CIPHER_FINAL, (void (*)(void))chacha20_poly1305_final },
+    { OSSL_FUNC_CIPHER_CIPHER, (void (*)(void))chacha20_poly1305_cipher },
+    { OSSL_FUNC_CIPHER_GET_PARAMS,
+        (void (*)(void))chacha20_poly1305_get_params },
+    { OSSL_FUNC_CIPHER_GET_CTX_PARAMS,
+        (void (*)(void))chacha20_poly1305_get_ctx_params },
+    { OSSL_FUNC_CIPHER_SET_CTX_PARAMS,
+        (void (*)(void))chacha20_poly1305_set_ctx_params },
+    { OSSL_FUNC_CIPHER_AEAD_SEAL, (void (*)(void))chacha20_poly1305_aead_seal },
+    { OSSL_FUNC_CIPHER_AEAD_OPEN, (void (*)(void))chacha20_poly1305_aead_open },
+    { 0, NULL }
+};
+
+#endif /* !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305) */
@@ -119,11 +119,24 @@ static const OSSL_ALGORITHM deflt_ciphers[] = {
     { "id-aes256-GCM", "default=yes", aes256gcm_functions },
     { "id-aes192-GCM", "default=yes", aes192gcm_functions },
     { "id-aes128-GCM", "default=yes", aes128gcm_functions },
+    { "id-aes256-CCM", "default=yes", aes256ccm_functions },
+    { "id-aes192-CCM", "default=yes", aes192ccm_functions },
+    { "id-aes128-CCM", "default=yes", aes128ccm_functions },
+#ifndef OPENSSL_NO_OCB
+    { "AES-256-OCB", "default=yes", aes256ocb_functions },
+    { "AES-192-OCB", "default=yes", aes192ocb_functions },
+    { "AES-128-OCB", "default=yes", aes128ocb_functions },
+#endif /* OPENSSL_NO_OCB */
+    { "AES-256-GCM-SIV", "default=yes", aes256gcm_siv_functions },
+    { "AES-128-GCM-SIV", "default=yes", aes128gcm_siv_functions },
 #ifndef OPENSSL_NO_ARIA
     { "ARIA-256-GCM", "default=yes", aria256gcm_functions },
     { "ARIA-192-GCM", "default=yes", aria192gcm_functions },
     { "ARIA-128-GCM", "default=yes", aria128gcm_functions },
 #endif /* OPENSSL_NO_ARIA */
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+    { "ChaCha20-Poly1305", "default=yes", chacha20_poly1305_functions },
+#endif
     { NULL, NULL, NULL }
 };
 
@@ -202,10 +202,11 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
         /* start with empty packet ... */
         if (left == 0)
             rb->offset = align;
-        else if (align != 0 && left >= SSL3_RT_HEADER_LENGTH) {
+        else if (align != 0 && left >= SSL3_RT_HEADER_LENGTH && clearold) {
             /*
              * check if next packet length is large enough to justify payload
-             * alignment...
+             * alignment... but only if we're allowed to move earlier packets
+             * out of the way, i.e. they're not still waiting in a pipeline.
              */
             pkt = rb->buf + rb->offset;
             if (pkt[0] == SSL3_RT_APPLICATION_DATA
@@ -929,7 +930,9 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
             }
         }
 
+        /* With ktls the kernel adds the TLSv1.3 inner content type */
         if (SSL_TREAT_AS_TLS13(s)
+                && !BIO_get_ktls_send(s->wbio)
                 && s->enc_write_ctx != NULL
                 && (s->statem.enc_write_state != ENC_WRITE_STATE_WRITE_PLAIN_ALERTS
                     || type != SSL3_RT_ALERT)) {
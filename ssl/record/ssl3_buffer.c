@@ -34,6 +34,184 @@ void SSL3_BUFFER_release(SSL3_BUFFER *b)
     b->buf = NULL;
 }
 
+/*
+ * Returns the size class for a buffer of |len| bytes, or 0 if buffers of that
+ * length are not pooled. Class |c| holds buffers of c * SSL_BUF_POOL_GRANULE
+ * bytes.
+ */
+static size_t buf_pool_class(size_t len)
+{
+    size_t c = (len + SSL_BUF_POOL_GRANULE - 1) / SSL_BUF_POOL_GRANULE;
+
+    return c <= SSL_BUF_POOL_CLASSES ? c : 0;
+}
+
+/* Pick the shard of |pool| used by the calling thread */
+static SSL_BUF_POOL_SHARD *buf_pool_shard(SSL_BUF_POOL *pool)
+{
+    CRYPTO_THREAD_ID tid = CRYPTO_THREAD_get_current_id();
+    const unsigned char *p = (const unsigned char *)&tid;
+    size_t i, h = 0;
+
+    for (i = 0; i < sizeof(tid); i++)
+        h = h * 31 + p[i];
+    return &pool->shards[h % SSL_BUF_POOL_SHARDS];
+}
+
+SSL_BUF_POOL *ssl_buffer_pool_new(size_t max_free)
+{
+    SSL_BUF_POOL *pool = OPENSSL_zalloc(sizeof(*pool));
+    size_t i;
+
+    if (pool == NULL)
+        return NULL;
+
+    for (i = 0; i < SSL_BUF_POOL_SHARDS; i++) {
+        if ((pool->shards[i].lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            ssl_buffer_pool_free(pool);
+            return NULL;
+        }
+    }
+    ssl_buffer_pool_set_max(pool, max_free);
+    return pool;
+}
+
+void ssl_buffer_pool_free(SSL_BUF_POOL *pool)
+{
+    size_t i;
+
+    if (pool == NULL)
+        return;
+
+    ssl_buffer_pool_set_max(pool, 0);
+    for (i = 0; i < SSL_BUF_POOL_SHARDS; i++)
+        CRYPTO_THREAD_lock_free(pool->shards[i].lock);
+    OPENSSL_free(pool);
+}
+
+/*
+ * Set the number of free buffers |pool| keeps per size class, which is shared
+ * out between the shards. Any buffers above the new limit are freed.
+ */
+void ssl_buffer_pool_set_max(SSL_BUF_POOL *pool, size_t max_free)
+{
+    SSL_BUF_POOL_SHARD *shard;
+    void *p;
+    size_t i, c;
+
+    pool->max_free = max_free;
+    for (i = 0; i < SSL_BUF_POOL_SHARDS; i++) {
+        shard = &pool->shards[i];
+        if (shard->lock == NULL)
+            continue;
+        CRYPTO_THREAD_write_lock(shard->lock);
+        shard->max_free = (max_free + SSL_BUF_POOL_SHARDS - 1)
+                          / SSL_BUF_POOL_SHARDS;
+        for (c = 0; c < SSL_BUF_POOL_CLASSES; c++) {
+            while (shard->num_free[c] > shard->max_free) {
+                p = shard->free_list[c];
+                shard->free_list[c] = *(void **)p;
+                shard->num_free[c]--;
+                OPENSSL_free(p);
+            }
+        }
+        CRYPTO_THREAD_unlock(shard->lock);
+    }
+}
+
+size_t ssl_buffer_pool_stat(SSL_BUF_POOL *pool, int cmd)
+{
+    SSL_BUF_POOL_SHARD *shard;
+    size_t i, c, ret = 0;
+
+    if (pool == NULL)
+        return 0;
+
+    for (i = 0; i < SSL_BUF_POOL_SHARDS; i++) {
+        shard = &pool->shards[i];
+        CRYPTO_THREAD_read_lock(shard->lock);
+        switch (cmd) {
+        case SSL_CTRL_BUFFER_POOL_CACHED:
+            for (c = 0; c < SSL_BUF_POOL_CLASSES; c++)
+                ret += shard->num_free[c];
+            break;
+        case SSL_CTRL_BUFFER_POOL_HITS:
+            ret += shard->stats.hit;
+            break;
+        case SSL_CTRL_BUFFER_POOL_MISSES:
+            ret += shard->stats.miss;
+            break;
+        case SSL_CTRL_BUFFER_POOL_DROPS:
+            ret += shard->stats.drop;
+            break;
+        }
+        CRYPTO_THREAD_unlock(shard->lock);
+    }
+    return ret;
+}
+
+/*
+ * Allocate a record buffer of at least |len| bytes, from the SSL_CTX pool if
+ * it has one free. Poolable buffers are always allocated at the full size of
+ * their class so that any of them can later be recycled.
+ */
+static unsigned char *ssl3_buffer_alloc(SSL *s, size_t len)
+{
+    SSL_BUF_POOL *pool = s->ctx->buffer_pool;
+    SSL_BUF_POOL_SHARD *shard;
+    size_t c = buf_pool_class(len);
+    void *p = NULL;
+
+    if (c == 0)
+        return OPENSSL_malloc(len);
+
+    if (pool != NULL) {
+        shard = buf_pool_shard(pool);
+        CRYPTO_THREAD_write_lock(shard->lock);
+        if ((p = shard->free_list[c - 1]) != NULL) {
+            shard->free_list[c - 1] = *(void **)p;
+            shard->num_free[c - 1]--;
+            shard->stats.hit++;
+        } else {
+            shard->stats.miss++;
+        }
+        CRYPTO_THREAD_unlock(shard->lock);
+    }
+    if (p == NULL)
+        p = OPENSSL_malloc(c * SSL_BUF_POOL_GRANULE);
+    return p;
+}
+
+/*
+ * Give back a buffer from ssl3_buffer_alloc() that was asked for |len| bytes.
+ * Pooled buffers go to other connections next, so they are cleansed first.
+ */
+static void ssl3_buffer_free(SSL *s, unsigned char *buf, size_t len)
+{
+    SSL_BUF_POOL *pool = s->ctx->buffer_pool;
+    SSL_BUF_POOL_SHARD *shard;
+    size_t c = buf_pool_class(len);
+
+    if (buf == NULL)
+        return;
+
+    if (c != 0 && pool != NULL) {
+        OPENSSL_cleanse(buf, c * SSL_BUF_POOL_GRANULE);
+        shard = buf_pool_shard(pool);
+        CRYPTO_THREAD_write_lock(shard->lock);
+        if (shard->num_free[c - 1] < shard->max_free) {
+            *(void **)buf = shard->free_list[c - 1];
+            shard->free_list[c - 1] = buf;
+            shard->num_free[c - 1]++;
+            buf = NULL;
+        } else {
+            shard->stats.drop++;
+        }
+        CRYPTO_THREAD_unlock(shard->lock);
+    }
+    OPENSSL_free(buf);
+}
+
 int ssl3_setup_read_buffer(SSL *s)
 {
     unsigned char *p;
@@ -60,7 +238,7 @@ int ssl3_setup_read_buffer(SSL *s)
 #endif
         if (b->default_len > len)
             len = b->default_len;
-        if ((p = OPENSSL_malloc(len)) == NULL) {
+        if ((p = ssl3_buffer_alloc(s, len)) == NULL) {
             /*
              * We've got a malloc failure, and we're still initialising buffers.
              * We assume we're so doomed that we won't even be able to send an
@@ -112,13 +290,13 @@ int ssl3_setup_write_buffer(SSL *s, size_t numwpipes, size_t len)
         SSL3_BUFFER *thiswb = &wb[currpipe];
 
         if (thiswb->len != len) {
-            OPENSSL_free(thiswb->buf);
+            ssl3_buffer_free(s, thiswb->buf, thiswb->len);
             thiswb->buf = NULL;         /* force reallocation */
         }
 
         if (thiswb->buf == NULL) {
             if (s->wbio == NULL || !BIO_get_ktls_send(s->wbio)) {
-                p = OPENSSL_malloc(len);
+                p = ssl3_buffer_alloc(s, len);
                 if (p == NULL) {
                     s->rlayer.numwpipes = currpipe;
                     /*
@@ -165,7 +343,7 @@ int ssl3_release_write_buffer(SSL *s)
         wb = &RECORD_LAYER_get_wbuf(&s->rlayer)[pipes - 1];
 
         if (s->wbio == NULL || !BIO_get_ktls_send(s->wbio))
-            OPENSSL_free(wb->buf);
+            ssl3_buffer_free(s, wb->buf, wb->len);
         wb->buf = NULL;
         pipes--;
     }
@@ -178,7 +356,7 @@ int ssl3_release_read_buffer(SSL *s)
     SSL3_BUFFER *b;
 
     b = RECORD_LAYER_get_rbuf(&s->rlayer);
-    OPENSSL_free(b->buf);
+    ssl3_buffer_free(s, b->buf, b->len);
     b->buf = NULL;
     return 1;
 }
@@ -3831,6 +3831,8 @@ long ssl3_ctx_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
                        keys + sizeof(ctx->ext.tick_key_name) +
                        sizeof(ctx->ext.secure->tick_hmac_key),
                        sizeof(ctx->ext.secure->tick_aes_key));
+                if (!tls_ticket_cipher_setup(ctx))
+                    return 0;
             } else {
                 memcpy(keys, ctx->ext.tick_key_name,
                        sizeof(ctx->ext.tick_key_name));
@@ -775,6 +775,8 @@ SSL *SSL_new(SSL_CTX *ctx)
     s->ext.ocsp.resp_len = 0;
     SSL_CTX_up_ref(ctx);
     s->session_ctx = ctx;
+    if (!tsan_load(&ctx->session_shards_fixed))
+        tsan_store(&ctx->session_shards_fixed, 1);
 #ifndef OPENSSL_NO_EC
     if (ctx->ext.ecpointformats) {
         s->ext.ecpointformats =
@@ -929,6 +931,7 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
      * by this SSL.
      */
     SSL_SESSION r, *p;
+    SSL_SESS_SHARD *shard;
 
     if (id_len > sizeof(r.session_id))
         return 0;
@@ -937,6 +940,14 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
     r.session_id_length = id_len;
     memcpy(r.session_id, id, id_len);
 
+    shard = ssl_session_shard(ssl->session_ctx, id, id_len);
+    if (shard != NULL) {
+        CRYPTO_THREAD_read_lock(shard->lock);
+        p = lh_SSL_SESSION_retrieve(shard->sessions, &r);
+        CRYPTO_THREAD_unlock(shard->lock);
+        return (p != NULL);
+    }
+
     CRYPTO_THREAD_read_lock(ssl->session_ctx->lock);
     p = lh_SSL_SESSION_retrieve(ssl->session_ctx->sessions, &r);
     CRYPTO_THREAD_unlock(ssl->session_ctx->lock);
@@ -2019,6 +2030,66 @@ int ssl_write_internal(SSL *s, const void *buf, size_t num, size_t *written)
     }
 }
 
+/* Amount of file data read per SSL_write_ex() when kernel TLS isn't used */
+#define SSL_SENDFILE_BUFSIZE    (4 * SSL3_RT_MAX_PLAIN_LENGTH)
+
+/*
+ * SSL_sendfile() for connections without kernel TLS transmit offload: read
+ * the file in chunks and push them through the normal record layer. A retry
+ * re-reads the same bytes into a new buffer, which is why moving write
+ * buffers are accepted for the duration of each write.
+ */
+static ossl_ssize_t ssl_sendfile_buffered(SSL *s, int fd, off_t offset,
+                                          size_t size)
+{
+#if defined(OPENSSL_SYS_WINDOWS) || defined(OPENSSL_SYS_VMS)
+    SSLerr(SSL_F_SSL_SENDFILE, SSL_R_UNINITIALIZED);
+    return -1;
+#else
+    unsigned char *buf;
+    size_t bufsz = size < SSL_SENDFILE_BUFSIZE ? size : SSL_SENDFILE_BUFSIZE;
+    size_t total = 0, len, written;
+    uint32_t moving = s->mode & SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER;
+    ssize_t n;
+    int ret;
+
+    if (size == 0)
+        return 0;
+
+    if ((buf = OPENSSL_malloc(bufsz)) == NULL) {
+        SSLerr(SSL_F_SSL_SENDFILE, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+
+    while (total < size) {
+        len = size - total < bufsz ? size - total : bufsz;
+        do {
+            n = pread(fd, buf, len, offset + (off_t)total);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0) {
+            ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(),
+                           "calling pread()");
+            break;
+        }
+        if (n == 0)
+            break;
+
+        s->mode |= SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER;
+        ret = SSL_write_ex(s, buf, (size_t)n, &written);
+        s->mode = (s->mode & ~SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER) | moving;
+        if (ret <= 0)
+            break;
+        total += written;
+        /* A short read means we've hit the end of the file */
+        if ((size_t)n < len)
+            break;
+    }
+    OPENSSL_free(buf);
+
+    return total > 0 ? (ossl_ssize_t)total : -1;
+#endif
+}
+
 ossl_ssize_t SSL_sendfile(SSL *s, int fd, off_t offset, size_t size, int flags)
 {
     ossl_ssize_t ret;
@@ -2034,10 +2105,8 @@ ossl_ssize_t SSL_sendfile(SSL *s, int fd, off_t offset, size_t size, int flags)
         return -1;
     }
 
-    if (!BIO_get_ktls_send(s->wbio)) {
-        SSLerr(SSL_F_SSL_SENDFILE, SSL_R_UNINITIALIZED);
-        return -1;
-    }
+    if (!BIO_get_ktls_send(s->wbio))
+        return ssl_sendfile_buffered(s, fd, offset, size);
 
     /* If we have an alert to send, lets send it */
     if (s->s3.alert_dispatch) {
@@ -2410,9 +2479,36 @@ LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx)
     return ctx->sessions;
 }
 
+static long ssl_session_shard_stat(SSL_CTX *ctx, int cmd, long idx)
+{
+    SSL_SESS_SHARD *shard;
+    long ret;
+
+    if (ctx->session_shards == NULL || idx < 0
+            || (size_t)idx >= ctx->session_shard_count)
+        return 0;
+    shard = &ctx->session_shards[idx];
+
+    switch (cmd) {
+    case SSL_CTRL_SESS_SHARD_NUMBER:
+        CRYPTO_THREAD_read_lock(shard->lock);
+        ret = lh_SSL_SESSION_num_items(shard->sessions);
+        CRYPTO_THREAD_unlock(shard->lock);
+        return ret;
+    case SSL_CTRL_SESS_SHARD_HITS:
+        return tsan_load(&shard->stats.sess_hit);
+    case SSL_CTRL_SESS_SHARD_MISSES:
+        return tsan_load(&shard->stats.sess_miss);
+    case SSL_CTRL_SESS_SHARD_EVICTIONS:
+        return tsan_load(&shard->stats.sess_evict);
+    }
+    return 0;
+}
+
 long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
 {
     long l;
+    size_t i;
     /* For some cases with ctx == NULL perform syntax checks */
     if (ctx == NULL) {
         switch (cmd) {
@@ -2459,12 +2555,66 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
         return (long)ctx->session_cache_size;
     case SSL_CTRL_SET_SESS_CACHE_MODE:
         l = ctx->session_cache_mode;
+        if (((l ^ larg) & SSL_SESS_CACHE_SHARDED) != 0) {
+            if (tsan_load(&ctx->session_shards_fixed)) {
+                /* Sessions may be looked up concurrently, keep the shards */
+                ERR_raise(ERR_LIB_SSL, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+                larg ^= SSL_SESS_CACHE_SHARDED;
+            } else if (!ssl_session_shards_setup(ctx,
+                                                 (larg & SSL_SESS_CACHE_SHARDED) != 0,
+                                                 ctx->session_shard_count)) {
+                larg &= ~SSL_SESS_CACHE_SHARDED;
+            }
+        }
         ctx->session_cache_mode = larg;
         return l;
     case SSL_CTRL_GET_SESS_CACHE_MODE:
         return ctx->session_cache_mode;
+    case SSL_CTRL_SET_SESS_CACHE_SHARDS:
+        if (larg < 1)
+            return 0;
+        l = (long)ctx->session_shard_count;
+        if (ctx->session_shards == NULL) {
+            ctx->session_shard_count = (size_t)larg;
+            return l;
+        }
+        if (tsan_load(&ctx->session_shards_fixed)) {
+            ERR_raise(ERR_LIB_SSL, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+            return 0;
+        }
+        if (!ssl_session_shards_setup(ctx, 1, (size_t)larg)) {
+            ctx->session_cache_mode &= ~SSL_SESS_CACHE_SHARDED;
+            return 0;
+        }
+        return l;
+    case SSL_CTRL_GET_SESS_CACHE_SHARDS:
+        return (long)ctx->session_shard_count;
+    case SSL_CTRL_SESS_SHARD_NUMBER:
+    case SSL_CTRL_SESS_SHARD_HITS:
+    case SSL_CTRL_SESS_SHARD_MISSES:
+    case SSL_CTRL_SESS_SHARD_EVICTIONS:
+        return ssl_session_shard_stat(ctx, cmd, larg);
+    case SSL_CTRL_SET_BUFFER_POOL_MAX:
+        if (larg < 0 || ctx->buffer_pool == NULL)
+            return 0;
+        l = (long)ctx->buffer_pool->max_free;
+        ssl_buffer_pool_set_max(ctx->buffer_pool, (size_t)larg);
+        return l;
+    case SSL_CTRL_GET_BUFFER_POOL_MAX:
+        return ctx->buffer_pool == NULL ? 0 : (long)ctx->buffer_pool->max_free;
+    case SSL_CTRL_BUFFER_POOL_CACHED:
+    case SSL_CTRL_BUFFER_POOL_HITS:
+    case SSL_CTRL_BUFFER_POOL_MISSES:
+    case SSL_CTRL_BUFFER_POOL_DROPS:
+        return (long)ssl_buffer_pool_stat(ctx->buffer_pool, cmd);
 
     case SSL_CTRL_SESS_NUMBER:
+        if (ctx->session_shards != NULL) {
+            for (l = 0, i = 0; i < ctx->session_shard_count; i++)
+                l += ssl_session_shard_stat(ctx, SSL_CTRL_SESS_SHARD_NUMBER,
+                                            (long)i);
+            return l;
+        }
         return lh_SSL_SESSION_num_items(ctx->sessions);
     case SSL_CTRL_SESS_CONNECT:
         return tsan_load(&ctx->stats.sess_connect);
@@ -3029,6 +3179,56 @@ static int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b)
     return memcmp(a->session_id, b->session_id, a->session_id_length);
 }
 
+/*
+ * Switch the session cache of |ctx| to (or from) SSL_SESS_CACHE_SHARDED
+ * mode with |n| shards.  Sessions cannot move between caches, so any that
+ * are currently cached are flushed first.
+ */
+int ssl_session_shards_setup(SSL_CTX *ctx, int sharded, size_t n)
+{
+    SSL_SESS_SHARD *shards;
+    size_t i;
+
+    SSL_CTX_flush_sessions(ctx, 0);
+    ssl_session_shards_free(ctx);
+    ctx->session_shard_count = n;
+    if (!sharded)
+        return 1;
+
+    if (n == 0 || n > SIZE_MAX / sizeof(*shards)
+            || (shards = OPENSSL_zalloc(n * sizeof(*shards))) == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    ctx->session_shards = shards;
+    for (i = 0; i < n; i++) {
+        shards[i].lock = CRYPTO_THREAD_lock_new();
+        shards[i].sessions = lh_SSL_SESSION_new(ssl_session_hash,
+                                                ssl_session_cmp);
+        if (shards[i].lock == NULL || shards[i].sessions == NULL) {
+            ssl_session_shards_free(ctx);
+            ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* The shards must have been flushed already */
+void ssl_session_shards_free(SSL_CTX *ctx)
+{
+    size_t i;
+
+    if (ctx->session_shards == NULL)
+        return;
+    for (i = 0; i < ctx->session_shard_count; i++) {
+        CRYPTO_THREAD_lock_free(ctx->session_shards[i].lock);
+        lh_SSL_SESSION_free(ctx->session_shards[i].sessions);
+    }
+    OPENSSL_free(ctx->session_shards);
+    ctx->session_shards = NULL;
+}
+
 /*
  * These wrapper functions should remain rather than redeclaring
  * SSL_SESSION_hash and SSL_SESSION_cmp for void* types and casting each
@@ -3062,6 +3262,7 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
     ret->mode = SSL_MODE_AUTO_RETRY;
     ret->session_cache_mode = SSL_SESS_CACHE_SERVER;
     ret->session_cache_size = SSL_SESSION_CACHE_MAX_SIZE_DEFAULT;
+    ret->session_shard_count = SSL_SESSION_CACHE_SHARDS_DEFAULT;
     /* We take the system default. */
     ret->session_timeout = meth->get_timeout();
     ret->references = 1;
@@ -3079,6 +3280,9 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
     ret->sessions = lh_SSL_SESSION_new(ssl_session_hash, ssl_session_cmp);
     if (ret->sessions == NULL)
         goto err;
+    ret->buffer_pool = ssl_buffer_pool_new(SSL_BUFFER_POOL_MAX_DEFAULT);
+    if (ret->buffer_pool == NULL)
+        goto err;
     ret->cert_store = X509_STORE_new();
     if (ret->cert_store == NULL)
         goto err;
@@ -3140,6 +3344,8 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
         || (RAND_priv_bytes(ret->ext.secure->tick_aes_key,
                        sizeof(ret->ext.secure->tick_aes_key)) <= 0))
         ret->options |= SSL_OP_NO_TICKET;
+    else if (!tls_ticket_cipher_setup(ret))
+        goto err;
 
     if (RAND_priv_bytes(ret->ext.cookie_hmac_key,
                    sizeof(ret->ext.cookie_hmac_key)) <= 0)
@@ -3267,6 +3473,8 @@ void SSL_CTX_free(SSL_CTX *a)
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_SSL_CTX, a, &a->ex_data);
     lh_SSL_SESSION_free(a->sessions);
+    ssl_session_shards_free(a);
+    ssl_buffer_pool_free(a->buffer_pool);
     X509_STORE_free(a->cert_store);
 #ifndef OPENSSL_NO_CT
     CTLOG_STORE_free(a->ctlog_store);
@@ -3294,6 +3502,8 @@ void SSL_CTX_free(SSL_CTX *a)
     OPENSSL_free(a->ext.supportedgroups);
 #endif
     OPENSSL_free(a->ext.alpn);
+    EVP_CIPHER_CTX_free(a->ext.tick_enc_tmpl);
+    EVP_CIPHER_CTX_free(a->ext.tick_dec_tmpl);
     OPENSSL_secure_free(a->ext.secure);
 
     CRYPTO_THREAD_lock_free(a->lock);
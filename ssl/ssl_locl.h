@@ -732,6 +732,54 @@ DEFINE_LHASH_OF(X509_NAME);
 # define TLSEXT_KEYNAME_LENGTH  16
 # define TLSEXT_TICK_KEY_LENGTH 32
 
+/*
+ * One shard of the session cache when SSL_SESS_CACHE_SHARDED is in effect.
+ * Sessions are assigned to a shard by a hash of their session id, and each
+ * shard has its own lock, hash table, LRU list and statistics.
+ */
+typedef struct ssl_sess_shard_st {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(SSL_SESSION) *sessions;
+    struct ssl_session_st *session_cache_head;
+    struct ssl_session_st *session_cache_tail;
+    struct {
+        TSAN_QUALIFIER int sess_hit;    /* found in this shard */
+        TSAN_QUALIFIER int sess_miss;   /* looked up but not found */
+        TSAN_QUALIFIER int sess_evict;  /* removed because the shard was full */
+    } stats;
+} SSL_SESS_SHARD;
+
+/*
+ * Free record buffers kept by an SSL_CTX for reuse by its connections, see
+ * ssl3_buffer.c. Buffers are grouped into size classes that are multiples of
+ * SSL_BUF_POOL_GRANULE bytes. The pool is split into shards selected by the
+ * calling thread, so that threads mostly recycle their own buffers under
+ * their own lock.
+ */
+# define SSL_BUF_POOL_SHARDS     8
+# define SSL_BUF_POOL_GRANULE    1024
+# define SSL_BUF_POOL_CLASSES    64
+
+typedef struct ssl_buf_pool_shard_st {
+    CRYPTO_RWLOCK *lock;
+    /* Maximum number of free buffers in each size class of this shard */
+    size_t max_free;
+    /* Free buffers are chained through their first bytes */
+    void *free_list[SSL_BUF_POOL_CLASSES];
+    size_t num_free[SSL_BUF_POOL_CLASSES];
+    struct {
+        size_t hit;     /* buffer handed out from the pool */
+        size_t miss;    /* pool empty, buffer allocated */
+        size_t drop;    /* pool full, buffer freed */
+    } stats;
+} SSL_BUF_POOL_SHARD;
+
+typedef struct ssl_buf_pool_st {
+    /* Maximum number of free buffers kept in each size class */
+    size_t max_free;
+    SSL_BUF_POOL_SHARD shards[SSL_BUF_POOL_SHARDS];
+} SSL_BUF_POOL;
+
 typedef struct ssl_ctx_ext_secure_st {
     unsigned char tick_hmac_key[TLSEXT_TICK_KEY_LENGTH];
     unsigned char tick_aes_key[TLSEXT_TICK_KEY_LENGTH];
@@ -753,6 +801,17 @@ struct ssl_ctx_st {
     size_t session_cache_size;
     struct ssl_session_st *session_cache_head;
     struct ssl_session_st *session_cache_tail;
+    /*
+     * Used instead of the above when SSL_SESS_CACHE_SHARDED is set, in which
+     * case session_cache_size is divided evenly between the shards.
+     */
+    SSL_SESS_SHARD *session_shards;
+    size_t session_shard_count;
+    /*
+     * Set by the first SSL_new(), after which other threads may be using the
+     * shards and they can no longer be replaced.
+     */
+    TSAN_QUALIFIER int session_shards_fixed;
     /*
      * This can have one of 2 values, ored together, SSL_SESS_CACHE_CLIENT,
      * SSL_SESS_CACHE_SERVER, Default is SSL_SESSION_CACHE_SERVER, which
@@ -915,6 +974,9 @@ struct ssl_ctx_st {
     /* The default read buffer length to use (0 means not set) */
     size_t default_read_buf_len;
 
+    /* Record buffers released by connections, ready to be reused */
+    SSL_BUF_POOL *buffer_pool;
+
 # ifndef OPENSSL_NO_ENGINE
     /*
      * Engine to pass requests for client certs to
@@ -938,6 +1000,13 @@ struct ssl_ctx_st {
         int (*ticket_key_cb) (SSL *ssl,
                               unsigned char *name, unsigned char *iv,
                               EVP_CIPHER_CTX *ectx, HMAC_CTX *hctx, int enc);
+        /*
+         * Contexts keyed with the built-in ticket key, one per direction.
+         * Each ticket starts from a copy, so the key schedule is only set up
+         * once per key. Rebuilt whenever the key is set.
+         */
+        EVP_CIPHER_CTX *tick_enc_tmpl;
+        EVP_CIPHER_CTX *tick_dec_tmpl;
 
         /* certificate status request info */
         /* Callback for status request */
@@ -2280,6 +2349,15 @@ __owur int ssl_get_new_session(SSL *s, int session);
 __owur SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
                                          size_t sess_id_len);
 __owur int ssl_get_prev_session(SSL *s, CLIENTHELLO_MSG *hello);
+__owur SSL_SESS_SHARD *ssl_session_shard(const SSL_CTX *ctx,
+                                         const unsigned char *sess_id,
+                                         size_t sess_id_len);
+__owur int ssl_session_shards_setup(SSL_CTX *ctx, int sharded, size_t n);
+void ssl_session_shards_free(SSL_CTX *ctx);
+__owur SSL_BUF_POOL *ssl_buffer_pool_new(size_t max_free);
+void ssl_buffer_pool_free(SSL_BUF_POOL *pool);
+void ssl_buffer_pool_set_max(SSL_BUF_POOL *pool, size_t max_free);
+size_t ssl_buffer_pool_stat(SSL_BUF_POOL *pool, int cmd);
 __owur SSL_SESSION *ssl_session_dup(const SSL_SESSION *src, int ticket);
 __owur int ssl_cipher_id_cmp(const SSL_CIPHER *a, const SSL_CIPHER *b);
 DECLARE_OBJ_BSEARCH_GLOBAL_CMP_FN(SSL_CIPHER, SSL_CIPHER, ssl_cipher_id);
@@ -2559,6 +2637,10 @@ __owur SSL_TICKET_STATUS tls_decrypt_ticket(SSL *s, const unsigned char *etick,
                                             const unsigned char *sess_id,
                                             size_t sesslen, SSL_SESSION **psess);
 
+__owur int tls_ticket_cipher_init(SSL_CTX *tctx, EVP_CIPHER_CTX *ctx,
+                                  const unsigned char *iv, int enc);
+__owur int tls_ticket_cipher_setup(SSL_CTX *tctx);
+
 __owur int tls_use_ticket(SSL *s);
 
 void ssl_set_sig_mask(uint32_t *pmask_a, SSL *s, int op);
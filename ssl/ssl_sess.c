@@ -16,10 +16,65 @@
 #include "ssl_locl.h"
 #include "statem/statem_locl.h"
 
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s);
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s);
+/*
+ * The session cache that holds sessions with a given id: either the one in
+ * the SSL_CTX itself, or one of its shards.
+ */
+typedef struct {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(SSL_SESSION) *sessions;
+    SSL_SESSION **head;
+    SSL_SESSION **tail;
+    size_t size;                /* Most sessions to hold, 0 is unlimited */
+    SSL_SESS_SHARD *shard;      /* NULL if not sharded */
+} SESS_CACHE;
+
+static void SSL_SESSION_list_remove(const SESS_CACHE *sc, SSL_SESSION *s);
+static void SSL_SESSION_list_add(const SESS_CACHE *sc, SSL_SESSION *s);
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck);
 
+SSL_SESS_SHARD *ssl_session_shard(const SSL_CTX *ctx,
+                                  const unsigned char *sess_id,
+                                  size_t sess_id_len)
+{
+    /*
+     * The hash tables only look at the first few bytes of the id, so use
+     * all of it here (FNV-1a) to keep the two choices independent.
+     */
+    uint32_t h = 0x811c9dc5;
+    size_t i;
+
+    if (ctx->session_shards == NULL)
+        return NULL;
+    for (i = 0; i < sess_id_len; i++) {
+        h ^= sess_id[i];
+        h *= 0x01000193;
+    }
+    return &ctx->session_shards[h % ctx->session_shard_count];
+}
+
+static void sess_cache_select(SSL_CTX *ctx, const unsigned char *sess_id,
+                              size_t sess_id_len, SESS_CACHE *sc)
+{
+    SSL_SESS_SHARD *shard = ssl_session_shard(ctx, sess_id, sess_id_len);
+
+    sc->shard = shard;
+    if (shard == NULL) {
+        sc->lock = ctx->lock;
+        sc->sessions = ctx->sessions;
+        sc->head = &ctx->session_cache_head;
+        sc->tail = &ctx->session_cache_tail;
+        sc->size = ctx->session_cache_size;
+    } else {
+        sc->lock = shard->lock;
+        sc->sessions = shard->sessions;
+        sc->head = &shard->session_cache_head;
+        sc->tail = &shard->session_cache_tail;
+        sc->size = (ctx->session_cache_size + ctx->session_shard_count - 1)
+                   / ctx->session_shard_count;
+    }
+}
+
 /*
  * SSL_get_session() and SSL_get1_session() are problematic in TLS1.3 because,
  * unlike in earlier protocol versions, the session ticket may not have been
@@ -424,6 +479,7 @@ SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
     if ((s->session_ctx->session_cache_mode
          & SSL_SESS_CACHE_NO_INTERNAL_LOOKUP) == 0) {
         SSL_SESSION data;
+        SESS_CACHE sc;
 
         data.ssl_version = s->version;
         if (!ossl_assert(sess_id_len <= SSL_MAX_SSL_SESSION_ID_LENGTH))
@@ -432,13 +488,31 @@ SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
         memcpy(data.session_id, sess_id, sess_id_len);
         data.session_id_length = sess_id_len;
 
-        CRYPTO_THREAD_read_lock(s->session_ctx->lock);
-        ret = lh_SSL_SESSION_retrieve(s->session_ctx->sessions, &data);
-        if (ret != NULL) {
-            /* don't allow other threads to steal it: */
-            SSL_SESSION_up_ref(ret);
+        sess_cache_select(s->session_ctx, sess_id, sess_id_len, &sc);
+        if (sc.shard == NULL) {
+            CRYPTO_THREAD_read_lock(sc.lock);
+            ret = lh_SSL_SESSION_retrieve(sc.sessions, &data);
+            if (ret != NULL) {
+                /* don't allow other threads to steal it: */
+                SSL_SESSION_up_ref(ret);
+            }
+            CRYPTO_THREAD_unlock(sc.lock);
+        } else {
+            /*
+             * A shard only sees a fraction of the lookups, so it can afford
+             * a write lock to keep its list in least recently used order.
+             */
+            CRYPTO_THREAD_write_lock(sc.lock);
+            ret = lh_SSL_SESSION_retrieve(sc.sessions, &data);
+            if (ret != NULL) {
+                SSL_SESSION_up_ref(ret);
+                SSL_SESSION_list_add(&sc, ret);
+                tsan_counter(&sc.shard->stats.sess_hit);
+            } else {
+                tsan_counter(&sc.shard->stats.sess_miss);
+            }
+            CRYPTO_THREAD_unlock(sc.lock);
         }
-        CRYPTO_THREAD_unlock(s->session_ctx->lock);
         if (ret == NULL)
             tsan_counter(&s->session_ctx->stats.sess_miss);
     }
@@ -638,6 +712,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
     int ret = 0;
     SSL_SESSION *s;
+    SESS_CACHE sc;
 
     /*
      * add just 1 reference count for the SSL_CTX's session cache even though
@@ -649,8 +724,9 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
      * if session c is in already in cache, we take back the increment later
      */
 
-    CRYPTO_THREAD_write_lock(ctx->lock);
-    s = lh_SSL_SESSION_insert(ctx->sessions, c);
+    sess_cache_select(ctx, c->session_id, c->session_id_length, &sc);
+    CRYPTO_THREAD_write_lock(sc.lock);
+    s = lh_SSL_SESSION_insert(sc.sessions, c);
 
     /*
      * s != NULL iff we already had a session with the given PID. In this
@@ -659,7 +735,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
      */
     if (s != NULL && s != c) {
         /* We *are* in trouble ... */
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(&sc, s);
         SSL_SESSION_free(s);
         /*
          * ... so pretend the other session did not exist in cache (we cannot
@@ -669,7 +745,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
          */
         s = NULL;
     } else if (s == NULL &&
-               lh_SSL_SESSION_retrieve(ctx->sessions, c) == NULL) {
+               lh_SSL_SESSION_retrieve(sc.sessions, c) == NULL) {
         /* s == NULL can also mean OOM error in lh_SSL_SESSION_insert ... */
 
         /*
@@ -681,7 +757,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 
     /* Put at the head of the queue unless it is already in the cache */
     if (s == NULL)
-        SSL_SESSION_list_add(ctx, c);
+        SSL_SESSION_list_add(&sc, c);
 
     if (s != NULL) {
         /*
@@ -698,16 +774,17 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 
         ret = 1;
 
-        if (SSL_CTX_sess_get_cache_size(ctx) > 0) {
-            while (SSL_CTX_sess_number(ctx) > SSL_CTX_sess_get_cache_size(ctx)) {
-                if (!remove_session_lock(ctx, ctx->session_cache_tail, 0))
+        if (sc.size > 0) {
+            while (lh_SSL_SESSION_num_items(sc.sessions) > sc.size) {
+                if (!remove_session_lock(ctx, *sc.tail, 0))
                     break;
-                else
-                    tsan_counter(&ctx->stats.sess_cache_full);
+                tsan_counter(&ctx->stats.sess_cache_full);
+                if (sc.shard != NULL)
+                    tsan_counter(&sc.shard->stats.sess_evict);
             }
         }
     }
-    CRYPTO_THREAD_unlock(ctx->lock);
+    CRYPTO_THREAD_unlock(sc.lock);
     return ret;
 }
 
@@ -719,20 +796,22 @@ int SSL_CTX_remove_session(SSL_CTX *ctx, SSL_SESSION *c)
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck)
 {
     SSL_SESSION *r;
+    SESS_CACHE sc;
     int ret = 0;
 
     if ((c != NULL) && (c->session_id_length != 0)) {
+        sess_cache_select(ctx, c->session_id, c->session_id_length, &sc);
         if (lck)
-            CRYPTO_THREAD_write_lock(ctx->lock);
-        if ((r = lh_SSL_SESSION_retrieve(ctx->sessions, c)) != NULL) {
+            CRYPTO_THREAD_write_lock(sc.lock);
+        if ((r = lh_SSL_SESSION_retrieve(sc.sessions, c)) != NULL) {
             ret = 1;
-            r = lh_SSL_SESSION_delete(ctx->sessions, r);
-            SSL_SESSION_list_remove(ctx, r);
+            r = lh_SSL_SESSION_delete(sc.sessions, r);
+            SSL_SESSION_list_remove(&sc, r);
         }
         c->not_resumable = 1;
 
         if (lck)
-            CRYPTO_THREAD_unlock(ctx->lock);
+            CRYPTO_THREAD_unlock(sc.lock);
 
         if (ctx->remove_session_cb != NULL)
             ctx->remove_session_cb(ctx, c);
@@ -1045,7 +1124,7 @@ int SSL_set_session_ticket_ext(SSL *s, void *ext_data, int ext_len)
 typedef struct timeout_param_st {
     SSL_CTX *ctx;
     long time;
-    LHASH_OF(SSL_SESSION) *cache;
+    const SESS_CACHE *cache;
 } TIMEOUT_PARAM;
 
 static void timeout_cb(SSL_SESSION *s, TIMEOUT_PARAM *p)
@@ -1055,8 +1134,8 @@ static void timeout_cb(SSL_SESSION *s, TIMEOUT_PARAM *p)
          * The reason we don't call SSL_CTX_remove_session() is to save on
          * locking overhead
          */
-        (void)lh_SSL_SESSION_delete(p->cache, s);
-        SSL_SESSION_list_remove(p->ctx, s);
+        (void)lh_SSL_SESSION_delete(p->cache->sessions, s);
+        SSL_SESSION_list_remove(p->cache, s);
         s->not_resumable = 1;
         if (p->ctx->remove_session_cb != NULL)
             p->ctx->remove_session_cb(p->ctx, s);
@@ -1066,22 +1145,50 @@ static void timeout_cb(SSL_SESSION *s, TIMEOUT_PARAM *p)
 
 IMPLEMENT_LHASH_DOALL_ARG(SSL_SESSION, TIMEOUT_PARAM);
 
-void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
+static void flush_session_cache(SSL_CTX *ctx, const SESS_CACHE *sc, long t)
 {
     unsigned long i;
     TIMEOUT_PARAM tp;
 
-    tp.ctx = s;
-    tp.cache = s->sessions;
-    if (tp.cache == NULL)
-        return;
+    tp.ctx = ctx;
+    tp.cache = sc;
     tp.time = t;
-    CRYPTO_THREAD_write_lock(s->lock);
-    i = lh_SSL_SESSION_get_down_load(s->sessions);
-    lh_SSL_SESSION_set_down_load(s->sessions, 0);
-    lh_SSL_SESSION_doall_TIMEOUT_PARAM(tp.cache, timeout_cb, &tp);
-    lh_SSL_SESSION_set_down_load(s->sessions, i);
-    CRYPTO_THREAD_unlock(s->lock);
+    CRYPTO_THREAD_write_lock(sc->lock);
+    i = lh_SSL_SESSION_get_down_load(sc->sessions);
+    lh_SSL_SESSION_set_down_load(sc->sessions, 0);
+    lh_SSL_SESSION_doall_TIMEOUT_PARAM(sc->sessions, timeout_cb, &tp);
+    lh_SSL_SESSION_set_down_load(sc->sessions, i);
+    CRYPTO_THREAD_unlock(sc->lock);
+}
+
+void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
+{
+    SESS_CACHE sc;
+    size_t i;
+
+    if (s->sessions == NULL)
+        return;
+
+    /* Each shard is swept under its own lock */
+    for (i = 0; s->session_shards != NULL && i < s->session_shard_count; i++) {
+        SSL_SESS_SHARD *shard = &s->session_shards[i];
+
+        sc.lock = shard->lock;
+        sc.sessions = shard->sessions;
+        sc.head = &shard->session_cache_head;
+        sc.tail = &shard->session_cache_tail;
+        sc.size = 0;
+        sc.shard = shard;
+        flush_session_cache(s, &sc, t);
+    }
+
+    sc.lock = s->lock;
+    sc.sessions = s->sessions;
+    sc.head = &s->session_cache_head;
+    sc.tail = &s->session_cache_tail;
+    sc.size = 0;
+    sc.shard = NULL;
+    flush_session_cache(s, &sc, t);
 }
 
 int ssl_clear_bad_session(SSL *s)
@@ -1095,27 +1202,27 @@ int ssl_clear_bad_session(SSL *s)
         return 0;
 }
 
-/* locked by SSL_CTX in the calling function */
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
+/* locked by the SESS_CACHE lock in the calling function */
+static void SSL_SESSION_list_remove(const SESS_CACHE *sc, SSL_SESSION *s)
 {
     if ((s->next == NULL) || (s->prev == NULL))
         return;
 
-    if (s->next == (SSL_SESSION *)&(ctx->session_cache_tail)) {
+    if (s->next == (SSL_SESSION *)sc->tail) {
         /* last element in list */
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)sc->head) {
             /* only one element in list */
-            ctx->session_cache_head = NULL;
-            ctx->session_cache_tail = NULL;
+            *sc->head = NULL;
+            *sc->tail = NULL;
         } else {
-            ctx->session_cache_tail = s->prev;
-            s->prev->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+            *sc->tail = s->prev;
+            s->prev->next = (SSL_SESSION *)sc->tail;
         }
     } else {
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)sc->head) {
             /* first element in list */
-            ctx->session_cache_head = s->next;
-            s->next->prev = (SSL_SESSION *)&(ctx->session_cache_head);
+            *sc->head = s->next;
+            s->next->prev = (SSL_SESSION *)sc->head;
         } else {
             /* middle of list */
             s->next->prev = s->prev;
@@ -1125,21 +1232,21 @@ static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
     s->prev = s->next = NULL;
 }
 
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s)
+static void SSL_SESSION_list_add(const SESS_CACHE *sc, SSL_SESSION *s)
 {
     if ((s->next != NULL) && (s->prev != NULL))
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(sc, s);
 
-    if (ctx->session_cache_head == NULL) {
-        ctx->session_cache_head = s;
-        ctx->session_cache_tail = s;
-        s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-        s->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+    if (*sc->head == NULL) {
+        *sc->head = s;
+        *sc->tail = s;
+        s->prev = (SSL_SESSION *)sc->head;
+        s->next = (SSL_SESSION *)sc->tail;
     } else {
-        s->next = ctx->session_cache_head;
+        s->next = *sc->head;
         s->next->prev = s;
-        s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-        ctx->session_cache_head = s;
+        s->prev = (SSL_SESSION *)sc->head;
+        *sc->head = s;
     }
 }
 
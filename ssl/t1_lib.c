@@ -1375,6 +1375,49 @@ SSL_TICKET_STATUS tls_get_ticket_from_client(SSL *s, CLIENTHELLO_MSG *hello,
                               hello->session_id, hello->session_id_len, ret);
 }
 
+/*
+ * Set up |ctx| to encrypt (|enc| is 1) or decrypt a ticket with the built-in
+ * ticket key of |tctx| and the given |iv|. The AES key schedule is expanded
+ * once by tls_ticket_cipher_setup() and then copied for every ticket.
+ */
+int tls_ticket_cipher_init(SSL_CTX *tctx, EVP_CIPHER_CTX *ctx,
+                           const unsigned char *iv, int enc)
+{
+    EVP_CIPHER_CTX *tmpl = enc ? tctx->ext.tick_enc_tmpl
+                               : tctx->ext.tick_dec_tmpl;
+
+    return tmpl != NULL
+           && EVP_CIPHER_CTX_copy(ctx, tmpl)
+           && EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, enc);
+}
+
+/*
+ * Build the ticket cipher contexts from the current built-in ticket key.
+ * Called whenever the key is set, which like setting the key itself must
+ * happen before |tctx| is shared between threads.
+ */
+int tls_ticket_cipher_setup(SSL_CTX *tctx)
+{
+    EVP_CIPHER_CTX *enc_tmpl = EVP_CIPHER_CTX_new();
+    EVP_CIPHER_CTX *dec_tmpl = EVP_CIPHER_CTX_new();
+
+    if (enc_tmpl == NULL || dec_tmpl == NULL
+            || !EVP_EncryptInit_ex(enc_tmpl, EVP_aes_256_cbc(), NULL,
+                                   tctx->ext.secure->tick_aes_key, NULL)
+            || !EVP_DecryptInit_ex(dec_tmpl, EVP_aes_256_cbc(), NULL,
+                                   tctx->ext.secure->tick_aes_key, NULL)) {
+        EVP_CIPHER_CTX_free(enc_tmpl);
+        EVP_CIPHER_CTX_free(dec_tmpl);
+        return 0;
+    }
+
+    EVP_CIPHER_CTX_free(tctx->ext.tick_enc_tmpl);
+    EVP_CIPHER_CTX_free(tctx->ext.tick_dec_tmpl);
+    tctx->ext.tick_enc_tmpl = enc_tmpl;
+    tctx->ext.tick_dec_tmpl = dec_tmpl;
+    return 1;
+}
+
 /*-
  * tls_decrypt_ticket attempts to decrypt a session ticket.
  *
@@ -1474,9 +1517,8 @@ SSL_TICKET_STATUS tls_decrypt_ticket(SSL *s, const unsigned char *etick,
         if (HMAC_Init_ex(hctx, tctx->ext.secure->tick_hmac_key,
                          sizeof(tctx->ext.secure->tick_hmac_key),
                          EVP_sha256(), NULL) <= 0
-            || EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), NULL,
-                                  tctx->ext.secure->tick_aes_key,
-                                  etick + TLSEXT_KEYNAME_LENGTH) <= 0) {
+            || !tls_ticket_cipher_init(tctx, ctx,
+                                       etick + TLSEXT_KEYNAME_LENGTH, 0)) {
             ret = SSL_TICKET_FATAL_ERR_OTHER;
             goto end;
         }
@@ -9,7 +9,10 @@
 
 #include <stdlib.h>
 #include "ssl_locl.h"
+#include "record/record_locl.h"
+#include "internal/ktls.h"
 #include "internal/cryptlib.h"
+#include "internal/thread_once.h"
 #include <openssl/evp.h>
 #include <openssl/kdf.h>
 
@@ -362,9 +365,9 @@ static int derive_secret_key_and_iv(SSL *s, int sending, const EVP_MD *md,
                                     const unsigned char *hash,
                                     const unsigned char *label,
                                     size_t labellen, unsigned char *secret,
-                                    unsigned char *iv, EVP_CIPHER_CTX *ciph_ctx)
+                                    unsigned char *key, unsigned char *iv,
+                                    EVP_CIPHER_CTX *ciph_ctx)
 {
-    unsigned char key[EVP_MAX_KEY_LENGTH];
     size_t ivlen, keylen, taglen;
     int hashleni = EVP_MD_size(md);
     size_t hashlen;
@@ -422,10 +425,103 @@ static int derive_secret_key_and_iv(SSL *s, int sending, const EVP_MD *md,
 
     return 1;
  err:
-    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(key, EVP_MAX_KEY_LENGTH);
     return 0;
 }
 
+#ifndef OPENSSL_NO_KTLS
+static CRYPTO_ONCE ktls_rekey_once = CRYPTO_ONCE_STATIC_INIT;
+static int ktls_rekey_ok = 0;
+
+DEFINE_RUN_ONCE_STATIC(do_ktls_rekey_probe)
+{
+    ktls_rekey_ok = ktls_rekey_probe();
+    return 1;
+}
+
+/*
+ * Offer the application traffic |key| and |iv| for one direction to kernel
+ * TLS. Returns 1 if the kernel now handles that direction, 0 if ktls is not
+ * used and the record layer should carry on in user space, or -1 if the
+ * kernel already owned the direction and refused the new keys. In the last
+ * case the connection cannot continue, as the kernel keeps processing that
+ * direction under the old keys. Directions are only offloaded on kernels
+ * that can rekey, so this doesn't normally happen.
+ */
+static int tls13_ktls_start(SSL *s, int sending, const EVP_CIPHER *ciph,
+                            const unsigned char *key, const unsigned char *iv)
+{
+    struct tls12_crypto_info_aes_gcm_128 crypto_info;
+    BIO *bio = sending ? s->wbio : s->rbio;
+    int rekey, ret;
+
+    if (bio == NULL)
+        return 0;
+
+    rekey = sending ? BIO_get_ktls_send(bio) : BIO_get_ktls_recv(bio);
+    if (!rekey) {
+        if (s->mode & (sending ? SSL_MODE_NO_KTLS_TX : SSL_MODE_NO_KTLS_RX))
+            return 0;
+
+        /* Either peer may send a KeyUpdate at any time */
+        if (!RUN_ONCE(&ktls_rekey_once, do_ktls_rekey_probe) || !ktls_rekey_ok)
+            return 0;
+
+        /* ktls supports only the maximum fragment size */
+        if (ssl_get_max_send_fragment(s) != SSL3_RT_MAX_PLAIN_LENGTH)
+            return 0;
+
+        /* check that cipher is AES_GCM_128 */
+        if (EVP_CIPHER_nid(ciph) != NID_aes_128_gcm
+            || EVP_CIPHER_mode(ciph) != EVP_CIPH_GCM_MODE
+            || EVP_CIPHER_key_length(ciph) != TLS_CIPHER_AES_GCM_128_KEY_SIZE)
+            return 0;
+
+        /* All future data will get encrypted by ktls. Flush or skip ktls */
+        if (sending) {
+            if (BIO_flush(bio) <= 0)
+                return 0;
+        } else if (RECORD_LAYER_read_pending(&s->rlayer)) {
+            /*
+             * Records protected under the new keys have already been read
+             * into our buffer; the kernel would not see them, so keep
+             * decrypting in user space.
+             */
+            return 0;
+        }
+    }
+
+    /*
+     * The kernel builds the TLSv1.3 nonce as salt || iv, XORed with the
+     * record sequence number, so split our 12 byte static IV accordingly.
+     */
+    memset(&crypto_info, 0, sizeof(crypto_info));
+    crypto_info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+    crypto_info.info.version = TLS1_3_VERSION;
+    memcpy(crypto_info.salt, iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+    memcpy(crypto_info.iv, iv + TLS_CIPHER_AES_GCM_128_SALT_SIZE,
+           TLS_CIPHER_AES_GCM_128_IV_SIZE);
+    memcpy(crypto_info.key, key, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+    if (sending)
+        memcpy(crypto_info.rec_seq, &s->rlayer.write_sequence,
+               TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+    else
+        memcpy(crypto_info.rec_seq, &s->rlayer.read_sequence,
+               TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+
+    ret = BIO_set_ktls(bio, &crypto_info, sending);
+    OPENSSL_cleanse(&crypto_info, sizeof(crypto_info));
+    if (!ret)
+        return rekey ? -1 : 0;
+
+    /* ktls works with user provided buffers directly */
+    if (sending && !rekey)
+        ssl3_release_write_buffer(s);
+
+    return 1;
+}
+#endif
+
 int tls13_change_cipher_state(SSL *s, int which)
 {
 #ifdef CHARSET_EBCDIC
@@ -448,6 +544,7 @@ int tls13_change_cipher_state(SSL *s, int which)
     static const unsigned char early_exporter_master_secret[] = "e exp master";
 #endif
     unsigned char *iv;
+    unsigned char key[EVP_MAX_KEY_LENGTH];
     unsigned char secret[EVP_MAX_MD_SIZE];
     unsigned char hashval[EVP_MAX_MD_SIZE];
     unsigned char *hash = hashval;
@@ -664,8 +761,8 @@ int tls13_change_cipher_state(SSL *s, int which)
     }
 
     if (!derive_secret_key_and_iv(s, which & SSL3_CC_WRITE, md, cipher,
-                                  insecret, hash, label, labellen, secret, iv,
-                                  ciph_ctx)) {
+                                  insecret, hash, label, labellen, secret, key,
+                                  iv, ciph_ctx)) {
         /* SSLfatal() already called */
         goto err;
     }
@@ -702,12 +799,25 @@ int tls13_change_cipher_state(SSL *s, int which)
         goto err;
     }
 
+#ifndef OPENSSL_NO_KTLS
+    /* Only the application traffic keys are handed over to the kernel */
+    if ((label == client_application_traffic
+            || label == server_application_traffic)
+            && tls13_ktls_start(s, which & SSL3_CC_WRITE, cipher, key,
+                                iv) < 0) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS13_CHANGE_CIPHER_STATE,
+                 ERR_R_INTERNAL_ERROR);
+        goto err;
+    }
+#endif
+
     if (!s->server && label == client_early_traffic)
         s->statem.enc_write_state = ENC_WRITE_STATE_WRITE_PLAIN_ALERTS;
     else
         s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
     ret = 1;
  err:
+    OPENSSL_cleanse(key, sizeof(key));
     OPENSSL_cleanse(secret, sizeof(secret));
     return ret;
 }
@@ -722,6 +832,7 @@ int tls13_update_key(SSL *s, int sending)
     const EVP_MD *md = ssl_handshake_md(s);
     size_t hashlen = EVP_MD_size(md);
     unsigned char *insecret, *iv;
+    unsigned char key[EVP_MAX_KEY_LENGTH];
     unsigned char secret[EVP_MAX_MD_SIZE];
     EVP_CIPHER_CTX *ciph_ctx;
     int ret = 0;
@@ -745,17 +856,30 @@ int tls13_update_key(SSL *s, int sending)
     if (!derive_secret_key_and_iv(s, sending, ssl_handshake_md(s),
                                   s->s3.tmp.new_sym_enc, insecret, NULL,
                                   application_traffic,
-                                  sizeof(application_traffic) - 1, secret, iv,
-                                  ciph_ctx)) {
+                                  sizeof(application_traffic) - 1, secret, key,
+                                  iv, ciph_ctx)) {
         /* SSLfatal() already called */
         goto err;
     }
 
+#ifndef OPENSSL_NO_KTLS
+    /*
+     * A direction already offloaded to the kernel must follow the KeyUpdate,
+     * otherwise the two sides disagree about the traffic keys.
+     */
+    if (tls13_ktls_start(s, sending, s->s3.tmp.new_sym_enc, key, iv) < 0) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS13_UPDATE_KEY,
+                 ERR_R_INTERNAL_ERROR);
+        goto err;
+    }
+#endif
+
     memcpy(insecret, secret, hashlen);
 
     s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
     ret = 1;
  err:
+    OPENSSL_cleanse(key, sizeof(key));
     OPENSSL_cleanse(secret, sizeof(secret));
     return ret;
 }
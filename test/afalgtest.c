@@ -1,5 +1,5 @@
 /*
- * Copyright 2016-2017 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2016-2019 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -14,6 +14,7 @@
 #include <openssl/engine.h>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
+#include "internal/nelem.h"
 #include "testutil.h"
 
 /* Use a buffer size which is not aligned to block size */
@@ -23,6 +24,10 @@
 static ENGINE *e;
 #endif
 
+/* Options */
+static int use_generic = 0;
+static int bench = 0;
+
 
 #ifndef OPENSSL_NO_AFALGENG
 # include <linux/version.h>
@@ -40,6 +45,10 @@ static ENGINE *e;
 # endif
 #endif
 
+#ifndef OPENSSL_NO_AFALGENG
+# include <sys/time.h>
+#endif
+
 #ifndef OPENSSL_NO_AFALGENG
 static int test_afalg_aes_cbc(int keysize_idx)
 {
@@ -112,6 +121,425 @@ static int test_afalg_aes_cbc(int keysize_idx)
     EVP_CIPHER_CTX_free(ctx);
     return ret;
 }
+
+/* Passes everything to the kernel, or nothing with |on| == 0 */
+static int set_kernel(int on)
+{
+    return TEST_true(ENGINE_ctrl_cmd(e, "KERNEL_MIN", on ? 0 : 1L << 30,
+                                     NULL, NULL, 0));
+}
+
+static int set_gcm_one_shot(int on)
+{
+    return TEST_true(ENGINE_ctrl_cmd(e, "GCM_ONE_SHOT", on, NULL, NULL, 0));
+}
+
+# define NUM_PIPES      4
+# define PIPE_SIZE      1024
+
+/* Pipes must give exactly what CBC over the concatenated pipes gives */
+static int test_afalg_aes_cbc_pipeline(int idx)
+{
+    EVP_CIPHER_CTX *ctx = NULL, *sw = NULL;
+    unsigned char key[16], iv[16];
+    unsigned char in[NUM_PIPES * PIPE_SIZE], out[NUM_PIPES * PIPE_SIZE];
+    unsigned char chk[NUM_PIPES * PIPE_SIZE];
+    unsigned char *outbufs[NUM_PIPES];
+    const unsigned char *inbufs[NUM_PIPES];
+    size_t lens[NUM_PIPES];
+    int i, len, ret = 0;
+
+    if (!set_kernel(idx == 0)
+            || !TEST_int_gt(RAND_bytes(key, sizeof(key)), 0)
+            || !TEST_int_gt(RAND_bytes(iv, sizeof(iv)), 0)
+            || !TEST_int_gt(RAND_bytes(in, sizeof(in)), 0)
+            || !TEST_ptr(ctx = EVP_CIPHER_CTX_new())
+            || !TEST_ptr(sw = EVP_CIPHER_CTX_new()))
+        goto end;
+    for (i = 0; i < NUM_PIPES; i++) {
+        inbufs[i] = in + i * PIPE_SIZE;
+        outbufs[i] = out + i * PIPE_SIZE;
+        lens[i] = PIPE_SIZE;
+    }
+
+    if (!TEST_true(EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), e, key, iv))
+            || !TEST_true(EVP_CIPHER_CTX_set_padding(ctx, 0))
+            || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(ctx,
+                                                EVP_CTRL_SET_PIPELINE_OUTPUT_BUFS,
+                                                NUM_PIPES, outbufs), 0)
+            || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(ctx,
+                                                EVP_CTRL_SET_PIPELINE_INPUT_BUFS,
+                                                NUM_PIPES, inbufs), 0)
+            || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(ctx,
+                                                EVP_CTRL_SET_PIPELINE_INPUT_LENS,
+                                                NUM_PIPES, lens), 0)
+            || !TEST_int_gt(EVP_Cipher(ctx, outbufs[0], inbufs[0], PIPE_SIZE),
+                            0)
+            || !TEST_true(EVP_EncryptInit_ex(sw, EVP_aes_128_cbc(), NULL, key,
+                                             iv))
+            || !TEST_true(EVP_CIPHER_CTX_set_padding(sw, 0))
+            || !TEST_true(EVP_EncryptUpdate(sw, chk, &len, in, sizeof(in)))
+            || !TEST_mem_eq(out, sizeof(out), chk, sizeof(chk)))
+        goto end;
+
+    for (i = 0; i < NUM_PIPES; i++)
+        inbufs[i] = chk + i * PIPE_SIZE;
+    if (!TEST_true(EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), e, key, iv))
+            || !TEST_true(EVP_CIPHER_CTX_set_padding(ctx, 0))
+            || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(ctx,
+                                                EVP_CTRL_SET_PIPELINE_OUTPUT_BUFS,
+                                                NUM_PIPES, outbufs), 0)
+            || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(ctx,
+                                                EVP_CTRL_SET_PIPELINE_INPUT_BUFS,
+                                                NUM_PIPES, inbufs), 0)
+            || !TEST_int_gt(EVP_CIPHER_CTX_ctrl(ctx,
+                                                EVP_CTRL_SET_PIPELINE_INPUT_LENS,
+                                                NUM_PIPES, lens), 0)
+            || !TEST_int_gt(EVP_Cipher(ctx, outbufs[0], inbufs[0], PIPE_SIZE),
+                            0)
+            || !TEST_mem_eq(out, sizeof(out), in, sizeof(in)))
+        goto end;
+
+    ret = 1;
+ end:
+    EVP_CIPHER_CTX_free(ctx);
+    EVP_CIPHER_CTX_free(sw);
+    return set_kernel(1) && ret;
+}
+
+# define GCM_SIZE       1000
+
+static int gcm_encrypt(const EVP_CIPHER *cipher, ENGINE *eng,
+                       const unsigned char *key, const unsigned char *iv,
+                       const unsigned char *aad, const unsigned char *in,
+                       unsigned char *out, unsigned char *tag)
+{
+    EVP_CIPHER_CTX *ctx;
+    int len, ret = 0;
+
+    if (TEST_ptr(ctx = EVP_CIPHER_CTX_new())
+            && TEST_true(EVP_EncryptInit_ex(ctx, cipher, eng, key, iv))
+            && TEST_true(EVP_EncryptUpdate(ctx, NULL, &len, aad, 20))
+            && TEST_true(EVP_EncryptUpdate(ctx, out, &len, in, GCM_SIZE))
+            && TEST_int_eq(len, GCM_SIZE)
+            && TEST_true(EVP_EncryptFinal_ex(ctx, out + len, &len))
+            && TEST_true(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, 16,
+                                             tag)))
+        ret = 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+/*
+ * Decrypts with the tag set before the payload, which is what the kernel
+ * needs, or after it with |late_tag|. Returns 1 if the tag matched, 0 if
+ * it didn't and -1 on error.
+ */
+static int gcm_decrypt(const EVP_CIPHER *cipher, const unsigned char *key,
+                       const unsigned char *iv, const unsigned char *aad,
+                       const unsigned char *in, unsigned char *out,
+                       unsigned char *tag, int late_tag)
+{
+    EVP_CIPHER_CTX *ctx;
+    int len, ret = -1;
+
+    if (TEST_ptr(ctx = EVP_CIPHER_CTX_new())
+            && TEST_true(EVP_DecryptInit_ex(ctx, cipher, e, key, iv))
+            && (late_tag
+                || TEST_true(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
+                                                 16, tag)))
+            && TEST_true(EVP_DecryptUpdate(ctx, NULL, &len, aad, 20))
+            && TEST_true(EVP_DecryptUpdate(ctx, out, &len, in, GCM_SIZE))
+            && TEST_int_eq(len, GCM_SIZE)
+            && (!late_tag
+                || TEST_true(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
+                                                 16, tag))))
+        ret = EVP_DecryptFinal_ex(ctx, out + len, &len) > 0;
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+/* Protects a TLS record in place, see tls1_enc() */
+static int gcm_tls_record(const EVP_CIPHER *cipher, ENGINE *eng,
+                          const unsigned char *key, unsigned char *iv,
+                          unsigned char *rec, size_t len, int enc)
+{
+    EVP_CIPHER_CTX *ctx;
+    unsigned char aad[EVP_AEAD_TLS1_AAD_LEN] = { 0, 0, 0, 0, 0, 0, 0, 1,
+                                                 23, 3, 3 };
+    int ret = -1;
+
+    /* The tag isn't there yet when encrypting */
+    if (enc)
+        len -= EVP_GCM_TLS_TAG_LEN;
+    aad[11] = (unsigned char)(len >> 8);
+    aad[12] = (unsigned char)len;
+    if (enc)
+        len += EVP_GCM_TLS_TAG_LEN;
+    if (TEST_ptr(ctx = EVP_CIPHER_CTX_new())
+            && TEST_true(EVP_CipherInit_ex(ctx, cipher, eng, key, NULL, enc))
+            && TEST_true(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IV_FIXED,
+                                             -1, iv))
+            && TEST_int_eq(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_TLS1_AAD,
+                                               sizeof(aad), aad),
+                           EVP_GCM_TLS_TAG_LEN))
+        ret = EVP_Cipher(ctx, rec, rec, len);
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+static int test_afalg_aes_gcm(int idx)
+{
+    const EVP_CIPHER *cipher = idx % 3 == 0 ? EVP_aes_128_gcm()
+                               : idx % 3 == 1 ? EVP_aes_192_gcm()
+                               : EVP_aes_256_gcm();
+    unsigned char key[32], iv[12], aad[20];
+    unsigned char in[GCM_SIZE], out[GCM_SIZE + 16], chk[GCM_SIZE + 16];
+    unsigned char tag[16], chktag[16];
+    unsigned char rec[8 + GCM_SIZE + 16];
+    size_t reclen = sizeof(rec);
+    int ret = 0;
+
+    if (!set_kernel(idx < 3)
+            || !set_gcm_one_shot(idx < 3)
+            || !TEST_int_gt(RAND_bytes(key, sizeof(key)), 0)
+            || !TEST_int_gt(RAND_bytes(iv, sizeof(iv)), 0)
+            || !TEST_int_gt(RAND_bytes(aad, sizeof(aad)), 0)
+            || !TEST_int_gt(RAND_bytes(in, sizeof(in)), 0))
+        goto end;
+
+    /* Same results as the built in implementation */
+    if (!gcm_encrypt(cipher, e, key, iv, aad, in, out, tag)
+            || !gcm_encrypt(cipher, NULL, key, iv, aad, in, chk, chktag)
+            || !TEST_mem_eq(out, GCM_SIZE, chk, GCM_SIZE)
+            || !TEST_mem_eq(tag, sizeof(tag), chktag, sizeof(chktag)))
+        goto end;
+
+    if (!TEST_int_eq(gcm_decrypt(cipher, key, iv, aad, out, chk, tag, 0), 1)
+            || !TEST_mem_eq(chk, GCM_SIZE, in, GCM_SIZE)
+            || !TEST_int_eq(gcm_decrypt(cipher, key, iv, aad, out, chk, tag, 1),
+                            1)
+            || !TEST_mem_eq(chk, GCM_SIZE, in, GCM_SIZE))
+        goto end;
+    tag[0] ^= 1;
+    if (!TEST_int_eq(gcm_decrypt(cipher, key, iv, aad, out, chk, tag, 0), 0)
+            || !TEST_int_eq(gcm_decrypt(cipher, key, iv, aad, out, chk, tag, 1),
+                            0))
+        goto end;
+
+    /* TLS records, from and to the built in implementation */
+    memcpy(rec + 8, in, GCM_SIZE);
+    if (!TEST_int_eq(gcm_tls_record(cipher, e, key, iv, rec, reclen, 1),
+                     (int)reclen)
+            || !TEST_int_eq(gcm_tls_record(cipher, NULL, key, iv, rec, reclen,
+                                           0), GCM_SIZE)
+            || !TEST_mem_eq(rec + 8, GCM_SIZE, in, GCM_SIZE)
+            || !TEST_int_eq(gcm_tls_record(cipher, NULL, key, iv, rec, reclen,
+                                           1), (int)reclen)
+            || !TEST_int_eq(gcm_tls_record(cipher, e, key, iv, rec, reclen, 0),
+                            GCM_SIZE)
+            || !TEST_mem_eq(rec + 8, GCM_SIZE, in, GCM_SIZE))
+        goto end;
+    if (!TEST_int_eq(gcm_tls_record(cipher, NULL, key, iv, rec, reclen, 1),
+                     (int)reclen))
+        goto end;
+    rec[reclen - 1] ^= 1;
+    if (!TEST_int_eq(gcm_tls_record(cipher, e, key, iv, rec, reclen, 0), -1))
+        goto end;
+
+    ret = 1;
+ end:
+    return set_gcm_one_shot(0) && set_kernel(1) && ret;
+}
+
+# define GCM_STREAM_SIZE    (4096 + 4096 + 8192 + 17)
+
+/*
+ * Encrypts or decrypts a GCM_STREAM_SIZE byte message in several updates
+ * that would each go to the kernel on their own, or in one with |chunked|
+ * == 0. Returns 1 if the tag matched, 0 if it didn't and -1 on error.
+ */
+static int gcm_stream(ENGINE *eng, int enc, int chunked,
+                      const unsigned char *key, const unsigned char *iv,
+                      const unsigned char *aad, const unsigned char *in,
+                      unsigned char *out, unsigned char *tag)
+{
+    static const int chunks[] = { 4096, 4096, 8192, 17 };
+    EVP_CIPHER_CTX *ctx;
+    int i, len, off, ret = -1;
+
+    if (!TEST_ptr(ctx = EVP_CIPHER_CTX_new())
+            || !TEST_true(EVP_CipherInit_ex(ctx, EVP_aes_128_gcm(), eng, key,
+                                            iv, enc))
+            || (!enc
+                && !TEST_true(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
+                                                  16, tag)))
+            || !TEST_true(EVP_CipherUpdate(ctx, NULL, &len, aad, 8))
+            || !TEST_true(EVP_CipherUpdate(ctx, NULL, &len, aad + 8, 12)))
+        goto end;
+    if (chunked) {
+        for (i = 0, off = 0; i < (int)OSSL_NELEM(chunks);
+             off += chunks[i++])
+            if (!TEST_true(EVP_CipherUpdate(ctx, out + off, &len, in + off,
+                                            chunks[i]))
+                    || !TEST_int_eq(len, chunks[i]))
+                goto end;
+    } else if (!TEST_true(EVP_CipherUpdate(ctx, out, &len, in,
+                                           GCM_STREAM_SIZE))
+               || !TEST_int_eq(len, GCM_STREAM_SIZE)) {
+        goto end;
+    }
+    if (!enc) {
+        ret = EVP_CipherFinal_ex(ctx, out, &len) > 0;
+    } else if (TEST_true(EVP_CipherFinal_ex(ctx, out, &len))
+               && TEST_true(EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG,
+                                                16, tag))) {
+        ret = 1;
+    }
+ end:
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+/*
+ * A message passed in several updates must give what the built in
+ * implementation gives, even though the kernel would take each update on
+ * its own.
+ */
+static int test_afalg_aes_gcm_stream(void)
+{
+    static unsigned char in[GCM_STREAM_SIZE], out[GCM_STREAM_SIZE];
+    static unsigned char chk[GCM_STREAM_SIZE];
+    unsigned char key[16], iv[12], aad[20], tag[16], chktag[16];
+
+    if (!TEST_int_gt(RAND_bytes(key, sizeof(key)), 0)
+            || !TEST_int_gt(RAND_bytes(iv, sizeof(iv)), 0)
+            || !TEST_int_gt(RAND_bytes(aad, sizeof(aad)), 0)
+            || !TEST_int_gt(RAND_bytes(in, sizeof(in)), 0))
+        return 0;
+
+    if (!TEST_int_eq(gcm_stream(e, 1, 1, key, iv, aad, in, out, tag), 1)
+            || !TEST_int_eq(gcm_stream(NULL, 1, 0, key, iv, aad, in, chk,
+                                       chktag), 1)
+            || !TEST_mem_eq(out, sizeof(out), chk, sizeof(chk))
+            || !TEST_mem_eq(tag, sizeof(tag), chktag, sizeof(chktag)))
+        return 0;
+
+    if (!TEST_int_eq(gcm_stream(e, 0, 1, key, iv, aad, out, chk, tag), 1)
+            || !TEST_mem_eq(chk, sizeof(chk), in, sizeof(in)))
+        return 0;
+    tag[0] ^= 1;
+    return TEST_int_eq(gcm_stream(e, 0, 1, key, iv, aad, out, chk, tag), 0);
+}
+
+/*
+ * Hashes in one large update and many small ones, and continues a copy made
+ * half way through
+ */
+static int test_afalg_sha(int idx)
+{
+    const EVP_MD *md = idx % 2 == 0 ? EVP_sha256() : EVP_sha512();
+    EVP_MD_CTX *ctx = NULL, *copy = NULL;
+    unsigned char in[10000];
+    unsigned char md1[EVP_MAX_MD_SIZE], md2[EVP_MAX_MD_SIZE];
+    unsigned char chk[EVP_MAX_MD_SIZE];
+    unsigned int len1, len2, chklen;
+    size_t i;
+    int j, ret = 0;
+
+    if (!set_kernel(idx < 2)
+            || !TEST_int_gt(RAND_bytes(in, sizeof(in)), 0)
+            || !TEST_true(EVP_Digest(in, sizeof(in), chk, &chklen, md, NULL))
+            || !TEST_ptr(ctx = EVP_MD_CTX_new())
+            || !TEST_ptr(copy = EVP_MD_CTX_new()))
+        goto end;
+
+    /* Twice, to reuse the context */
+    for (j = 0; j < 2; j++) {
+        if (!TEST_true(EVP_DigestInit_ex(ctx, md, e))
+                || !TEST_true(EVP_DigestUpdate(ctx, in, sizeof(in) / 2))
+                || !TEST_true(EVP_MD_CTX_copy_ex(copy, ctx)))
+            goto end;
+        for (i = sizeof(in) / 2; i < sizeof(in); i += 100)
+            if (!TEST_true(EVP_DigestUpdate(ctx, in + i, 100)))
+                goto end;
+        if (!TEST_true(EVP_DigestFinal_ex(ctx, md1, &len1))
+                || !TEST_true(EVP_DigestUpdate(copy, in + sizeof(in) / 2,
+                                               sizeof(in) / 2))
+                || !TEST_true(EVP_DigestFinal_ex(copy, md2, &len2))
+                || !TEST_mem_eq(md1, len1, chk, chklen)
+                || !TEST_mem_eq(md2, len2, chk, chklen))
+            goto end;
+    }
+
+    ret = 1;
+ end:
+    EVP_MD_CTX_free(ctx);
+    EVP_MD_CTX_free(copy);
+    return set_kernel(1) && ret;
+}
+
+# define BENCH_SIZE     16384
+# define BENCH_ROUNDS   2000
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Throughput in MB/s of the kernel and of user space, for comparison */
+static int test_afalg_bench(int idx)
+{
+    static const char *names[] = { "aes-128-cbc", "aes-128-gcm", "sha256" };
+    static unsigned char buf[BENCH_SIZE + 16];
+    unsigned char key[16] = { 0 }, iv[16] = { 0 }, md[EVP_MAX_MD_SIZE];
+    EVP_CIPHER_CTX *ctx = NULL;
+    double start, mbs[2];
+    int i, k, len, ret = 0;
+
+    if (!TEST_ptr(ctx = EVP_CIPHER_CTX_new()))
+        goto end;
+    for (k = 0; k < 2; k++) {
+        if (!set_kernel(k == 0) || !set_gcm_one_shot(k == 0))
+            goto end;
+        start = now();
+        for (i = 0; i < BENCH_ROUNDS; i++) {
+            switch (idx) {
+            case 0:
+                if (!TEST_true(EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), e,
+                                                  key, iv))
+                        || !TEST_true(EVP_EncryptUpdate(ctx, buf, &len, buf,
+                                                        BENCH_SIZE)))
+                    goto end;
+                break;
+            case 1:
+                if (!TEST_true(EVP_EncryptInit_ex(ctx, EVP_aes_128_gcm(), e,
+                                                  key, iv))
+                        || !TEST_true(EVP_EncryptUpdate(ctx, buf, &len, buf,
+                                                        BENCH_SIZE))
+                        || !TEST_true(EVP_EncryptFinal_ex(ctx, buf, &len)))
+                    goto end;
+                break;
+            default:
+                if (!TEST_true(EVP_Digest(buf, BENCH_SIZE, md, NULL,
+                                          EVP_sha256(), e)))
+                    goto end;
+            }
+        }
+        mbs[k] = (double)BENCH_SIZE * BENCH_ROUNDS / (now() - start) / 1e6;
+    }
+    TEST_info("%s, %d byte buffers: kernel%s %.1f MB/s, user space %.1f MB/s",
+              names[idx], BENCH_SIZE, use_generic ? " (generic)" : "",
+              mbs[0], mbs[1]);
+
+    ret = 1;
+ end:
+    EVP_CIPHER_CTX_free(ctx);
+    return set_gcm_one_shot(0) && set_kernel(1) && ret;
+}
 #endif
 
 #ifndef OPENSSL_NO_ENGINE
@@ -125,15 +553,69 @@ int global_init(void)
 }
 #endif
 
+typedef enum OPTION_choice {
+    OPT_ERR = -1,
+    OPT_EOF = 0,
+    OPT_GENERIC,
+    OPT_BENCH,
+    OPT_TEST_ENUM
+} OPTION_CHOICE;
+
+const OPTIONS *test_get_options(void)
+{
+    static const OPTIONS test_options[] = {
+        OPT_TEST_OPTIONS_DEFAULT_USAGE,
+        { "generic", OPT_GENERIC, '-',
+          "Use the kernel's generic software implementations" },
+        { "bench", OPT_BENCH, '-',
+          "Compare the throughput of the kernel and of user space" },
+        { NULL }
+    };
+    return test_options;
+}
+
 int setup_tests(void)
 {
+    OPTION_CHOICE o;
+
+    while ((o = opt_next()) != OPT_EOF) {
+        switch (o) {
+        case OPT_GENERIC:
+            use_generic = 1;
+            break;
+        case OPT_BENCH:
+            bench = 1;
+            break;
+        case OPT_TEST_CASES:
+            break;
+        default:
+            return 0;
+        }
+    }
+
 #ifndef OPENSSL_NO_ENGINE
     if ((e = ENGINE_by_id("afalg")) == NULL) {
         /* Probably a platform env issue, not a test failure. */
         TEST_info("Can't load AFALG engine");
     } else {
 # ifndef OPENSSL_NO_AFALGENG
+        /*
+         * Take the kernel path for every request, and the zero-copy path for
+         * all but the smallest ones
+         */
+        if (!TEST_true(ENGINE_ctrl_cmd(e, "KERNEL_MIN", 0, NULL, NULL, 0))
+                || !TEST_true(ENGINE_ctrl_cmd(e, "ZERO_COPY_MIN", 256, NULL,
+                                              NULL, 0))
+                || !TEST_true(ENGINE_ctrl_cmd(e, "USE_GENERIC", use_generic,
+                                              NULL, NULL, 0)))
+            return 0;
         ADD_ALL_TESTS(test_afalg_aes_cbc, 3);
+        ADD_ALL_TESTS(test_afalg_aes_cbc_pipeline, 2);
+        ADD_ALL_TESTS(test_afalg_aes_gcm, 6);
+        ADD_TEST(test_afalg_aes_gcm_stream);
+        ADD_ALL_TESTS(test_afalg_sha, 4);
+        if (bench)
+            ADD_ALL_TESTS(test_afalg_bench, 3);
 # endif
     }
 #endif
@@ -1,5 +1,5 @@
 /*
- * Copyright 2017-2018 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2017-2019 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -12,6 +12,8 @@
 
 #include <openssl/rand.h>
 #include <openssl/asn1t.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
 #include "internal/numbers.h"
 #include "testutil.h"
 
@@ -160,6 +162,165 @@ static int test_uint64(void)
     return 1;
 }
 
+/* Borrowed decoding ****************************************************** */
+
+typedef struct {
+    ASN1_OCTET_STRING *octets;
+    ASN1_INTEGER *padded;
+    ASN1_INTEGER *negative;
+    ASN1_BIT_STRING *bits;
+    ASN1_TYPE *any;
+    ASN1_UTF8STRING *text;
+} ASN1_BORROW_DATA;
+
+ASN1_SEQUENCE(ASN1_BORROW_DATA) = {
+    ASN1_SIMPLE(ASN1_BORROW_DATA, octets, ASN1_OCTET_STRING),
+    ASN1_SIMPLE(ASN1_BORROW_DATA, padded, ASN1_INTEGER),
+    ASN1_SIMPLE(ASN1_BORROW_DATA, negative, ASN1_INTEGER),
+    ASN1_SIMPLE(ASN1_BORROW_DATA, bits, ASN1_BIT_STRING),
+    ASN1_SIMPLE(ASN1_BORROW_DATA, any, ASN1_ANY),
+    ASN1_SIMPLE(ASN1_BORROW_DATA, text, ASN1_UTF8STRING),
+} static_ASN1_SEQUENCE_END(ASN1_BORROW_DATA)
+
+IMPLEMENT_STATIC_ASN1_ENCODE_FUNCTIONS(ASN1_BORROW_DATA)
+IMPLEMENT_STATIC_ASN1_ALLOC_FUNCTIONS(ASN1_BORROW_DATA)
+
+static const unsigned char t_borrow[] = {
+    0x30, 0x1b,                         /* SEQUENCE tag + length */
+    0x04, 0x03, 0x01, 0x02, 0x03,       /* OCTET STRING */
+    0x02, 0x02, 0x00, 0x80,             /* INTEGER 128 */
+    0x02, 0x01, 0xff,                   /* INTEGER -1 */
+    0x03, 0x03, 0x04, 0xa5, 0xf0,       /* BIT STRING, 4 unused bits */
+    0x30, 0x03, 0x01, 0x01, 0xff,       /* SEQUENCE { TRUE } */
+    0x0c, 0x03, 0x61, 0x62, 0x63        /* UTF8String "abc" */
+};
+
+static int test_borrow(void)
+{
+    unsigned char buf[sizeof(t_borrow)];
+    const unsigned char *p = buf;
+    unsigned char *der = NULL;
+    ASN1_BORROW_DATA *d = NULL;
+    int derlen = 0, ret = 0;
+
+    /* Decode from a copy to check that the copy is left untouched */
+    memcpy(buf, t_borrow, sizeof(buf));
+    d = (ASN1_BORROW_DATA *)
+        ASN1_item_d2i_flags(NULL, &p, sizeof(buf),
+                            ASN1_ITEM_rptr(ASN1_BORROW_DATA),
+                            ASN1_D2I_FLAG_BORROW);
+    if (!TEST_ptr(d)
+            || !TEST_ptr_eq(p, buf + sizeof(buf))
+            || !TEST_ptr_eq(d->octets->data, buf + 4)
+            || !TEST_long_eq(ASN1_INTEGER_get(d->padded), 128)
+            || !TEST_ptr_eq(d->padded->data, buf + 10)
+            || !TEST_long_eq(ASN1_INTEGER_get(d->negative), -1)
+            || !TEST_false(d->negative->flags & ASN1_STRING_FLAG_BORROWED)
+            || !TEST_ptr_eq(d->bits->data, buf + 17)
+            || !TEST_int_eq(d->bits->flags & 0x07, 4)
+            || !TEST_int_eq(d->any->type, V_ASN1_SEQUENCE)
+            || !TEST_ptr_eq(d->any->value.sequence->data, buf + 19)
+            || !TEST_false(d->text->flags & ASN1_STRING_FLAG_BORROWED)
+            || !TEST_str_eq((char *)d->text->data, "abc"))
+        goto err;
+
+    /* Re-encoding must give the same DER */
+    derlen = i2d_ASN1_BORROW_DATA(d, &der);
+    if (!TEST_mem_eq(der, derlen, t_borrow, sizeof(t_borrow)))
+        goto err;
+
+    /* Changing a borrowed value must not write to the input */
+    if (!TEST_true(ASN1_OCTET_STRING_set(d->octets,
+                                         (unsigned char *)"xyz", 3))
+            || !TEST_false(d->octets->flags & ASN1_STRING_FLAG_BORROWED)
+            || !TEST_true(ASN1_BIT_STRING_set_bit(d->bits, 15, 1))
+            || !TEST_false(d->bits->flags & ASN1_STRING_FLAG_BORROWED)
+            || !TEST_mem_eq(buf, sizeof(buf), t_borrow, sizeof(t_borrow)))
+        goto err;
+
+    ret = 1;
+ err:
+    OPENSSL_free(der);
+    ASN1_BORROW_DATA_free(d);
+    return ret;
+}
+
+/*
+ * Functions that replace the data of a string must not free it if it was
+ * borrowed
+ */
+static int test_borrow_replace(void)
+{
+    static const unsigned char t_spki[] = {
+        0x30, 0x0c,                         /* SEQUENCE tag + length */
+        0x30, 0x04, 0x06, 0x02, 0x2a, 0x03, /* SEQUENCE { OID 1.2.3 } */
+        0x03, 0x04, 0x00, 0x01, 0x02, 0x03  /* BIT STRING */
+    };
+    static const unsigned char t_int[] = { 0x02, 0x02, 0x01, 0x00 };
+    unsigned char buf[sizeof(t_spki)], *penc = NULL;
+    const unsigned char *p = buf;
+    ASN1_BORROW_DATA *d = NULL;
+    X509_PUBKEY *pub = NULL;
+    ASN1_OBJECT *obj = NULL;
+    int ret = 0;
+
+    memcpy(buf, t_spki, sizeof(buf));
+    pub = (X509_PUBKEY *)ASN1_item_d2i_flags(NULL, &p, sizeof(buf),
+                                             ASN1_ITEM_rptr(X509_PUBKEY),
+                                             ASN1_D2I_FLAG_BORROW);
+    if (!TEST_ptr(pub)
+            || !TEST_ptr(obj = OBJ_txt2obj("1.2.4", 1))
+            || !TEST_ptr(penc = OPENSSL_malloc(2)))
+        goto err;
+    penc[0] = penc[1] = 0xaa;
+    if (!TEST_true(X509_PUBKEY_set0_param(pub, obj, V_ASN1_UNDEF, NULL,
+                                          penc, 2)))
+        goto err;
+    obj = NULL;
+    penc = NULL;
+    if (!TEST_mem_eq(buf, sizeof(buf), t_spki, sizeof(t_spki)))
+        goto err;
+
+    p = t_borrow;
+    d = (ASN1_BORROW_DATA *)
+        ASN1_item_d2i_flags(NULL, &p, sizeof(t_borrow),
+                            ASN1_ITEM_rptr(ASN1_BORROW_DATA),
+                            ASN1_D2I_FLAG_BORROW);
+    p = t_int;
+    if (!TEST_ptr(d)
+            || !TEST_ptr(d2i_ASN1_UINTEGER(&d->padded, &p, sizeof(t_int)))
+            || !TEST_false(d->padded->flags & ASN1_STRING_FLAG_BORROWED)
+            || !TEST_long_eq(ASN1_INTEGER_get(d->padded), 256))
+        goto err;
+
+    ret = 1;
+ err:
+    ASN1_OBJECT_free(obj);
+    OPENSSL_free(penc);
+    X509_PUBKEY_free(pub);
+    ASN1_BORROW_DATA_free(d);
+    return ret;
+}
+
+/* Bit strings with non-zero unused bits are not DER, and must be copied */
+static int test_borrow_bits(void)
+{
+    static const unsigned char t_bits[] = { 0x03, 0x02, 0x04, 0xa5 };
+    const unsigned char *p = t_bits;
+    ASN1_BIT_STRING *bits;
+    int ret;
+
+    bits = (ASN1_BIT_STRING *)
+        ASN1_item_d2i_flags(NULL, &p, sizeof(t_bits),
+                            ASN1_ITEM_rptr(ASN1_BIT_STRING),
+                            ASN1_D2I_FLAG_BORROW);
+    ret = TEST_ptr(bits)
+          && TEST_false(bits->flags & ASN1_STRING_FLAG_BORROWED)
+          && TEST_int_eq(bits->data[0], 0xa0);
+    ASN1_BIT_STRING_free(bits);
+    return ret;
+}
+
 int setup_tests(void)
 {
 #if !OPENSSL_API_3
@@ -169,5 +330,8 @@ int setup_tests(void)
     ADD_TEST(test_uint32);
     ADD_TEST(test_int64);
     ADD_TEST(test_uint64);
+    ADD_TEST(test_borrow);
+    ADD_TEST(test_borrow_replace);
+    ADD_TEST(test_borrow_bits);
     return 1;
 }
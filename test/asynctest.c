@@ -16,6 +16,10 @@
 #include <openssl/async.h>
 #include <openssl/crypto.h>
 
+#ifdef OPENSSL_SYS_UNIX
+# include <poll.h>
+#endif
+
 static int ctr = 0;
 static ASYNC_JOB *currjob = NULL;
 
@@ -306,6 +310,157 @@ static int test_ASYNC_block_pause(void)
     return 1;
 }
 
+/* Like the dasync engine: report completion, then wait to be resumed */
+static int complete_via_callback(void *args)
+{
+    ASYNC_WAIT_CTX *waitctx = ASYNC_get_wait_ctx(ASYNC_get_current_job());
+    ASYNC_callback_fn callback;
+    void *callback_arg;
+
+    if (!ASYNC_WAIT_CTX_get_callback(waitctx, &callback, &callback_arg)
+            || !callback(callback_arg))
+        return 0;
+    ASYNC_pause_job();
+    return 1;
+}
+
+/* Returns 1 if |ring|'s fd is readable, 0 if not, -1 if it has none */
+static int ring_readable(ASYNC_RING *ring)
+{
+#ifdef OPENSSL_SYS_UNIX
+    OSSL_ASYNC_FD fd;
+    struct pollfd pfd;
+
+    if (ASYNC_RING_get_fd(ring, &fd)) {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        return poll(&pfd, 1, 0) == 1;
+    }
+#endif
+    return -1;
+}
+
+#define RING_JOBS       8
+static int test_ASYNC_RING(void)
+{
+    ASYNC_JOB *job[RING_JOBS];
+    ASYNC_WAIT_CTX *waitctx[RING_JOBS];
+    ASYNC_RING *ring = NULL;
+    void *done[RING_JOBS + 1];
+    ASYNC_callback_fn callback;
+    void *callback_arg;
+    int tag[RING_JOBS], seen[RING_JOBS];
+    int i, funcret, ok = 0;
+    size_t n;
+
+    memset(job, 0, sizeof(job));
+    memset(waitctx, 0, sizeof(waitctx));
+    memset(seen, 0, sizeof(seen));
+
+    /* Start with a small ring, so that it has to grow */
+    if (!ASYNC_init_thread(RING_JOBS, 0)
+            || (ring = ASYNC_RING_new(2)) == NULL
+            || ring_readable(ring) == 1)
+        goto err;
+    for (i = 0; i < RING_JOBS; i++) {
+        tag[i] = i;
+        if ((waitctx[i] = ASYNC_WAIT_CTX_new()) == NULL
+                || !ASYNC_WAIT_CTX_set_ring(waitctx[i], ring, &tag[i])
+                || ASYNC_start_job(&job[i], waitctx[i], &funcret,
+                                   complete_via_callback, NULL, 0)
+                   != ASYNC_PAUSE)
+            goto err;
+    }
+    if (ring_readable(ring) == 0)
+        goto err;
+
+    /* Drain in two batches, resuming the jobs that completed */
+    for (n = 0; n < RING_JOBS; ) {
+        size_t got = ASYNC_RING_drain(ring, done, RING_JOBS / 2), j;
+
+        if (got == 0)
+            goto err;
+        for (j = 0; j < got; j++) {
+            i = *(int *)done[j];
+            if (seen[i]++
+                    || ASYNC_start_job(&job[i], waitctx[i], &funcret,
+                                       complete_via_callback, NULL, 0)
+                       != ASYNC_FINISH
+                    || funcret != 1)
+                goto err;
+        }
+        n += got;
+    }
+    if (n != RING_JOBS
+            || ASYNC_RING_drain(ring, done, RING_JOBS + 1) != 0
+            || ring_readable(ring) == 1)
+        goto err;
+
+    /* Detaching the ring removes its callback again */
+    if (!ASYNC_WAIT_CTX_set_ring(waitctx[0], NULL, NULL)
+            || ASYNC_WAIT_CTX_get_callback(waitctx[0], &callback,
+                                           &callback_arg))
+        goto err;
+    ok = 1;
+
+ err:
+    if (!ok)
+        fprintf(stderr, "test_ASYNC_RING() failed\n");
+    for (i = 0; i < RING_JOBS; i++)
+        ASYNC_WAIT_CTX_free(waitctx[i]);
+    ASYNC_RING_free(ring);
+    ASYNC_cleanup_thread();
+    return ok;
+}
+
+#define STACK_USE       (12 * 1024)
+static int use_stack(void *args)
+{
+    unsigned char buf[STACK_USE];
+    char num[32];
+    size_t i;
+
+    for (i = 0; i < sizeof(buf); i++)
+        buf[i] = (unsigned char)i;
+    ASYNC_pause_job();
+    for (i = 0; i < sizeof(buf); i++)
+        if (buf[i] != (unsigned char)i)
+            return 0;
+
+    /* Floating point formatting needs a correctly aligned stack */
+    snprintf(num, sizeof(num), "%.2f", (double)sizeof(buf) / 1024);
+    return strcmp(num, "12.00") == 0;
+}
+
+static int test_ASYNC_set_stack_size(void)
+{
+    ASYNC_JOB *job = NULL;
+    int funcret = 0;
+    ASYNC_WAIT_CTX *waitctx = NULL;
+
+    if (       ASYNC_set_stack_size(1024)
+            || ASYNC_get_stack_size() != 0
+            || !ASYNC_set_stack_size(16 * 1024)
+            || ASYNC_get_stack_size() != 16 * 1024
+            || !ASYNC_init_thread(1, 0)
+            || (waitctx = ASYNC_WAIT_CTX_new()) == NULL
+            || ASYNC_start_job(&job, waitctx, &funcret, use_stack, NULL, 0)
+               != ASYNC_PAUSE
+            || ASYNC_start_job(&job, waitctx, &funcret, use_stack, NULL, 0)
+               != ASYNC_FINISH
+            || funcret != 1) {
+        fprintf(stderr, "test_ASYNC_set_stack_size() failed\n");
+        ASYNC_WAIT_CTX_free(waitctx);
+        ASYNC_cleanup_thread();
+        ASYNC_set_stack_size(0);
+        return 0;
+    }
+
+    ASYNC_WAIT_CTX_free(waitctx);
+    ASYNC_cleanup_thread();
+    return ASYNC_set_stack_size(0);
+}
+
 int main(int argc, char **argv)
 {
     if (!ASYNC_is_capable()) {
@@ -320,7 +475,9 @@ int main(int argc, char **argv)
                 || !test_ASYNC_start_job()
                 || !test_ASYNC_get_current_job()
                 || !test_ASYNC_WAIT_CTX_get_all_fds()
-                || !test_ASYNC_block_pause()) {
+                || !test_ASYNC_block_pause()
+                || !test_ASYNC_set_stack_size()
+                || !test_ASYNC_RING()) {
             return 1;
         }
     }
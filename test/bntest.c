@@ -601,6 +601,75 @@ static int test_modexp_mont5(void)
     return st;
 }
 
+/*
+ * Test BN_mod_exp_mont_consttime_x2() against single exponentiations, for
+ * the sizes that have a two-lane implementation and for one that does not.
+ */
+static int test_modexp_x2(int idx)
+{
+    static const int sizes[] = { 1024, 1536, 2048 };
+    int bits = sizes[idx], i, st = 0;
+    BIGNUM *a1 = NULL, *exp1 = NULL, *m1 = NULL, *r1 = NULL, *e1 = NULL;
+    BIGNUM *a2 = NULL, *exp2 = NULL, *m2 = NULL, *r2 = NULL, *e2 = NULL;
+
+    if (!TEST_ptr(a1 = BN_new())
+            || !TEST_ptr(exp1 = BN_new())
+            || !TEST_ptr(m1 = BN_new())
+            || !TEST_ptr(r1 = BN_new())
+            || !TEST_ptr(e1 = BN_new())
+            || !TEST_ptr(a2 = BN_new())
+            || !TEST_ptr(exp2 = BN_new())
+            || !TEST_ptr(m2 = BN_new())
+            || !TEST_ptr(r2 = BN_new())
+            || !TEST_ptr(e2 = BN_new()))
+        goto err;
+
+    for (i = 0; i < 20; i++) {
+        if (!TEST_true(BN_rand(m1, bits, BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ODD))
+                || !TEST_true(BN_rand(m2, bits, BN_RAND_TOP_ONE,
+                                      BN_RAND_BOTTOM_ODD))
+                || !TEST_true(BN_rand_range(a1, m1))
+                || !TEST_true(BN_rand_range(a2, m2))
+                || !TEST_true(BN_rand(exp1, bits, BN_RAND_TOP_ANY,
+                                      BN_RAND_BOTTOM_ANY))
+                || !TEST_true(BN_rand(exp2, bits, BN_RAND_TOP_ANY,
+                                      BN_RAND_BOTTOM_ANY)))
+            goto err;
+        /* A few edge cases */
+        if (i == 1) {
+            BN_zero(a1);
+            BN_one(exp2);
+        } else if (i == 2) {
+            if (!TEST_true(BN_sub(a1, m1, BN_value_one()))
+                    || !TEST_true(BN_sub(a2, m2, BN_value_one())))
+                goto err;
+            BN_zero(exp2);
+        }
+        if (!TEST_true(BN_mod_exp_mont_consttime_x2(r1, a1, exp1, m1, NULL,
+                                                    r2, a2, exp2, m2, NULL,
+                                                    ctx))
+                || !TEST_true(BN_mod_exp(e1, a1, exp1, m1, ctx))
+                || !TEST_true(BN_mod_exp(e2, a2, exp2, m2, ctx))
+                || !TEST_BN_eq(r1, e1)
+                || !TEST_BN_eq(r2, e2))
+            goto err;
+    }
+    st = 1;
+
+ err:
+    BN_free(a1);
+    BN_free(exp1);
+    BN_free(m1);
+    BN_free(r1);
+    BN_free(e1);
+    BN_free(a2);
+    BN_free(exp2);
+    BN_free(m2);
+    BN_free(r2);
+    BN_free(e2);
+    return st;
+}
+
 #ifndef OPENSSL_NO_EC2M
 static int test_gf2m_add(void)
 {
@@ -2432,6 +2501,76 @@ static int test_ctx_consttime_flag(void)
     return st;
 }
 
+/*
+ * Results computed with a BN_CTX whose temporaries come from an arena must
+ * match a normal BN_CTX, across several resets of the arena.
+ */
+static int test_ctx_arena(void)
+{
+    OSSL_ARENA *arena = NULL;
+    BN_CTX *actx = NULL;
+    BIGNUM *a = NULL, *m = NULL, *r1 = NULL, *r2 = NULL;
+    size_t allocs = 0, blocks = 0, peak = 0;
+    int i, st = 0;
+
+    if (!TEST_ptr(arena = OSSL_ARENA_new(1024))
+            || !TEST_ptr(a = BN_new())
+            || !TEST_ptr(m = BN_new())
+            || !TEST_ptr(r1 = BN_new())
+            || !TEST_ptr(r2 = BN_new()))
+        goto err;
+
+    for (i = 0; i < 4; i++) {
+        if (!TEST_ptr(actx = BN_CTX_new())
+                || !TEST_true(BN_CTX_set0_arena(actx, arena))
+                || !TEST_true(BN_rand(m, 1024, BN_RAND_TOP_ONE,
+                                      BN_RAND_BOTTOM_ODD)))
+            goto err;
+        /* |a| needs an inverse modulo |m| */
+        do {
+            if (!TEST_true(BN_rand(a, 1000, BN_RAND_TOP_ANY,
+                                   BN_RAND_BOTTOM_ANY))
+                    || !TEST_true(BN_gcd(r1, a, m, ctx)))
+                goto err;
+        } while (!BN_is_one(r1));
+        if (!TEST_true(BN_mod_exp(r1, a, a, m, ctx))
+                || !TEST_true(BN_mod_exp(r2, a, a, m, actx))
+                || !TEST_BN_eq(r1, r2)
+                || !TEST_ptr(BN_mod_inverse(r1, a, m, ctx))
+                || !TEST_ptr(BN_mod_inverse(r2, a, m, actx))
+                || !TEST_BN_eq(r1, r2))
+            goto err;
+        BN_CTX_free(actx);
+        actx = NULL;
+        OSSL_ARENA_reset(arena);
+    }
+
+    /* Blocks are reused after a reset */
+    OSSL_ARENA_get_stats(arena, &allocs, &blocks, &peak);
+    if (!TEST_size_t_gt(allocs, 4 * blocks)
+            || !TEST_size_t_gt(peak, 1024))
+        goto err;
+
+    /* An arena can't be attached once the context has been used */
+    if (!TEST_ptr(actx = BN_CTX_new()))
+        goto err;
+    BN_CTX_start(actx);
+    if (!TEST_ptr(BN_CTX_get(actx))
+            || !TEST_false(BN_CTX_set0_arena(actx, arena)))
+        goto err;
+    BN_CTX_end(actx);
+
+    st = 1;
+ err:
+    BN_CTX_free(actx);
+    OSSL_ARENA_free(arena);
+    BN_free(a);
+    BN_free(m);
+    BN_free(r1);
+    BN_free(r2);
+    return st;
+}
+
 static int file_test_run(STANZA *s)
 {
     static const FILETEST filetests[] = {
@@ -2539,6 +2678,7 @@ int setup_tests(void)
         ADD_TEST(test_div_recip);
         ADD_TEST(test_mod);
         ADD_TEST(test_modexp_mont5);
+        ADD_ALL_TESTS(test_modexp_x2, 3);
         ADD_TEST(test_kronecker);
         ADD_TEST(test_rand);
         ADD_TEST(test_bn2padded);
@@ -2554,6 +2694,7 @@ int setup_tests(void)
         ADD_ALL_TESTS(test_smallsafeprime, 16);
         ADD_TEST(test_swap);
         ADD_TEST(test_ctx_consttime_flag);
+        ADD_TEST(test_ctx_arena);
 #ifndef OPENSSL_NO_EC2M
         ADD_TEST(test_gf2m_add);
         ADD_TEST(test_gf2m_mod);
@@ -12,8 +12,10 @@
 #include <openssl/bio.h>
 #include <openssl/crypto.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
 #include <openssl/pem.h>
 #include <openssl/x509.h>
+#include <openssl/x509v3.h>
 
 #include "testutil.h"
 
@@ -371,6 +373,147 @@ static int test_reuse_crl(void)
     return 1;
 }
 
+/*
+ * Re-encode |crl| and decode it again with d2i_X509_CRL_compact().
+ */
+static X509_CRL *compact_CRL(X509_CRL *crl)
+{
+    unsigned char *der = NULL;
+    const unsigned char *p;
+    int len;
+    X509_CRL *ret = NULL;
+
+    if (crl != NULL && (len = i2d_X509_CRL(crl, &der)) > 0) {
+        p = der;
+        ret = d2i_X509_CRL_compact(NULL, &p, len);
+        if (ret != NULL && p != der + len) {
+            X509_CRL_free(ret);
+            ret = NULL;
+        }
+    }
+    OPENSSL_free(der);
+    return ret;
+}
+
+static int test_compact_crl(void)
+{
+    X509_CRL *basic_crl = CRL_from_strings(kBasicCRL);
+    X509_CRL *revoked_crl = CRL_from_strings(kRevokedCRL);
+    X509_CRL *cbasic = compact_CRL(basic_crl);
+    X509_CRL *crevoked = compact_CRL(revoked_crl);
+    unsigned char *der1 = NULL, *der2 = NULL;
+    int r, len1, len2;
+
+    r = TEST_ptr(cbasic)
+        && TEST_ptr(crevoked)
+        && TEST_ptr_null(X509_CRL_get_REVOKED(crevoked))
+        && TEST_int_eq(verify(test_leaf, test_root,
+                              make_CRL_stack(cbasic, NULL),
+                              X509_V_FLAG_CRL_CHECK), X509_V_OK)
+        && TEST_int_eq(verify(test_leaf, test_root,
+                              make_CRL_stack(cbasic, crevoked),
+                              X509_V_FLAG_CRL_CHECK), X509_V_ERR_CERT_REVOKED)
+        && TEST_int_eq(X509_CRL_match(revoked_crl, crevoked), 0);
+
+    /* The original encoding, with all entries, is written out */
+    len1 = i2d_X509_CRL(revoked_crl, &der1);
+    len2 = i2d_X509_CRL(crevoked, &der2);
+    r = r && TEST_mem_eq(der1, len1, der2, len2);
+
+    OPENSSL_free(der1);
+    OPENSSL_free(der2);
+    X509_CRL_free(basic_crl);
+    X509_CRL_free(revoked_crl);
+    X509_CRL_free(cbasic);
+    X509_CRL_free(crevoked);
+    return r;
+}
+
+#define NUM_REVOKED 1000
+
+/*
+ * Serial numbers 1 to NUM_REVOKED are revoked in a scrambled order, and
+ * number 500 is marked as removeFromCRL.
+ */
+static int test_compact_crl_lookup(void)
+{
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    X509_CRL *crl = NULL, *compact = NULL;
+    X509_REVOKED *rev = NULL, *found;
+    ASN1_INTEGER *serial = NULL;
+    ASN1_ENUMERATED *reason = NULL;
+    ASN1_TIME *tm = NULL;
+    int i, ret = 0;
+
+    if (!TEST_ptr(pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL))
+            || !TEST_int_gt(EVP_PKEY_keygen_init(pctx), 0)
+            || !TEST_int_gt(EVP_PKEY_CTX_set_rsa_keygen_bits(pctx, 1024), 0)
+            || !TEST_int_gt(EVP_PKEY_keygen(pctx, &pkey), 0)
+            || !TEST_ptr(crl = X509_CRL_new())
+            || !TEST_ptr(tm = ASN1_TIME_set(NULL, PARAM_TIME))
+            || !TEST_ptr(serial = ASN1_INTEGER_new())
+            || !TEST_ptr(reason = ASN1_ENUMERATED_new())
+            || !TEST_true(X509_CRL_set_version(crl, 1))
+            || !TEST_true(X509_CRL_set_issuer_name(crl,
+                              X509_get_subject_name(test_root)))
+            || !TEST_true(X509_CRL_set1_lastUpdate(crl, tm)))
+        goto err;
+
+    for (i = 0; i < NUM_REVOKED; i++) {
+        long s = (i * 7919L) % NUM_REVOKED + 1;
+
+        if (!TEST_ptr(rev = X509_REVOKED_new())
+                || !TEST_true(ASN1_INTEGER_set(serial, s))
+                || !TEST_true(X509_REVOKED_set_serialNumber(rev, serial))
+                || !TEST_true(X509_REVOKED_set_revocationDate(rev, tm))
+                || !TEST_true(ASN1_ENUMERATED_set(reason,
+                                  s == 500 ? CRL_REASON_REMOVE_FROM_CRL
+                                           : CRL_REASON_KEY_COMPROMISE))
+                || !TEST_int_eq(X509_REVOKED_add1_ext_i2d(rev, NID_crl_reason,
+                                                          reason, 0, 0), 1)
+                || !TEST_true(X509_CRL_add0_revoked(crl, rev)))
+            goto err;
+        rev = NULL;
+    }
+    if (!TEST_int_gt(X509_CRL_sign(crl, pkey, EVP_sha256()), 0)
+            || !TEST_ptr(compact = compact_CRL(crl))
+            || !TEST_int_eq(X509_CRL_verify(compact, pkey), 1))
+        goto err;
+
+    for (i = 0; i <= NUM_REVOKED + 1; i++) {
+        int expect = i == 0 || i > NUM_REVOKED ? 0 : i == 500 ? 2 : 1;
+
+        found = NULL;
+        if (!TEST_true(ASN1_INTEGER_set(serial, i))
+                || !TEST_int_eq(X509_CRL_get0_by_serial(compact, &found,
+                                                        serial), expect))
+            goto err;
+        if (expect == 0)
+            continue;
+        if (!TEST_ptr(found)
+                || !TEST_int_eq(ASN1_INTEGER_cmp(
+                                    X509_REVOKED_get0_serialNumber(found),
+                                    serial), 0)
+                || !TEST_int_eq(ASN1_TIME_compare(
+                                    X509_REVOKED_get0_revocationDate(found),
+                                    tm), 0))
+            goto err;
+    }
+    ret = 1;
+
+ err:
+    X509_REVOKED_free(rev);
+    ASN1_INTEGER_free(serial);
+    ASN1_ENUMERATED_free(reason);
+    ASN1_TIME_free(tm);
+    X509_CRL_free(crl);
+    X509_CRL_free(compact);
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_CTX_free(pctx);
+    return ret;
+}
+
 int setup_tests(void)
 {
     if (!TEST_ptr(test_root = X509_from_strings(kCRLTestRoot))
@@ -383,6 +526,8 @@ int setup_tests(void)
     ADD_TEST(test_known_critical_crl);
     ADD_ALL_TESTS(test_unknown_critical_crl, OSSL_NELEM(unknown_critical_crls));
     ADD_TEST(test_reuse_crl);
+    ADD_TEST(test_compact_crl);
+    ADD_TEST(test_compact_crl_lookup);
     return 1;
 }
 
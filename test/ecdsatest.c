@@ -320,6 +320,89 @@ static int test_builtin(int n)
     OPENSSL_free(sig);
     return ret;
 }
+
+# define BATCH_SIZE 8
+
+/*-
+ * ECDSA_do_verify_batch() on a batch mixing:
+ * - signatures by several keys on the same curve
+ * - a signature by a key on another curve, verified on its own
+ * - a modified digest and a signature by the wrong key, rejected
+ * and checks that each result agrees with ECDSA_do_verify().
+ */
+static int test_verify_batch(int n)
+{
+    EC_KEY *keys[BATCH_SIZE] = { NULL };
+    ECDSA_SIG *sigs[BATCH_SIZE] = { NULL };
+    unsigned char dgst[BATCH_SIZE][32];
+    const unsigned char *dgsts[BATCH_SIZE];
+    int dgst_lens[BATCH_SIZE], res[BATCH_SIZE];
+    int nid, other, i, ret = 0;
+
+    nid = curves[n].nid;
+
+    /* skip built-in curves where ord(G) is not prime */
+    if (nid == NID_ipsec4 || nid == NID_ipsec3) {
+        TEST_info("skipped: ECDSA unsupported for curve %s", OBJ_nid2sn(nid));
+        return 1;
+    }
+    other = nid == NID_X9_62_prime256v1 ? NID_secp384r1 : NID_X9_62_prime256v1;
+
+    for (i = 0; i < BATCH_SIZE; i++) {
+        if (i % 3 == 0 || i == 5) {
+            keys[i] = EC_KEY_new_by_curve_name(i == 5 ? other : nid);
+            if (!TEST_ptr(keys[i])
+                || !TEST_true(EC_KEY_generate_key(keys[i])))
+                goto err;
+        } else {
+            /* Share keys so that the batch has repeated public keys */
+            if (!TEST_true(EC_KEY_up_ref(keys[i - i % 3])))
+                goto err;
+            keys[i] = keys[i - i % 3];
+        }
+        if (!TEST_true(RAND_bytes(dgst[i], sizeof(dgst[i])))
+            || !TEST_ptr(sigs[i] = ECDSA_do_sign(dgst[i], sizeof(dgst[i]),
+                                                 keys[i])))
+            goto err;
+        dgsts[i] = dgst[i];
+        dgst_lens[i] = sizeof(dgst[i]);
+    }
+
+    if (!TEST_int_eq(ECDSA_do_verify_batch(dgsts, dgst_lens,
+                                           (const ECDSA_SIG **)sigs, keys,
+                                           BATCH_SIZE, res), 1))
+        goto err;
+    for (i = 0; i < BATCH_SIZE; i++)
+        if (!TEST_int_eq(res[i], 1))
+            goto err;
+
+    dgst[2][0] ^= 1;
+    /* Signature by keys[0] presented as one by keys[4] */
+    ECDSA_SIG_free(sigs[4]);
+    if (!TEST_ptr(sigs[4] = ECDSA_do_sign(dgst[4], sizeof(dgst[4]), keys[0]))
+        || !TEST_int_eq(ECDSA_do_verify_batch(dgsts, dgst_lens,
+                                              (const ECDSA_SIG **)sigs, keys,
+                                              BATCH_SIZE, res), 0))
+        goto err;
+    for (i = 0; i < BATCH_SIZE; i++)
+        if (!TEST_int_eq(res[i], ECDSA_do_verify(dgsts[i], dgst_lens[i],
+                                                 sigs[i], keys[i]))
+            || !TEST_int_eq(res[i], i != 2 && i != 4))
+            goto err;
+
+    /* An empty batch trivially verifies */
+    if (!TEST_int_eq(ECDSA_do_verify_batch(NULL, NULL, NULL, NULL, 0, NULL),
+                     1))
+        goto err;
+
+    ret = 1;
+ err:
+    for (i = 0; i < BATCH_SIZE; i++) {
+        EC_KEY_free(keys[i]);
+        ECDSA_SIG_free(sigs[i]);
+    }
+    return ret;
+}
 #endif
 
 int setup_tests(void)
@@ -334,6 +417,7 @@ int setup_tests(void)
         return 0;
     ADD_ALL_TESTS(test_builtin, crv_len);
     ADD_ALL_TESTS(x9_62_tests, OSSL_NELEM(ecdsa_cavs_kats));
+    ADD_ALL_TESTS(test_verify_batch, crv_len);
 #endif
     return 1;
 }
@@ -450,6 +450,8 @@ static const EVP_TEST_METHOD digest_test_method = {
 
 typedef struct cipher_data_st {
     const EVP_CIPHER *cipher;
+    /* Provider implementation of an AEAD cipher, if one can be fetched */
+    EVP_CIPHER *fetched_cipher;
     int enc;
     /* EVP_CIPH_GCM_MODE, EVP_CIPH_CCM_MODE or EVP_CIPH_OCB_MODE if AEAD */
     int aead;
@@ -472,16 +474,23 @@ typedef struct cipher_data_st {
 static int cipher_test_init(EVP_TEST *t, const char *alg)
 {
     const EVP_CIPHER *cipher;
+    EVP_CIPHER *fetched = NULL;
     CIPHER_DATA *cdat;
     int m;
 
     if ((cipher = EVP_get_cipherbyname(alg)) == NULL) {
-        /* If alg has an OID assume disabled algorithm */
-        if (OBJ_sn2nid(alg) != NID_undef || OBJ_ln2nid(alg) != NID_undef) {
-            t->skip = 1;
-            return 1;
+        /* Some ciphers are only available from a provider */
+        if ((fetched = EVP_CIPHER_fetch(NULL, alg, NULL)) != NULL) {
+            cipher = fetched;
+        } else {
+            ERR_clear_error();
+            /* If alg has an OID assume disabled algorithm */
+            if (OBJ_sn2nid(alg) != NID_undef || OBJ_ln2nid(alg) != NID_undef) {
+                t->skip = 1;
+                return 1;
+            }
+            return 0;
         }
-        return 0;
     }
     cdat = OPENSSL_zalloc(sizeof(*cdat));
     cdat->cipher = cipher;
@@ -497,6 +506,19 @@ static int cipher_test_init(EVP_TEST *t, const char *alg)
     else
         cdat->aead = 0;
 
+    /*
+     * Run AEAD tests against the provider implementation as well when the
+     * legacy lookup gave us the built-in one.
+     */
+    if (fetched == NULL && cdat->aead != 0
+            && EVP_CIPHER_provider(cipher) == NULL) {
+        fetched = EVP_CIPHER_fetch(NULL, OBJ_nid2sn(EVP_CIPHER_nid(cipher)),
+                                   NULL);
+        if (fetched == NULL)
+            ERR_clear_error();
+    }
+    cdat->fetched_cipher = fetched;
+
     t->data = cdat;
     return 1;
 }
@@ -513,6 +535,7 @@ static void cipher_test_cleanup(EVP_TEST *t)
     for (i = 0; i < AAD_NUM; i++)
         OPENSSL_free(cdat->aad[i]);
     OPENSSL_free(cdat->tag);
+    EVP_CIPHER_meth_free(cdat->fetched_cipher);
 }
 
 static int cipher_test_parse(EVP_TEST *t, const char *keyword,
@@ -664,6 +687,19 @@ static int cipher_test_enc(EVP_TEST *t, int enc,
         goto err;
     }
 
+    /* Carry on with a copy to check that the keyed state is duplicated */
+    if (out_misalign == 1) {
+        EVP_CIPHER_CTX *dup = EVP_CIPHER_CTX_new();
+
+        if (dup == NULL || !EVP_CIPHER_CTX_copy(dup, ctx)) {
+            EVP_CIPHER_CTX_free(dup);
+            t->err = "CIPHER_CTX_COPY_ERROR";
+            goto err;
+        }
+        EVP_CIPHER_CTX_free(ctx);
+        ctx = dup;
+    }
+
     if (expected->aead == EVP_CIPH_CCM_MODE) {
         if (!EVP_CipherUpdate(ctx, NULL, &tmplen, NULL, out_len)) {
             t->err = "CCM_PLAINTEXT_LENGTH_SET_ERROR";
@@ -774,27 +810,93 @@ static int cipher_test_enc(EVP_TEST *t, int enc,
     return ok;
 }
 
-static int cipher_test_run(EVP_TEST *t)
+/*
+ * Check the single-call AEAD interface against the same vector. Returns 1
+ * on success, 0 on a test failure (with t->err set).
+ */
+static int cipher_test_aead_oneshot(EVP_TEST *t)
 {
-    CIPHER_DATA *cdat = t->data;
-    int rv, frag = 0;
-    size_t out_misalign, inp_misalign;
+    CIPHER_DATA *expected = t->data;
+    EVP_CIPHER_CTX *ctx = NULL;
+    unsigned char *aad = NULL, *out = NULL, *p;
+    unsigned char rtag[16];
+    size_t aadlen = 0, outlen;
+    int i, ok = 0;
+
+    /* The legacy SIV mode treats the AAD pieces as a vector */
+    if (EVP_CIPHER_mode(expected->cipher) == EVP_CIPH_SIV_MODE
+            && EVP_CIPHER_provider(expected->cipher) == NULL)
+        return 1;
+    if (expected->tag_len > sizeof(rtag))
+        return 1;
 
-    if (!cdat->key) {
-        t->err = "NO_KEY";
-        return 0;
-    }
-    if (!cdat->iv && EVP_CIPHER_iv_length(cdat->cipher)) {
-        /* IV is optional and usually omitted in wrap mode */
-        if (EVP_CIPHER_mode(cdat->cipher) != EVP_CIPH_WRAP_MODE) {
-            t->err = "NO_IV";
-            return 0;
+    t->err = "TEST_FAILURE";
+    for (i = 0; expected->aad[i] != NULL; i++)
+        aadlen += expected->aad_len[i];
+    outlen = expected->plaintext_len > expected->ciphertext_len
+             ? expected->plaintext_len : expected->ciphertext_len;
+    if (!TEST_ptr(aad = OPENSSL_malloc(aadlen + 1))
+            || !TEST_ptr(out = OPENSSL_malloc(outlen + 1))
+            || !TEST_ptr(ctx = EVP_CIPHER_CTX_new()))
+        goto err;
+    for (p = aad, i = 0; expected->aad[i] != NULL; i++) {
+        memcpy(p, expected->aad[i], expected->aad_len[i]);
+        p += expected->aad_len[i];
+    }
+
+    if (expected->enc) {
+        if (!EVP_EncryptInit_ex(ctx, expected->cipher, NULL, NULL, NULL)
+                || !EVP_CIPHER_CTX_set_key_length(ctx, expected->key_len)
+                || !EVP_CIPHER_CTX_aead_seal(ctx, expected->key,
+                                             expected->iv, expected->iv_len,
+                                             aad, aadlen, out,
+                                             expected->plaintext,
+                                             expected->plaintext_len,
+                                             rtag, expected->tag_len)) {
+            t->err = "AEAD_SEAL_ERROR";
+            goto err;
         }
+        if (!memory_err_compare(t, "AEAD_SEAL_VALUE_MISMATCH",
+                                expected->ciphertext, expected->ciphertext_len,
+                                out, expected->plaintext_len)
+                || !memory_err_compare(t, "AEAD_SEAL_TAG_MISMATCH",
+                                       expected->tag, expected->tag_len,
+                                       rtag, expected->tag_len))
+            goto err;
     }
-    if (cdat->aead && !cdat->tag) {
-        t->err = "NO_TAG";
-        return 0;
+    if (expected->enc != 1) {
+        if (!EVP_DecryptInit_ex(ctx, expected->cipher, NULL, NULL, NULL)
+                || !EVP_CIPHER_CTX_set_key_length(ctx, expected->key_len)
+                || !EVP_CIPHER_CTX_aead_open(ctx, expected->key,
+                                             expected->iv, expected->iv_len,
+                                             aad, aadlen, out,
+                                             expected->ciphertext,
+                                             expected->ciphertext_len,
+                                             expected->tag,
+                                             expected->tag_len)) {
+            t->err = "AEAD_OPEN_ERROR";
+            goto err;
+        }
+        if (!memory_err_compare(t, "AEAD_OPEN_VALUE_MISMATCH",
+                                expected->plaintext, expected->plaintext_len,
+                                out, expected->ciphertext_len))
+            goto err;
     }
+    t->err = NULL;
+    ok = 1;
+ err:
+    OPENSSL_free(aad);
+    OPENSSL_free(out);
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+static int cipher_test_run_one(EVP_TEST *t)
+{
+    CIPHER_DATA *cdat = t->data;
+    int rv, frag = 0;
+    size_t out_misalign, inp_misalign;
+
     for (out_misalign = 0; out_misalign <= 1;) {
         static char aux_err[64];
         t->aux_err = aux_err;
@@ -850,9 +952,44 @@ static int cipher_test_run(EVP_TEST *t)
     }
     t->aux_err = NULL;
 
+    if (cdat->aead != 0)
+        cipher_test_aead_oneshot(t);
+
     return 1;
 }
 
+static int cipher_test_run(EVP_TEST *t)
+{
+    CIPHER_DATA *cdat = t->data;
+    const EVP_CIPHER *cipher = cdat->cipher;
+    int rv;
+
+    if (!cdat->key) {
+        t->err = "NO_KEY";
+        return 0;
+    }
+    if (!cdat->iv && EVP_CIPHER_iv_length(cdat->cipher)) {
+        /* IV is optional and usually omitted in wrap mode */
+        if (EVP_CIPHER_mode(cdat->cipher) != EVP_CIPH_WRAP_MODE) {
+            t->err = "NO_IV";
+            return 0;
+        }
+    }
+    if (cdat->aead && !cdat->tag) {
+        t->err = "NO_TAG";
+        return 0;
+    }
+    rv = cipher_test_run_one(t);
+    if (rv != 1 || t->err != NULL || cdat->fetched_cipher == NULL
+            || cdat->fetched_cipher == cipher)
+        return rv;
+
+    cdat->cipher = cdat->fetched_cipher;
+    rv = cipher_test_run_one(t);
+    cdat->cipher = cipher;
+    return rv;
+}
+
 static const EVP_TEST_METHOD cipher_test_method = {
     "Cipher",
     cipher_test_init,
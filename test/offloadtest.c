@@ -0,0 +1,270 @@
+/*
+ * Copyright 2019 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <openssl/opensslconf.h>
+#include <openssl/async.h>
+#include <openssl/engine.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include "testutil.h"
+
+#if !defined(OPENSSL_NO_ENGINE) && defined(OPENSSL_SYS_UNIX) \
+    && defined(OPENSSL_THREADS)
+# include <poll.h>
+
+/* Many jobs, so that the workers get to batch their requests */
+# define NUM_JOBS        16
+
+static ENGINE *e;
+static RSA *rsa;
+static EC_KEY *eckey;
+
+typedef struct {
+    int type;
+    int pauses;
+} JOB_ARGS;
+
+static const unsigned char dgst[32] = "a digest of exactly 32 bytes...";
+
+static int job_rsa(void)
+{
+    unsigned char sig[256];
+    unsigned int siglen;
+
+    return RSA_size(rsa) <= (int)sizeof(sig)
+           && RSA_sign(NID_sha256, dgst, sizeof(dgst), sig, &siglen, rsa)
+           && RSA_verify(NID_sha256, dgst, sizeof(dgst), sig, siglen, rsa)
+              == 1;
+}
+
+static int job_ecdsa(void)
+{
+    ECDSA_SIG *sig;
+    unsigned char bad[sizeof(dgst)];
+    int ret;
+
+    memcpy(bad, dgst, sizeof(dgst));
+    bad[0] ^= 1;
+    if ((sig = ECDSA_do_sign(dgst, sizeof(dgst), eckey)) == NULL)
+        return 0;
+    ret = ECDSA_do_verify(dgst, sizeof(dgst), sig, eckey) == 1
+          && ECDSA_do_verify(bad, sizeof(bad), sig, eckey) == 0;
+    ECDSA_SIG_free(sig);
+    return ret;
+}
+
+static int job_gcm(void)
+{
+    static const unsigned char key[32] = { 0 }, iv[12] = { 0 };
+    unsigned char in[100], ct[100], pt[100], tag[16];
+    EVP_CIPHER_CTX *ctx;
+    int len, ret = 0;
+
+    memset(in, 'x', sizeof(in));
+    if ((ctx = EVP_CIPHER_CTX_new()) == NULL
+            || !EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), e, key, iv)
+            || !EVP_EncryptUpdate(ctx, NULL, &len, dgst, sizeof(dgst))
+            || !EVP_EncryptUpdate(ctx, ct, &len, in, sizeof(in))
+            || len != sizeof(in)
+            || !EVP_EncryptFinal_ex(ctx, ct + len, &len)
+            || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, sizeof(tag),
+                                    tag)
+            || !EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), e, key, iv)
+            || !EVP_DecryptUpdate(ctx, NULL, &len, dgst, sizeof(dgst))
+            || !EVP_DecryptUpdate(ctx, pt, &len, ct, sizeof(ct))
+            || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, sizeof(tag),
+                                    tag)
+            || !EVP_DecryptFinal_ex(ctx, pt + len, &len))
+        goto err;
+    ret = memcmp(in, pt, sizeof(in)) == 0;
+ err:
+    EVP_CIPHER_CTX_free(ctx);
+    return ret;
+}
+
+static int offload_job(void *arg)
+{
+    switch (((JOB_ARGS *)arg)->type) {
+    case 0:
+        return job_rsa();
+    case 1:
+        return job_ecdsa();
+    default:
+        return job_gcm();
+    }
+}
+
+static int start_job(ASYNC_JOB **job, ASYNC_WAIT_CTX *waitctx, int *ret,
+                     JOB_ARGS *args, int *finished)
+{
+    switch (ASYNC_start_job(job, waitctx, ret, offload_job, args,
+                            sizeof(*args))) {
+    case ASYNC_PAUSE:
+        args->pauses++;
+        return 1;
+    case ASYNC_FINISH:
+        *finished = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Runs NUM_JOBS jobs of the given |type| and waits for them either on their
+ * wait fds or on a completion ring.  Every job must have been paused while
+ * the engine worked on its requests.
+ */
+static int test_offload(int idx)
+{
+    ASYNC_JOB *job[NUM_JOBS];
+    ASYNC_WAIT_CTX *waitctx[NUM_JOBS];
+    ASYNC_RING *ring = NULL;
+    JOB_ARGS args[NUM_JOBS];
+    struct pollfd pfd[NUM_JOBS];
+    OSSL_ASYNC_FD fd;
+    int finished[NUM_JOBS], ret[NUM_JOBS], tag[NUM_JOBS], which[NUM_JOBS];
+    void *ready[NUM_JOBS];
+    int use_ring = idx >= 3, i, n, left = NUM_JOBS, testresult = 0;
+    size_t numfds, j, got;
+
+    memset(job, 0, sizeof(job));
+    memset(waitctx, 0, sizeof(waitctx));
+    memset(finished, 0, sizeof(finished));
+    memset(ret, 0, sizeof(ret));
+
+    if (use_ring
+            && (!TEST_ptr(ring = ASYNC_RING_new(0))
+                || !TEST_true(ASYNC_RING_get_fd(ring, &fd))))
+        goto err;
+    for (i = 0; i < NUM_JOBS; i++) {
+        args[i].type = idx % 3;
+        args[i].pauses = 0;
+        tag[i] = i;
+        if (!TEST_ptr(waitctx[i] = ASYNC_WAIT_CTX_new())
+                || (use_ring
+                    && !TEST_true(ASYNC_WAIT_CTX_set_ring(waitctx[i], ring,
+                                                          &tag[i])))
+                || !TEST_true(start_job(&job[i], waitctx[i], &ret[i],
+                                        &args[i], &finished[i])))
+            goto err;
+        left -= finished[i];
+    }
+
+    while (left > 0) {
+        if (use_ring) {
+            pfd[0].fd = fd;
+            pfd[0].events = POLLIN;
+            if (!TEST_int_eq(poll(pfd, 1, 10000), 1))
+                goto err;
+            got = ASYNC_RING_drain(ring, ready, NUM_JOBS);
+            for (j = 0; j < got; j++)
+                which[j] = *(int *)ready[j];
+            n = (int)got;
+        } else {
+            for (i = n = 0; i < NUM_JOBS; i++) {
+                if (finished[i])
+                    continue;
+                if (!TEST_true(ASYNC_WAIT_CTX_get_all_fds(waitctx[i], NULL,
+                                                          &numfds))
+                        || !TEST_size_t_eq(numfds, 1))
+                    goto err;
+                ASYNC_WAIT_CTX_get_all_fds(waitctx[i], &pfd[n].fd, &numfds);
+                pfd[n].events = POLLIN;
+                pfd[n].revents = 0;
+                which[n++] = i;
+            }
+            if (!TEST_int_gt(poll(pfd, n, 10000), 0))
+                goto err;
+            for (i = j = 0; i < n; i++)
+                if (pfd[i].revents != 0)
+                    which[j++] = which[i];
+            n = (int)j;
+        }
+        for (i = 0; i < n; i++) {
+            if (!TEST_false(finished[which[i]])
+                    || !TEST_true(start_job(&job[which[i]], waitctx[which[i]],
+                                            &ret[which[i]], &args[which[i]],
+                                            &finished[which[i]])))
+                goto err;
+            left -= finished[which[i]];
+        }
+    }
+
+    for (i = 0; i < NUM_JOBS; i++)
+        if (!TEST_int_eq(ret[i], 1) || !TEST_int_gt(args[i].pauses, 0))
+            goto err;
+    testresult = 1;
+ err:
+    for (i = 0; i < NUM_JOBS; i++)
+        ASYNC_WAIT_CTX_free(waitctx[i]);
+    ASYNC_RING_free(ring);
+    return testresult;
+}
+#endif
+
+int setup_tests(void)
+{
+#if !defined(OPENSSL_NO_ENGINE) && defined(OPENSSL_SYS_UNIX) \
+    && defined(OPENSSL_THREADS)
+    BIGNUM *bn = NULL;
+    EC_GROUP *group = NULL;
+    int ok;
+
+    if (!ASYNC_is_capable()) {
+        TEST_info("Async not supported, skipping offload tests");
+        return 1;
+    }
+    ENGINE_load_builtin_engines();
+    if ((e = ENGINE_by_id("offload")) == NULL) {
+        /* Probably a platform env issue, not a test failure. */
+        TEST_info("Can't load offload engine");
+        return 1;
+    }
+
+    if (!TEST_true(ENGINE_init(e))) {
+        ENGINE_free(e);
+        e = NULL;
+        return 0;
+    }
+    ok = TEST_ptr(rsa = RSA_new_method(e))
+         && TEST_ptr(bn = BN_new())
+         && TEST_true(BN_set_word(bn, RSA_F4))
+         && TEST_true(RSA_generate_key_ex(rsa, 1024, bn, NULL))
+         && TEST_ptr(eckey = EC_KEY_new_method(e))
+         && TEST_ptr(group =
+                     EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1))
+         && TEST_true(EC_KEY_set_group(eckey, group))
+         && TEST_true(EC_KEY_generate_key(eckey));
+    BN_free(bn);
+    EC_GROUP_free(group);
+    if (!ok)
+        return 0;
+
+    ADD_ALL_TESTS(test_offload, 6);
+#endif
+    return 1;
+}
+
+#if !defined(OPENSSL_NO_ENGINE) && defined(OPENSSL_SYS_UNIX) \
+    && defined(OPENSSL_THREADS)
+void cleanup_tests(void)
+{
+    RSA_free(rsa);
+    EC_KEY_free(eckey);
+    if (e != NULL) {
+        ENGINE_finish(e);
+        ENGINE_free(e);
+    }
+    ASYNC_cleanup_thread();
+}
+#endif
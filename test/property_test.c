@@ -369,6 +369,57 @@ err:
     return res;
 }
 
+static int test_query_cache_invalidate(void)
+{
+    OSSL_METHOD_STORE *store;
+    void *result = NULL;
+    int res = 0;
+
+    if (!TEST_ptr(store = ossl_method_store_new(NULL))
+        || !add_property_names("n", NULL)
+        || !TEST_true(ossl_method_store_add(store, 1, "n=1", "abc", NULL))
+        || !TEST_true(ossl_method_store_cache_set(store, 1, "n=1", "first")))
+        goto err;
+
+    /* The second lookup is answered from the per thread cache, if any */
+    if (!TEST_true(ossl_method_store_cache_get(store, 1, "n=1", &result))
+        || !TEST_str_eq(result, "first")
+        || !TEST_true(ossl_method_store_cache_get(store, 1, "n=1", &result))
+        || !TEST_str_eq(result, "first"))
+        goto err;
+
+    /* Replacing an entry must be seen straight away */
+    if (!TEST_true(ossl_method_store_cache_set(store, 1, "n=1", "second"))
+        || !TEST_true(ossl_method_store_cache_get(store, 1, "n=1", &result))
+        || !TEST_str_eq(result, "second"))
+        goto err;
+
+    /* As must removing it */
+    if (!TEST_true(ossl_method_store_cache_set(store, 1, "n=1", NULL))
+        || !TEST_false(ossl_method_store_cache_get(store, 1, "n=1", &result)))
+        goto err;
+
+    /* Adding an implementation flushes the cache for that algorithm */
+    if (!TEST_true(ossl_method_store_cache_set(store, 1, "n=1", "third"))
+        || !TEST_true(ossl_method_store_cache_get(store, 1, "n=1", &result))
+        || !TEST_true(ossl_method_store_add(store, 1, "n=2", "def", NULL))
+        || !TEST_false(ossl_method_store_cache_get(store, 1, "n=1", &result)))
+        goto err;
+
+    /* And so does changing the global properties */
+    if (!TEST_true(ossl_method_store_cache_set(store, 1, "", "fourth"))
+        || !TEST_true(ossl_method_store_cache_get(store, 1, NULL, &result))
+        || !TEST_str_eq(result, "fourth")
+        || !TEST_true(ossl_method_store_set_global_properties(store, "n=2"))
+        || !TEST_false(ossl_method_store_cache_get(store, 1, NULL, &result)))
+        goto err;
+    res = 1;
+
+err:
+    ossl_method_store_free(store);
+    return res;
+}
+
 int setup_tests(void)
 {
     ADD_TEST(test_property_string);
@@ -379,5 +430,6 @@ int setup_tests(void)
     ADD_TEST(test_register_deregister);
     ADD_TEST(test_property);
     ADD_TEST(test_query_cache_stochastic);
+    ADD_TEST(test_query_cache_invalidate);
     return 1;
 }
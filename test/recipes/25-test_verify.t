@@ -27,7 +27,7 @@ sub verify {
     run(app([@args]));
 }
 
-plan tests => 137;
+plan tests => 140;
 
 # Canonical success
 ok(verify("ee-cert", "sslserver", ["root-cert"], ["ca-cert"]),
@@ -385,3 +385,15 @@ SKIP: {
              "31323334353637383132333435363738"),
        "SM2 hex ID test");
 }
+
+# Trust anchors from an indexed bundle, both roots have the same subject
+ok(run(app(["openssl", "cabundle", "-out", "roots.idx",
+            srctop_file(qw(test certs root-cert2.pem)),
+            srctop_file(qw(test certs root-cert.pem))])),
+   "create CA bundle");
+ok(verify("ee-cert", "sslserver", [], ["ca-cert"], "-no-CAfile", "-no-CApath",
+          "-CAbundle", "roots.idx"),
+   "accept trust anchor from CA bundle");
+ok(!verify("ee-cert", "sslserver", [], ["ca-cert"], "-no-CAfile", "-no-CApath",
+           "-CAbundle", srctop_file(qw(test certs root-cert.pem))),
+   "fail PEM file as CA bundle");
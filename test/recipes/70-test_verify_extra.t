@@ -7,14 +7,23 @@
 # https://www.openssl.org/source/license.html
 
 
+use File::Path qw/rmtree mkpath/;
 use OpenSSL::Test qw/:DEFAULT srctop_file/;
 
 setup("test_verify_extra");
 
 plan tests => 1;
 
+# An empty directory for the hashed directory lookup tests
+my $dir = "verify_extra_dir";
+rmtree($dir);
+mkpath($dir);
+
 ok(run(test(["verify_extra_test",
              srctop_file("test", "certs", "roots.pem"),
              srctop_file("test", "certs", "untrusted.pem"),
              srctop_file("test", "certs", "bad.pem"),
-             srctop_file("test", "certs", "sm2-csr.pem")])));
+             srctop_file("test", "certs", "sm2-csr.pem"),
+             $dir])));
+
+rmtree($dir);
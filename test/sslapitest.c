@@ -775,7 +775,7 @@ static int ping_pong_query(SSL *clientssl, SSL *serverssl, int cfd, int sfd)
         goto end;
 
     /* ktls is used then kernel sequences are used instead of OpenSSL sequences */
-    if (clientssl->mode & SSL_MODE_NO_KTLS_TX) {
+    if (!BIO_get_ktls_send(clientssl->wbio)) {
         if (!TEST_mem_ne(crec_wseq_before, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE,
                          crec_wseq_after, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE))
             goto end;
@@ -785,7 +785,7 @@ static int ping_pong_query(SSL *clientssl, SSL *serverssl, int cfd, int sfd)
             goto end;
     }
 
-    if (serverssl->mode & SSL_MODE_NO_KTLS_TX) {
+    if (!BIO_get_ktls_send(serverssl->wbio)) {
         if (!TEST_mem_ne(srec_wseq_before, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE,
                          srec_wseq_after, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE))
             goto end;
@@ -795,7 +795,7 @@ static int ping_pong_query(SSL *clientssl, SSL *serverssl, int cfd, int sfd)
             goto end;
     }
 
-    if (clientssl->mode & SSL_MODE_NO_KTLS_RX) {
+    if (!BIO_get_ktls_recv(clientssl->rbio)) {
         if (!TEST_mem_ne(crec_rseq_before, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE,
                          crec_rseq_after, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE))
             goto end;
@@ -805,7 +805,7 @@ static int ping_pong_query(SSL *clientssl, SSL *serverssl, int cfd, int sfd)
             goto end;
     }
 
-    if (serverssl->mode & SSL_MODE_NO_KTLS_RX) {
+    if (!BIO_get_ktls_recv(serverssl->rbio)) {
         if (!TEST_mem_ne(srec_rseq_before, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE,
                          srec_rseq_after, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE))
             goto end;
@@ -821,7 +821,8 @@ end:
 }
 
 static int execute_test_ktls(int cis_ktls_tx, int cis_ktls_rx,
-                             int sis_ktls_tx, int sis_ktls_rx)
+                             int sis_ktls_tx, int sis_ktls_rx,
+                             int tlsver, int key_update)
 {
     SSL_CTX *cctx = NULL, *sctx = NULL;
     SSL *clientssl = NULL, *serverssl = NULL;
@@ -838,12 +839,21 @@ static int execute_test_ktls(int cis_ktls_tx, int cis_ktls_rx,
     /* Create a session based on SHA-256 */
     if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
                                        TLS_client_method(),
-                                       TLS1_2_VERSION, TLS1_2_VERSION,
-                                       &sctx, &cctx, cert, privkey))
-            || !TEST_true(SSL_CTX_set_cipher_list(cctx,
-                                                  "AES128-GCM-SHA256"))
-            || !TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
-                                          &clientssl, sfd, cfd)))
+                                       tlsver, tlsver,
+                                       &sctx, &cctx, cert, privkey)))
+        goto end;
+
+    if (tlsver == TLS1_3_VERSION) {
+        if (!TEST_true(SSL_CTX_set_ciphersuites(cctx,
+                                                "TLS_AES_128_GCM_SHA256")))
+            goto end;
+    } else {
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx, "AES128-GCM-SHA256")))
+            goto end;
+    }
+
+    if (!TEST_true(create_ssl_objects2(sctx, cctx, &serverssl,
+                                       &clientssl, sfd, cfd)))
         goto end;
 
     if (!cis_ktls_tx) {
@@ -870,6 +880,13 @@ static int execute_test_ktls(int cis_ktls_tx, int cis_ktls_rx,
                                                 SSL_ERROR_NONE)))
         goto end;
 
+    /*
+     * TLSv1.3 is only offloaded if the kernel can follow a KeyUpdate,
+     * otherwise the connection must carry on in user space
+     */
+    if (tlsver == TLS1_3_VERSION && !ktls_rekey_probe())
+        cis_ktls_tx = cis_ktls_rx = sis_ktls_tx = sis_ktls_rx = 0;
+
     if (!cis_ktls_tx) {
         if (!TEST_false(BIO_get_ktls_send(clientssl->wbio)))
             goto end;
@@ -905,6 +922,17 @@ static int execute_test_ktls(int cis_ktls_tx, int cis_ktls_rx,
     if (!TEST_true(ping_pong_query(clientssl, serverssl, cfd, sfd)))
         goto end;
 
+    /*
+     * Both peers rekey: the client's KeyUpdate requests one back from the
+     * server, and every offloaded direction has to follow in the kernel.
+     */
+    if (key_update) {
+        if (!TEST_true(SSL_key_update(clientssl, SSL_KEY_UPDATE_REQUESTED))
+                || !TEST_true(ping_pong_query(clientssl, serverssl, cfd, sfd))
+                || !TEST_true(ping_pong_query(clientssl, serverssl, cfd, sfd)))
+            goto end;
+    }
+
     testresult = 1;
 end:
     if (clientssl) {
@@ -1028,82 +1056,172 @@ end:
 
 static int test_ktls_no_txrx_client_no_txrx_server(void)
 {
-    return execute_test_ktls(0, 0, 0, 0);
+    return execute_test_ktls(0, 0, 0, 0, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_rx_client_no_txrx_server(void)
 {
-    return execute_test_ktls(1, 0, 0, 0);
+    return execute_test_ktls(1, 0, 0, 0, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_tx_client_no_txrx_server(void)
 {
-    return execute_test_ktls(0, 1, 0, 0);
+    return execute_test_ktls(0, 1, 0, 0, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_client_no_txrx_server(void)
 {
-    return execute_test_ktls(1, 1, 0, 0);
+    return execute_test_ktls(1, 1, 0, 0, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_txrx_client_no_rx_server(void)
 {
-    return execute_test_ktls(0, 0, 1, 0);
+    return execute_test_ktls(0, 0, 1, 0, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_rx_client_no_rx_server(void)
 {
-    return execute_test_ktls(1, 0, 1, 0);
+    return execute_test_ktls(1, 0, 1, 0, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_tx_client_no_rx_server(void)
 {
-    return execute_test_ktls(0, 1, 1, 0);
+    return execute_test_ktls(0, 1, 1, 0, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_client_no_rx_server(void)
 {
-    return execute_test_ktls(1, 1, 1, 0);
+    return execute_test_ktls(1, 1, 1, 0, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_txrx_client_no_tx_server(void)
 {
-    return execute_test_ktls(0, 0, 0, 1);
+    return execute_test_ktls(0, 0, 0, 1, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_rx_client_no_tx_server(void)
 {
-    return execute_test_ktls(1, 0, 0, 1);
+    return execute_test_ktls(1, 0, 0, 1, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_tx_client_no_tx_server(void)
 {
-    return execute_test_ktls(0, 1, 0, 1);
+    return execute_test_ktls(0, 1, 0, 1, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_client_no_tx_server(void)
 {
-    return execute_test_ktls(1, 1, 0, 1);
+    return execute_test_ktls(1, 1, 0, 1, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_txrx_client_server(void)
 {
-    return execute_test_ktls(0, 0, 1, 1);
+    return execute_test_ktls(0, 0, 1, 1, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_rx_client_server(void)
 {
-    return execute_test_ktls(1, 0, 1, 1);
+    return execute_test_ktls(1, 0, 1, 1, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_no_tx_client_server(void)
 {
-    return execute_test_ktls(0, 1, 1, 1);
+    return execute_test_ktls(0, 1, 1, 1, TLS1_2_VERSION, 0);
 }
 
 static int test_ktls_client_server(void)
 {
-    return execute_test_ktls(1, 1, 1, 1);
+    return execute_test_ktls(1, 1, 1, 1, TLS1_2_VERSION, 0);
+}
+
+# ifndef OPENSSL_NO_TLS1_3
+/*
+ * Test TLSv1.3 offload with every combination of kernel TX and RX on the
+ * client and server. Bit 0 of |idx| is client TX, bit 1 client RX, bit 2
+ * server TX and bit 3 server RX. With bit 4 both peers also update their
+ * keys, on kernels that can't rekey without any offload.
+ */
+static int test_ktls_tls13(int idx)
+{
+    return execute_test_ktls(idx & 1, (idx >> 1) & 1, (idx >> 2) & 1,
+                             (idx >> 3) & 1, TLS1_3_VERSION, (idx >> 4) & 1);
+}
+# endif
+#endif
+
+#if !defined(OPENSSL_SYS_WINDOWS) && !defined(OPENSSL_SYS_VMS)
+/*
+ * Without kernel TLS SSL_sendfile() falls back to reading the file and
+ * writing it through the record layer, so it works over any BIO.
+ */
+static int test_sendfile_buffered(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    unsigned char *buf = NULL, *buf_dst = NULL;
+    const size_t bufsz = 3 * 16384 + 1000;
+    const off_t offset = 1000;
+    BIO *out = NULL, *in = NULL;
+    FILE *ffdp = NULL;
+    size_t readbytes, total = 0;
+    int testresult = 0;
+
+    buf = OPENSSL_malloc(bufsz);
+    buf_dst = OPENSSL_zalloc(bufsz);
+    if (!TEST_ptr(buf) || !TEST_ptr(buf_dst)
+            || !TEST_int_gt(RAND_bytes(buf, bufsz), 0))
+        goto end;
+
+    out = BIO_new_file(tmpfilename, "wb");
+    if (!TEST_ptr(out)
+            || !TEST_int_eq(BIO_write(out, buf, bufsz), (int)bufsz))
+        goto end;
+    BIO_free(out);
+    out = NULL;
+
+    in = BIO_new_file(tmpfilename, "rb");
+    if (!TEST_ptr(in)
+            || !TEST_int_gt(BIO_get_fp(in, &ffdp), 0)
+            || !TEST_ptr(ffdp))
+        goto end;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_false(BIO_get_ktls_send(SSL_get_wbio(serverssl))))
+        goto end;
+
+    /* Ask for more than the file holds: we should get up to end of file */
+    if (!TEST_int_eq((int)SSL_sendfile(serverssl, fileno(ffdp), offset,
+                                       bufsz, 0),
+                     (int)(bufsz - offset)))
+        goto end;
+
+    while (total < bufsz - offset) {
+        if (!TEST_true(SSL_read_ex(clientssl, buf_dst + total,
+                                   bufsz - total, &readbytes)))
+            goto end;
+        total += readbytes;
+    }
+    if (!TEST_mem_eq(buf_dst, total, buf + offset, bufsz - offset))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    BIO_free(out);
+    BIO_free(in);
+    OPENSSL_free(buf);
+    OPENSSL_free(buf_dst);
+    return testresult;
 }
 #endif
 
@@ -1132,6 +1250,66 @@ static int test_large_message_dtls(void)
 }
 #endif
 
+/*
+ * Test that record buffers released by one connection are reused by the next
+ * one through the SSL_CTX buffer pool.
+ */
+static int test_buffer_pool(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    const char msg[] = "buffer pool";
+    char buf[sizeof(msg)];
+    size_t written, readbytes;
+    int i, testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_long_eq(SSL_CTX_get_buffer_pool_max(cctx),
+                             SSL_BUFFER_POOL_MAX_DEFAULT)
+            || !TEST_long_eq(SSL_CTX_buffer_pool_cached(cctx), 0))
+        goto end;
+    SSL_CTX_set_mode(cctx, SSL_MODE_RELEASE_BUFFERS);
+
+    for (i = 0; i < 2; i++) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_true(SSL_write_ex(clientssl, msg, sizeof(msg),
+                                           &written))
+                || !TEST_true(SSL_read_ex(serverssl, buf, sizeof(buf),
+                                          &readbytes))
+                || !TEST_mem_eq(buf, readbytes, msg, sizeof(msg)))
+            goto end;
+
+        /* Idle buffers of the client are back in the pool */
+        if (!TEST_long_gt(SSL_CTX_buffer_pool_cached(cctx), 0))
+            goto end;
+
+        shutdown_ssl_connection(serverssl, clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    if (!TEST_long_gt(SSL_CTX_buffer_pool_hits(cctx), 0)
+            || !TEST_long_gt(SSL_CTX_buffer_pool_misses(cctx), 0)
+            || !TEST_long_eq(SSL_CTX_set_buffer_pool_max(cctx, 0),
+                             SSL_BUFFER_POOL_MAX_DEFAULT)
+            || !TEST_long_eq(SSL_CTX_buffer_pool_cached(cctx), 0))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
 #ifndef OPENSSL_NO_OCSP
 static int ocsp_server_cb(SSL *s, void *arg)
 {
@@ -1623,6 +1801,119 @@ static int execute_test_session(int maxprot, int use_int_cache,
 }
 #endif /* !defined(OPENSSL_NO_TLS1_3) || !defined(OPENSSL_NO_TLS1_2) */
 
+#ifndef OPENSSL_NO_TLS1_2
+/*
+ * Test the sharded server side session cache: sessions must be resumable,
+ * every shard must respect its share of the cache size and the per shard
+ * counters must add up.
+ */
+static int test_session_cache_sharded(void)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    SSL_SESSION *sess = NULL, *extra = NULL;
+    unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+    long shards, i, hits = 0, number = 0, evictions = 0;
+    int testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(), TLS_client_method(),
+                                       TLS1_VERSION, TLS1_2_VERSION,
+                                       &sctx, &cctx, cert, privkey)))
+        return 0;
+
+    SSL_CTX_set_options(sctx, SSL_OP_NO_TICKET);
+    SSL_CTX_sess_set_cache_size(sctx, 8);
+    if (!TEST_long_eq(SSL_CTX_sess_set_cache_shards(sctx, 4),
+                      SSL_SESSION_CACHE_SHARDS_DEFAULT))
+        goto end;
+    /* Sharding can be switched on and off before the cache is used */
+    SSL_CTX_set_session_cache_mode(sctx, SSL_SESS_CACHE_SERVER
+                                         | SSL_SESS_CACHE_SHARDED);
+    SSL_CTX_set_session_cache_mode(sctx, SSL_SESS_CACHE_SERVER);
+    if (!TEST_long_eq(SSL_CTX_get_session_cache_mode(sctx),
+                      SSL_SESS_CACHE_SERVER))
+        goto end;
+    SSL_CTX_set_session_cache_mode(sctx, SSL_SESS_CACHE_SERVER
+                                         | SSL_SESS_CACHE_SHARDED);
+    if (!TEST_long_eq(SSL_CTX_get_session_cache_mode(sctx),
+                      SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_SHARDED)
+            || !TEST_long_eq(shards = SSL_CTX_sess_get_cache_shards(sctx), 4))
+        goto end;
+
+    /* A full handshake followed by a resumption from the server cache */
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_ptr(sess = SSL_get1_session(clientssl))
+            || !TEST_long_eq(SSL_CTX_sess_number(sctx), 1))
+        goto end;
+    shutdown_ssl_connection(serverssl, clientssl);
+    serverssl = clientssl = NULL;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(SSL_set_session(clientssl, sess))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(SSL_session_reused(clientssl)))
+        goto end;
+    shutdown_ssl_connection(serverssl, clientssl);
+    serverssl = clientssl = NULL;
+
+    for (i = 0; i < shards; i++)
+        hits += SSL_CTX_sess_shard_hits(sctx, i);
+    if (!TEST_long_eq(hits, 1)
+            || !TEST_long_eq(SSL_CTX_sess_shard_hits(sctx, shards), 0))
+        goto end;
+
+    /* Overfill the cache, each shard holds at most two sessions */
+    for (i = 0; i < 64; i++) {
+        memset(id, 0, sizeof(id));
+        id[0] = (unsigned char)i;
+        id[SSL_MAX_SSL_SESSION_ID_LENGTH - 1] = (unsigned char)(i * 7);
+        if (!TEST_ptr(extra = SSL_SESSION_new())
+                || !TEST_true(SSL_SESSION_set1_id(extra, id, sizeof(id)))
+                || !TEST_true(SSL_CTX_add_session(sctx, extra)))
+            goto end;
+        SSL_SESSION_free(extra);
+        extra = NULL;
+    }
+    for (i = 0; i < shards; i++) {
+        if (!TEST_long_le(SSL_CTX_sess_shard_number(sctx, i), 2))
+            goto end;
+        number += SSL_CTX_sess_shard_number(sctx, i);
+        evictions += SSL_CTX_sess_shard_evictions(sctx, i);
+    }
+    if (!TEST_long_eq(SSL_CTX_sess_number(sctx), number)
+            || !TEST_long_eq(evictions, 65 - number)
+            || !TEST_long_eq(SSL_CTX_sess_cache_full(sctx), evictions))
+        goto end;
+
+    /* Once the cache is in use the shards stay */
+    SSL_CTX_set_session_cache_mode(sctx, SSL_SESS_CACHE_SERVER);
+    if (!TEST_long_eq(SSL_CTX_get_session_cache_mode(sctx),
+                      SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_SHARDED)
+            || !TEST_long_eq(SSL_CTX_sess_set_cache_shards(sctx, 2), 0)
+            || !TEST_long_eq(SSL_CTX_sess_get_cache_shards(sctx), shards)
+            || !TEST_long_eq(SSL_CTX_sess_number(sctx), number))
+        goto end;
+    ERR_clear_error();
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_SESSION_free(sess);
+    SSL_SESSION_free(extra);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+#endif
+
 static int test_session_with_only_int_cache(void)
 {
 #ifndef OPENSSL_NO_TLS1_3
@@ -4773,6 +5064,55 @@ static int test_serverinfo(int tst)
     return testresult;
 }
 
+#ifndef OPENSSL_NO_CRYPTO_MDEBUG
+/*
+ * With OPENSSL_TEST_GETCOUNTS set, test_export_key_mat() also breaks the
+ * allocation counts down by handshake state.  Allocations made between two
+ * info callbacks on the same endpoint are charged to the state it was in.
+ */
+static int count_states = 0;
+static int alloc_mark;
+static const char *alloc_state[2];
+static struct {
+    int server;
+    const char *state;
+    int allocs;
+} alloc_by_state[64];
+static size_t alloc_by_state_num = 0;
+
+static int alloc_total(void)
+{
+    int mcount, rcount;
+
+    CRYPTO_get_alloc_counts(&mcount, &rcount, NULL);
+    return mcount + rcount;
+}
+
+static void alloc_state_cb(const SSL *s, int where, int ret)
+{
+    int server = SSL_is_server(s) ? 1 : 0;
+    int allocs = alloc_total() - alloc_mark;
+    const char *state = alloc_state[server];
+    size_t i;
+
+    if (state != NULL) {
+        for (i = 0; i < alloc_by_state_num; i++)
+            if (alloc_by_state[i].server == server
+                    && strcmp(alloc_by_state[i].state, state) == 0)
+                break;
+        if (i == alloc_by_state_num && i < OSSL_NELEM(alloc_by_state)) {
+            alloc_by_state[i].server = server;
+            alloc_by_state[i].state = state;
+            alloc_by_state_num++;
+        }
+        if (i < alloc_by_state_num)
+            alloc_by_state[i].allocs += allocs;
+    }
+    alloc_state[server] = SSL_state_string_long(s);
+    alloc_mark = alloc_total();
+}
+#endif
+
 /*
  * Test that SSL_export_keying_material() produces expected results. There are
  * no test vectors so all we do is test that both sides of the communication
@@ -4826,9 +5166,17 @@ static int test_export_key_mat(int tst)
     SSL_CTX_set_min_proto_version(cctx, protocols[tst]);
 
     if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl, NULL,
-                                      NULL))
-            || !TEST_true(create_ssl_connection(serverssl, clientssl,
-                                                SSL_ERROR_NONE)))
+                                      NULL)))
+        goto end;
+#ifndef OPENSSL_NO_CRYPTO_MDEBUG
+    if (count_states) {
+        SSL_set_info_callback(clientssl, alloc_state_cb);
+        SSL_set_info_callback(serverssl, alloc_state_cb);
+        alloc_state[0] = alloc_state[1] = NULL;
+        alloc_mark = alloc_total();
+    }
+#endif
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl, SSL_ERROR_NONE)))
         goto end;
 
     if (tst == 5) {
@@ -6832,32 +7180,38 @@ int setup_tests(void)
             || !TEST_ptr(tmpfilename = test_get_argument(2)))
         return 0;
 
+    cert = test_mk_file_path(certsdir, "servercert.pem");
+    if (cert == NULL)
+        return 0;
+
+    privkey = test_mk_file_path(certsdir, "serverkey.pem");
+    if (privkey == NULL) {
+        OPENSSL_free(cert);
+        return 0;
+    }
+
     if (getenv("OPENSSL_TEST_GETCOUNTS") != NULL) {
 #ifdef OPENSSL_NO_CRYPTO_MDEBUG
         TEST_error("not supported in this build");
         return 0;
 #else
         int i, mcount, rcount, fcount;
+        size_t j;
 
+        count_states = 1;
         for (i = 0; i < 4; i++)
             test_export_key_mat(i);
         CRYPTO_get_alloc_counts(&mcount, &rcount, &fcount);
         test_printf_stdout("malloc %d realloc %d free %d\n",
                 mcount, rcount, fcount);
+        for (j = 0; j < alloc_by_state_num; j++)
+            test_printf_stdout("%6d %s %s\n", alloc_by_state[j].allocs,
+                               alloc_by_state[j].server ? "server" : "client",
+                               alloc_by_state[j].state);
         return 1;
 #endif
     }
 
-    cert = test_mk_file_path(certsdir, "servercert.pem");
-    if (cert == NULL)
-        return 0;
-
-    privkey = test_mk_file_path(certsdir, "serverkey.pem");
-    if (privkey == NULL) {
-        OPENSSL_free(cert);
-        return 0;
-    }
-
 #if !defined(OPENSSL_NO_TLS1_2) && !defined(OPENSSL_NO_KTLS) \
     && !defined(OPENSSL_NO_SOCK)
     ADD_TEST(test_ktls_no_txrx_client_no_txrx_server);
@@ -6876,10 +7230,17 @@ int setup_tests(void)
     ADD_TEST(test_ktls_no_rx_client_server);
     ADD_TEST(test_ktls_no_tx_client_server);
     ADD_TEST(test_ktls_client_server);
+# ifndef OPENSSL_NO_TLS1_3
+    ADD_ALL_TESTS(test_ktls_tls13, 32);
+# endif
     ADD_TEST(test_ktls_sendfile);
+#endif
+#if !defined(OPENSSL_SYS_WINDOWS) && !defined(OPENSSL_SYS_VMS)
+    ADD_TEST(test_sendfile_buffered);
 #endif
     ADD_TEST(test_large_message_tls);
     ADD_TEST(test_large_message_tls_read_ahead);
+    ADD_TEST(test_buffer_pool);
 #ifndef OPENSSL_NO_DTLS
     ADD_TEST(test_large_message_dtls);
 #endif
@@ -6889,6 +7250,9 @@ int setup_tests(void)
     ADD_TEST(test_session_with_only_int_cache);
     ADD_TEST(test_session_with_only_ext_cache);
     ADD_TEST(test_session_with_both_cache);
+#ifndef OPENSSL_NO_TLS1_2
+    ADD_TEST(test_session_cache_sharded);
+#endif
 #ifndef OPENSSL_NO_TLS1_3
     ADD_ALL_TESTS(test_stateful_tickets, 3);
     ADD_ALL_TESTS(test_stateless_tickets, 3);
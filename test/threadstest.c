@@ -9,9 +9,16 @@
 
 #if defined(_WIN32)
 # include <windows.h>
+#else
+# include <sys/time.h>
 #endif
 
+#include <string.h>
+#include <openssl/async.h>
 #include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
 #include "testutil.h"
 
 #if !defined(OPENSSL_THREADS) || defined(CRYPTO_TDEBUG)
@@ -184,10 +191,398 @@ static int test_thread_local(void)
     return 1;
 }
 
+/*
+ * Concurrent method fetches, served from the method store query cache.
+ * Besides checking that every fetch succeeds, this reports the aggregate
+ * wall clock fetch rate for increasing thread counts so that scaling of the
+ * cache read path can be compared between builds (visible with V=1).
+ */
+#define MULTI_FETCH_MAX_THREADS   8
+#define MULTI_FETCH_ITERATIONS    20000
+
+static int multi_fetch_failures = 0;
+
+/* Wall clock time in seconds */
+static double multi_fetch_now(void)
+{
+#if defined(_WIN32)
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+#endif
+}
+
+static void multi_fetch_thread_cb(void)
+{
+    int i;
+
+    for (i = 0; i < MULTI_FETCH_ITERATIONS; i++) {
+        EVP_MD *md = EVP_MD_fetch(NULL, "SHA256", NULL);
+        EVP_CIPHER *cipher = EVP_CIPHER_fetch(NULL, "AES-128-CBC", NULL);
+
+        if (md == NULL || cipher == NULL)
+            multi_fetch_failures = 1;
+        EVP_MD_meth_free(md);
+        EVP_CIPHER_meth_free(cipher);
+    }
+}
+
+static int test_multi_fetch(void)
+{
+    thread_t threads[MULTI_FETCH_MAX_THREADS];
+    int nthreads, i;
+    double start, secs;
+
+    /* Warm the cache so that only hits are measured */
+    multi_fetch_thread_cb();
+    if (!TEST_false(multi_fetch_failures))
+        return 0;
+
+    for (nthreads = 1; nthreads <= MULTI_FETCH_MAX_THREADS; nthreads *= 2) {
+        start = multi_fetch_now();
+        for (i = 0; i < nthreads; i++)
+            if (!TEST_true(run_thread(&threads[i], multi_fetch_thread_cb)))
+                return 0;
+        for (i = 0; i < nthreads; i++)
+            if (!TEST_true(wait_for_thread(threads[i])))
+                return 0;
+        secs = multi_fetch_now() - start;
+        if (!TEST_false(multi_fetch_failures))
+            return 0;
+        if (secs > 0)
+            TEST_info("%d thread(s): %.0f fetches per second", nthreads,
+                      2.0 * nthreads * MULTI_FETCH_ITERATIONS / secs);
+    }
+    return 1;
+}
+
+/*
+ * Private key operations on one RSA key shared by several threads, each of
+ * which gets a blinding of its own.
+ */
+#define MULTI_RSA_THREADS       4
+#define MULTI_RSA_ITERATIONS    50
+
+static RSA *multi_rsa = NULL;
+static int multi_rsa_failures = 0;
+
+static void multi_rsa_thread_cb(void)
+{
+    unsigned char msg[16] = "thread test";
+    unsigned char sig[256], out[256];
+    int i, siglen;
+
+    for (i = 0; i < MULTI_RSA_ITERATIONS; i++) {
+        siglen = RSA_private_encrypt(sizeof(msg), msg, sig, multi_rsa,
+                                     RSA_PKCS1_PADDING);
+        if (siglen <= 0
+                || RSA_public_decrypt(siglen, sig, out, multi_rsa,
+                                      RSA_PKCS1_PADDING) != (int)sizeof(msg)
+                || memcmp(msg, out, sizeof(msg)) != 0)
+            multi_rsa_failures = 1;
+    }
+}
+
+static int test_multi_rsa(void)
+{
+    thread_t threads[MULTI_RSA_THREADS];
+    BIGNUM *e = NULL;
+    int i, testresult = 0;
+
+    if (!TEST_ptr(e = BN_new())
+            || !TEST_true(BN_set_word(e, RSA_F4))
+            || !TEST_ptr(multi_rsa = RSA_new())
+            || !TEST_true(RSA_generate_key_ex(multi_rsa, 1024, e, NULL)))
+        goto err;
+
+    multi_rsa_thread_cb();
+    for (i = 0; i < MULTI_RSA_THREADS; i++)
+        if (!TEST_true(run_thread(&threads[i], multi_rsa_thread_cb)))
+            goto err;
+    for (i = 0; i < MULTI_RSA_THREADS; i++)
+        if (!TEST_true(wait_for_thread(threads[i])))
+            goto err;
+    testresult = TEST_false(multi_rsa_failures);
+
+ err:
+    RSA_free(multi_rsa);
+    BN_free(e);
+    return testresult;
+}
+
+#if defined(OPENSSL_THREADS) && !defined(CRYPTO_TDEBUG) \
+    && !defined(OPENSSL_SYS_WINDOWS)
+# define TEST_ASYNC_SCHED
+# include <unistd.h>
+
+# define SCHED_THREADS   3
+# define SCHED_TASKS     300
+
+static ASYNC_SCHED *sched;
+static CRYPTO_RWLOCK *sched_lock;
+static int sched_done, sched_sum;
+
+static void sched_thread_cb(void)
+{
+    if (!ASYNC_SCHED_run(sched))
+        sched_sum = -1;
+    OPENSSL_thread_stop();
+}
+
+static void sched_done_cb(int status, int ret, void *arg)
+{
+    CRYPTO_THREAD_write_lock(sched_lock);
+    sched_done++;
+    if (status == ASYNC_FINISH)
+        sched_sum += ret;
+    CRYPTO_THREAD_unlock(sched_lock);
+}
+
+static void pipe_cleanup(ASYNC_WAIT_CTX *ctx, const void *key,
+                         OSSL_ASYNC_FD readfd, void *custom)
+{
+    close(readfd);
+    close(*(int *)custom);
+    OPENSSL_free(custom);
+}
+
+/*
+ * Pauses three times, in turns as a plain yield, after calling the wait ctx
+ * callback, and after making its own wait fd readable.
+ */
+static int sched_task(void *arg)
+{
+    ASYNC_WAIT_CTX *waitctx = ASYNC_get_wait_ctx(ASYNC_get_current_job());
+    ASYNC_callback_fn callback;
+    void *callback_arg;
+    int n = *(int *)arg, fds[2], *writefd;
+    char c = 0;
+
+    if (!ASYNC_pause_job()
+        || !ASYNC_WAIT_CTX_get_callback(waitctx, &callback, &callback_arg)
+        || callback == NULL
+        || !callback(callback_arg)
+        || !ASYNC_pause_job())
+        return 0;
+
+    if ((writefd = OPENSSL_malloc(sizeof(*writefd))) == NULL)
+        return 0;
+    if (pipe(fds) != 0) {
+        OPENSSL_free(writefd);
+        return 0;
+    }
+    *writefd = fds[1];
+    if (!ASYNC_WAIT_CTX_set_wait_fd(waitctx, &sched, fds[0], writefd,
+                                    pipe_cleanup)) {
+        pipe_cleanup(waitctx, &sched, fds[0], writefd);
+        return 0;
+    }
+    if (write(fds[1], &c, 1) != 1
+        || !ASYNC_pause_job()
+        || read(fds[0], &c, 1) != 1)
+        return 0;
+    return n;
+}
+
+static int test_async_sched(void)
+{
+    thread_t threads[SCHED_THREADS];
+    int i, expected = 0, testresult = 0;
+
+    if (!ASYNC_is_capable())
+        return TEST_skip("not async capable");
+    if (!TEST_ptr(sched_lock = CRYPTO_THREAD_lock_new())
+            || !TEST_ptr(sched = ASYNC_SCHED_new()))
+        goto err;
+    sched_done = sched_sum = 0;
+
+    for (i = 1; i <= SCHED_TASKS; i++) {
+        if (!TEST_true(ASYNC_SCHED_submit(sched, sched_task, &i, sizeof(i),
+                                          sched_done_cb, NULL)))
+            goto err;
+        expected += i;
+    }
+    /* Workers return once everything submitted so far is done */
+    ASYNC_SCHED_stop(sched);
+    if (!TEST_false(ASYNC_SCHED_submit(sched, sched_task, &i, sizeof(i),
+                                       sched_done_cb, NULL)))
+        goto err;
+
+    for (i = 0; i < SCHED_THREADS; i++)
+        if (!TEST_true(run_thread(&threads[i], sched_thread_cb)))
+            goto err;
+    for (i = 0; i < SCHED_THREADS; i++)
+        if (!TEST_true(wait_for_thread(threads[i])))
+            goto err;
+    testresult = TEST_int_eq(sched_done, SCHED_TASKS)
+                 && TEST_int_eq(sched_sum, expected);
+
+ err:
+    ERR_clear_error();
+    ASYNC_SCHED_free(sched);
+    CRYPTO_THREAD_lock_free(sched_lock);
+    return testresult;
+}
+
+static int migrate_fds[2];
+static volatile int migrate_paused, blocker_running, blocker_release;
+static CRYPTO_THREAD_ID migrate_tid[2];
+
+static int migrate_task(void *arg)
+{
+    ASYNC_WAIT_CTX *waitctx = ASYNC_get_wait_ctx(ASYNC_get_current_job());
+    char c;
+
+    migrate_tid[0] = CRYPTO_THREAD_get_current_id();
+    if (!ASYNC_WAIT_CTX_set_wait_fd(waitctx, &sched, migrate_fds[0], NULL,
+                                    NULL))
+        return 0;
+    migrate_paused = 1;
+    if (!ASYNC_pause_job())
+        return 0;
+    migrate_tid[1] = CRYPTO_THREAD_get_current_id();
+    blocker_release = 1;
+    return read(migrate_fds[0], &c, 1) == 1
+           && ASYNC_WAIT_CTX_clear_fd(waitctx, &sched);
+}
+
+/* Keeps its worker busy until migrate_task() has been resumed */
+static int blocker_task(void *arg)
+{
+    blocker_running = 1;
+    while (!blocker_release)
+        continue;
+    return 1;
+}
+
+/*
+ * A job that pauses on the only worker there is, which is then kept busy, is
+ * resumed by a worker that joins later.
+ */
+static int test_async_sched_migrate(void)
+{
+    thread_t threads[2];
+    int started = 0, testresult = 0;
+    char c = 0;
+
+    if (!ASYNC_is_capable())
+        return TEST_skip("not async capable");
+    migrate_fds[0] = migrate_fds[1] = -1;
+    migrate_paused = blocker_running = blocker_release = 0;
+    if (!TEST_ptr(sched_lock = CRYPTO_THREAD_lock_new())
+            || !TEST_ptr(sched = ASYNC_SCHED_new())
+            || !TEST_int_eq(pipe(migrate_fds), 0))
+        goto err;
+    sched_done = sched_sum = 0;
+
+    if (!TEST_true(ASYNC_SCHED_submit(sched, migrate_task, NULL, 0,
+                                      sched_done_cb, NULL))
+            || !TEST_true(run_thread(&threads[started++], sched_thread_cb)))
+        goto err;
+    while (!migrate_paused)
+        continue;
+    if (!TEST_true(ASYNC_SCHED_submit(sched, blocker_task, NULL, 0,
+                                      sched_done_cb, NULL)))
+        goto err;
+    while (!blocker_running)
+        continue;
+    if (!TEST_true(run_thread(&threads[started++], sched_thread_cb))
+            || !TEST_int_eq(write(migrate_fds[1], &c, 1), 1))
+        goto err;
+    ASYNC_SCHED_stop(sched);
+    while (started > 0)
+        if (!TEST_true(wait_for_thread(threads[--started])))
+            goto err;
+
+    testresult = TEST_int_eq(sched_done, 2)
+                 && TEST_int_eq(sched_sum, 2)
+                 && TEST_false(CRYPTO_THREAD_compare_id(migrate_tid[0],
+                                                        migrate_tid[1]));
+
+ err:
+    if (started > 0) {
+        /* Let the workers finish whatever happened */
+        blocker_release = 1;
+        if (write(migrate_fds[1], &c, 1) != 1)
+            TEST_info("could not wake the paused task");
+        ASYNC_SCHED_stop(sched);
+        while (started > 0)
+            wait_for_thread(threads[--started]);
+    }
+    ASYNC_SCHED_free(sched);
+    CRYPTO_THREAD_lock_free(sched_lock);
+    if (migrate_fds[0] != -1) {
+        close(migrate_fds[0]);
+        close(migrate_fds[1]);
+    }
+    return testresult;
+}
+
+static ASYNC_JOB *pool_job;
+static ASYNC_WAIT_CTX *pool_waitctx;
+static int pool_status;
+
+static int pause_once(void *arg)
+{
+    return ASYNC_pause_job();
+}
+
+static void pool_resume_cb(void)
+{
+    int ret;
+
+    pool_status = ASYNC_start_job(&pool_job, pool_waitctx, &ret, pause_once,
+                                  NULL, 0);
+    OPENSSL_thread_stop();
+}
+
+/*
+ * A job finished by another thread no longer counts against the pool of the
+ * thread that started it.
+ */
+static int test_async_migrate_pool(void)
+{
+    thread_t thread;
+    int ret, testresult = 0;
+
+    if (!ASYNC_is_capable())
+        return TEST_skip("not async capable");
+    pool_job = NULL;
+    if (!TEST_true(ASYNC_init_thread(1, 0))
+            || !TEST_ptr(pool_waitctx = ASYNC_WAIT_CTX_new())
+            || !TEST_int_eq(ASYNC_start_job(&pool_job, pool_waitctx, &ret,
+                                            pause_once, NULL, 0), ASYNC_PAUSE)
+            || !TEST_true(run_thread(&thread, pool_resume_cb))
+            || !TEST_true(wait_for_thread(thread))
+            || !TEST_int_eq(pool_status, ASYNC_FINISH)
+            || !TEST_int_eq(ASYNC_start_job(&pool_job, pool_waitctx, &ret,
+                                            pause_once, NULL, 0), ASYNC_PAUSE)
+            || !TEST_int_eq(ASYNC_start_job(&pool_job, pool_waitctx, &ret,
+                                            pause_once, NULL, 0), ASYNC_FINISH))
+        goto err;
+    testresult = 1;
+
+ err:
+    ASYNC_WAIT_CTX_free(pool_waitctx);
+    ASYNC_cleanup_thread();
+    return testresult;
+}
+#endif
+
 int setup_tests(void)
 {
     ADD_TEST(test_lock);
     ADD_TEST(test_once);
     ADD_TEST(test_thread_local);
+    ADD_TEST(test_multi_fetch);
+    ADD_TEST(test_multi_rsa);
+#ifdef TEST_ASYNC_SCHED
+    ADD_TEST(test_async_sched);
+    ADD_TEST(test_async_sched_migrate);
+    ADD_TEST(test_async_migrate_pool);
+#endif
     return 1;
 }
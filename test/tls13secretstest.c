@@ -11,6 +11,7 @@
 #include <openssl/evp.h>
 
 #include "../ssl/ssl_locl.h"
+#include "../ssl/record/record_locl.h"
 #include "testutil.h"
 
 #define IVLEN   12
@@ -165,6 +166,23 @@ void RECORD_LAYER_reset_write_sequence(RECORD_LAYER *rl)
 {
 }
 
+#ifndef OPENSSL_NO_KTLS
+int RECORD_LAYER_read_pending(const RECORD_LAYER *rl)
+{
+    return 0;
+}
+
+int ssl3_release_write_buffer(SSL *s)
+{
+    return 1;
+}
+
+unsigned int ssl_get_max_send_fragment(const SSL *ssl)
+{
+    return SSL3_RT_MAX_PLAIN_LENGTH;
+}
+#endif
+
 int ssl_cipher_get_evp(const SSL_SESSION *s, const EVP_CIPHER **enc,
                        const EVP_MD **md, int *mac_pkey_type,
                        size_t *mac_secret_size, SSL_COMP **comp, int use_etm)
@@ -12,6 +12,7 @@
 #include <openssl/crypto.h>
 #include <openssl/bio.h>
 #include <openssl/x509.h>
+#include <openssl/x509v3.h>
 #include <openssl/pem.h>
 #include <openssl/err.h>
 #include "testutil.h"
@@ -20,6 +21,7 @@ static const char *roots_f;
 static const char *untrusted_f;
 static const char *bad_f;
 static const char *req_f;
+static const char *dir_f;
 
 static STACK_OF(X509) *load_certs_from_file(const char *filename)
 {
@@ -177,7 +179,361 @@ static int test_store_ctx(void)
     return testresult;
 }
 
-OPT_TEST_DECLARE_USAGE("roots.pem untrusted.pem bad.pem\n")
+/*
+ * Check that lookups in a store find certificates added to it, both through
+ * the API and directly to the stack returned by X509_STORE_get0_objects().
+ */
+static int test_store_lookup(void)
+{
+    int ret = 0;
+    X509 *leaf, *subinter;
+    X509_OBJECT *obj = NULL;
+    STACK_OF(X509) *untrusted = NULL, *found = NULL;
+    X509_STORE_CTX *sctx = NULL;
+    X509_STORE *store = NULL;
+    X509_LOOKUP *lookup = NULL;
+
+    if (!TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(lookup = X509_STORE_add_lookup(store,
+                                                        X509_LOOKUP_file()))
+            || !TEST_true(X509_LOOKUP_load_file(lookup, roots_f,
+                                                X509_FILETYPE_PEM))
+            || !TEST_ptr(untrusted = load_certs_from_file(untrusted_f))
+            || !TEST_ptr(subinter = sk_X509_value(untrusted, 0))
+            || !TEST_ptr(leaf = sk_X509_value(untrusted, 1))
+            || !TEST_ptr(sctx = X509_STORE_CTX_new())
+            || !TEST_true(X509_STORE_CTX_init(sctx, store, leaf, NULL)))
+        goto err;
+
+    /* The self-signed subinterCA from roots.pem */
+    if (!TEST_ptr(found = X509_STORE_CTX_get1_certs(sctx,
+                                  X509_get_subject_name(subinter)))
+            || !TEST_int_eq(sk_X509_num(found), 1))
+        goto err;
+    sk_X509_pop_free(found, X509_free);
+    found = NULL;
+
+    /* Adding the same certificate twice keeps one copy */
+    if (!TEST_true(X509_STORE_add_cert(store, subinter))
+            || !TEST_true(X509_STORE_add_cert(store, subinter))
+            || !TEST_int_eq(sk_X509_OBJECT_num(X509_STORE_get0_objects(store)),
+                            3)
+            || !TEST_ptr(found = X509_STORE_CTX_get1_certs(sctx,
+                                  X509_get_subject_name(subinter)))
+            || !TEST_int_eq(sk_X509_num(found), 2))
+        goto err;
+    sk_X509_pop_free(found, X509_free);
+    found = NULL;
+
+    /* Objects pushed directly are found too */
+    if (!TEST_ptr_null(X509_STORE_CTX_get1_certs(sctx,
+                                  X509_get_subject_name(leaf)))
+            || !TEST_ptr(obj = X509_OBJECT_new())
+            || !TEST_true(X509_OBJECT_set1_X509(obj, leaf))
+            || !TEST_true(X509_STORE_lock(store)))
+        goto err;
+    if (!TEST_true(sk_X509_OBJECT_push(X509_STORE_get0_objects(store), obj))) {
+        X509_STORE_unlock(store);
+        goto err;
+    }
+    obj = NULL;
+    X509_STORE_unlock(store);
+    if (!TEST_ptr(found = X509_STORE_CTX_get1_certs(sctx,
+                                  X509_get_subject_name(leaf)))
+            || !TEST_int_eq(sk_X509_num(found), 1)
+            || !TEST_ptr_eq(sk_X509_value(found, 0), leaf))
+        goto err;
+
+    /* The leaf's issuer is found by its key identifier and name */
+    if (!TEST_int_eq(X509_verify_cert(sctx), 1))
+        goto err;
+
+    ret = 1;
+ err:
+    X509_OBJECT_free(obj);
+    sk_X509_pop_free(found, X509_free);
+    X509_STORE_CTX_free(sctx);
+    sk_X509_pop_free(untrusted, X509_free);
+    X509_STORE_free(store);
+    return ret;
+}
+
+static int write_hashed_cert(X509 *x)
+{
+    char path[1024];
+    BIO *bio;
+    int ret;
+
+    BIO_snprintf(path, sizeof(path), "%s/%08lx.0", dir_f,
+                 X509_NAME_hash(X509_get_subject_name(x)));
+    if (!TEST_ptr(bio = BIO_new_file(path, "w")))
+        return 0;
+    ret = TEST_true(PEM_write_bio_X509(bio, x));
+    BIO_free(bio);
+    return ret;
+}
+
+/*
+ * Look up certificates in an initially empty hashed directory, and check
+ * that files added to it are found, but only once the index TTL has passed.
+ */
+static int test_dir_lookup(void)
+{
+    int ret = 0;
+    X509 *leaf;
+    STACK_OF(X509) *roots = NULL, *untrusted = NULL, *found = NULL;
+    X509_STORE_CTX *sctx = NULL;
+    X509_STORE *store = NULL;
+    X509_LOOKUP *lookup = NULL;
+
+    if (!TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(lookup = X509_STORE_add_lookup(store,
+                                                        X509_LOOKUP_hash_dir()))
+            || !TEST_true(X509_LOOKUP_add_dir(lookup, dir_f,
+                                              X509_FILETYPE_PEM))
+            || !TEST_ptr(roots = load_certs_from_file(roots_f))
+            || !TEST_int_eq(sk_X509_num(roots), 2)
+            || !TEST_ptr(untrusted = load_certs_from_file(untrusted_f))
+            || !TEST_ptr(leaf = sk_X509_value(untrusted, 1))
+            || !TEST_ptr(sctx = X509_STORE_CTX_new()))
+        goto err;
+
+    /* Nothing to find yet */
+    if (!TEST_true(X509_STORE_CTX_init(sctx, store, leaf, untrusted))
+            || !TEST_int_le(X509_verify_cert(sctx), 0))
+        goto err;
+    X509_STORE_CTX_cleanup(sctx);
+
+    /* With a TTL of 0 a new file is picked up by the next lookup */
+    if (!write_hashed_cert(sk_X509_value(roots, 1))
+            || !TEST_true(X509_STORE_CTX_init(sctx, store, leaf, untrusted))
+            || !TEST_int_eq(X509_verify_cert(sctx), 1))
+        goto err;
+    X509_STORE_CTX_cleanup(sctx);
+
+    /* With a long TTL the index is not revalidated */
+    if (!TEST_true(X509_LOOKUP_set_dir_ttl(lookup, 3600))
+            || !TEST_true(X509_STORE_CTX_init(sctx, store, leaf, NULL))
+            || !TEST_ptr_null(X509_STORE_CTX_get1_certs(sctx,
+                                  X509_get_subject_name(leaf)))
+            || !write_hashed_cert(leaf)
+            || !TEST_ptr_null(X509_STORE_CTX_get1_certs(sctx,
+                                  X509_get_subject_name(leaf)))
+            || !TEST_true(X509_LOOKUP_set_dir_ttl(lookup, 0))
+            || !TEST_ptr(found = X509_STORE_CTX_get1_certs(sctx,
+                                  X509_get_subject_name(leaf)))
+            || !TEST_int_eq(sk_X509_num(found), 1)
+            || !TEST_int_eq(X509_cmp(sk_X509_value(found, 0), leaf), 0))
+        goto err;
+
+    /* A name without a file is still not found */
+    if (!TEST_ptr_null(X509_STORE_CTX_get1_certs(sctx,
+                           X509_get_subject_name(sk_X509_value(roots, 0)))))
+        goto err;
+
+    ret = 1;
+ err:
+    sk_X509_pop_free(found, X509_free);
+    X509_STORE_CTX_free(sctx);
+    sk_X509_pop_free(roots, X509_free);
+    sk_X509_pop_free(untrusted, X509_free);
+    X509_STORE_free(store);
+    return ret;
+}
+
+/*
+ * Write the trust anchors to a bundle, indexed or not, and check that they
+ * are only decoded once they are looked up.
+ */
+static int test_bundle_lookup(int idx)
+{
+    int ret = 0;
+    char path[1024];
+    X509 *leaf;
+    STACK_OF(X509) *roots = NULL, *untrusted = NULL;
+    X509_STORE_CTX *sctx = NULL;
+    X509_STORE *store = NULL;
+    X509_LOOKUP *lookup = NULL;
+    X509_OBJECT *obj = NULL;
+    BIO *bio = NULL;
+    int i;
+
+    BIO_snprintf(path, sizeof(path), "%s/bundle%d", dir_f, idx);
+    if (!TEST_ptr(roots = load_certs_from_file(roots_f))
+            || !TEST_ptr(untrusted = load_certs_from_file(untrusted_f))
+            || !TEST_ptr(leaf = sk_X509_value(untrusted, 1))
+            || !TEST_ptr(bio = BIO_new_file(path, "wb")))
+        goto err;
+    if (idx == 0) {
+        if (!TEST_true(X509_bundle_write_bio(bio, roots)))
+            goto err;
+    } else {
+        for (i = 0; i < sk_X509_num(roots); i++)
+            if (!TEST_true(i2d_X509_bio(bio, sk_X509_value(roots, i))))
+                goto err;
+    }
+    BIO_free(bio);
+    bio = NULL;
+
+    if (!TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(lookup = X509_STORE_add_lookup(store,
+                                                        X509_LOOKUP_bundle()))
+            || !TEST_false(X509_LOOKUP_load_file(lookup, path,
+                                                 X509_FILETYPE_PEM))
+            || !TEST_false(X509_LOOKUP_load_file(lookup, roots_f,
+                                                 X509_FILETYPE_ASN1))
+            || !TEST_true(X509_LOOKUP_load_file(lookup, path,
+                                                X509_FILETYPE_ASN1))
+            || !TEST_int_eq(sk_X509_OBJECT_num(X509_STORE_get0_objects(store)),
+                            0)
+            || !TEST_ptr(sctx = X509_STORE_CTX_new())
+            || !TEST_true(X509_STORE_CTX_init(sctx, store, leaf, untrusted)))
+        goto err;
+
+    /* A successful lookup leaves errors that were already queued alone */
+    ERR_clear_error();
+    ERR_raise(ERR_LIB_X509, ERR_R_PASSED_INVALID_ARGUMENT);
+    if (!TEST_ptr(obj = X509_OBJECT_new())
+            || !TEST_int_eq(X509_STORE_CTX_get_by_subject(sctx, X509_LU_X509,
+                                X509_get_issuer_name(leaf), obj), 1)
+            || !TEST_int_eq(ERR_GET_REASON(ERR_peek_error()),
+                            ERR_R_PASSED_INVALID_ARGUMENT)
+            || !TEST_int_eq(X509_verify_cert(sctx), 1)
+            || !TEST_int_eq(sk_X509_OBJECT_num(X509_STORE_get0_objects(store)),
+                            1))
+        goto err;
+    X509_STORE_CTX_cleanup(sctx);
+
+    /* A name that is not in the bundle is not found */
+    if (!TEST_true(X509_STORE_CTX_init(sctx, store, leaf, NULL))
+            || !TEST_ptr_null(X509_STORE_CTX_get1_certs(sctx,
+                                  X509_get_subject_name(leaf))))
+        goto err;
+
+    ret = 1;
+ err:
+    ERR_clear_error();
+    X509_OBJECT_free(obj);
+    BIO_free(bio);
+    X509_STORE_CTX_free(sctx);
+    sk_X509_pop_free(roots, X509_free);
+    sk_X509_pop_free(untrusted, X509_free);
+    X509_STORE_free(store);
+    return ret;
+}
+
+static int verify_leaf(X509_STORE *store, X509 *x, STACK_OF(X509) *untrusted)
+{
+    X509_STORE_CTX *sctx = X509_STORE_CTX_new();
+    int ret = 0;
+
+    if (TEST_ptr(sctx)
+            && TEST_true(X509_STORE_CTX_init(sctx, store, x, untrusted))) {
+        ret = X509_verify_cert(sctx) == 1
+              && X509_STORE_CTX_get_error(sctx) == X509_V_OK
+              && sk_X509_num(X509_STORE_CTX_get0_chain(sctx)) > 1
+              && sk_X509_value(X509_STORE_CTX_get0_chain(sctx), 0) == x;
+    }
+    X509_STORE_CTX_free(sctx);
+    return ret;
+}
+
+static int chain_cache_check_issued(X509_STORE_CTX *ctx, X509 *x,
+                                    X509 *issuer)
+{
+    return X509_check_issued(issuer, x) == X509_V_OK;
+}
+
+/*
+ * Verify the "leaf" certificate from untrusted.pem a few times with the
+ * verified chain cache enabled and check that only the first verification
+ * of each distinct input misses.
+ */
+static int test_chain_cache(void)
+{
+    int ret = 0;
+    X509 *x = NULL, *copy = NULL;
+    STACK_OF(X509) *untrusted = NULL, *single = NULL;
+    X509_STORE *store = NULL;
+    X509_LOOKUP *lookup = NULL;
+
+    if (!TEST_ptr(store = X509_STORE_new())
+            || !TEST_ptr(lookup = X509_STORE_add_lookup(store,
+                                                        X509_LOOKUP_file()))
+            || !TEST_true(X509_LOOKUP_load_file(lookup, roots_f,
+                                                X509_FILETYPE_PEM))
+            || !TEST_ptr(untrusted = load_certs_from_file(untrusted_f))
+            || !TEST_int_eq(sk_X509_num(untrusted), 2)
+            || !TEST_ptr(x = sk_X509_value(untrusted, 1))
+            || !TEST_ptr(copy = X509_dup(x))
+            || !TEST_ptr(single = sk_X509_new_null())
+            || !TEST_true(sk_X509_push(single, sk_X509_value(untrusted, 0))))
+        goto err;
+
+    /* Disabled cache */
+    if (!TEST_true(verify_leaf(store, x, untrusted))
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_misses(store), 0)
+            || !TEST_false(X509_STORE_set_chain_cache(store, 16, 0))
+            || !TEST_true(X509_STORE_set_chain_cache(store, 16, 3600)))
+        goto err;
+
+    /* First verification misses, identical ones hit, even for a copy */
+    if (!TEST_true(verify_leaf(store, x, untrusted))
+            || !TEST_true(verify_leaf(store, x, untrusted))
+            || !TEST_true(verify_leaf(store, copy, untrusted))
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_misses(store), 1)
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_hits(store), 2))
+        goto err;
+
+    /* A different untrusted set is a different entry */
+    if (!TEST_true(verify_leaf(store, x, single))
+            || !TEST_true(verify_leaf(store, x, single))
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_misses(store), 2)
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_hits(store), 3))
+        goto err;
+
+    /* So are different verification parameters */
+    X509_STORE_set_flags(store, X509_V_FLAG_PARTIAL_CHAIN);
+    if (!TEST_true(verify_leaf(store, x, untrusted))
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_misses(store), 3))
+        goto err;
+
+    /* Flushing, and adding to the store, invalidate all entries */
+    X509_STORE_flush_chain_cache(store);
+    if (!TEST_true(verify_leaf(store, x, untrusted))
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_misses(store), 4)
+            || !TEST_true(X509_STORE_add_cert(store, sk_X509_value(untrusted,
+                                                                   0)))
+            || !TEST_true(verify_leaf(store, x, untrusted))
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_misses(store), 5)
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_hits(store), 3))
+        goto err;
+
+    /* Chains found through store callbacks aren't cached */
+    X509_STORE_set_check_issued(store, chain_cache_check_issued);
+    if (!TEST_true(verify_leaf(store, x, untrusted))
+            || !TEST_true(verify_leaf(store, x, untrusted))
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_misses(store), 5)
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_hits(store), 3))
+        goto err;
+    X509_STORE_set_check_issued(store, NULL);
+
+    /* Turning the cache off */
+    if (!TEST_true(X509_STORE_set_chain_cache(store, 0, 0))
+            || !TEST_true(verify_leaf(store, x, untrusted))
+            || !TEST_ulong_eq(X509_STORE_get_chain_cache_hits(store), 3))
+        goto err;
+
+    ret = 1;
+ err:
+    X509_free(copy);
+    sk_X509_free(single);
+    sk_X509_pop_free(untrusted, X509_free);
+    X509_STORE_free(store);
+    return ret;
+}
+
+OPT_TEST_DECLARE_USAGE("roots.pem untrusted.pem bad.pem sm2-csr.pem dir\n")
 
 #ifndef OPENSSL_NO_SM2
 static int test_sm2_id(void)
@@ -266,11 +622,16 @@ int setup_tests(void)
     if (!TEST_ptr(roots_f = test_get_argument(0))
             || !TEST_ptr(untrusted_f = test_get_argument(1))
             || !TEST_ptr(bad_f = test_get_argument(2))
-            || !TEST_ptr(req_f = test_get_argument(3)))
+            || !TEST_ptr(req_f = test_get_argument(3))
+            || !TEST_ptr(dir_f = test_get_argument(4)))
         return 0;
 
     ADD_TEST(test_alt_chains_cert_forgery);
     ADD_TEST(test_store_ctx);
+    ADD_TEST(test_store_lookup);
+    ADD_TEST(test_chain_cache);
+    ADD_TEST(test_dir_lookup);
+    ADD_ALL_TESTS(test_bundle_lookup, 2);
 #ifndef OPENSSL_NO_SM2
     ADD_TEST(test_sm2_id);
     ADD_TEST(test_req_sm2_id);